@@ -0,0 +1,67 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Epoll-based event dispatcher
+ */
+
+#pragma once
+
+#include <list>
+#include <map>
+#include <vector>
+
+#include <libcamera/base/private.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+struct epoll_event;
+
+namespace libcamera {
+
+class EventNotifier;
+class Timer;
+
+class EventDispatcherEpoll final : public EventDispatcher
+{
+public:
+	EventDispatcherEpoll();
+	~EventDispatcherEpoll();
+
+	void registerEventNotifier(EventNotifier *notifier);
+	void unregisterEventNotifier(EventNotifier *notifier);
+
+	void registerTimer(Timer *timer);
+	void unregisterTimer(Timer *timer);
+
+	void processEvents();
+	void interrupt();
+
+private:
+	struct EventNotifierEpoll {
+		EventNotifier *notifier = nullptr;
+		UniqueFD fd;
+	};
+
+	void armTimer();
+	void processInterrupt();
+	void processTimerfd();
+	void processNotifiers(const struct epoll_event *events, int count);
+	void processTimers();
+
+	std::map<EventNotifier *, EventNotifierEpoll> notifiers_;
+	std::vector<EventNotifier *> staleNotifiers_;
+	std::list<Timer *> timers_;
+	std::vector<struct epoll_event> events_;
+
+	UniqueFD epollfd_;
+	UniqueFD eventfd_;
+	UniqueFD timerfd_;
+	utils::time_point timerDeadline_;
+
+	bool processingEvents_;
+};
+
+} /* namespace libcamera */
@@ -43,14 +43,18 @@ public:
 	static pid_t currentId();
 
 	EventDispatcher *eventDispatcher();
+	void setEventDispatcher(std::unique_ptr<EventDispatcher> dispatcher);
 
-	void dispatchMessages(Message::Type type = Message::Type::None);
+	void dispatchMessages(Message::Type type = Message::Type::None,
+			      Object *receiver = nullptr);
 
 protected:
 	int exec();
 	virtual void run();
 
 private:
+	static EventDispatcher *createEventDispatcher();
+
 	void startThread();
 	void finishThread();
 
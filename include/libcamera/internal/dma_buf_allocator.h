@@ -7,13 +7,17 @@
 
 #pragma once
 
+#include <memory>
 #include <stddef.h>
+#include <vector>
 
 #include <libcamera/base/flags.h>
 #include <libcamera/base/unique_fd.h>
 
 namespace libcamera {
 
+class FrameBuffer;
+
 class DmaBufAllocator
 {
 public:
@@ -25,16 +29,40 @@ public:
 
 	using DmaBufAllocatorFlags = Flags<DmaBufAllocatorFlag>;
 
+	struct PoolStats {
+		unsigned int hits;
+		unsigned int misses;
+		unsigned int evictions;
+		unsigned int buffers;
+		std::size_t size;
+	};
+
 	DmaBufAllocator(DmaBufAllocatorFlags flags = DmaBufAllocatorFlag::CmaHeap);
 	~DmaBufAllocator();
 	bool isValid() const { return providerHandle_.isValid(); }
 	UniqueFD alloc(const char *name, std::size_t size);
 
+	int exportBuffers(unsigned int count,
+			  const std::vector<unsigned int> &planeSizes,
+			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
+
+	void setPoolLimit(std::size_t limit);
+	PoolStats poolStats() const;
+
 private:
+	class Pool;
+	class PooledBufferData;
+
+	std::unique_ptr<FrameBuffer> createBuffer(const char *name,
+						  const std::vector<unsigned int> &planeSizes);
+
+	UniqueFD allocPooled(const char *name, std::size_t size);
 	UniqueFD allocFromHeap(const char *name, std::size_t size);
 	UniqueFD allocFromUDmaBuf(const char *name, std::size_t size);
 	UniqueFD providerHandle_;
 	DmaBufAllocatorFlag type_;
+
+	std::shared_ptr<Pool> pool_;
 };
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(DmaBufAllocator::DmaBufAllocatorFlag)
@@ -9,12 +9,17 @@
 
 #include <memory>
 #include <utility>
+#include <vector>
 
 #include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
 
 #include <libcamera/fence.h>
 #include <libcamera/framebuffer.h>
 
+#include "libcamera/internal/mapped_framebuffer.h"
+
 namespace libcamera {
 
 class FrameBuffer::Private : public Extensible::Private
@@ -35,6 +40,8 @@ public:
 
 	FrameMetadata &metadata() { return metadata_; }
 
+	const MappedFrameBuffer *map(MappedFrameBuffer::MapFlags flags) const;
+
 private:
 	std::vector<Plane> planes_;
 	FrameMetadata metadata_;
@@ -43,6 +50,10 @@ private:
 	std::unique_ptr<Fence> fence_;
 	Request *request_;
 	bool isContiguous_;
+
+	mutable Mutex mappingsLock_;
+	mutable std::vector<std::unique_ptr<MappedFrameBuffer>> mappings_
+		LIBCAMERA_TSA_GUARDED_BY(mappingsLock_);
 };
 
 } /* namespace libcamera */
@@ -12,6 +12,7 @@
 #include <string.h>
 #include <tuple>
 #include <type_traits>
+#include <utility>
 #include <vector>
 
 #include <libcamera/base/flags.h>
@@ -41,6 +42,15 @@ void appendPOD(std::vector<uint8_t> &vec, T val)
 	memcpy(&*(vec.end() - byteWidth), &val, byteWidth);
 }
 
+template<typename T,
+	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
+void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+{
+	ASSERT(pos + sizeof(val) <= vec.size());
+
+	memcpy(vec.data() + pos, &val, sizeof(val));
+}
+
 template<typename T,
 	 std::enable_if_t<std::is_arithmetic_v<T>> * = nullptr>
 T readPOD(std::vector<uint8_t>::const_iterator it, size_t pos,
@@ -69,6 +79,9 @@ class IPADataSerializer
 public:
 	static std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
 	serialize(const T &data, ControlSerializer *cs = nullptr);
+	static void serialize(const T &data, std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec,
+			      ControlSerializer *cs = nullptr);
 
 	static T deserialize(const std::vector<uint8_t> &data,
 			     ControlSerializer *cs = nullptr);
@@ -88,6 +101,42 @@ public:
 
 #ifndef __DOXYGEN__
 
+template<typename T>
+std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+IPADataSerializer<T>::serialize(const T &data, ControlSerializer *cs)
+{
+	std::vector<uint8_t> dataVec;
+	std::vector<SharedFD> fdsVec;
+
+	serialize(data, dataVec, fdsVec, cs);
+
+	return { std::move(dataVec), std::move(fdsVec) };
+}
+
+namespace {
+
+/*
+ * Serialize an element of a container, prefixed with its size in bytes and
+ * its number of fds, directly into the container's vectors.
+ */
+template<typename V>
+void appendElement(const V &data, std::vector<uint8_t> &dataVec,
+		   std::vector<SharedFD> &fdsVec, ControlSerializer *cs)
+{
+	const size_t offset = dataVec.size();
+	const size_t fdsOffset = fdsVec.size();
+
+	appendPOD<uint32_t>(dataVec, 0);
+	appendPOD<uint32_t>(dataVec, 0);
+
+	IPADataSerializer<V>::serialize(data, dataVec, fdsVec, cs);
+
+	writePOD<uint32_t>(dataVec, offset, dataVec.size() - offset - 8);
+	writePOD<uint32_t>(dataVec, offset + 4, fdsVec.size() - fdsOffset);
+}
+
+} /* namespace */
+
 /*
  * Serialization format for vector of type V:
  *
@@ -111,26 +160,21 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, dataVec, fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::vector<V> &data, std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec, ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t vecLen = data.size();
 		appendPOD<uint32_t>(dataVec, vecLen);
 
 		/* Serialize the members. */
-		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-		}
-
-		return { dataVec, fdsVec };
+		for (auto const &it : data)
+			appendElement<V>(it, dataVec, fdsVec, cs);
 	}
 
 	static std::vector<V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -208,35 +252,23 @@ public:
 		std::vector<uint8_t> dataVec;
 		std::vector<SharedFD> fdsVec;
 
+		serialize(data, dataVec, fdsVec, cs);
+
+		return { std::move(dataVec), std::move(fdsVec) };
+	}
+
+	static void serialize(const std::map<K, V> &data, std::vector<uint8_t> &dataVec,
+			      std::vector<SharedFD> &fdsVec, ControlSerializer *cs = nullptr)
+	{
 		/* Serialize the length. */
 		uint32_t mapLen = data.size();
 		appendPOD<uint32_t>(dataVec, mapLen);
 
 		/* Serialize the members. */
 		for (auto const &it : data) {
-			std::vector<uint8_t> dvec;
-			std::vector<SharedFD> fvec;
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<K>::serialize(it.first, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
-
-			std::tie(dvec, fvec) =
-				IPADataSerializer<V>::serialize(it.second, cs);
-
-			appendPOD<uint32_t>(dataVec, dvec.size());
-			appendPOD<uint32_t>(dataVec, fvec.size());
-
-			dataVec.insert(dataVec.end(), dvec.begin(), dvec.end());
-			fdsVec.insert(fdsVec.end(), fvec.begin(), fvec.end());
+			appendElement<K>(it.first, dataVec, fdsVec, cs);
+			appendElement<V>(it.second, dataVec, fdsVec, cs);
 		}
-
-		return { dataVec, fdsVec };
 	}
 
 	static std::map<K, V> deserialize(std::vector<uint8_t> &data, ControlSerializer *cs = nullptr)
@@ -317,6 +349,13 @@ public:
 		return { dataVec, {} };
 	}
 
+	static void serialize(const Flags<E> &data, std::vector<uint8_t> &dataVec,
+			      [[maybe_unused]] std::vector<SharedFD> &fdsVec,
+			      [[maybe_unused]] ControlSerializer *cs = nullptr)
+	{
+		appendPOD<uint32_t>(dataVec, static_cast<typename Flags<E>::Type>(data));
+	}
+
 	static Flags<E> deserialize(std::vector<uint8_t> &data,
 				    [[maybe_unused]] ControlSerializer *cs = nullptr)
 	{
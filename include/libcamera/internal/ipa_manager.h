@@ -7,7 +7,10 @@
 
 #pragma once
 
+#include <map>
+#include <memory>
 #include <stdint.h>
+#include <string>
 #include <vector>
 
 #include <libcamera/base/log.h>
@@ -55,18 +58,48 @@ public:
 #endif
 
 private:
+	struct SearchDir {
+		std::string path;
+		unsigned int maxDepth;
+		bool user;
+	};
+
+	struct CacheEntry {
+		int64_t mtime;
+		int64_t size;
+		std::string pipelineName;
+	};
+
+	struct ModuleEntry {
+		std::string path;
+		std::string pipelineName;
+		std::unique_ptr<IPAModule> module;
+	};
+
 	static IPAManager *self_;
 
 	void parseDir(const char *libDir, unsigned int maxDepth,
 		      std::vector<std::string> &files);
-	unsigned int addDir(const char *libDir, unsigned int maxDepth = 0);
+	unsigned int addDir(const SearchDir &dir,
+			    std::map<std::string, CacheEntry> &cache,
+			    bool &cacheUpdated);
+	void indexModules();
+
+	static std::string cachePath();
+	std::map<std::string, CacheEntry> loadCache() const;
+	void saveCache(const std::map<std::string, CacheEntry> &cache) const;
 
 	IPAModule *module(PipelineHandler *pipe, uint32_t minVersion,
 			  uint32_t maxVersion);
 
 	bool isSignatureValid(IPAModule *ipa) const;
 
-	std::vector<IPAModule *> modules_;
+	std::vector<SearchDir> searchDirs_;
+	std::string userPaths_;
+	std::string cachePath_;
+
+	bool indexed_;
+	std::vector<ModuleEntry> modules_;
 
 #if HAVE_IPA_PUBKEY
 	static const uint8_t publicKeyData_[];
@@ -7,10 +7,17 @@
 
 #pragma once
 
+#include <array>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <map>
 #include <vector>
 
 #include <libcamera/base/shared_fd.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/utils.h>
 
 #include "libcamera/internal/ipc_unixsocket.h"
 
@@ -49,20 +56,54 @@ private:
 class IPCPipe
 {
 public:
+	using Completion = std::function<void(int ret, IPCMessage &out)>;
+
+	static constexpr unsigned int kLatencyBuckets = 24;
+	using LatencyHistogram = std::array<unsigned int, kLatencyBuckets>;
+
 	IPCPipe();
 	virtual ~IPCPipe();
 
 	bool isConnected() const { return connected_; }
 
-	virtual int sendSync(const IPCMessage &in,
-			     IPCMessage *out) = 0;
+	int sendSync(const IPCMessage &in, IPCMessage *out = nullptr);
+	int sendCall(const IPCMessage &in, Completion completion);
 
 	virtual int sendAsync(const IPCMessage &data) = 0;
 
+	void setTimeout(std::chrono::milliseconds timeout) { timeout_ = timeout; }
+	std::chrono::milliseconds timeout() const { return timeout_; }
+
+	const LatencyHistogram &latency() const { return latency_; }
+	unsigned int timeouts() const { return timeouts_; }
+
 	Signal<const IPCMessage &> recv;
 
 protected:
+	void handleMessage(IPCUnixSocket::Payload &payload);
+
 	bool connected_;
+
+private:
+	struct CallData {
+		Completion completion;
+		utils::time_point start;
+		utils::time_point deadline;
+	};
+
+	void complete(CallData &call, int ret, IPCMessage &out);
+	void armTimer();
+	void expireCalls();
+
+	static constexpr unsigned int kMaxExpiredCalls = 16;
+
+	std::map<uint32_t, CallData> callData_;
+	std::deque<uint32_t> expiredCalls_;
+	std::chrono::milliseconds timeout_;
+	Timer timer_;
+
+	LatencyHistogram latency_;
+	unsigned int timeouts_;
 };
 
 } /* namespace libcamera */
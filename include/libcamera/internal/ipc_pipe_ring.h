@@ -0,0 +1,36 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Image Processing Algorithm IPC module using shared memory ring buffers
+ */
+
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "libcamera/internal/ipc_pipe.h"
+#include "libcamera/internal/ipc_ring.h"
+
+namespace libcamera {
+
+class Process;
+
+class IPCPipeRing : public IPCPipe
+{
+public:
+	IPCPipeRing(const char *ipaModulePath, const char *ipaProxyWorkerPath);
+	~IPCPipeRing();
+
+	int sendAsync(const IPCMessage &data) override;
+
+private:
+	void readyRead();
+
+	std::unique_ptr<Process> proc_;
+	std::unique_ptr<IPCRing> ring_;
+	IPCRing::Payload payload_;
+};
+
+} /* namespace libcamera */
@@ -7,7 +7,6 @@
 
 #pragma once
 
-#include <map>
 #include <memory>
 #include <vector>
 
@@ -24,24 +23,13 @@ public:
 	IPCPipeUnixSocket(const char *ipaModulePath, const char *ipaProxyWorkerPath);
 	~IPCPipeUnixSocket();
 
-	int sendSync(const IPCMessage &in,
-		     IPCMessage *out = nullptr) override;
-
 	int sendAsync(const IPCMessage &data) override;
 
 private:
-	struct CallData {
-		IPCUnixSocket::Payload *response;
-		bool done;
-	};
-
 	void readyRead();
-	int call(const IPCUnixSocket::Payload &message,
-		 IPCUnixSocket::Payload *response, uint32_t seq);
 
 	std::unique_ptr<Process> proc_;
 	std::unique_ptr<IPCUnixSocket> socket_;
-	std::map<uint32_t, CallData> callData_;
 };
 
 } /* namespace libcamera */
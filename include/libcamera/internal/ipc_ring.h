@@ -0,0 +1,86 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * IPC mechanism based on shared memory ring buffers
+ */
+
+#pragma once
+
+#include <deque>
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <utility>
+
+#include <libcamera/base/signal.h>
+#include <libcamera/base/unique_fd.h>
+
+#include "libcamera/internal/ipc_unixsocket.h"
+
+namespace libcamera {
+
+class EventNotifier;
+
+class IPCRing
+{
+public:
+	using Payload = IPCUnixSocket::Payload;
+
+	struct Handle {
+		UniqueFD socket;
+		UniqueFD memory;
+		UniqueFD rxDoorbell;
+		UniqueFD txDoorbell;
+	};
+
+	IPCRing();
+	~IPCRing();
+
+	Handle create();
+	int bind(Handle handle);
+	void close();
+	bool isBound() const;
+
+	int send(const Payload &payload);
+	int receive(Payload *payload);
+
+	Signal<> readyRead;
+
+private:
+	struct Ring;
+
+	struct RecordHeader {
+		uint32_t size;
+		uint32_t seq;
+	};
+
+	int map(const UniqueFD &memory, bool create);
+	bool available() const;
+	int teardown();
+
+	int sendRing(const Payload &payload);
+	int sendSocket(const Payload &payload);
+	void fetchSocket();
+
+	void socketReadyRead();
+	void doorbellNotifier();
+	void notify();
+
+	IPCUnixSocket socket_;
+
+	void *mem_;
+	Ring *rx_;
+	Ring *tx_;
+
+	UniqueFD rxDoorbell_;
+	UniqueFD txDoorbell_;
+	std::unique_ptr<EventNotifier> notifier_;
+
+	uint32_t txSeq_;
+	uint32_t rxSeq_;
+
+	std::deque<std::pair<uint32_t, Payload>> socketPayloads_;
+};
+
+} /* namespace libcamera */
@@ -12,6 +12,7 @@
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/flags.h>
+#include <libcamera/base/shared_fd.h>
 #include <libcamera/base/span.h>
 
 #include <libcamera/framebuffer.h>
@@ -55,6 +56,18 @@ public:
 	using MapFlags = Flags<MapFlag>;
 
 	MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags);
+
+	MapFlags flags() const { return flags_; }
+
+	void beginAccess(MapFlags access) const;
+	void endAccess(MapFlags access) const;
+
+private:
+	void sync(uint64_t step, MapFlags access) const;
+
+	MapFlags flags_;
+	/* Pruned from the file descriptors that don't support sync by sync() */
+	mutable std::vector<SharedFD> dmabufs_;
 };
 
 LIBCAMERA_FLAGS_ENABLE_OPERATORS(MappedFrameBuffer::MapFlag)
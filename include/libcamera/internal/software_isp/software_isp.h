@@ -7,6 +7,8 @@
 
 #pragma once
 
+#include <array>
+#include <deque>
 #include <functional>
 #include <initializer_list>
 #include <map>
@@ -17,6 +19,7 @@
 
 #include <libcamera/base/class.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/object.h>
 #include <libcamera/base/signal.h>
 #include <libcamera/base/thread.h>
 
@@ -42,12 +45,14 @@ struct StreamConfiguration;
 
 LOG_DECLARE_CATEGORY(SoftwareIsp)
 
-class SoftwareIsp
+class SoftwareIsp : public Object
 {
 public:
 	SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor);
 	~SoftwareIsp();
 
+	static constexpr unsigned int kMaxStreams = 2;
+
 	int loadConfiguration([[maybe_unused]] const std::string &filename) { return 0; }
 
 	bool isValid() const;
@@ -66,35 +71,53 @@ public:
 	int exportBuffers(const Stream *stream, unsigned int count,
 			  std::vector<std::unique_ptr<FrameBuffer>> *buffers);
 
-	void processStats(const ControlList &sensorControls);
+	void processStats(const uint32_t frame, const uint32_t bufferId,
+			  const ControlList &sensorControls);
 
 	int start();
 	void stop();
 
-	int queueBuffers(FrameBuffer *input,
+	int queueBuffers(uint32_t frame, FrameBuffer *input,
 			 const std::map<const Stream *, FrameBuffer *> &outputs);
 
-	void process(FrameBuffer *input, FrameBuffer *output);
+	void process(uint32_t frame, FrameBuffer *input,
+		     const std::vector<FrameBuffer *> &outputs);
 
 	Signal<FrameBuffer *> inputBufferReady;
 	Signal<FrameBuffer *> outputBufferReady;
-	Signal<> ispStatsReady;
+	Signal<uint32_t, uint32_t> ispStatsReady;
 	Signal<const ControlList &> setSensorControls;
 
 private:
-	void saveIspParams();
+	void fillParamsBuffers();
+	void paramsBufferReady(uint32_t frame);
 	void setSensorCtrls(const ControlList &sensorControls);
-	void statsReady();
+	void statsReady(uint32_t frame, uint32_t bufferId);
+	void statsProcessed(uint32_t bufferId);
 	void inputReady(FrameBuffer *input);
 	void outputReady(FrameBuffer *output);
 
 	std::unique_ptr<DebayerCpu> debayer_;
 	Thread ispWorkerThread_;
-	SharedMemObject<DebayerParams> sharedParams_;
-	DebayerParams debayerParams_;
+	SharedMemObject<std::array<DebayerParams, kDebayerParamsBufferCount>> sharedParams_;
+
+	struct PendingFrame {
+		FrameBuffer *input;
+		std::map<const Stream *, FrameBuffer *> outputs;
+	};
+	std::map<uint32_t, PendingFrame> pendingFrames_;
+	/* Frames waiting for their parameters buffer to be released */
+	std::deque<uint32_t> waitingFrames_;
+	/* Parameters buffers in use, from fillParamsBuffer() until processed */
+	std::array<bool, kDebayerParamsBufferCount> paramsBuffersBusy_;
+	/* Frames being processed, indexed by input buffer */
+	std::map<FrameBuffer *, uint32_t> processingFrames_;
+	std::vector<const Stream *> streams_;
 	DmaBufAllocator dmaHeap_;
 
 	std::unique_ptr<ipa::soft::IPAProxySoft> ipa_;
+	bool ccmEnabled_;
+	bool running_;
 };
 
 } /* namespace libcamera */
@@ -46,4 +46,14 @@ struct SwIspStats {
 	Histogram yHistogram;
 };
 
+/**
+ * \brief Number of statistics buffers shared between the Software ISP and IPA
+ *
+ * The statistics are stored in a ring of SwIspStats buffers to let the IPA
+ * access the statistics of a frame while the Software ISP processes the next
+ * frames. Buffers are handed back to the ISP once the IPA has read them, and
+ * statistics are dropped when no buffer is free.
+ */
+static constexpr unsigned int kSwIspStatsBufferCount = 4;
+
 } /* namespace libcamera */
@@ -0,0 +1,140 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Binary trace recorder
+ */
+
+#pragma once
+
+#include <atomic>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+
+#include <libcamera/base/class.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/thread_annotations.h>
+
+namespace libcamera {
+
+class TraceEvent;
+
+class TraceRecorder
+{
+public:
+	enum Phase : uint8_t {
+		Begin = 1,
+		End = 2,
+		Instant = 3,
+		AsyncBegin = 4,
+		AsyncEnd = 5,
+	};
+
+	~TraceRecorder();
+
+	static TraceRecorder *instance();
+
+	void record(const TraceEvent &event, Phase phase, uint64_t arg0,
+		    uint64_t arg1);
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(TraceRecorder)
+
+	struct FileHeader;
+	struct EventInfo;
+	struct Record;
+	struct ThreadBuffer;
+
+	TraceRecorder();
+
+	int open(const std::string &path);
+	uint16_t registerEvent(const TraceEvent &event);
+	bool allocateChunk(ThreadBuffer *buffer);
+
+	static bool destroyed_;
+
+	void *mem_;
+	size_t size_;
+	FileHeader *header_;
+	EventInfo *events_;
+
+	Mutex mutex_;
+	unsigned int numEvents_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	unsigned int numChunks_;
+	std::atomic<unsigned int> nextChunk_;
+};
+
+class TraceEvent
+{
+public:
+	TraceEvent(const char *category, const char *name,
+		   const char *arg0 = nullptr, const char *arg1 = nullptr)
+		: category_(category), name_(name), args_{ arg0, arg1 }, id_(0)
+	{
+	}
+
+	void begin(uint64_t arg0 = 0, uint64_t arg1 = 0) const
+	{
+		record(TraceRecorder::Begin, arg0, arg1);
+	}
+
+	void end(uint64_t arg0 = 0, uint64_t arg1 = 0) const
+	{
+		record(TraceRecorder::End, arg0, arg1);
+	}
+
+	void instant(uint64_t arg0 = 0, uint64_t arg1 = 0) const
+	{
+		record(TraceRecorder::Instant, arg0, arg1);
+	}
+
+	void asyncBegin(uint64_t id, uint64_t arg1 = 0) const
+	{
+		record(TraceRecorder::AsyncBegin, id, arg1);
+	}
+
+	void asyncEnd(uint64_t id, uint64_t arg1 = 0) const
+	{
+		record(TraceRecorder::AsyncEnd, id, arg1);
+	}
+
+private:
+	friend TraceRecorder;
+
+	void record(TraceRecorder::Phase phase, uint64_t arg0, uint64_t arg1) const
+	{
+		TraceRecorder *recorder = TraceRecorder::instance();
+		if (recorder)
+			recorder->record(*this, phase, arg0, arg1);
+	}
+
+	const char *category_;
+	const char *name_;
+	const char *args_[2];
+
+	/* Event identifier in the trace file, assigned on first use. */
+	mutable std::atomic<uint16_t> id_;
+};
+
+class TraceScope
+{
+public:
+	TraceScope(const TraceEvent &event, uint64_t arg0 = 0, uint64_t arg1 = 0)
+		: event_(event)
+	{
+		event_.begin(arg0, arg1);
+	}
+
+	~TraceScope()
+	{
+		event_.end();
+	}
+
+private:
+	LIBCAMERA_DISABLE_COPY_AND_MOVE(TraceScope)
+
+	const TraceEvent &event_;
+};
+
+} /* namespace libcamera */
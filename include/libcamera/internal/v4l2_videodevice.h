@@ -8,13 +8,13 @@
 #pragma once
 
 #include <array>
-#include <atomic>
 #include <memory>
 #include <optional>
 #include <ostream>
 #include <queue>
 #include <stdint.h>
 #include <string>
+#include <unordered_map>
 #include <unordered_set>
 #include <vector>
 
@@ -134,16 +134,23 @@ public:
 	void put(unsigned int index);
 
 private:
+	static constexpr unsigned int kNoEntry = ~0U;
+
 	class Entry
 	{
 	public:
 		Entry();
-		Entry(bool free, uint64_t lastUsed, const FrameBuffer &buffer);
 
+		void set(const FrameBuffer &buffer, size_t hash);
 		bool operator==(const FrameBuffer &buffer) const;
 
 		bool free_;
-		uint64_t lastUsed_;
+		bool valid_;
+		size_t hash_;
+
+		/* Links in the list of free entries. */
+		unsigned int prev_;
+		unsigned int next_;
 
 	private:
 		struct Plane {
@@ -159,8 +166,19 @@ private:
 		std::vector<Plane> planes_;
 	};
 
-	std::atomic<uint64_t> lastUsedCounter_;
+	static size_t hash(const FrameBuffer &buffer);
+
+	void pushFree(unsigned int index);
+	void removeFree(unsigned int index);
+
 	std::vector<Entry> cache_;
+	std::unordered_multimap<size_t, unsigned int> index_;
+
+	/* Free entries, from least to most recently released. */
+	unsigned int freeHead_;
+	unsigned int freeTail_;
+	unsigned int numUsed_;
+
 	/* \todo Expose the miss counter through an instrumentation API. */
 	unsigned int missCounter_;
 };
@@ -265,7 +283,9 @@ private:
 	UniqueFD exportDmabufFd(unsigned int index, unsigned int plane);
 
 	void bufferAvailable();
-	FrameBuffer *dequeueBuffer();
+	int dequeueBuffer(FrameBuffer **buffer);
+	void fillMetadata(FrameBuffer *buffer, const struct v4l2_buffer &buf,
+			  const struct v4l2_plane *planes);
 
 	int queueToDevice(FrameBuffer *buffer);
 
@@ -287,6 +307,7 @@ private:
 	std::queue<FrameBuffer *> pendingBuffersToQueue_;
 
 	EventNotifier *fdBufferNotifier_;
+	bool nonBlocking_;
 
 	State state_;
 	std::optional<unsigned int> firstFrame_;
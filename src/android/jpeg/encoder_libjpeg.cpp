@@ -22,6 +22,7 @@
 #include <libcamera/pixel_format.h>
 
 #include "libcamera/internal/formats.h"
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 #include "../camera_buffer.h"
@@ -184,16 +185,19 @@ int EncoderLibJpeg::encode(Camera3RequestDescriptor::StreamBuffer *buffer,
 			   libcamera::Span<const uint8_t> exifData,
 			   unsigned int quality)
 {
-	MappedFrameBuffer frame(buffer->srcBuffer,
-				MappedFrameBuffer::MapFlag::Read);
-	if (!frame.isValid()) {
-		LOG(JPEG, Error) << "Failed to map FrameBuffer : "
-				 << strerror(frame.error());
-		return frame.error();
+	const MappedFrameBuffer *frame =
+		buffer->srcBuffer->_d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!frame) {
+		LOG(JPEG, Error) << "Failed to map FrameBuffer";
+		return -EINVAL;
 	}
 
-	return encode(frame.planes(), buffer->dstBuffer->plane(0),
-		      exifData, quality);
+	frame->beginAccess(MappedFrameBuffer::MapFlag::Read);
+	int ret = encode(frame->planes(), buffer->dstBuffer->plane(0),
+			 exifData, quality);
+	frame->endAccess(MappedFrameBuffer::MapFlag::Read);
+
+	return ret;
 }
 
 int EncoderLibJpeg::encode(const std::vector<Span<uint8_t>> &src,
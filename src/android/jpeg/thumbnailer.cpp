@@ -11,6 +11,7 @@
 
 #include <libcamera/formats.h>
 
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 using namespace libcamera;
@@ -41,16 +42,15 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 				  const Size &targetSize,
 				  std::vector<unsigned char> *destination)
 {
-	MappedFrameBuffer frame(&source, MappedFrameBuffer::MapFlag::Read);
-	if (!frame.isValid()) {
-		LOG(Thumbnailer, Error)
-			<< "Failed to map FrameBuffer : "
-			<< strerror(frame.error());
+	if (!valid_) {
+		LOG(Thumbnailer, Error) << "Config is unconfigured or invalid.";
 		return;
 	}
 
-	if (!valid_) {
-		LOG(Thumbnailer, Error) << "Config is unconfigured or invalid.";
+	const MappedFrameBuffer *frame =
+		source._d()->map(MappedFrameBuffer::MapFlag::Read);
+	if (!frame) {
+		LOG(Thumbnailer, Error) << "Failed to map FrameBuffer";
 		return;
 	}
 
@@ -59,12 +59,12 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 	const unsigned int tw = targetSize.width;
 	const unsigned int th = targetSize.height;
 
-	ASSERT(frame.planes().size() == 2);
+	ASSERT(frame->planes().size() == 2);
 	ASSERT(tw % 2 == 0 && th % 2 == 0);
 
 	/* Image scaling block implementing nearest-neighbour algorithm. */
-	unsigned char *src = frame.planes()[0].data();
-	unsigned char *srcC = frame.planes()[1].data();
+	unsigned char *src = frame->planes()[0].data();
+	unsigned char *srcC = frame->planes()[1].data();
 	unsigned char *srcCb, *srcCr;
 	unsigned char *dstY, *srcY;
 
@@ -73,6 +73,8 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 	unsigned char *dst = destination->data();
 	unsigned char *dstC = dst + th * tw;
 
+	frame->beginAccess(MappedFrameBuffer::MapFlag::Read);
+
 	for (unsigned int y = 0; y < th; y += 2) {
 		unsigned int sourceY = (sh * y + th / 2) / th;
 
@@ -93,4 +95,6 @@ void Thumbnailer::createThumbnail(const FrameBuffer &source,
 			dstC[(y / 2) * tw + x + 1] = srcCr[(sourceX / 2) * 2];
 		}
 	}
+
+	frame->endAccess(MappedFrameBuffer::MapFlag::Read);
 }
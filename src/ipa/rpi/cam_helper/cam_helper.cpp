@@ -235,8 +235,8 @@ void CamHelper::parseEmbeddedData(Span<const uint8_t> buffer,
 	 * Fetch it first in case any other fields were set meaningfully.
 	 */
 	DeviceStatus deviceStatus, parsedDeviceStatus;
-	if (metadata.get("device.status", deviceStatus) ||
-	    parsedMetadata.get("device.status", parsedDeviceStatus)) {
+	if (metadata.get(MetadataTag::DeviceStatus, deviceStatus) ||
+	    parsedMetadata.get(MetadataTag::DeviceStatus, parsedDeviceStatus)) {
 		LOG(IPARPI, Error) << "DeviceStatus not found";
 		return;
 	}
@@ -250,7 +250,7 @@ void CamHelper::parseEmbeddedData(Span<const uint8_t> buffer,
 
 	LOG(IPARPI, Debug) << "Metadata updated - " << deviceStatus;
 
-	metadata.set("device.status", deviceStatus);
+	metadata.set(MetadataTag::DeviceStatus, deviceStatus);
 }
 
 void CamHelper::populateMetadata([[maybe_unused]] const MdParser::RegisterMap &registers,
@@ -104,7 +104,7 @@ void CamHelperImx219::populateMetadata(const MdParser::RegisterMap &registers,
 	deviceStatus.analogueGain = gain(registers.at(gainReg));
 	deviceStatus.frameLength = registers.at(frameLengthHiReg) * 256 + registers.at(frameLengthLoReg);
 
-	metadata.set("device.status", deviceStatus);
+	metadata.set(MetadataTag::DeviceStatus, deviceStatus);
 }
 
 static CamHelper *create()
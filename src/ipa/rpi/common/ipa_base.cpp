@@ -33,6 +33,7 @@ namespace libcamera {
 
 using namespace std::literals::chrono_literals;
 using utils::Duration;
+using RPiController::MetadataTag;
 
 namespace {
 
@@ -292,7 +293,7 @@ void IpaBase::start(const ControlList &controls, StartResult *result)
 	agcStatus.shutterTime = 0.0s;
 	agcStatus.analogueGain = 0.0;
 
-	metadata.get("agc.status", agcStatus);
+	metadata.get(MetadataTag::AgcStatus, agcStatus);
 	if (agcStatus.shutterTime && agcStatus.analogueGain) {
 		ControlList ctrls(sensorCtrls_);
 		applyAGC(&agcStatus, ctrls);
@@ -410,8 +411,8 @@ void IpaBase::prepareIsp(const PrepareParams &params)
 	AgcStatus agcStatus;
 	bool hdrChange = false;
 	RPiController::Metadata &delayedMetadata = rpiMetadata_[params.delayContext];
-	if (!delayedMetadata.get<AgcStatus>("agc.status", agcStatus)) {
-		rpiMetadata.set("agc.delayed_status", agcStatus);
+	if (!delayedMetadata.get<AgcStatus>(MetadataTag::AgcStatus, agcStatus)) {
+		rpiMetadata.set(MetadataTag::AgcDelayedStatus, agcStatus);
 		hdrChange = agcStatus.hdr.mode != hdrStatus_.mode;
 		hdrStatus_ = agcStatus.hdr;
 	}
@@ -481,13 +482,13 @@ void IpaBase::processStats(const ProcessParams &params)
 		RPiController::StatisticsPtr statistics = platformProcessStats(it->second.planes()[0]);
 
 		/* reportMetadata() will pick this up and set the FocusFoM metadata */
-		rpiMetadata.set("focus.status", statistics->focusRegions);
+		rpiMetadata.set(MetadataTag::FocusStatus, statistics->focusRegions);
 
 		helper_->process(statistics, rpiMetadata);
 		controller_.process(statistics, &rpiMetadata);
 
 		struct AgcStatus agcStatus;
-		if (rpiMetadata.get("agc.status", agcStatus) == 0) {
+		if (rpiMetadata.get(MetadataTag::AgcStatus, agcStatus) == 0) {
 			ControlList ctrls(sensorCtrls_);
 			applyAGC(&agcStatus, ctrls);
 			setDelayedControls.emit(ctrls, ipaContext);
@@ -1282,7 +1283,7 @@ void IpaBase::fillDeviceStatus(const ControlList &sensorControls, unsigned int i
 
 	LOG(IPARPI, Debug) << "Metadata - " << deviceStatus;
 
-	rpiMetadata_[ipaContext].set("device.status", deviceStatus);
+	rpiMetadata_[ipaContext].set(MetadataTag::DeviceStatus, deviceStatus);
 }
 
 void IpaBase::reportMetadata(unsigned int ipaContext)
@@ -1295,7 +1296,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 	 * processed can be extracted and placed into the libcamera metadata
 	 * buffer, where an application could query it.
 	 */
-	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>("device.status");
+	const DeviceStatus *deviceStatus = rpiMetadata.getLocked<const DeviceStatus>(MetadataTag::DeviceStatus);
 	if (deviceStatus) {
 		libcameraMetadata_.set(controls::ExposureTime,
 				       deviceStatus->shutterSpeed.get<std::micro>());
@@ -1308,24 +1309,24 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 			libcameraMetadata_.set(controls::LensPosition, *deviceStatus->lensPosition);
 	}
 
-	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	const AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<const AgcPrepareStatus>(MetadataTag::AgcPrepareStatus);
 	if (agcPrepareStatus) {
 		libcameraMetadata_.set(controls::AeLocked, agcPrepareStatus->locked);
 		libcameraMetadata_.set(controls::DigitalGain, agcPrepareStatus->digitalGain);
 	}
 
-	LuxStatus *luxStatus = rpiMetadata.getLocked<LuxStatus>("lux.status");
+	const LuxStatus *luxStatus = rpiMetadata.getLocked<const LuxStatus>(MetadataTag::LuxStatus);
 	if (luxStatus)
 		libcameraMetadata_.set(controls::Lux, luxStatus->lux);
 
-	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+	const AwbStatus *awbStatus = rpiMetadata.getLocked<const AwbStatus>(MetadataTag::AwbStatus);
 	if (awbStatus) {
 		libcameraMetadata_.set(controls::ColourGains, { static_cast<float>(awbStatus->gainR),
 								static_cast<float>(awbStatus->gainB) });
 		libcameraMetadata_.set(controls::ColourTemperature, awbStatus->temperatureK);
 	}
 
-	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+	const BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<const BlackLevelStatus>(MetadataTag::BlackLevelStatus);
 	if (blackLevelStatus)
 		libcameraMetadata_.set(controls::SensorBlackLevels,
 				       { static_cast<int32_t>(blackLevelStatus->blackLevelR),
@@ -1333,8 +1334,8 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 					 static_cast<int32_t>(blackLevelStatus->blackLevelG),
 					 static_cast<int32_t>(blackLevelStatus->blackLevelB) });
 
-	RPiController::FocusRegions *focusStatus =
-		rpiMetadata.getLocked<RPiController::FocusRegions>("focus.status");
+	const RPiController::FocusRegions *focusStatus =
+		rpiMetadata.getLocked<const RPiController::FocusRegions>(MetadataTag::FocusStatus);
 	if (focusStatus) {
 		/*
 		 * Calculate the average FoM over the central (symmetric) positions
@@ -1358,7 +1359,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 		libcameraMetadata_.set(controls::FocusFoM, focusFoM);
 	}
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	const CcmStatus *ccmStatus = rpiMetadata.getLocked<const CcmStatus>(MetadataTag::CcmStatus);
 	if (ccmStatus) {
 		float m[9];
 		for (unsigned int i = 0; i < 9; i++)
@@ -1366,7 +1367,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 		libcameraMetadata_.set(controls::ColourCorrectionMatrix, m);
 	}
 
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<const AfStatus>(MetadataTag::AfStatus);
 	if (afStatus) {
 		int32_t s, p;
 		switch (afStatus->state) {
@@ -1403,7 +1404,7 @@ void IpaBase::reportMetadata(unsigned int ipaContext)
 	 * delayed_status to be available, we use the HDR status that came out of the
 	 * switchMode call.
 	 */
-	const AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>("agc.delayed_status");
+	const AgcStatus *agcStatus = rpiMetadata.getLocked<const AgcStatus>(MetadataTag::AgcDelayedStatus);
 	const HdrStatus &hdrStatus = agcStatus ? agcStatus->hdr : hdrStatus_;
 	if (!hdrStatus.mode.empty() && hdrStatus.mode != "Off") {
 		int32_t hdrMode = controls::HdrModeOff;
@@ -9,6 +9,22 @@
 
 using namespace RPiController;
 
+MetadataAccess::MetadataAccess(std::initializer_list<MetadataTag> readTags,
+			       std::initializer_list<MetadataTag> writeTags)
+	: reads(0), writes(0)
+{
+	for (MetadataTag tag : readTags)
+		reads |= 1u << static_cast<unsigned int>(tag);
+	for (MetadataTag tag : writeTags)
+		writes |= 1u << static_cast<unsigned int>(tag);
+}
+
+bool MetadataAccess::conflicts(MetadataAccess const &other) const
+{
+	return (writes & (other.reads | other.writes)) ||
+	       (reads & other.writes);
+}
+
 int Algorithm::read([[maybe_unused]] const libcamera::YamlObject &params)
 {
 	return 0;
@@ -32,6 +48,16 @@ void Algorithm::process([[maybe_unused]] StatisticsPtr &stats,
 {
 }
 
+std::optional<MetadataAccess> Algorithm::prepareAccess() const
+{
+	return std::nullopt;
+}
+
+std::optional<MetadataAccess> Algorithm::processAccess() const
+{
+	return std::nullopt;
+}
+
 /* For registering algorithms with the system: */
 
 namespace {
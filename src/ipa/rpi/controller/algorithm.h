@@ -11,9 +11,12 @@
  * Controller.
  */
 
-#include <string>
-#include <memory>
+#include <initializer_list>
 #include <map>
+#include <memory>
+#include <optional>
+#include <stdint.h>
+#include <string>
 
 #include "libcamera/internal/yaml_parser.h"
 
@@ -21,6 +24,21 @@
 
 namespace RPiController {
 
+/*
+ * The metadata items read and written by an algorithm, in either the image or
+ * the global metadata. The Controller uses this to run the algorithms that
+ * don't depend on each other concurrently.
+ */
+
+struct MetadataAccess {
+	MetadataAccess(std::initializer_list<MetadataTag> readTags = {},
+		       std::initializer_list<MetadataTag> writeTags = {});
+	bool conflicts(MetadataAccess const &other) const;
+
+	uint32_t reads;
+	uint32_t writes;
+};
+
 /* This defines the basic interface for all control algorithms. */
 
 class Algorithm
@@ -37,6 +55,12 @@ public:
 	virtual void switchMode(CameraMode const &cameraMode, Metadata *metadata);
 	virtual void prepare(Metadata *imageMetadata);
 	virtual void process(StatisticsPtr &stats, Metadata *imageMetadata);
+	/*
+	 * Report the metadata accessed by prepare() and process(). Algorithms
+	 * that don't are never run concurrently with any other algorithm.
+	 */
+	virtual std::optional<MetadataAccess> prepareAccess() const;
+	virtual std::optional<MetadataAccess> processAccess() const;
 	Metadata &getGlobalMetadata() const
 	{
 		return controller_->getGlobalMetadata();
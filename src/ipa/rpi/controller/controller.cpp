@@ -5,15 +5,19 @@
  * ISP controller
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <stdlib.h>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
 
 #include "libcamera/internal/yaml_parser.h"
 
 #include "algorithm.h"
 #include "controller.h"
+#include "worker_pool.h"
 
 using namespace RPiController;
 using namespace libcamera;
@@ -75,6 +79,55 @@ static const std::map<std::string, Controller::HardwareConfig> HardwareConfigMap
 	},
 };
 
+namespace {
+
+constexpr unsigned int MaxThreads = 4;
+
+/*
+ * Sort the algorithms in groups that can run concurrently. An algorithm is
+ * put in the group following the last one that contains an algorithm it
+ * conflicts with, earlier in the tuning file order. Algorithms that don't
+ * report their metadata accesses conflict with all the others, which keeps
+ * the tuning file order for them.
+ */
+std::vector<std::vector<Algorithm *>>
+createSchedule(std::vector<AlgorithmPtr> const &algorithms,
+	       std::optional<MetadataAccess> (Algorithm::*access)() const)
+{
+	std::vector<std::vector<Algorithm *>> schedule;
+	std::vector<std::optional<MetadataAccess>> accesses;
+	std::vector<unsigned int> groups;
+
+	for (auto const &algo : algorithms) {
+		std::optional<MetadataAccess> algoAccess = (algo.get()->*access)();
+		unsigned int group = 0;
+
+		for (unsigned int i = 0; i < accesses.size(); i++) {
+			if (!algoAccess || !accesses[i] ||
+			    algoAccess->conflicts(*accesses[i]))
+				group = std::max(group, groups[i] + 1);
+		}
+
+		if (group == schedule.size())
+			schedule.emplace_back();
+		schedule[group].push_back(algo.get());
+
+		accesses.push_back(algoAccess);
+		groups.push_back(group);
+	}
+
+	for (unsigned int i = 0; i < schedule.size(); i++) {
+		std::string names;
+		for (Algorithm *algo : schedule[i])
+			names += std::string(" ") + algo->name();
+		LOG(RPiController, Debug) << "Group " << i << ":" << names;
+	}
+
+	return schedule;
+}
+
+} /* namespace */
+
 Controller::Controller()
 	: switchModeCalled_(false)
 {
@@ -154,6 +207,39 @@ void Controller::initialise()
 {
 	for (auto &algo : algorithms_)
 		algo->initialise();
+
+	LOG(RPiController, Debug) << "Prepare schedule:";
+	prepareSchedule_ = createSchedule(algorithms_, &Algorithm::prepareAccess);
+	LOG(RPiController, Debug) << "Process schedule:";
+	processSchedule_ = createSchedule(algorithms_, &Algorithm::processAccess);
+
+	/*
+	 * Run all the algorithms in the tuning file order in the calling thread
+	 * by default. The algorithms take microseconds per frame, which is in
+	 * the range of the cost of handing them over to other threads. Running
+	 * the independent algorithms concurrently can be enabled by setting the
+	 * number of threads through the LIBCAMERA_RPI_CONTROLLER_THREADS
+	 * environment variable.
+	 */
+	unsigned int numThreads = 1;
+
+	const char *threads = utils::secure_getenv("LIBCAMERA_RPI_CONTROLLER_THREADS");
+	if (threads)
+		numThreads = strtoul(threads, nullptr, 10);
+
+	numThreads = std::clamp(numThreads, 1U, MaxThreads);
+
+	size_t maxGroupSize = 1;
+	for (Schedule const *schedule : { &prepareSchedule_, &processSchedule_ }) {
+		for (auto const &group : *schedule)
+			maxGroupSize = std::max(maxGroupSize, group.size());
+	}
+
+	numThreads = std::min<size_t>(numThreads, maxGroupSize);
+	if (numThreads > 1)
+		workers_ = std::make_unique<WorkerPool>(numThreads - 1);
+	else
+		workers_.reset();
 }
 
 void Controller::switchMode(CameraMode const &cameraMode, Metadata *metadata)
@@ -166,15 +252,17 @@ void Controller::switchMode(CameraMode const &cameraMode, Metadata *metadata)
 void Controller::prepare(Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
+	run(prepareSchedule_, [&](Algorithm *algo) {
 		algo->prepare(imageMetadata);
+	});
 }
 
 void Controller::process(StatisticsPtr stats, Metadata *imageMetadata)
 {
 	assert(switchModeCalled_);
-	for (auto &algo : algorithms_)
+	run(processSchedule_, [&](Algorithm *algo) {
 		algo->process(stats, imageMetadata);
+	});
 }
 
 Metadata &Controller::getGlobalMetadata()
@@ -202,6 +290,22 @@ Algorithm *Controller::getAlgorithm(std::string const &name) const
 	return nullptr;
 }
 
+void Controller::run(Schedule const &schedule,
+		     std::function<void(Algorithm *)> const &func)
+{
+	for (auto const &group : schedule) {
+		if (!workers_ || group.size() == 1) {
+			for (Algorithm *algo : group)
+				func(algo);
+			continue;
+		}
+
+		workers_->run(group.size(), [&](unsigned int i) {
+			func(group[i]);
+		});
+	}
+}
+
 const std::string &Controller::getTarget() const
 {
 	return target_;
@@ -12,6 +12,8 @@
  * convenient manner.
  */
 
+#include <functional>
+#include <memory>
 #include <vector>
 #include <string>
 
@@ -27,6 +29,7 @@ namespace RPiController {
 
 class Algorithm;
 typedef std::unique_ptr<Algorithm> AlgorithmPtr;
+class WorkerPool;
 
 /*
  * The Controller holds a pointer to some global_metadata, which is how
@@ -64,14 +67,25 @@ public:
 	const HardwareConfig &getHardwareConfig() const;
 
 protected:
+	/*
+	 * Groups of algorithms to run one after the other, the algorithms
+	 * within each group being independent of each other.
+	 */
+	typedef std::vector<std::vector<Algorithm *>> Schedule;
+
 	int createAlgorithm(const std::string &name, const libcamera::YamlObject &params);
 
 	Metadata globalMetadata_;
 	std::vector<AlgorithmPtr> algorithms_;
 	bool switchModeCalled_;
+	Schedule prepareSchedule_;
+	Schedule processSchedule_;
 
 private:
+	void run(Schedule const &schedule, std::function<void(Algorithm *)> const &func);
+
 	std::string target_;
+	std::unique_ptr<WorkerPool> workers_;
 };
 
 } /* namespace RPiController */
@@ -26,13 +26,17 @@ public:
 	}
 
 	template<typename T> Histogram(T *histogram, int num)
+	{
+		set(histogram, num);
+	}
+	/* Replace the histogram contents, reusing the existing storage. */
+	template<typename T> void set(T *histogram, int num)
 	{
 		assert(num);
-		cumulative_.reserve(num + 1);
-		cumulative_.push_back(0);
+		cumulative_.resize(num + 1);
+		cumulative_[0] = 0;
 		for (int i = 0; i < num; i++)
-			cumulative_.push_back(cumulative_.back() +
-					      histogram[i]);
+			cumulative_[i + 1] = cumulative_[i] + histogram[i];
 	}
 	uint32_t bins() const { return cumulative_.size() - 1; }
 	uint64_t total() const { return cumulative_[cumulative_.size() - 1]; }
@@ -0,0 +1,61 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * general metadata class
+ */
+
+#include "metadata.h"
+
+#include <algorithm>
+#include <string_view>
+
+using namespace RPiController;
+
+namespace {
+
+/* String names of the metadata tags, sorted in the MetadataTag order. */
+constexpr std::array<std::string_view, static_cast<unsigned int>(MetadataTag::NumTags)> tagNames = {
+	"af.status",
+	"agc.delayed_status",
+	"agc.prepare_status",
+	"agc.status",
+	"alsc.status",
+	"awb.status",
+	"black_level.status",
+	"cac.status",
+	"ccm.status",
+	"cdn.status",
+	"contrast.status",
+	"denoise.status",
+	"device.status",
+	"dpc.status",
+	"focus.status",
+	"geq.status",
+	"hdr.status",
+	"lux.status",
+	"noise.status",
+	"pdaf.regions",
+	"saturation.status",
+	"sdn.status",
+	"sharpen.status",
+	"stitch.status",
+	"tdn.status",
+	"tonemap.status",
+};
+
+} /* namespace */
+
+/*
+ * Return the slot index of a string tag, or -1 if the tag has no dedicated
+ * slot. This is what keeps the string based API working for algorithms that
+ * haven't been converted to use MetadataTag.
+ */
+int Metadata::tagIndex(std::string const &tag)
+{
+	auto it = std::lower_bound(tagNames.begin(), tagNames.end(), tag);
+	if (it == tagNames.end() || *it != tag)
+		return -1;
+
+	return it - tagNames.begin();
+}
@@ -9,14 +9,56 @@
 /* A simple class for carrying arbitrary metadata, for example about an image. */
 
 #include <any>
+#include <array>
 #include <map>
+#include <memory>
 #include <mutex>
+#include <stdint.h>
 #include <string>
+#include <type_traits>
+#include <typeinfo>
+#include <utility>
 
 #include <libcamera/base/thread_annotations.h>
 
 namespace RPiController {
 
+/*
+ * Tags of the metadata items exchanged by the algorithms. Each of them gets
+ * a dedicated slot in the Metadata, which avoids looking up strings on every
+ * access. Items with any other tag are still supported through the string
+ * based API, but are stored less efficiently.
+ */
+enum class MetadataTag : unsigned int {
+	AfStatus,
+	AgcDelayedStatus,
+	AgcPrepareStatus,
+	AgcStatus,
+	AlscStatus,
+	AwbStatus,
+	BlackLevelStatus,
+	CacStatus,
+	CcmStatus,
+	CdnStatus,
+	ContrastStatus,
+	DenoiseStatus,
+	DeviceStatus,
+	DpcStatus,
+	FocusStatus,
+	GeqStatus,
+	HdrStatus,
+	LuxStatus,
+	NoiseStatus,
+	PdafStatus,
+	SaturationStatus,
+	SdnStatus,
+	SharpenStatus,
+	StitchStatus,
+	TdnStatus,
+	TonemapStatus,
+	NumTags,
+};
+
 class LIBCAMERA_TSA_CAPABILITY("mutex") Metadata
 {
 public:
@@ -25,26 +67,51 @@ public:
 	Metadata(Metadata const &other)
 	{
 		std::scoped_lock otherLock(other.mutex_);
+		copySlots(other);
 		data_ = other.data_;
 	}
 
 	Metadata(Metadata &&other)
 	{
 		std::scoped_lock otherLock(other.mutex_);
+		slots_ = std::move(other.slots_);
+		present_ = std::exchange(other.present_, 0);
 		data_ = std::move(other.data_);
 		other.data_.clear();
 	}
 
+	template<typename T>
+	void set(MetadataTag tag, T const &value)
+	{
+		std::scoped_lock lock(mutex_);
+		setLocked(tag, value);
+	}
+
 	template<typename T>
 	void set(std::string const &tag, T const &value)
 	{
 		std::scoped_lock lock(mutex_);
-		data_[tag] = value;
+		setLocked(tag, value);
+	}
+
+	template<typename T>
+	int get(MetadataTag tag, T &value) const
+	{
+		std::scoped_lock lock(mutex_);
+		const T *ptr = find<T>(tag);
+		if (!ptr)
+			return -1;
+		value = *ptr;
+		return 0;
 	}
 
 	template<typename T>
 	int get(std::string const &tag, T &value) const
 	{
+		int index = tagIndex(tag);
+		if (index >= 0)
+			return get(static_cast<MetadataTag>(index), value);
+
 		std::scoped_lock lock(mutex_);
 		auto it = data_.find(tag);
 		if (it == data_.end())
@@ -56,12 +123,15 @@ public:
 	void clear()
 	{
 		std::scoped_lock lock(mutex_);
+		/* Keep the slot storage around to be reused by the next frame. */
+		present_ = 0;
 		data_.clear();
 	}
 
 	Metadata &operator=(Metadata const &other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
+		copySlots(other);
 		data_ = other.data_;
 		return *this;
 	}
@@ -69,6 +139,8 @@ public:
 	Metadata &operator=(Metadata &&other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
+		slots_ = std::move(other.slots_);
+		present_ = std::exchange(other.present_, 0);
 		data_ = std::move(other.data_);
 		other.data_.clear();
 		return *this;
@@ -77,6 +149,14 @@ public:
 	void merge(Metadata &other)
 	{
 		std::scoped_lock lock(mutex_, other.mutex_);
+		/* As with std::map::merge(), existing items are left in other. */
+		uint32_t missing = other.present_ & ~present_;
+		for (unsigned int i = 0; i < kNumSlots; ++i) {
+			if (missing & (1u << i))
+				slots_[i] = std::move(other.slots_[i]);
+		}
+		present_ |= missing;
+		other.present_ &= ~missing;
 		data_.merge(other.data_);
 	}
 
@@ -85,29 +165,86 @@ public:
 		std::scoped_lock lock(mutex_, other.mutex_);
 		/*
 		 * If the metadata key exists, ignore this item and copy only
-		 * unique key/value pairs.
+		 * unique key/value pairs. Values are shared with other until
+		 * one of the copies gets modified.
 		 */
+		uint32_t missing = other.present_ & ~present_;
+		for (unsigned int i = 0; i < kNumSlots; ++i) {
+			if (missing & (1u << i))
+				slots_[i] = other.slots_[i];
+		}
+		present_ |= missing;
 		data_.insert(other.data_.begin(), other.data_.end());
 	}
 
 	template<typename T>
-	T *getLocked(std::string const &tag)
+	T *getLocked(MetadataTag tag)
 	{
 		/*
 		 * This allows in-place access to the Metadata contents,
-		 * for which you should be holding the lock.
+		 * for which you should be holding the lock. Use a const T
+		 * if the item isn't going to be modified, to avoid copying
+		 * values shared with other Metadata instances.
 		 */
+		using Value = std::remove_const_t<T>;
+
+		if (!(present_ & bit(tag)))
+			return nullptr;
+
+		/* As std::any_cast() on a pointer, return nullptr on type mismatch. */
+		Slot &slot = slots_[static_cast<unsigned int>(tag)];
+		if (*slot.type != typeid(Value))
+			return nullptr;
+
+		if constexpr (!std::is_const_v<T>) {
+			if (slot.value.use_count() > 1)
+				slot.value = slot.clone(slot.value.get());
+		}
+
+		return static_cast<Value *>(slot.value.get());
+	}
+
+	template<typename T>
+	T *getLocked(std::string const &tag)
+	{
+		int index = tagIndex(tag);
+		if (index >= 0)
+			return getLocked<T>(static_cast<MetadataTag>(index));
+
 		auto it = data_.find(tag);
 		if (it == data_.end())
 			return nullptr;
 		return std::any_cast<T>(&it->second);
 	}
 
+	template<typename T>
+	void setLocked(MetadataTag tag, T const &value)
+	{
+		/* Use this only if you're holding the lock yourself. */
+		Slot &slot = slots_[static_cast<unsigned int>(tag)];
+
+		/* Overwrite the previous value in place if nobody else uses it. */
+		if (slot.value && slot.value.use_count() == 1 &&
+		    *slot.type == typeid(T)) {
+			*static_cast<T *>(slot.value.get()) = value;
+		} else {
+			slot.value = std::make_shared<T>(value);
+			slot.type = &typeid(T);
+			slot.clone = &cloneValue<T>;
+		}
+
+		present_ |= bit(tag);
+	}
+
 	template<typename T>
 	void setLocked(std::string const &tag, T const &value)
 	{
 		/* Use this only if you're holding the lock yourself. */
-		data_[tag] = value;
+		int index = tagIndex(tag);
+		if (index >= 0)
+			setLocked(static_cast<MetadataTag>(index), value);
+		else
+			data_[tag] = value;
 	}
 
 	/*
@@ -119,8 +256,59 @@ public:
 	auto try_lock() LIBCAMERA_TSA_ACQUIRE() { return mutex_.try_lock(); }
 	void unlock() LIBCAMERA_TSA_RELEASE() { mutex_.unlock(); }
 
+	static int tagIndex(std::string const &tag);
+
 private:
+	static constexpr unsigned int kNumSlots =
+		static_cast<unsigned int>(MetadataTag::NumTags);
+	static_assert(kNumSlots <= 32, "Too many metadata tags");
+
+	struct Slot {
+		std::shared_ptr<void> value;
+		const std::type_info *type = nullptr;
+		std::shared_ptr<void> (*clone)(const void *) = nullptr;
+	};
+
+	template<typename T>
+	static std::shared_ptr<void> cloneValue(const void *value)
+	{
+		return std::make_shared<T>(*static_cast<const T *>(value));
+	}
+
+	static constexpr uint32_t bit(MetadataTag tag)
+	{
+		return 1u << static_cast<unsigned int>(tag);
+	}
+
+	template<typename T>
+	const T *find(MetadataTag tag) const
+	{
+		if (!(present_ & bit(tag)))
+			return nullptr;
+
+		const Slot &slot = slots_[static_cast<unsigned int>(tag)];
+		if (*slot.type != typeid(T))
+			throw std::bad_any_cast();
+
+		return static_cast<const T *>(slot.value.get());
+	}
+
+	void copySlots(Metadata const &other)
+	{
+		/*
+		 * Share the values present in other, and leave the storage of
+		 * the other slots alone so that it can be reused.
+		 */
+		for (unsigned int i = 0; i < kNumSlots; ++i) {
+			if (other.present_ & (1u << i))
+				slots_[i] = other.slots_[i];
+		}
+		present_ = other.present_;
+	}
+
 	mutable std::mutex mutex_;
+	std::array<Slot, kNumSlots> slots_;
+	uint32_t present_ = 0;
 	std::map<std::string, std::any> data_;
 };
 
@@ -29,20 +29,22 @@ public:
 	{
 	}
 
+	/*
+	 * The storage of the regions is kept when the statistics get
+	 * initialised again, so reusing a RegionStats doesn't allocate.
+	 */
 	void init(const libcamera::Size &size, unsigned int numFloating = 0)
 	{
 		size_ = size;
 		numFloating_ = numFloating;
-		regions_.clear();
-		regions_.resize(size_.width * size_.height + numFloating_);
+		regions_.assign(size_.width * size_.height + numFloating_, {});
 	}
 
 	void init(unsigned int num)
 	{
 		size_ = libcamera::Size(num, 1);
 		numFloating_ = 0;
-		regions_.clear();
-		regions_.resize(num);
+		regions_.assign(num, {});
 	}
 
 	unsigned int numRegions() const
@@ -631,7 +631,7 @@ void Af::prepare(Metadata *imageMetadata)
 		double oldFs = fsmooth_;
 		ScanState oldSs = scanState_;
 		uint32_t oldSt = stepCount_;
-		if (imageMetadata->get("pdaf.regions", regions) == 0)
+		if (imageMetadata->get(MetadataTag::PdafStatus, regions) == 0)
 			getPhase(regions, phase, conf);
 		doAF(prevContrast_, phase, conf);
 		updateLensPosition();
@@ -660,7 +660,7 @@ void Af::prepare(Metadata *imageMetadata)
 		status.state = reportState_;
 	status.lensSetting = initted_ ? std::optional<int>(cfg_.map.eval(fsmooth_))
 				      : std::nullopt;
-	imageMetadata->set("af.status", status);
+	imageMetadata->set(MetadataTag::AfStatus, status);
 }
 
 void Af::process(StatisticsPtr &stats, [[maybe_unused]] Metadata *imageMetadata)
@@ -789,6 +789,16 @@ void Af::pause(AfAlgorithm::AfPause pause)
 	}
 }
 
+std::optional<MetadataAccess> Af::prepareAccess() const
+{
+	return MetadataAccess({ MetadataTag::PdafStatus }, { MetadataTag::AfStatus });
+}
+
+std::optional<MetadataAccess> Af::processAccess() const
+{
+	return MetadataAccess();
+}
+
 // Register algorithm with the system.
 static Algorithm *create(Controller *controller)
 {
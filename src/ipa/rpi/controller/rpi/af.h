@@ -46,6 +46,8 @@ public:
 	void switchMode(CameraMode const &cameraMode, Metadata *metadata) override;
 	void prepare(Metadata *imageMetadata) override;
 	void process(StatisticsPtr &stats, Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 
 	/* controls */
 	void setRange(AfRange range) override;
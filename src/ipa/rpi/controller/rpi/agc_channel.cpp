@@ -471,7 +471,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 	/* Fetch the AWB status now because AWB also sets it in the prepare method. */
 	fetchAwbStatus(imageMetadata);
 
-	if (!imageMetadata->get("agc.delayed_status", delayedStatus))
+	if (!imageMetadata->get(MetadataTag::AgcDelayedStatus, delayedStatus))
 		totalExposureValue = delayedStatus.totalExposureValue;
 
 	prepareStatus.digitalGain = 1.0;
@@ -480,7 +480,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 	if (status_.totalExposureValue) {
 		/* Process has run, so we have meaningful values. */
 		DeviceStatus deviceStatus;
-		if (imageMetadata->get("device.status", deviceStatus) == 0) {
+		if (imageMetadata->get(MetadataTag::DeviceStatus, deviceStatus) == 0) {
 			Duration actualExposure = deviceStatus.shutterSpeed *
 						  deviceStatus.analogueGain;
 			if (actualExposure) {
@@ -500,7 +500,7 @@ void AgcChannel::prepare(Metadata *imageMetadata)
 			}
 		} else
 			LOG(RPiAgc, Warning) << "AgcChannel: no device metadata";
-		imageMetadata->set("agc.prepare_status", prepareStatus);
+		imageMetadata->set(MetadataTag::AgcPrepareStatus, prepareStatus);
 	}
 }
 
@@ -642,7 +642,7 @@ void AgcChannel::fetchCurrentExposure(DeviceStatus const &deviceStatus)
 
 void AgcChannel::fetchAwbStatus(Metadata *imageMetadata)
 {
-	if (imageMetadata->get("awb.status", awb_) != 0)
+	if (imageMetadata->get(MetadataTag::AwbStatus, awb_) != 0)
 		LOG(RPiAgc, Debug) << "No AWB status found";
 }
 
@@ -727,7 +727,7 @@ void AgcChannel::computeGain(StatisticsPtr &statistics, Metadata *imageMetadata,
 {
 	struct LuxStatus lux = {};
 	lux.lux = 400; /* default lux level to 400 in case no metadata found */
-	if (imageMetadata->get("lux.status", lux) != 0)
+	if (imageMetadata->get(MetadataTag::LuxStatus, lux) != 0)
 		LOG(RPiAgc, Warning) << "No lux level found";
 	const Histogram &h = statistics->yHist;
 	double evGain = status_.ev * config_.baseEv;
@@ -985,7 +985,7 @@ void AgcChannel::writeAndFinish(Metadata *imageMetadata, bool desaturate)
 	 * Write to metadata as well, in case anyone wants to update the camera
 	 * immediately.
 	 */
-	imageMetadata->set("agc.status", status_);
+	imageMetadata->set(MetadataTag::AgcStatus, status_);
 	LOG(RPiAgc, Debug) << "Output written, total exposure requested is "
 			   << filtered_.totalExposure;
 	LOG(RPiAgc, Debug) << "Camera exposure update: shutter time " << filtered_.shutter
@@ -209,8 +209,6 @@ void Alsc::initialise()
 	firstTime_ = true;
 	ct_ = config_.defaultCt;
 
-	const size_t XY = config_.tableSize.width * config_.tableSize.height;
-
 	for (auto &r : syncResults_)
 		r.resize(config_.tableSize);
 	for (auto &r : prevSyncResults_)
@@ -228,8 +226,7 @@ void Alsc::initialise()
 	/* Temporaries for the computations, but sensible to allocate this up-front! */
 	for (auto &c : tmpC_)
 		c.resize(config_.tableSize);
-	for (auto &m : tmpM_)
-		m.resize(XY);
+	solver_.configure(config_.tableSize);
 }
 
 void Alsc::waitForAysncThread()
@@ -329,7 +326,7 @@ double getCt(Metadata *metadata, double defaultCt)
 {
 	AwbStatus awbStatus;
 	awbStatus.temperatureK = defaultCt; /* in case nothing found */
-	if (metadata->get("awb.status", awbStatus) != 0)
+	if (metadata->get(MetadataTag::AwbStatus, awbStatus) != 0)
 		LOG(RPiAlsc, Debug) << "no AWB results found, using "
 				    << awbStatus.temperatureK;
 	else
@@ -409,12 +406,12 @@ void Alsc::prepare(Metadata *imageMetadata)
 	status.r = prevSyncResults_[0].data();
 	status.g = prevSyncResults_[1].data();
 	status.b = prevSyncResults_[2].data();
-	imageMetadata->set("alsc.status", status);
+	imageMetadata->set(MetadataTag::AlscStatus, status);
 	/*
 	 * Put the results in the global metadata as well. This will be used by
 	 * AWB to factor in the colour shading correction.
 	 */
-	getGlobalMetadata().set("alsc.status", status);
+	getGlobalMetadata().set(MetadataTag::AlscStatus, status);
 }
 
 void Alsc::process(StatisticsPtr &stats, Metadata *imageMetadata)
@@ -597,6 +594,23 @@ void compensateLambdasForCal(const Array2D<double> &calTable,
 	printf("]\n");
 }
 
+/* Normalise the values so that the smallest value is 1. */
+static void normalise(Array2D<double> &results)
+{
+	double minval = *std::min_element(results.begin(), results.end());
+	std::for_each(results.begin(), results.end(),
+		      [minval](double val) { return val / minval; });
+}
+
+/* Rescale the values so that the average value is 1. */
+static void reaverage(Array2D<double> &data)
+{
+	double sum = std::accumulate(data.begin(), data.end(), 0.0);
+	double ratio = 1 / (sum / data.size());
+	std::for_each(data.begin(), data.end(),
+		      [ratio](double val) { return val * ratio; });
+}
+
 /*
  * Compute weight out of 1.0 which reflects how similar we wish to make the
  * colours of these two regions.
@@ -609,32 +623,51 @@ static double computeWeight(double Ci, double Cj, double sigma)
 	return exp(-diff * diff / 2);
 }
 
-/* Compute all weights. */
-static void computeW(const Array2D<double> &C, double sigma,
-		     SparseArray<double> &W)
+void AlscSolver::configure(const Size &size)
+{
+	width_ = size.width;
+	size_ = size.width * size.height;
+
+	weightH_.resize(size_);
+	weightV_.resize(size_);
+	for (auto &m : M_)
+		m.resize(size_);
+
+	/*
+	 * The lambdas are padded with a row of zeros above and below. As the
+	 * matrix coefficients for missing neighbours are zero, all regions
+	 * can then be computed in the same way, without going out of bounds.
+	 */
+	lambda_.assign(size_ + 2 * width_, 0.0);
+	oldLambda_.resize(size_);
+}
+
+/*
+ * Compute all weights. The weight between two regions is symmetric, so only
+ * compute it once for each pair of neighbours.
+ */
+void AlscSolver::computeWeights(const Array2D<double> &C, double sigma)
 {
-	size_t XY = C.size();
-	size_t X = C.dimensions().width;
+	const unsigned int X = width_, XY = size_;
 
 	for (unsigned int i = 0; i < XY; i++) {
-		/* Start with neighbour above and go clockwise. */
-		W[i][0] = i >= X ? computeWeight(C[i], C[i - X], sigma) : 0;
-		W[i][1] = i % X < X - 1 ? computeWeight(C[i], C[i + 1], sigma) : 0;
-		W[i][2] = i < XY - X ? computeWeight(C[i], C[i + X], sigma) : 0;
-		W[i][3] = i % X ? computeWeight(C[i], C[i - 1], sigma) : 0;
+		weightH_[i] = i % X < X - 1 ? computeWeight(C[i], C[i + 1], sigma) : 0;
+		weightV_[i] = i < XY - X ? computeWeight(C[i], C[i + X], sigma) : 0;
 	}
 }
 
 /* Compute M, the large but sparse matrix such that M * lambdas = 0. */
-static void constructM(const Array2D<double> &C,
-		       const SparseArray<double> &W,
-		       SparseArray<double> &M)
+void AlscSolver::constructM(const Array2D<double> &C)
 {
-	size_t XY = C.size();
-	size_t X = C.dimensions().width;
+	const unsigned int X = width_, XY = size_;
 
 	double epsilon = 0.001;
 	for (unsigned int i = 0; i < XY; i++) {
+		/* Start with neighbour above and go clockwise. */
+		double w0 = i >= X ? weightV_[i - X] : 0;
+		double w1 = weightH_[i];
+		double w2 = weightV_[i];
+		double w3 = i % X ? weightH_[i - 1] : 0;
 		/*
 		 * Note how, if C[i] == INSUFFICIENT_DATA, the weights will all
 		 * be zero so the equation is still set up correctly.
@@ -642,132 +675,70 @@ static void constructM(const Array2D<double> &C,
 		int m = !!(i >= X) + !!(i % X < X - 1) + !!(i < XY - X) +
 			!!(i % X); /* total number of neighbours */
 		/* we'll divide the diagonal out straight away */
-		double diagonal = (epsilon + W[i][0] + W[i][1] + W[i][2] + W[i][3]) * C[i];
-		M[i][0] = i >= X ? (W[i][0] * C[i - X] + epsilon / m * C[i]) / diagonal : 0;
-		M[i][1] = i % X < X - 1 ? (W[i][1] * C[i + 1] + epsilon / m * C[i]) / diagonal : 0;
-		M[i][2] = i < XY - X ? (W[i][2] * C[i + X] + epsilon / m * C[i]) / diagonal : 0;
-		M[i][3] = i % X ? (W[i][3] * C[i - 1] + epsilon / m * C[i]) / diagonal : 0;
+		double diagonal = (epsilon + w0 + w1 + w2 + w3) * C[i];
+		M_[0][i] = i >= X ? (w0 * C[i - X] + epsilon / m * C[i]) / diagonal : 0;
+		M_[1][i] = i % X < X - 1 ? (w1 * C[i + 1] + epsilon / m * C[i]) / diagonal : 0;
+		M_[2][i] = i < XY - X ? (w2 * C[i + X] + epsilon / m * C[i]) / diagonal : 0;
+		M_[3][i] = i % X ? (w3 * C[i - 1] + epsilon / m * C[i]) / diagonal : 0;
 	}
 }
 
-/*
- * In the compute_lambda_ functions, note that the matrix coefficients for the
- * left/right neighbours are zero down the left/right edges, so we don't need
- * need to test the i value to exclude them.
- */
-static double computeLambdaBottom(int i, const SparseArray<double> &M,
-				  Array2D<double> &lambda)
-{
-	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + lambda.dimensions().width] +
-	       M[i][3] * lambda[i - 1];
-}
-static double computeLambdaBottomStart(int i, const SparseArray<double> &M,
-				       Array2D<double> &lambda)
-{
-	return M[i][1] * lambda[i + 1] + M[i][2] * lambda[i + lambda.dimensions().width];
-}
-static double computeLambdaInterior(int i, const SparseArray<double> &M,
-				    Array2D<double> &lambda)
-{
-	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][1] * lambda[i + 1] +
-	       M[i][2] * lambda[i + lambda.dimensions().width] + M[i][3] * lambda[i - 1];
-}
-static double computeLambdaTop(int i, const SparseArray<double> &M,
-			       Array2D<double> &lambda)
-{
-	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][1] * lambda[i + 1] +
-	       M[i][3] * lambda[i - 1];
-}
-static double computeLambdaTopEnd(int i, const SparseArray<double> &M,
-				  Array2D<double> &lambda)
-{
-	return M[i][0] * lambda[i - lambda.dimensions().width] + M[i][3] * lambda[i - 1];
-}
-
 /* Gauss-Seidel iteration with over-relaxation. */
-static double gaussSeidel2Sor(const SparseArray<double> &M, double omega,
-			      Array2D<double> &lambda, double lambdaBound)
+double AlscSolver::iterate(double omega, double lambdaBound)
 {
-	int XY = lambda.size();
-	int X = lambda.dimensions().width;
+	const int X = width_, XY = size_;
 	const double min = 1 - lambdaBound, max = 1 + lambdaBound;
-	Array2D<double> oldLambda = lambda;
-	int i;
-	lambda[0] = computeLambdaBottomStart(0, M, lambda);
-	lambda[0] = std::clamp(lambda[0], min, max);
-	for (i = 1; i < X; i++) {
-		lambda[i] = computeLambdaBottom(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	for (; i < XY - X; i++) {
-		lambda[i] = computeLambdaInterior(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	for (; i < XY - 1; i++) {
-		lambda[i] = computeLambdaTop(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	lambda[i] = computeLambdaTopEnd(i, M, lambda);
-	lambda[i] = std::clamp(lambda[i], min, max);
+	const double *M0 = M_[0].data(), *M1 = M_[1].data();
+	const double *M2 = M_[2].data(), *M3 = M_[3].data();
+	double *lambda = lambda_.data() + X;
+
+	std::copy(lambda, lambda + XY, oldLambda_.begin());
+
+	auto update = [&](int i) {
+		double value = M0[i] * lambda[i - X] + M1[i] * lambda[i + 1] +
+			       M2[i] * lambda[i + X] + M3[i] * lambda[i - 1];
+		lambda[i] = std::clamp(value, min, max);
+	};
+
+	for (int i = 0; i < XY; i++)
+		update(i);
 	/*
 	 * Also solve the system from bottom to top, to help spread the updates
 	 * better.
 	 */
-	lambda[i] = computeLambdaTopEnd(i, M, lambda);
-	lambda[i] = std::clamp(lambda[i], min, max);
-	for (i = XY - 2; i >= XY - X; i--) {
-		lambda[i] = computeLambdaTop(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	for (; i >= X; i--) {
-		lambda[i] = computeLambdaInterior(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	for (; i >= 1; i--) {
-		lambda[i] = computeLambdaBottom(i, M, lambda);
-		lambda[i] = std::clamp(lambda[i], min, max);
-	}
-	lambda[0] = computeLambdaBottomStart(0, M, lambda);
-	lambda[0] = std::clamp(lambda[0], min, max);
+	for (int i = XY - 1; i >= 0; i--)
+		update(i);
+
 	double maxDiff = 0;
-	for (i = 0; i < XY; i++) {
-		lambda[i] = oldLambda[i] + (lambda[i] - oldLambda[i]) * omega;
-		if (fabs(lambda[i] - oldLambda[i]) > fabs(maxDiff))
-			maxDiff = lambda[i] - oldLambda[i];
+	for (int i = 0; i < XY; i++) {
+		lambda[i] = oldLambda_[i] + (lambda[i] - oldLambda_[i]) * omega;
+		if (fabs(lambda[i] - oldLambda_[i]) > fabs(maxDiff))
+			maxDiff = lambda[i] - oldLambda_[i];
 	}
 	return maxDiff;
 }
 
-/* Normalise the values so that the smallest value is 1. */
-static void normalise(Array2D<double> &results)
+unsigned int AlscSolver::solve(const Array2D<double> &C, double sigma,
+			       double omega, unsigned int nIter,
+			       double threshold, double lambdaBound,
+			       Array2D<double> &lambda)
 {
-	double minval = *std::min_element(results.begin(), results.end());
-	std::for_each(results.begin(), results.end(),
-		      [minval](double val) { return val / minval; });
-}
+	if (C.dimensions().width != width_ || C.size() != size_)
+		configure(C.dimensions());
 
-/* Rescale the values so that the average value is 1. */
-static void reaverage(Array2D<double> &data)
-{
-	double sum = std::accumulate(data.begin(), data.end(), 0.0);
-	double ratio = 1 / (sum / data.size());
-	std::for_each(data.begin(), data.end(),
-		      [ratio](double val) { return val * ratio; });
-}
+	computeWeights(C, sigma);
+	constructM(C);
+
+	std::copy(lambda.begin(), lambda.end(), lambda_.begin() + width_);
 
-static void runMatrixIterations(const Array2D<double> &C,
-				Array2D<double> &lambda,
-				const SparseArray<double> &W,
-				SparseArray<double> &M, double omega,
-				unsigned int nIter, double threshold, double lambdaBound)
-{
-	constructM(C, W, M);
 	double lastMaxDiff = std::numeric_limits<double>::max();
-	for (unsigned int i = 0; i < nIter; i++) {
-		double maxDiff = fabs(gaussSeidel2Sor(M, omega, lambda, lambdaBound));
+	unsigned int i;
+	for (i = 0; i < nIter; i++) {
+		double maxDiff = fabs(iterate(omega, lambdaBound));
 		if (maxDiff < threshold) {
 			LOG(RPiAlsc, Debug)
 				<< "Stop after " << i + 1 << " iterations";
+			i++;
 			break;
 		}
 		/*
@@ -780,8 +751,11 @@ static void runMatrixIterations(const Array2D<double> &C,
 				<< lastMaxDiff << " to " << maxDiff;
 		lastMaxDiff = maxDiff;
 	}
-	/* We're going to normalise the lambdas so the total average is 1. */
-	reaverage(lambda);
+
+	std::copy(lambda_.begin() + width_, lambda_.begin() + width_ + size_,
+		  lambda.begin());
+
+	return i;
 }
 
 static void addLuminanceRb(Array2D<double> &result, const Array2D<double> &lambda,
@@ -817,7 +791,6 @@ void Alsc::doAlsc()
 {
 	Array2D<double> &cr = tmpC_[0], &cb = tmpC_[1], &calTableR = tmpC_[2],
 			&calTableB = tmpC_[3], &calTableTmp = tmpC_[4];
-	SparseArray<double> &wr = tmpM_[0], &wb = tmpM_[1], &M = tmpM_[2];
 
 	/*
 	 * Calculate our R/B ("Cr"/"Cb") colour statistics, and assess which are
@@ -840,14 +813,17 @@ void Alsc::doAlsc()
 	 */
 	applyCalTable(calTableR, cr);
 	applyCalTable(calTableB, cb);
-	/* Compute weights between zones. */
-	computeW(cr, config_.sigmaCr, wr);
-	computeW(cb, config_.sigmaCb, wb);
-	/* Run Gauss-Seidel iterations over the resulting matrix, for R and B. */
-	runMatrixIterations(cr, lambdaR_, wr, M, config_.omega, config_.nIter,
-			    config_.threshold, config_.lambdaBound);
-	runMatrixIterations(cb, lambdaB_, wb, M, config_.omega, config_.nIter,
-			    config_.threshold, config_.lambdaBound);
+	/*
+	 * Run Gauss-Seidel iterations over the matrix built from the weights
+	 * between zones, for R and B. We're going to normalise the lambdas so
+	 * the total average is 1.
+	 */
+	solver_.solve(cr, config_.sigmaCr, config_.omega, config_.nIter,
+		      config_.threshold, config_.lambdaBound, lambdaR_);
+	reaverage(lambdaR_);
+	solver_.solve(cb, config_.sigmaCb, config_.omega, config_.nIter,
+		      config_.threshold, config_.lambdaBound, lambdaB_);
+	reaverage(lambdaB_);
 	/*
 	 * Fold the calibrated gains into our final lambda values. (Note that on
 	 * the next run, we re-start with the lambda values that don't have the
@@ -861,6 +837,16 @@ void Alsc::doAlsc()
 			     config_.luminanceStrength);
 }
 
+std::optional<MetadataAccess> Alsc::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::AlscStatus });
+}
+
+std::optional<MetadataAccess> Alsc::processAccess() const
+{
+	return MetadataAccess({ MetadataTag::AwbStatus }, {});
+}
+
 /* Register algorithm with the system. */
 static Algorithm *create(Controller *controller)
 {
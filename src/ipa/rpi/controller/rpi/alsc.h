@@ -69,12 +69,42 @@ private:
 };
 
 /*
- * We'll use the term SparseArray for the large sparse matrices that are
- * XY tall but have only 4 non-zero elements on each row.
+ * The adaptive part of the ALSC algorithm. It finds the "lambdas" that make
+ * the colour ratios C of neighbouring regions as similar as possible, by
+ * running Gauss-Seidel iterations with over-relaxation over the large but
+ * sparse matrix M such that M * lambdas = 0. M is XY tall but has only 4
+ * non-zero elements on each row, which are stored in 4 separate planes.
+ *
+ * The lambdas are refined in place, the results of the previous run being
+ * the starting point of the next one, and the iterations stop early once
+ * they have converged.
  */
 
-template<typename T>
-using SparseArray = std::vector<std::array<T, 4>>;
+class AlscSolver
+{
+public:
+	using Size = libcamera::Size;
+
+	void configure(const Size &size);
+	unsigned int solve(const Array2D<double> &C, double sigma, double omega,
+			   unsigned int nIter, double threshold,
+			   double lambdaBound, Array2D<double> &lambda);
+
+private:
+	void computeWeights(const Array2D<double> &C, double sigma);
+	void constructM(const Array2D<double> &C);
+	double iterate(double omega, double lambdaBound);
+
+	unsigned int width_ = 0;
+	unsigned int size_ = 0;
+	/* weights between each region and its right and lower neighbours */
+	std::vector<double> weightH_;
+	std::vector<double> weightV_;
+	/* coefficients for the neighbours above, right, below and left */
+	std::array<std::vector<double>, 4> M_;
+	std::vector<double> lambda_;
+	std::vector<double> oldLambda_;
+};
 
 struct AlscCalibration {
 	double ct;
@@ -115,6 +145,8 @@ public:
 	int read(const libcamera::YamlObject &params) override;
 	void prepare(Metadata *imageMetadata) override;
 	void process(StatisticsPtr &stats, Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 
 private:
 	/* configuration is read-only, and available to both threads */
@@ -168,7 +200,7 @@ private:
 
 	/* Temporaries for the computations */
 	std::array<Array2D<double>, 5> tmpC_;
-	std::array<SparseArray<double>, 3> tmpM_;
+	AlscSolver solver_;
 };
 
 } /* namespace RPiController */
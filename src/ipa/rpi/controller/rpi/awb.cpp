@@ -5,8 +5,11 @@
  * AWB control algorithm
  */
 
+#include <algorithm>
 #include <assert.h>
+#include <cmath>
 #include <functional>
+#include <limits>
 
 #include <libcamera/base/log.h>
 
@@ -22,6 +25,15 @@ LOG_DEFINE_CATEGORY(RPiAwb)
 
 #define NAME "rpi.awb"
 
+/*
+ * A warm-started search may miss the best CT when the likelihood has several
+ * minima and the scene changes. Fall back to a full search when the lux level
+ * changes by more than this ratio, or when the colour error at the previous
+ * result, as a proportion of its maximum, changes by more than this amount.
+ */
+static constexpr double kMaxWarmStartLuxRatio = 2.0;
+static constexpr double kMaxWarmStartErrorChange = 0.1;
+
 /*
  * todo - the locking in this algorithm needs some tidying up as has been done
  * elsewhere (ALSC and AGC).
@@ -144,6 +156,7 @@ int AwbConfig::read(const libcamera::YamlObject &params)
 	minRegions = params["min_regions"].get<uint32_t>(10);
 	deltaLimit = params["delta_limit"].get<double>(0.2);
 	coarseStep = params["coarse_step"].get<double>(0.2);
+	fullSearchPeriod = params["full_search_period"].get<uint16_t>(10);
 	transversePos = params["transverse_pos"].get<double>(0.01);
 	transverseNeg = params["transverse_neg"].get<double>(0.01);
 	if (transversePos <= 0 || transverseNeg <= 0) {
@@ -219,6 +232,7 @@ void Awb::initialise()
 	}
 	prevSyncResults_ = syncResults_;
 	asyncResults_ = syncResults_;
+	search_.configure(config_);
 }
 
 void Awb::initialValues(double &gainR, double &gainB)
@@ -286,7 +300,7 @@ void Awb::switchMode([[maybe_unused]] CameraMode const &cameraMode,
 		     Metadata *metadata)
 {
 	/* Let other algorithms know the current white balance values. */
-	metadata->set("awb.status", prevSyncResults_);
+	metadata->set(MetadataTag::AwbStatus, prevSyncResults_);
 }
 
 bool Awb::isAutoEnabled() const
@@ -355,7 +369,7 @@ void Awb::prepare(Metadata *imageMetadata)
 				 (1.0 - speed) * prevSyncResults_.gainG;
 	prevSyncResults_.gainB = speed * syncResults_.gainB +
 				 (1.0 - speed) * prevSyncResults_.gainB;
-	imageMetadata->set("awb.status", prevSyncResults_);
+	imageMetadata->set(MetadataTag::AwbStatus, prevSyncResults_);
 	LOG(RPiAwb, Debug)
 		<< "Using AWB gains r " << prevSyncResults_.gainR << " g "
 		<< prevSyncResults_.gainG << " b "
@@ -375,7 +389,7 @@ void Awb::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		/* Update any settings and any image metadata that we need. */
 		struct LuxStatus luxStatus = {};
 		luxStatus.lux = 400; /* in case no metadata */
-		if (imageMetadata->get("lux.status", luxStatus) != 0)
+		if (imageMetadata->get(MetadataTag::LuxStatus, luxStatus) != 0)
 			LOG(RPiAwb, Debug) << "No lux metadata found";
 		LOG(RPiAwb, Debug) << "Awb lux value is " << luxStatus.lux;
 
@@ -411,6 +425,11 @@ static void generateStats(std::vector<Awb::RGB> &zones,
 {
 	std::scoped_lock<RPiController::Metadata> l(globalMetadata);
 
+	/* Factor in the ALSC applied colour shading correction if required. */
+	const AlscStatus *alscStatus = nullptr;
+	if (stats->colourStatsPos == Statistics::ColourStatsPos::PreLsc)
+		alscStatus = globalMetadata.getLocked<const AlscStatus>(MetadataTag::AlscStatus);
+
 	for (unsigned int i = 0; i < stats->awbRegions.numRegions(); i++) {
 		Awb::RGB zone;
 		auto &region = stats->awbRegions.get(i);
@@ -420,9 +439,7 @@ static void generateStats(std::vector<Awb::RGB> &zones,
 				continue;
 			zone.R = region.val.rSum / region.counted;
 			zone.B = region.val.bSum / region.counted;
-			/* Factor in the ALSC applied colour shading correction if required. */
-			const AlscStatus *alscStatus = globalMetadata.getLocked<AlscStatus>("alsc.status");
-			if (stats->colourStatsPos == Statistics::ColourStatsPos::PreLsc && alscStatus) {
+			if (alscStatus) {
 				zone.R *= alscStatus->r[i];
 				zone.G *= alscStatus->g[i];
 				zone.B *= alscStatus->b[i];
@@ -451,50 +468,6 @@ void Awb::prepareStats()
 	}
 }
 
-double Awb::computeDelta2Sum(double gainR, double gainB)
-{
-	/*
-	 * Compute the sum of the squared colour error (non-greyness) as it
-	 * appears in the log likelihood equation.
-	 */
-	double delta2Sum = 0;
-	for (auto &z : zones_) {
-		double deltaR = gainR * z.R - 1 - config_.whitepointR;
-		double deltaB = gainB * z.B - 1 - config_.whitepointB;
-		double delta2 = deltaR * deltaR + deltaB * deltaB;
-		/* LOG(RPiAwb, Debug) << "deltaR " << deltaR << " deltaB " << deltaB << " delta2 " << delta2; */
-		delta2 = std::min(delta2, config_.deltaLimit);
-		delta2Sum += delta2;
-	}
-	return delta2Sum;
-}
-
-ipa::Pwl Awb::interpolatePrior()
-{
-	/*
-	 * Interpolate the prior log likelihood function for our current lux
-	 * value.
-	 */
-	if (lux_ <= config_.priors.front().lux)
-		return config_.priors.front().prior;
-	else if (lux_ >= config_.priors.back().lux)
-		return config_.priors.back().prior;
-	else {
-		int idx = 0;
-		/* find which two we lie between */
-		while (config_.priors[idx + 1].lux < lux_)
-			idx++;
-		double lux0 = config_.priors[idx].lux,
-		       lux1 = config_.priors[idx + 1].lux;
-		return ipa::Pwl::combine(config_.priors[idx].prior,
-				    config_.priors[idx + 1].prior,
-				    [&](double /*x*/, double y0, double y1) {
-					    return y0 + (y1 - y0) *
-							(lux_ - lux0) / (lux1 - lux0);
-				    });
-	}
-}
-
 static double interpolateQuadatric(ipa::Pwl::Point const &a, ipa::Pwl::Point const &b,
 				   ipa::Pwl::Point const &c)
 {
@@ -514,63 +487,238 @@ static double interpolateQuadatric(ipa::Pwl::Point const &a, ipa::Pwl::Point con
 	return a.y() < c.y() - eps ? a.x() : (c.y() < a.y() - eps ? c.x() : b.x());
 }
 
-double Awb::coarseSearch(ipa::Pwl const &prior)
+AwbSearch::AwbSearch()
+	: config_(nullptr), prevMode_(nullptr), prevPoint_(0), prevLux_(0),
+	  prevError_(0), warmSearches_(0), zonesR_(nullptr), zonesB_(nullptr),
+	  priorScale_(1.0), band_(0), bandWeight_(0), grid_(nullptr),
+	  debug_(false)
+{
+}
+
+void AwbSearch::configure(const AwbConfig &config)
 {
-	points_.clear(); /* assume doesn't deallocate memory */
-	size_t bestPoint = 0;
-	double t = mode_->ctLo;
+	config_ = &config;
+	grids_.clear();
+	reset();
+}
+
+void AwbSearch::reset()
+{
+	prevMode_ = nullptr;
+	warmSearches_ = 0;
+}
+
+AwbSearch::Grid &AwbSearch::grid(const AwbMode &mode)
+{
+	auto it = grids_.find(&mode);
+	if (it != grids_.end())
+		return it->second;
+
+	/* Sample the CT curve at the steps the coarse search takes. */
+	Grid &grid = grids_[&mode];
+	double t = mode.ctLo;
 	int spanR = 0, spanB = 0;
-	/* Step down the CT curve evaluating log likelihood. */
 	while (true) {
-		double r = config_.ctR.eval(t, &spanR);
-		double b = config_.ctB.eval(t, &spanB);
-		double gainR = 1 / r, gainB = 1 / b;
-		double delta2Sum = computeDelta2Sum(gainR, gainB);
-		double priorLogLikelihood = prior.eval(prior.domain().clamp(t));
-		double finalLogLikelihood = delta2Sum - priorLogLikelihood;
-		LOG(RPiAwb, Debug)
-			<< "t: " << t << " gain R " << gainR << " gain B "
-			<< gainB << " delta2_sum " << delta2Sum
-			<< " prior " << priorLogLikelihood << " final "
-			<< finalLogLikelihood;
-		points_.push_back(ipa::Pwl::Point({ t, finalLogLikelihood }));
-		if (points_.back().y() < points_[bestPoint].y())
-			bestPoint = points_.size() - 1;
-		if (t == mode_->ctHi)
+		grid.t.push_back(t);
+		grid.r.push_back(config_->ctR.eval(t, &spanR));
+		grid.b.push_back(config_->ctB.eval(t, &spanB));
+		if (t == mode.ctHi)
 			break;
 		/* for even steps along the r/b curve scale them by the current t */
-		t = std::min(t + t / 10 * config_.coarseStep, mode_->ctHi);
+		t = std::min(t + t / 10 * config_->coarseStep, mode.ctHi);
 	}
-	t = points_[bestPoint].x();
-	LOG(RPiAwb, Debug) << "Coarse search found CT " << t;
+	grid.priors.resize(config_->priors.size() + 1);
+
+	return grid;
+}
+
+void AwbSearch::bandPriors(unsigned int band, ipa::Pwl const *&lo,
+			   ipa::Pwl const *&hi) const
+{
+	/*
+	 * Band 0 lies below the first prior's lux level, and the last band
+	 * above the last one's. Band n lies between priors n - 1 and n.
+	 */
+	const std::vector<AwbPrior> &priors = config_->priors;
+	lo = &priors[band ? band - 1 : 0].prior;
+	hi = &priors[std::min<size_t>(band, priors.size() - 1)].prior;
+}
+
+double AwbSearch::evalPrior(double t) const
+{
+	/*
+	 * Interpolating the priors of the band for our lux value, and then
+	 * evaluating the result, is the same as interpolating the values of
+	 * the priors themselves (over the union of their domains).
+	 */
+	ipa::Pwl const *lo, *hi;
+	bandPriors(band_, lo, hi);
+	ipa::Pwl::Interval domain(std::min(lo->domain().start, hi->domain().start),
+				  std::max(lo->domain().end, hi->domain().end));
+	t = domain.clamp(t);
+	double y0 = lo->eval(t), y1 = hi->eval(t);
+	return (y0 + (y1 - y0) * bandWeight_) * priorScale_;
+}
+
+double AwbSearch::computeDelta2Sum(double gainR, double gainB) const
+{
+	/*
+	 * Compute the sum of the squared colour error (non-greyness) as it
+	 * appears in the log likelihood equation. Use a few partial sums so
+	 * that the additions don't all wait for each other.
+	 */
+	const double *zonesR = zonesR_->data(), *zonesB = zonesB_->data();
+	const size_t numZones = zonesR_->size();
+	const double offsetR = 1 + config_->whitepointR;
+	const double offsetB = 1 + config_->whitepointB;
+	const double deltaLimit = config_->deltaLimit;
+	double sums[4] = { 0, 0, 0, 0 };
+	size_t i = 0;
+
+	for (; i + 4 <= numZones; i += 4) {
+		for (unsigned int j = 0; j < 4; j++) {
+			double deltaR = gainR * zonesR[i + j] - offsetR;
+			double deltaB = gainB * zonesB[i + j] - offsetB;
+			sums[j] += std::min(deltaR * deltaR + deltaB * deltaB,
+					    deltaLimit);
+		}
+	}
+	for (; i < numZones; i++) {
+		double deltaR = gainR * zonesR[i] - offsetR;
+		double deltaB = gainB * zonesB[i] - offsetB;
+		sums[0] += std::min(deltaR * deltaR + deltaB * deltaB, deltaLimit);
+	}
+
+	return (sums[0] + sums[1]) + (sums[2] + sums[3]);
+}
+
+double AwbSearch::prior(unsigned int i) const
+{
+	/* The prior log likelihood at coarse search point i. */
+	auto &[lo, hi] = grid_->priors[band_];
+	return (lo[i] + (hi[i] - lo[i]) * bandWeight_) * priorScale_;
+}
+
+double AwbSearch::likelihood(unsigned int i)
+{
+	/* Evaluate the log likelihood at coarse search point i, if not done yet. */
+	double &value = likelihoods_[i];
+	if (!std::isnan(value))
+		return value;
+
+	double gainR = 1 / grid_->r[i], gainB = 1 / grid_->b[i];
+	double delta2Sum = computeDelta2Sum(gainR, gainB);
+	double priorLogLikelihood = prior(i);
+	value = delta2Sum - priorLogLikelihood;
+	if (debug_)
+		LOG(RPiAwb, Debug)
+			<< "t: " << grid_->t[i] << " gain R " << gainR
+			<< " gain B " << gainB << " delta2_sum " << delta2Sum
+			<< " prior " << priorLogLikelihood << " final " << value;
+	return value;
+}
+
+double AwbSearch::colourError(unsigned int i)
+{
+	/*
+	 * The colour error at coarse search point i, as a proportion of the
+	 * largest possible error given the number of zones.
+	 */
+	double maxError = std::max<size_t>(zonesR_->size(), 1) * config_->deltaLimit;
+	return (likelihood(i) + prior(i)) / maxError;
+}
+
+bool AwbSearch::canWarmStart(double lux, const AwbMode &mode)
+{
+	/* Only warm-start from a search over the same part of the CT curve. */
+	if (prevMode_ != &mode || warmSearches_ + 1 >= config_->fullSearchPeriod)
+		return false;
+
+	double luxRatio = std::max(lux, prevLux_) / std::max(std::min(lux, prevLux_), 1.0);
+	if (luxRatio > kMaxWarmStartLuxRatio) {
+		LOG(RPiAwb, Debug)
+			<< "Lux changed from " << prevLux_ << " to " << lux
+			<< ", running a full search";
+		return false;
+	}
+
+	unsigned int point = std::min<unsigned int>(prevPoint_, grid_->t.size() - 1);
+	double error = colourError(point);
+	if (std::abs(error - prevError_) > kMaxWarmStartErrorChange) {
+		LOG(RPiAwb, Debug)
+			<< "Colour error at CT " << grid_->t[point]
+			<< " changed from " << prevError_ << " to " << error
+			<< ", running a full search";
+		return false;
+	}
+
+	return true;
+}
+
+double AwbSearch::coarseSearch(bool warmStart)
+{
+	const std::vector<double> &t = grid_->t;
+	const unsigned int numPoints = t.size();
+
+	unsigned int bestPoint = 0;
+	if (warmStart) {
+		/*
+		 * Walk down the CT curve from the previous result until we
+		 * reach a minimum. This finds the same result as the full
+		 * search unless the likelihood has several minima.
+		 */
+		bestPoint = std::min(prevPoint_, numPoints - 1);
+		if (bestPoint + 1 < numPoints &&
+		    likelihood(bestPoint + 1) < likelihood(bestPoint)) {
+			while (bestPoint + 1 < numPoints &&
+			       likelihood(bestPoint + 1) < likelihood(bestPoint))
+				bestPoint++;
+		} else {
+			while (bestPoint > 0 &&
+			       likelihood(bestPoint - 1) <= likelihood(bestPoint))
+				bestPoint--;
+		}
+	} else {
+		/* Step down the whole CT curve evaluating log likelihood. */
+		for (unsigned int i = 0; i < numPoints; i++) {
+			if (likelihood(i) < likelihood(bestPoint))
+				bestPoint = i;
+		}
+	}
+	prevPoint_ = bestPoint;
+	prevError_ = colourError(bestPoint);
+
+	double ct = t[bestPoint];
+	LOG(RPiAwb, Debug)
+		<< (warmStart ? "Warm-started" : "Full")
+		<< " coarse search found CT " << ct;
 	/*
 	 * We have the best point of the search, but refine it with a quadratic
 	 * interpolation around its neighbours.
 	 */
-	if (points_.size() > 2) {
-		unsigned long bp = std::min(bestPoint, points_.size() - 2);
-		bestPoint = std::max(1UL, bp);
-		t = interpolateQuadatric(points_[bestPoint - 1],
-					 points_[bestPoint],
-					 points_[bestPoint + 1]);
+	if (numPoints > 2) {
+		bestPoint = std::clamp(bestPoint, 1U, numPoints - 2);
+		ct = interpolateQuadatric(ipa::Pwl::Point({ t[bestPoint - 1], likelihood(bestPoint - 1) }),
+					  ipa::Pwl::Point({ t[bestPoint], likelihood(bestPoint) }),
+					  ipa::Pwl::Point({ t[bestPoint + 1], likelihood(bestPoint + 1) }));
 		LOG(RPiAwb, Debug)
 			<< "After quadratic refinement, coarse search has CT "
-			<< t;
+			<< ct;
 	}
-	return t;
+	return ct;
 }
 
-void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
+void AwbSearch::fineSearch(double &t, double &r, double &b) const
 {
 	int spanR = -1, spanB = -1;
-	config_.ctR.eval(t, &spanR);
-	config_.ctB.eval(t, &spanB);
-	double step = t / 10 * config_.coarseStep * 0.1;
+	config_->ctR.eval(t, &spanR);
+	config_->ctB.eval(t, &spanB);
+	double step = t / 10 * config_->coarseStep * 0.1;
 	int nsteps = 5;
-	double rDiff = config_.ctR.eval(t + nsteps * step, &spanR) -
-		       config_.ctR.eval(t - nsteps * step, &spanR);
-	double bDiff = config_.ctB.eval(t + nsteps * step, &spanB) -
-		       config_.ctB.eval(t - nsteps * step, &spanB);
+	double rDiff = config_->ctR.eval(t + nsteps * step, &spanR) -
+		       config_->ctR.eval(t - nsteps * step, &spanR);
+	double bDiff = config_->ctB.eval(t + nsteps * step, &spanB) -
+		       config_->ctB.eval(t - nsteps * step, &spanB);
 	ipa::Pwl::Point transverse({ bDiff, -rDiff });
 	if (transverse.length2() < 1e-6)
 		return;
@@ -580,7 +728,7 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 	 */
 	transverse = transverse / transverse.length();
 	double bestLogLikelihood = 0, bestT = 0, bestR = 0, bestB = 0;
-	double transverseRange = config_.transverseNeg + config_.transversePos;
+	double transverseRange = config_->transverseNeg + config_->transversePos;
 	const int maxNumDeltas = 12;
 	/* a transverse step approximately every 0.01 r/b units */
 	int numDeltas = floor(transverseRange * 100 + 0.5) + 1;
@@ -592,16 +740,15 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 	nsteps += numDeltas;
 	for (int i = -nsteps; i <= nsteps; i++) {
 		double tTest = t + i * step;
-		double priorLogLikelihood =
-			prior.eval(prior.domain().clamp(tTest));
-		double rCurve = config_.ctR.eval(tTest, &spanR);
-		double bCurve = config_.ctB.eval(tTest, &spanB);
+		double priorLogLikelihood = evalPrior(tTest);
+		double rCurve = config_->ctR.eval(tTest, &spanR);
+		double bCurve = config_->ctB.eval(tTest, &spanB);
 		/* x will be distance off the curve, y the log likelihood there */
 		ipa::Pwl::Point points[maxNumDeltas];
 		int bestPoint = 0;
 		/* Take some measurements transversely *off* the CT curve. */
 		for (int j = 0; j < numDeltas; j++) {
-			points[j][0] = -config_.transverseNeg +
+			points[j][0] = -config_->transverseNeg +
 				       (transverseRange * j) / (numDeltas - 1);
 			ipa::Pwl::Point rbTest = ipa::Pwl::Point({ rCurve, bCurve }) +
 						 transverse * points[j].x();
@@ -609,9 +756,10 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 			double gainR = 1 / rTest, gainB = 1 / bTest;
 			double delta2Sum = computeDelta2Sum(gainR, gainB);
 			points[j][1] = delta2Sum - priorLogLikelihood;
-			LOG(RPiAwb, Debug)
-				<< "At t " << tTest << " r " << rTest << " b "
-				<< bTest << ": " << points[j].y();
+			if (debug_)
+				LOG(RPiAwb, Debug)
+					<< "At t " << tTest << " r " << rTest << " b "
+					<< bTest << ": " << points[j].y();
 			if (points[j].y() < points[bestPoint].y())
 				bestPoint = j;
 		}
@@ -628,11 +776,12 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 		double gainR = 1 / rTest, gainB = 1 / bTest;
 		double delta2Sum = computeDelta2Sum(gainR, gainB);
 		double finalLogLikelihood = delta2Sum - priorLogLikelihood;
-		LOG(RPiAwb, Debug)
-			<< "Finally "
-			<< tTest << " r " << rTest << " b " << bTest << ": "
-			<< finalLogLikelihood
-			<< (finalLogLikelihood < bestLogLikelihood ? " BEST" : "");
+		if (debug_)
+			LOG(RPiAwb, Debug)
+				<< "Finally "
+				<< tTest << " r " << rTest << " b " << bTest << ": "
+				<< finalLogLikelihood
+				<< (finalLogLikelihood < bestLogLikelihood ? " BEST" : "");
 		if (bestT == 0 || finalLogLikelihood < bestLogLikelihood)
 			bestLogLikelihood = finalLogLikelihood,
 			bestT = tTest, bestR = rTest, bestB = bTest;
@@ -642,26 +791,67 @@ void Awb::fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
 		<< "Fine search found t " << t << " r " << r << " b " << b;
 }
 
-void Awb::awbBayes()
+void AwbSearch::search(const std::vector<double> &zonesR,
+		       const std::vector<double> &zonesB, double priorScale,
+		       double lux, const AwbMode &mode, double &t, double &r,
+		       double &b)
 {
+	zonesR_ = &zonesR;
+	zonesB_ = &zonesB;
+	priorScale_ = priorScale;
 	/*
-	 * May as well divide out G to save computeDelta2Sum from doing it over
-	 * and over.
+	 * Every point evaluated by the search can be logged, but building the
+	 * messages is costly, so only do so when they get printed.
 	 */
-	for (auto &z : zones_)
-		z.R = z.R / (z.G + 1), z.B = z.B / (z.G + 1);
-	/*
-	 * Get the current prior, and scale according to how many zones are
-	 * valid... not entirely sure about this.
-	 */
-	ipa::Pwl prior = interpolatePrior();
-	prior *= zones_.size() / (double)(statistics_->awbRegions.numRegions());
-	prior.map([](double x, double y) {
-		LOG(RPiAwb, Debug) << "(" << x << "," << y << ")";
-	});
-	double t = coarseSearch(prior);
-	double r = config_.ctR.eval(t);
-	double b = config_.ctB.eval(t);
+	debug_ = _LOG_CATEGORY(RPiAwb)().severity() <= LogDebug;
+
+	/* Find the lux band, and how far through it we are. */
+	const std::vector<AwbPrior> &priors = config_->priors;
+	bandWeight_ = 0;
+	if (lux <= priors.front().lux)
+		band_ = 0;
+	else if (lux >= priors.back().lux)
+		band_ = priors.size();
+	else {
+		unsigned int idx = 0;
+		/* find which two we lie between */
+		while (priors[idx + 1].lux < lux)
+			idx++;
+		band_ = idx + 1;
+		bandWeight_ = (lux - priors[idx].lux) /
+			      (priors[idx + 1].lux - priors[idx].lux);
+	}
+
+	grid_ = &grid(mode);
+	auto &[lo, hi] = grid_->priors[band_];
+	if (lo.empty()) {
+		ipa::Pwl const *priorLo, *priorHi;
+		bandPriors(band_, priorLo, priorHi);
+		double start = std::min(priorLo->domain().start, priorHi->domain().start);
+		double end = std::max(priorLo->domain().end, priorHi->domain().end);
+		for (double ct : grid_->t) {
+			ct = std::clamp(ct, start, end);
+			lo.push_back(priorLo->eval(ct));
+			hi.push_back(priorHi->eval(ct));
+		}
+	}
+
+	if (debug_) {
+		for (unsigned int i = 0; i < grid_->t.size(); i++)
+			LOG(RPiAwb, Debug)
+				<< "(" << grid_->t[i] << "," << prior(i) << ")";
+	}
+
+	likelihoods_.assign(grid_->t.size(), std::numeric_limits<double>::quiet_NaN());
+
+	bool warmStart = canWarmStart(lux, mode);
+	warmSearches_ = warmStart ? warmSearches_ + 1 : 0;
+	prevMode_ = &mode;
+	prevLux_ = lux;
+
+	t = coarseSearch(warmStart);
+	r = config_->ctR.eval(t);
+	b = config_->ctB.eval(t);
 	LOG(RPiAwb, Debug)
 		<< "After coarse search: r " << r << " b " << b << " (gains r "
 		<< 1 / r << " b " << 1 / b << ")";
@@ -673,10 +863,31 @@ void Awb::awbBayes()
 	 * though I probably need more real datasets before deciding exactly how
 	 * this should be controlled and tuned.
 	 */
-	fineSearch(t, r, b, prior);
+	fineSearch(t, r, b);
 	LOG(RPiAwb, Debug)
 		<< "After fine search: r " << r << " b " << b << " (gains r "
 		<< 1 / r << " b " << 1 / b << ")";
+}
+
+void Awb::awbBayes()
+{
+	/*
+	 * May as well divide out G to save the search from doing it over and
+	 * over.
+	 */
+	zonesR_.clear();
+	zonesB_.clear();
+	for (auto &z : zones_) {
+		zonesR_.push_back(z.R / (z.G + 1));
+		zonesB_.push_back(z.B / (z.G + 1));
+	}
+	/*
+	 * Scale the prior according to how many zones are valid... not
+	 * entirely sure about this.
+	 */
+	double priorScale = zones_.size() / (double)(statistics_->awbRegions.numRegions());
+	double t, r, b;
+	search_.search(zonesR_, zonesB_, priorScale, lux_, *mode_, t, r, b);
 	/*
 	 * Write results out for the main thread to pick up. Remember to adjust
 	 * the gains from the ones that the "canonical sensor" would require to
@@ -744,6 +955,16 @@ void Awb::doAwb()
 	statistics_.reset();
 }
 
+std::optional<MetadataAccess> Awb::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::AwbStatus });
+}
+
+std::optional<MetadataAccess> Awb::processAccess() const
+{
+	return MetadataAccess({ MetadataTag::LuxStatus }, {});
+}
+
 /* Register algorithm with the system. */
 static Algorithm *create(Controller *controller)
 {
@@ -8,7 +8,10 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <map>
 #include <thread>
+#include <utility>
+#include <vector>
 
 #include <libcamera/geometry.h>
 
@@ -69,6 +72,12 @@ struct AwbConfig {
 	double deltaLimit;
 	/* step size control in coarse search */
 	double coarseStep;
+	/*
+	 * search the whole CT curve at least every "this many" AWB runs, and
+	 * only search from the previous result in between, unless the scene
+	 * changes
+	 */
+	uint16_t fullSearchPeriod;
 	/* how far to wander off CT curve towards "more purple" */
 	double transversePos;
 	/* how far to wander off CT curve towards "more green" */
@@ -89,6 +98,76 @@ struct AwbConfig {
 	bool bayes; /* use Bayesian algorithm */
 };
 
+/*
+ * Bayesian search for the most likely illuminant along the CT curve. The
+ * coarse search points, and the priors evaluated at them, are cached for each
+ * AWB mode and lux band. The coarse search normally starts from its previous
+ * result and only walks as far as the nearest minimum.
+ */
+class AwbSearch
+{
+public:
+	AwbSearch();
+	void configure(const AwbConfig &config);
+	/* forget the previous result, so that the next search is a full one */
+	void reset();
+	/*
+	 * zonesR and zonesB hold the R/G and B/G values of the valid zones,
+	 * and the prior is scaled by priorScale. Returns the CT found with the
+	 * corresponding r and b values.
+	 */
+	void search(const std::vector<double> &zonesR,
+		    const std::vector<double> &zonesB, double priorScale,
+		    double lux, const AwbMode &mode, double &t, double &r,
+		    double &b);
+
+private:
+	struct Grid {
+		/* the CT curve sampled at the coarse search steps */
+		std::vector<double> t;
+		std::vector<double> r;
+		std::vector<double> b;
+		/*
+		 * the priors at each step, for the lower and upper lux
+		 * levels of each lux band (empty until the band is used)
+		 */
+		std::vector<std::pair<std::vector<double>, std::vector<double>>> priors;
+	};
+
+	Grid &grid(const AwbMode &mode);
+	void bandPriors(unsigned int band, libcamera::ipa::Pwl const *&lo,
+			libcamera::ipa::Pwl const *&hi) const;
+	double evalPrior(double t) const;
+	double computeDelta2Sum(double gainR, double gainB) const;
+	double prior(unsigned int i) const;
+	double likelihood(unsigned int i);
+	double colourError(unsigned int i);
+	bool canWarmStart(double lux, const AwbMode &mode);
+	double coarseSearch(bool warmStart);
+	void fineSearch(double &t, double &r, double &b) const;
+
+	const AwbConfig *config_;
+	std::map<const AwbMode *, Grid> grids_;
+	/* where the previous coarse search finished */
+	const AwbMode *prevMode_;
+	unsigned int prevPoint_;
+	/* lux level and colour error at the end of the previous search */
+	double prevLux_;
+	double prevError_;
+	/* number of warm-started searches since the last full one */
+	unsigned int warmSearches_;
+	/* state of the search in progress */
+	const std::vector<double> *zonesR_;
+	const std::vector<double> *zonesB_;
+	double priorScale_;
+	unsigned int band_;
+	double bandWeight_;
+	Grid *grid_;
+	std::vector<double> likelihoods_;
+	/* whether to log every point evaluated by the search */
+	bool debug_;
+};
+
 class Awb : public AwbAlgorithm
 {
 public:
@@ -106,6 +185,8 @@ public:
 	void switchMode(CameraMode const &cameraMode, Metadata *metadata) override;
 	void prepare(Metadata *imageMetadata) override;
 	void process(StatisticsPtr &stats, Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 	struct RGB {
 		RGB(double r = 0, double g = 0, double b = 0)
 			: R(r), G(g), B(b)
@@ -163,12 +244,11 @@ private:
 	void awbBayes();
 	void awbGrey();
 	void prepareStats();
-	double computeDelta2Sum(double gainR, double gainB);
-	libcamera::ipa::Pwl interpolatePrior();
-	double coarseSearch(libcamera::ipa::Pwl const &prior);
-	void fineSearch(double &t, double &r, double &b, libcamera::ipa::Pwl const &prior);
 	std::vector<RGB> zones_;
-	std::vector<libcamera::ipa::Pwl::Point> points_;
+	/* the zones as passed to the Bayesian search */
+	std::vector<double> zonesR_;
+	std::vector<double> zonesB_;
+	AwbSearch search_;
 	/* manual r setting */
 	double manualR_;
 	/* manual b setting */
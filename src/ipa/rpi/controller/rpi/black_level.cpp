@@ -63,7 +63,17 @@ void BlackLevel::prepare(Metadata *imageMetadata)
 	status.blackLevelR = blackLevelR_;
 	status.blackLevelG = blackLevelG_;
 	status.blackLevelB = blackLevelB_;
-	imageMetadata->set("black_level.status", status);
+	imageMetadata->set(MetadataTag::BlackLevelStatus, status);
+}
+
+std::optional<MetadataAccess> BlackLevel::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::BlackLevelStatus });
+}
+
+std::optional<MetadataAccess> BlackLevel::processAccess() const
+{
+	return MetadataAccess();
 }
 
 /* Register algorithm with the system. */
@@ -22,6 +22,8 @@ public:
 	void initialValues(uint16_t &blackLevelR, uint16_t &blackLevelG,
 			   uint16_t &blackLevelB) override;
 	void prepare(Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 
 private:
 	double blackLevelR_;
@@ -96,7 +96,17 @@ int Cac::read(const libcamera::YamlObject &params)
 void Cac::prepare(Metadata *imageMetadata)
 {
 	if (config_.enabled)
-		imageMetadata->set("cac.status", cacStatus_);
+		imageMetadata->set(MetadataTag::CacStatus, cacStatus_);
+}
+
+std::optional<MetadataAccess> Cac::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::CacStatus });
+}
+
+std::optional<MetadataAccess> Cac::processAccess() const
+{
+	return MetadataAccess();
 }
 
 // Register algorithm with the system.
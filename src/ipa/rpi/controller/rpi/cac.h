@@ -26,6 +26,8 @@ public:
 	char const *name() const override;
 	int read(const libcamera::YamlObject &params) override;
 	void prepare(Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 
 private:
 	CacConfig config_;
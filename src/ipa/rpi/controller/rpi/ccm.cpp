@@ -116,9 +116,9 @@ void Ccm::initialise()
 namespace {
 
 template<typename T>
-bool getLocked(Metadata *metadata, std::string const &tag, T &value)
+bool getLocked(Metadata *metadata, MetadataTag tag, T &value)
 {
-	T *ptr = metadata->getLocked<T>(tag);
+	const T *ptr = metadata->getLocked<const T>(tag);
 	if (ptr == nullptr)
 		return false;
 	value = *ptr;
@@ -163,8 +163,8 @@ void Ccm::prepare(Metadata *imageMetadata)
 	{
 		/* grab mutex just once to get everything */
 		std::lock_guard<Metadata> lock(*imageMetadata);
-		awbOk = getLocked(imageMetadata, "awb.status", awb);
-		luxOk = getLocked(imageMetadata, "lux.status", lux);
+		awbOk = getLocked(imageMetadata, MetadataTag::AwbStatus, awb);
+		luxOk = getLocked(imageMetadata, MetadataTag::LuxStatus, lux);
 	}
 	if (!awbOk)
 		LOG(RPiCcm, Warning) << "no colour temperature found";
@@ -191,7 +191,17 @@ void Ccm::prepare(Metadata *imageMetadata)
 		<< " " << ccmStatus.matrix[5] << "     "
 		<< ccmStatus.matrix[6] << " " << ccmStatus.matrix[7]
 		<< " " << ccmStatus.matrix[8];
-	imageMetadata->set("ccm.status", ccmStatus);
+	imageMetadata->set(MetadataTag::CcmStatus, ccmStatus);
+}
+
+std::optional<MetadataAccess> Ccm::prepareAccess() const
+{
+	return MetadataAccess({ MetadataTag::AwbStatus, MetadataTag::LuxStatus }, { MetadataTag::CcmStatus });
+}
+
+std::optional<MetadataAccess> Ccm::processAccess() const
+{
+	return MetadataAccess();
 }
 
 /* Register algorithm with the system. */
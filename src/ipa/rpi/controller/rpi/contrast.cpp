@@ -91,7 +91,7 @@ void Contrast::initialise()
 
 void Contrast::prepare(Metadata *imageMetadata)
 {
-	imageMetadata->set("contrast.status", status_);
+	imageMetadata->set(MetadataTag::ContrastStatus, status_);
 }
 
 namespace {
@@ -190,6 +190,16 @@ void Contrast::process(StatisticsPtr &stats,
 	status_.gammaCurve = std::move(gammaCurve);
 }
 
+std::optional<MetadataAccess> Contrast::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::ContrastStatus });
+}
+
+std::optional<MetadataAccess> Contrast::processAccess() const
+{
+	return MetadataAccess();
+}
+
 /* Register algorithm with the system. */
 static Algorithm *create(Controller *controller)
 {
@@ -42,6 +42,8 @@ public:
 	void initialise() override;
 	void switchMode(CameraMode const &cameraMode, Metadata *metadata) override;
 	void prepare(Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 	void setMode(DenoiseMode mode) override;
 	void setConfig(std::string const &name) override;
 
@@ -48,7 +48,17 @@ void Dpc::prepare(Metadata *imageMetadata)
 	/* Should we vary this with lux level or analogue gain? TBD. */
 	dpcStatus.strength = config_.strength;
 	LOG(RPiDpc, Debug) << "strength " << dpcStatus.strength;
-	imageMetadata->set("dpc.status", dpcStatus);
+	imageMetadata->set(MetadataTag::DpcStatus, dpcStatus);
+}
+
+std::optional<MetadataAccess> Dpc::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::DpcStatus });
+}
+
+std::optional<MetadataAccess> Dpc::processAccess() const
+{
+	return MetadataAccess();
 }
 
 /* Register algorithm with the system. */
@@ -56,11 +56,11 @@ void Geq::prepare(Metadata *imageMetadata)
 {
 	LuxStatus luxStatus = {};
 	luxStatus.lux = 400;
-	if (imageMetadata->get("lux.status", luxStatus))
+	if (imageMetadata->get(MetadataTag::LuxStatus, luxStatus))
 		LOG(RPiGeq, Warning) << "no lux data found";
 	DeviceStatus deviceStatus;
 	deviceStatus.analogueGain = 1.0; /* in case not found */
-	if (imageMetadata->get("device.status", deviceStatus))
+	if (imageMetadata->get(MetadataTag::DeviceStatus, deviceStatus))
 		LOG(RPiGeq, Warning)
 			<< "no device metadata - use analogue gain of 1x";
 	GeqStatus geqStatus = {};
@@ -77,7 +77,17 @@ void Geq::prepare(Metadata *imageMetadata)
 		<< geqStatus.slope << " (analogue gain "
 		<< deviceStatus.analogueGain << " lux "
 		<< luxStatus.lux << ")";
-	imageMetadata->set("geq.status", geqStatus);
+	imageMetadata->set(MetadataTag::GeqStatus, geqStatus);
+}
+
+std::optional<MetadataAccess> Geq::prepareAccess() const
+{
+	return MetadataAccess({ MetadataTag::LuxStatus, MetadataTag::DeviceStatus }, { MetadataTag::GeqStatus });
+}
+
+std::optional<MetadataAccess> Geq::processAccess() const
+{
+	return MetadataAccess();
 }
 
 /* Register algorithm with the system. */
@@ -154,7 +154,7 @@ std::vector<unsigned int> Hdr::getChannels() const
 void Hdr::updateAgcStatus(Metadata *metadata)
 {
 	std::scoped_lock lock(*metadata);
-	AgcStatus *agcStatus = metadata->getLocked<AgcStatus>("agc.status");
+	AgcStatus *agcStatus = metadata->getLocked<AgcStatus>(MetadataTag::AgcStatus);
 	if (agcStatus) {
 		HdrConfig &hdrConfig = config_[status_.mode];
 		auto it = hdrConfig.channelMap.find(agcStatus->channel);
@@ -177,7 +177,7 @@ void Hdr::switchMode([[maybe_unused]] CameraMode const &cameraMode, Metadata *me
 void Hdr::prepare(Metadata *imageMetadata)
 {
 	AgcStatus agcStatus;
-	if (!imageMetadata->get<AgcStatus>("agc.delayed_status", agcStatus))
+	if (!imageMetadata->get<AgcStatus>(MetadataTag::AgcDelayedStatus, agcStatus))
 		delayedStatus_ = agcStatus.hdr;
 
 	auto it = config_.find(delayedStatus_.mode);
@@ -192,7 +192,7 @@ void Hdr::prepare(Metadata *imageMetadata)
 		return;
 
 	AlscStatus alscStatus{}; /* some compilers seem to require the braces */
-	if (imageMetadata->get<AlscStatus>("alsc.status", alscStatus)) {
+	if (imageMetadata->get<AlscStatus>(MetadataTag::AlscStatus, alscStatus)) {
 		LOG(RPiHdr, Warning) << "No ALSC status";
 		return;
 	}
@@ -204,7 +204,7 @@ void Hdr::prepare(Metadata *imageMetadata)
 		alscStatus.g[i] *= gains[i];
 		alscStatus.b[i] *= gains[i];
 	}
-	imageMetadata->set("alsc.status", alscStatus);
+	imageMetadata->set(MetadataTag::AlscStatus, alscStatus);
 }
 
 bool Hdr::updateTonemap([[maybe_unused]] StatisticsPtr &stats, HdrConfig &config)
@@ -369,7 +369,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 	 * case delayedStatus_ should be right.
 	 */
 	AgcStatus agcStatus;
-	if (!imageMetadata->get<AgcStatus>("agc.delayed_status", agcStatus))
+	if (!imageMetadata->get<AgcStatus>(MetadataTag::AgcDelayedStatus, agcStatus))
 		delayedStatus_ = agcStatus.hdr;
 
 	auto it = config_.find(delayedStatus_.mode);
@@ -394,7 +394,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		tonemapStatus.strength = config.strength;
 		tonemapStatus.tonemap = tonemap_;
 
-		imageMetadata->set("tonemap.status", tonemapStatus);
+		imageMetadata->set(MetadataTag::TonemapStatus, tonemapStatus);
 	}
 
 	if (config.stitchEnable) {
@@ -405,7 +405,7 @@ void Hdr::process(StatisticsPtr &stats, Metadata *imageMetadata)
 		stitchStatus.motionThreshold = config.motionThreshold;
 		stitchStatus.thresholdLo = config.thresholdLo;
 
-		imageMetadata->set("stitch.status", stitchStatus);
+		imageMetadata->set(MetadataTag::StitchStatus, stitchStatus);
 	}
 }
 
@@ -60,7 +60,7 @@ void Noise::prepare(Metadata *imageMetadata)
 {
 	struct DeviceStatus deviceStatus;
 	deviceStatus.analogueGain = 1.0; /* keep compiler calm */
-	if (imageMetadata->get("device.status", deviceStatus) == 0) {
+	if (imageMetadata->get(MetadataTag::DeviceStatus, deviceStatus) == 0) {
 		/*
 		 * There is a slight question as to exactly how the noise
 		 * profile, specifically the constant part of it, scales. For
@@ -73,7 +73,7 @@ void Noise::prepare(Metadata *imageMetadata)
 		struct NoiseStatus status;
 		status.noiseConstant = referenceConstant_ * factor;
 		status.noiseSlope = referenceSlope_ * factor;
-		imageMetadata->set("noise.status", status);
+		imageMetadata->set(MetadataTag::NoiseStatus, status);
 		LOG(RPiNoise, Debug)
 			<< "constant " << status.noiseConstant
 			<< " slope " << status.noiseSlope;
@@ -81,6 +81,16 @@ void Noise::prepare(Metadata *imageMetadata)
 		LOG(RPiNoise, Warning) << " no metadata";
 }
 
+std::optional<MetadataAccess> Noise::prepareAccess() const
+{
+	return MetadataAccess({ MetadataTag::DeviceStatus }, { MetadataTag::NoiseStatus });
+}
+
+std::optional<MetadataAccess> Noise::processAccess() const
+{
+	return MetadataAccess();
+}
+
 /* Register algorithm with the system. */
 static Algorithm *create(Controller *controller)
 {
@@ -46,7 +46,17 @@ void Saturation::prepare(Metadata *imageMetadata)
 	saturation.shiftR = config_.shiftR;
 	saturation.shiftG = config_.shiftG;
 	saturation.shiftB = config_.shiftB;
-	imageMetadata->set("saturation.status", saturation);
+	imageMetadata->set(MetadataTag::SaturationStatus, saturation);
+}
+
+std::optional<MetadataAccess> Saturation::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::SaturationStatus });
+}
+
+std::optional<MetadataAccess> Saturation::processAccess() const
+{
+	return MetadataAccess();
 }
 
 // Register algorithm with the system.
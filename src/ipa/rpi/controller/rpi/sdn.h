@@ -21,6 +21,8 @@ public:
 	int read(const libcamera::YamlObject &params) override;
 	void initialise() override;
 	void prepare(Metadata *imageMetadata) override;
+	std::optional<MetadataAccess> prepareAccess() const override;
+	std::optional<MetadataAccess> processAccess() const override;
 	void setMode(DenoiseMode mode) override;
 
 private:
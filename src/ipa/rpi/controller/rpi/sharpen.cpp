@@ -81,7 +81,17 @@ void Sharpen::prepare(Metadata *imageMetadata)
 	status.limit = limit_ / modeFactor_ * userStrengthSqrt;
 	/* Finally, report any application-supplied parameters that were used. */
 	status.userStrength = userStrength_;
-	imageMetadata->set("sharpen.status", status);
+	imageMetadata->set(MetadataTag::SharpenStatus, status);
+}
+
+std::optional<MetadataAccess> Sharpen::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::SharpenStatus });
+}
+
+std::optional<MetadataAccess> Sharpen::processAccess() const
+{
+	return MetadataAccess();
 }
 
 /* Register algorithm with the system. */
@@ -50,7 +50,17 @@ void Tonemap::prepare(Metadata *imageMetadata)
 	tonemapStatus.iirStrength = config_.iirStrength;
 	tonemapStatus.strength = config_.strength;
 	tonemapStatus.tonemap = config_.tonemap;
-	imageMetadata->set("tonemap.status", tonemapStatus);
+	imageMetadata->set(MetadataTag::TonemapStatus, tonemapStatus);
+}
+
+std::optional<MetadataAccess> Tonemap::prepareAccess() const
+{
+	return MetadataAccess({}, { MetadataTag::TonemapStatus });
+}
+
+std::optional<MetadataAccess> Tonemap::processAccess() const
+{
+	return MetadataAccess();
 }
 
 // Register algorithm with the system.
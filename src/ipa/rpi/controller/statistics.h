@@ -6,6 +6,7 @@
  */
 #pragma once
 
+#include <atomic>
 #include <memory>
 #include <stdint.h>
 #include <vector>
@@ -75,4 +76,41 @@ struct Statistics {
 
 using StatisticsPtr = std::shared_ptr<Statistics>;
 
+/*
+ * A pool of Statistics, so that the statistics of each frame can reuse the
+ * storage of earlier ones instead of being allocated from scratch. Algorithms
+ * may hold on to the statistics of earlier frames, so a Statistics is only
+ * handed out again once nothing else references it.
+ */
+class StatisticsPool
+{
+public:
+	StatisticsPool(Statistics::AgcStatsPos a, Statistics::ColourStatsPos c)
+		: agcStatsPos_(a), colourStatsPos_(c)
+	{
+	}
+
+	StatisticsPtr acquire()
+	{
+		for (StatisticsPtr &statistics : pool_) {
+			if (statistics.use_count() == 1) {
+				/*
+				 * The last user may have released it from
+				 * another thread, make sure it's done with it.
+				 */
+				std::atomic_thread_fence(std::memory_order_acquire);
+				return statistics;
+			}
+		}
+
+		return pool_.emplace_back(std::make_shared<Statistics>(agcStatsPos_,
+								       colourStatsPos_));
+	}
+
+private:
+	Statistics::AgcStatsPos agcStatsPos_;
+	Statistics::ColourStatsPos colourStatsPos_;
+	std::vector<StatisticsPtr> pool_;
+};
+
 } /* namespace RPiController */
@@ -0,0 +1,78 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * pool of threads to run algorithms concurrently
+ */
+
+#include "worker_pool.h"
+
+using namespace RPiController;
+
+WorkerPool::WorkerPool(unsigned int numWorkers)
+	: func_(nullptr), count_(0), next_(0), pending_(0), abort_(false)
+{
+	for (unsigned int i = 0; i < numWorkers; i++)
+		workers_.emplace_back(&WorkerPool::workerFunc, this);
+}
+
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex_);
+		abort_ = true;
+	}
+	workSignal_.notify_all();
+
+	for (std::thread &worker : workers_)
+		worker.join();
+}
+
+void WorkerPool::run(unsigned int count, const std::function<void(unsigned int)> &func)
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+	func_ = &func;
+	count_ = count;
+	next_ = 0;
+	pending_ = count;
+
+	if (count > 1)
+		workSignal_.notify_all();
+
+	runTasks(lock);
+
+	/*
+	 * Tasks picked by the workers may still be running, and func must
+	 * outlive them.
+	 */
+	doneSignal_.wait(lock, [&] { return pending_ == 0; });
+	func_ = nullptr;
+}
+
+void WorkerPool::runTasks(std::unique_lock<std::mutex> &lock)
+{
+	while (next_ < count_) {
+		unsigned int index = next_++;
+		const std::function<void(unsigned int)> &func = *func_;
+
+		lock.unlock();
+		func(index);
+		lock.lock();
+
+		if (--pending_ == 0)
+			doneSignal_.notify_one();
+	}
+}
+
+void WorkerPool::workerFunc()
+{
+	std::unique_lock<std::mutex> lock(mutex_);
+
+	while (true) {
+		workSignal_.wait(lock, [&] { return next_ < count_ || abort_; });
+		if (abort_)
+			break;
+
+		runTasks(lock);
+	}
+}
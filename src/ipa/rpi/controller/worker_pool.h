@@ -0,0 +1,54 @@
+/* SPDX-License-Identifier: BSD-2-Clause */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * pool of threads to run algorithms concurrently
+ */
+#pragma once
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace RPiController {
+
+/*
+ * A small pool of worker threads, used by the Controller to run the
+ * algorithms that don't depend on each other concurrently. The thread calling
+ * run() takes part in the work, so a pool of size zero runs everything in the
+ * calling thread.
+ */
+
+class WorkerPool
+{
+public:
+	WorkerPool(unsigned int numWorkers);
+	~WorkerPool();
+
+	unsigned int size() const { return workers_.size(); }
+
+	/* Call func(i) for every i in [0, count) and wait for all of them. */
+	void run(unsigned int count, const std::function<void(unsigned int)> &func);
+
+private:
+	void workerFunc();
+	void runTasks(std::unique_lock<std::mutex> &lock);
+
+	std::vector<std::thread> workers_;
+	std::mutex mutex_;
+	/* condvar for the workers to wait for new work on */
+	std::condition_variable workSignal_;
+	/* condvar for run() to wait for the tasks to complete on */
+	std::condition_variable doneSignal_;
+
+	/* The following all require the mutex. */
+	const std::function<void(unsigned int)> *func_;
+	unsigned int count_;
+	unsigned int next_;
+	unsigned int pending_;
+	bool abort_;
+};
+
+} /* namespace RPiController */
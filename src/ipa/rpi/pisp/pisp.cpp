@@ -44,6 +44,7 @@
 #include "controller/tonemap_status.h"
 
 using namespace std::literals::chrono_literals;
+using RPiController::MetadataTag;
 
 namespace libcamera {
 
@@ -199,7 +200,9 @@ class IpaPiSP final : public IpaBase
 {
 public:
 	IpaPiSP()
-		: IpaBase(), fe_(nullptr), be_(nullptr)
+		: IpaBase(), fe_(nullptr), be_(nullptr),
+		  statsPool_(RPiController::Statistics::AgcStatsPos::PostWb,
+			     RPiController::Statistics::ColourStatsPos::PreLsc)
 	{
 	}
 
@@ -265,6 +268,9 @@ private:
 	utils::Duration lastExposure_;
 	std::map<std::string, utils::Duration> lastStitchExposures_;
 	HdrStatus lastStitchHdrStatus_;
+
+	/* Statistics reused from frame to frame. */
+	RPiController::StatisticsPool statsPool_;
 };
 
 int32_t IpaPiSP::platformInit(const InitParams &params,
@@ -340,8 +346,8 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	global.rgb_enables &= ~(PISP_BE_RGB_ENABLE_GAMMA + PISP_BE_RGB_ENABLE_CCM +
 				PISP_BE_RGB_ENABLE_SHARPEN + PISP_BE_RGB_ENABLE_SAT_CONTROL);
 
-	NoiseStatus *noiseStatus = rpiMetadata.getLocked<NoiseStatus>("noise.status");
-	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	NoiseStatus *noiseStatus = rpiMetadata.getLocked<NoiseStatus>(MetadataTag::NoiseStatus);
+	AgcPrepareStatus *agcPrepareStatus = rpiMetadata.getLocked<AgcPrepareStatus>(MetadataTag::AgcPrepareStatus);
 
 	{
 		/* All Frontend config goes first, we do not want to hold the FE lock for long! */
@@ -351,11 +357,11 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 			applyFocusStats(noiseStatus);
 
 		BlackLevelStatus *blackLevelStatus =
-			rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+			rpiMetadata.getLocked<BlackLevelStatus>(MetadataTag::BlackLevelStatus);
 		if (blackLevelStatus)
 			applyBlackLevel(blackLevelStatus, global);
 
-		AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+		AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>(MetadataTag::AwbStatus);
 		if (awbStatus && agcPrepareStatus) {
 			/* Applies digital gain as well. */
 			applyWBG(awbStatus, agcPrepareStatus, global);
@@ -365,66 +371,66 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 		}
 	}
 
-	CacStatus *cacStatus = rpiMetadata.getLocked<CacStatus>("cac.status");
+	CacStatus *cacStatus = rpiMetadata.getLocked<CacStatus>(MetadataTag::CacStatus);
 	if (cacStatus)
 		applyCAC(cacStatus, global);
 
 	ContrastStatus *contrastStatus =
-		rpiMetadata.getLocked<ContrastStatus>("contrast.status");
+		rpiMetadata.getLocked<ContrastStatus>(MetadataTag::ContrastStatus);
 	if (contrastStatus)
 		applyContrast(contrastStatus, global);
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>(MetadataTag::CcmStatus);
 	if (ccmStatus)
 		applyCCM(ccmStatus, global);
 
-	AlscStatus *alscStatus = rpiMetadata.getLocked<AlscStatus>("alsc.status");
+	AlscStatus *alscStatus = rpiMetadata.getLocked<AlscStatus>(MetadataTag::AlscStatus);
 	if (alscStatus)
 		applyLensShading(alscStatus, global);
 
-	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>("dpc.status");
+	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>(MetadataTag::DpcStatus);
 	if (dpcStatus)
 		applyDPC(dpcStatus, global);
 
-	SdnStatus *sdnStatus = rpiMetadata.getLocked<SdnStatus>("sdn.status");
+	SdnStatus *sdnStatus = rpiMetadata.getLocked<SdnStatus>(MetadataTag::SdnStatus);
 	if (sdnStatus)
 		applySdn(sdnStatus, global);
 
-	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>("device.status");
-	TdnStatus *tdnStatus = rpiMetadata.getLocked<TdnStatus>("tdn.status");
+	DeviceStatus *deviceStatus = rpiMetadata.getLocked<DeviceStatus>(MetadataTag::DeviceStatus);
+	TdnStatus *tdnStatus = rpiMetadata.getLocked<TdnStatus>(MetadataTag::TdnStatus);
 	if (tdnStatus && deviceStatus)
 		applyTdn(tdnStatus, deviceStatus, global);
 
-	CdnStatus *cdnStatus = rpiMetadata.getLocked<CdnStatus>("cdn.status");
+	CdnStatus *cdnStatus = rpiMetadata.getLocked<CdnStatus>(MetadataTag::CdnStatus);
 	if (cdnStatus)
 		applyCdn(cdnStatus, global);
 
-	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>("geq.status");
+	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>(MetadataTag::GeqStatus);
 	if (geqStatus)
 		applyGeq(geqStatus, global);
 
 	SaturationStatus *saturationStatus =
-		rpiMetadata.getLocked<SaturationStatus>("saturation.status");
+		rpiMetadata.getLocked<SaturationStatus>(MetadataTag::SaturationStatus);
 	if (saturationStatus)
 		applySaturation(saturationStatus, global);
 
-	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>("sharpen.status");
+	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>(MetadataTag::SharpenStatus);
 	if (sharpenStatus)
 		applySharpen(sharpenStatus, global);
 
-	StitchStatus *stitchStatus = rpiMetadata.getLocked<StitchStatus>("stitch.status");
+	StitchStatus *stitchStatus = rpiMetadata.getLocked<StitchStatus>(MetadataTag::StitchStatus);
 	if (stitchStatus) {
 		/*
 		 * Note that it's the *delayed* AGC status that contains the HDR mode/channel
 		 * info that pertains to this frame!
 		 */
-		AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>("agc.delayed_status");
+		AgcStatus *agcStatus = rpiMetadata.getLocked<AgcStatus>(MetadataTag::AgcDelayedStatus);
 		/* prepareIsp() will fetch this value. Maybe pass it back differently? */
 		stitchSwapBuffers_ = applyStitch(stitchStatus, deviceStatus, agcStatus, global);
 	} else
 		lastStitchHdrStatus_ = HdrStatus();
 
-	TonemapStatus *tonemapStatus = rpiMetadata.getLocked<TonemapStatus>("tonemap.status");
+	TonemapStatus *tonemapStatus = rpiMetadata.getLocked<TonemapStatus>(MetadataTag::TonemapStatus);
 	if (tonemapStatus)
 		applyTonemap(tonemapStatus, global);
 
@@ -434,7 +440,7 @@ void IpaPiSP::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	lastExposure_ = deviceStatus->shutterSpeed * deviceStatus->analogueGain;
 
 	/* Lens control */
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<const AfStatus>(MetadataTag::AfStatus);
 	if (afStatus) {
 		ControlList lensctrls(lensCtrls_);
 		applyAF(afStatus, lensctrls);
@@ -450,13 +456,10 @@ RPiController::StatisticsPtr IpaPiSP::platformProcessStats(Span<uint8_t> mem)
 	const pisp_statistics *stats = reinterpret_cast<pisp_statistics *>(mem.data());
 
 	unsigned int i;
-	StatisticsPtr statistics =
-		std::make_unique<Statistics>(Statistics::AgcStatsPos::PostWb,
-					     Statistics::ColourStatsPos::PreLsc);
+	StatisticsPtr statistics = statsPool_.acquire();
 
 	/* RGB histograms are not used, so do not populate them. */
-	statistics->yHist = RPiController::Histogram(stats->agc.histogram,
-						     PISP_AGC_STATS_NUM_BINS);
+	statistics->yHist.set(stats->agc.histogram, PISP_AGC_STATS_NUM_BINS);
 
 	statistics->awbRegions.init({ PISP_AWB_STATS_SIZE, PISP_AWB_STATS_SIZE });
 	for (i = 0; i < statistics->awbRegions.numRegions(); i++)
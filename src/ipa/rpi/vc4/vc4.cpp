@@ -31,6 +31,8 @@
 #include "controller/noise_status.h"
 #include "controller/sharpen_status.h"
 
+using RPiController::MetadataTag;
+
 namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPARPI)
@@ -41,7 +43,9 @@ class IpaVc4 final : public IpaBase
 {
 public:
 	IpaVc4()
-		: IpaBase(), lsTable_(nullptr)
+		: IpaBase(), lsTable_(nullptr),
+		  statsPool_(RPiController::Statistics::AgcStatsPos::PreWb,
+			     RPiController::Statistics::ColourStatsPos::PostLsc)
 	{
 	}
 
@@ -81,6 +85,9 @@ private:
 	/* LS table allocation passed in from the pipeline handler. */
 	SharedFD lsTableHandle_;
 	void *lsTable_;
+
+	/* Statistics reused from frame to frame. */
+	RPiController::StatisticsPool statsPool_;
 };
 
 int32_t IpaVc4::platformInit([[maybe_unused]] const InitParams &params, [[maybe_unused]] InitResult *result)
@@ -143,47 +150,47 @@ void IpaVc4::platformPrepareIsp([[maybe_unused]] const PrepareParams &params,
 	/* Lock the metadata buffer to avoid constant locks/unlocks. */
 	std::unique_lock<RPiController::Metadata> lock(rpiMetadata);
 
-	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>("awb.status");
+	AwbStatus *awbStatus = rpiMetadata.getLocked<AwbStatus>(MetadataTag::AwbStatus);
 	if (awbStatus)
 		applyAWB(awbStatus, ctrls);
 
-	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>("ccm.status");
+	CcmStatus *ccmStatus = rpiMetadata.getLocked<CcmStatus>(MetadataTag::CcmStatus);
 	if (ccmStatus)
 		applyCCM(ccmStatus, ctrls);
 
-	AgcPrepareStatus *dgStatus = rpiMetadata.getLocked<AgcPrepareStatus>("agc.prepare_status");
+	AgcPrepareStatus *dgStatus = rpiMetadata.getLocked<AgcPrepareStatus>(MetadataTag::AgcPrepareStatus);
 	if (dgStatus)
 		applyDG(dgStatus, ctrls);
 
-	AlscStatus *lsStatus = rpiMetadata.getLocked<AlscStatus>("alsc.status");
+	AlscStatus *lsStatus = rpiMetadata.getLocked<AlscStatus>(MetadataTag::AlscStatus);
 	if (lsStatus)
 		applyLS(lsStatus, ctrls);
 
-	ContrastStatus *contrastStatus = rpiMetadata.getLocked<ContrastStatus>("contrast.status");
+	ContrastStatus *contrastStatus = rpiMetadata.getLocked<ContrastStatus>(MetadataTag::ContrastStatus);
 	if (contrastStatus)
 		applyGamma(contrastStatus, ctrls);
 
-	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>("black_level.status");
+	BlackLevelStatus *blackLevelStatus = rpiMetadata.getLocked<BlackLevelStatus>(MetadataTag::BlackLevelStatus);
 	if (blackLevelStatus)
 		applyBlackLevel(blackLevelStatus, ctrls);
 
-	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>("geq.status");
+	GeqStatus *geqStatus = rpiMetadata.getLocked<GeqStatus>(MetadataTag::GeqStatus);
 	if (geqStatus)
 		applyGEQ(geqStatus, ctrls);
 
-	DenoiseStatus *denoiseStatus = rpiMetadata.getLocked<DenoiseStatus>("denoise.status");
+	DenoiseStatus *denoiseStatus = rpiMetadata.getLocked<DenoiseStatus>(MetadataTag::DenoiseStatus);
 	if (denoiseStatus)
 		applyDenoise(denoiseStatus, ctrls);
 
-	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>("sharpen.status");
+	SharpenStatus *sharpenStatus = rpiMetadata.getLocked<SharpenStatus>(MetadataTag::SharpenStatus);
 	if (sharpenStatus)
 		applySharpen(sharpenStatus, ctrls);
 
-	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>("dpc.status");
+	DpcStatus *dpcStatus = rpiMetadata.getLocked<DpcStatus>(MetadataTag::DpcStatus);
 	if (dpcStatus)
 		applyDPC(dpcStatus, ctrls);
 
-	const AfStatus *afStatus = rpiMetadata.getLocked<AfStatus>("af.status");
+	const AfStatus *afStatus = rpiMetadata.getLocked<const AfStatus>(MetadataTag::AfStatus);
 	if (afStatus) {
 		ControlList lensctrls(lensCtrls_);
 		applyAF(afStatus, lensctrls);
@@ -200,14 +207,12 @@ RPiController::StatisticsPtr IpaVc4::platformProcessStats(Span<uint8_t> mem)
 	using namespace RPiController;
 
 	const bcm2835_isp_stats *stats = reinterpret_cast<bcm2835_isp_stats *>(mem.data());
-	StatisticsPtr statistics = std::make_shared<Statistics>(Statistics::AgcStatsPos::PreWb,
-								Statistics::ColourStatsPos::PostLsc);
+	StatisticsPtr statistics = statsPool_.acquire();
 	const Controller::HardwareConfig &hw = controller_.getHardwareConfig();
 	unsigned int i;
 
 	/* RGB histograms are not used, so do not populate them. */
-	statistics->yHist = RPiController::Histogram(stats->hist[0].g_hist,
-						     hw.numHistogramBins);
+	statistics->yHist.set(stats->hist[0].g_hist, hw.numHistogramBins);
 
 	/* All region sums are based on a 16-bit normalised pipeline bit-depth. */
 	unsigned int scale = Statistics::NormalisationFactorPow2 - hw.pipelineWidth;
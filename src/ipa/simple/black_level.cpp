@@ -56,7 +56,7 @@ uint8_t BlackLevel::get() const
  * only if it has not been yet set or if it is lower than the lowest value seen
  * so far.
  */
-void BlackLevel::update(SwIspStats::Histogram &yHistogram)
+void BlackLevel::update(const SwIspStats::Histogram &yHistogram)
 {
 	/*
 	 * The constant is selected to be "good enough", not overly conservative or
@@ -19,7 +19,7 @@ class BlackLevel
 public:
 	BlackLevel();
 	uint8_t get() const;
-	void update(SwIspStats::Histogram &yHistogram);
+	void update(const SwIspStats::Histogram &yHistogram);
 
 private:
 	uint8_t blackLevel_;
@@ -0,0 +1,138 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * color correction matrix handling
+ */
+
+#include "ccm.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <libcamera/base/log.h>
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(IPASoftCcm)
+
+/**
+ * \class Ccm
+ * \brief Object providing the color correction matrix for software ISP
+ *
+ * The color correction matrices are read from the tuning file for a set of
+ * color temperatures. The colour temperature of the scene is estimated from the
+ * statistics, and the matrix to apply is interpolated between the matrices of
+ * the closest color temperatures.
+ *
+ * Color correction is disabled when the tuning file doesn't provide any
+ * matrix. Otherwise the software ISP applies the matrix in its debayering
+ * loop, combined with the white balance gains and gamma correction.
+ */
+
+Ccm::Ccm()
+	: ccm_(ipa::Matrix<float, 3, 3>::identity()), ct_(0), enabled_(false)
+{
+}
+
+/**
+ * \brief Initialize the color correction matrices from the tuning data
+ * \param[in] tuningData The tuning data
+ *
+ * The matrices are read from the optional \a ccms list of the tuning data,
+ * each entry containing a color temperature \a ct and a 3x3 matrix \a ccm in
+ * row-major order.
+ *
+ * \return 0 on success, or a negative error code if the tuning data is invalid
+ */
+int Ccm::init(const YamlObject &tuningData)
+{
+	if (!tuningData.contains("ccms")) {
+		LOG(IPASoftCcm, Debug) << "No color correction matrix, disabling CCM";
+		return 0;
+	}
+
+	int ret = ccms_.readYaml(tuningData["ccms"], "ct", "ccm");
+	if (ret < 0) {
+		LOG(IPASoftCcm, Error) << "Failed to parse 'ccms' tuning data";
+		return ret;
+	}
+
+	enabled_ = true;
+	ccm_ = ccms_.get(5000);
+
+	return 0;
+}
+
+/**
+ * \fn bool Ccm::enabled() const
+ * \brief Check if color correction is enabled
+ * \return True if the tuning file provides color correction matrices
+ */
+
+/**
+ * \fn const ipa::Matrix<float, 3, 3> &Ccm::get() const
+ * \brief Get the color correction matrix for the current scene
+ * \return The color correction matrix
+ */
+
+/**
+ * \brief Update the color correction matrix from the statistics
+ * \param[in] sumR The sum of the red pixels, black level subtracted
+ * \param[in] sumG The sum of the green pixels, black level subtracted
+ * \param[in] sumB The sum of the blue pixels, black level subtracted
+ */
+void Ccm::update(uint64_t sumR, uint64_t sumG, uint64_t sumB)
+{
+	if (!enabled_ || !sumR || !sumG || !sumB)
+		return;
+
+	unsigned int ct = estimateCCT(sumR, sumG, sumB);
+	if (!ct)
+		return;
+
+	/* Skip the interpolation for negligible color temperature changes. */
+	if (ct_ && (ct > ct_ ? ct - ct_ : ct_ - ct) < 100)
+		return;
+
+	ct_ = ct;
+	ccm_ = ccms_.get(ct);
+
+	LOG(IPASoftCcm, Debug)
+		<< "Color temperature " << ct << "K, CCM " << ccm_;
+}
+
+/*
+ * Estimate the color temperature of the scene, return 0 if the color is too far
+ * from white for the estimate to be meaningful.
+ */
+unsigned int Ccm::estimateCCT(double red, double green, double blue)
+{
+	/* Convert the RGB values to CIE tristimulus values (XYZ) */
+	double X = (-0.14282) * (red) + (1.54924) * (green) + (-0.95641) * (blue);
+	double Y = (-0.32466) * (red) + (1.57837) * (green) + (-0.73191) * (blue);
+	double Z = (-0.68202) * (red) + (0.77073) * (green) + (0.56332) * (blue);
+
+	/*
+	 * The sum is zero or negative for saturated red, blue or magenta
+	 * scenes, the chromaticity can't be computed.
+	 */
+	double sum = X + Y + Z;
+	if (sum <= 0)
+		return 0;
+
+	/* Calculate the normalized chromaticity values */
+	double x = X / sum;
+	double y = Y / sum;
+
+	/* Calculate CCT */
+	double n = (x - 0.3320) / (0.1858 - y);
+	if (!std::isfinite(n))
+		return 0;
+
+	double cct = 449 * n * n * n + 3525 * n * n + 6823.3 * n + 5520.33;
+
+	return std::clamp(cct, 1000.0, 15000.0);
+}
+
+} /* namespace libcamera */
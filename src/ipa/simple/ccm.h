@@ -0,0 +1,37 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * color correction matrix handling
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+#include "libcamera/internal/yaml_parser.h"
+
+#include "libipa/matrix.h"
+#include "libipa/matrix_interpolator.h"
+
+namespace libcamera {
+
+class Ccm
+{
+public:
+	Ccm();
+	int init(const YamlObject &tuningData);
+	bool enabled() const { return enabled_; }
+	const ipa::Matrix<float, 3, 3> &get() const { return ccm_; }
+	void update(uint64_t sumR, uint64_t sumG, uint64_t sumB);
+
+private:
+	static unsigned int estimateCCT(double red, double green, double blue);
+
+	ipa::MatrixInterpolator<float, 3, 3> ccms_;
+	ipa::Matrix<float, 3, 3> ccm_;
+	unsigned int ct_;
+	bool enabled_;
+};
+
+} /* namespace libcamera */
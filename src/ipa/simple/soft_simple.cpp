@@ -30,6 +30,7 @@
 #include "libipa/camera_sensor_helper.h"
 
 #include "black_level.h"
+#include "ccm.h"
 
 namespace libcamera {
 LOG_DEFINE_CATEGORY(IPASoft)
@@ -68,15 +69,19 @@ public:
 	int init(const IPASettings &settings,
 		 const SharedFD &fdStats,
 		 const SharedFD &fdParams,
-		 const ControlInfoMap &sensorInfoMap) override;
+		 const ControlInfoMap &sensorInfoMap,
+		 bool *ccmEnabled) override;
 	int configure(const ControlInfoMap &sensorInfoMap) override;
 
 	int start() override;
 	void stop() override;
 
-	void processStats(const ControlList &sensorControls) override;
+	void fillParamsBuffer(const uint32_t frame, const uint32_t bufferId) override;
+	void processStats(const uint32_t frame, const uint32_t bufferId,
+			  const ControlList &sensorControls) override;
 
 private:
+	void fillCcmParams(DebayerParams *params, uint8_t blackLevel);
 	void updateExposure(double exposureMSV);
 
 	DebayerParams *params_;
@@ -84,10 +89,15 @@ private:
 	std::unique_ptr<CameraSensorHelper> camHelper_;
 	ControlInfoMap sensorInfoMap_;
 	BlackLevel blackLevel_;
+	Ccm ccm_;
+	DebayerParams::GammaLookupTable ccmGammaTable_;
 
 	static constexpr unsigned int kGammaLookupSize = 1024;
 	std::array<uint8_t, kGammaLookupSize> gammaTable_;
 	int lastBlackLevel_ = -1;
+	/* Gain: 128 = 0.5, 256 = 1.0, 512 = 2.0, etc. */
+	unsigned int gainR_ = 256;
+	unsigned int gainB_ = 256;
 
 	int32_t exposureMin_, exposureMax_;
 	int32_t exposure_;
@@ -99,15 +109,16 @@ private:
 IPASoftSimple::~IPASoftSimple()
 {
 	if (stats_)
-		munmap(stats_, sizeof(SwIspStats));
+		munmap(stats_, sizeof(SwIspStats) * kSwIspStatsBufferCount);
 	if (params_)
-		munmap(params_, sizeof(DebayerParams));
+		munmap(params_, sizeof(DebayerParams) * kDebayerParamsBufferCount);
 }
 
 int IPASoftSimple::init(const IPASettings &settings,
 			const SharedFD &fdStats,
 			const SharedFD &fdParams,
-			const ControlInfoMap &sensorInfoMap)
+			const ControlInfoMap &sensorInfoMap,
+			bool *ccmEnabled)
 {
 	camHelper_ = CameraSensorHelperFactoryBase::create(settings.sensorModel);
 	if (!camHelper_) {
@@ -134,6 +145,23 @@ int IPASoftSimple::init(const IPASettings &settings,
 	unsigned int version = (*data)["version"].get<uint32_t>(0);
 	LOG(IPASoft, Debug) << "Tuning file version " << version;
 
+	int ret = ccm_.init(*data);
+	if (ret)
+		return ret;
+
+	*ccmEnabled = ccm_.enabled();
+
+	/*
+	 * With color correction, the black level and gains are applied by the
+	 * CCM lookup tables, the gamma table only depends on the gamma value.
+	 */
+	if (ccm_.enabled()) {
+		constexpr float gamma = 0.5;
+		const float divisor = DebayerParams::kGammaLookupSize - 1.0;
+		for (unsigned int i = 0; i < DebayerParams::kGammaLookupSize; i++)
+			ccmGammaTable_[i] = UINT8_MAX * std::pow(i / divisor, gamma);
+	}
+
 	params_ = nullptr;
 	stats_ = nullptr;
 
@@ -148,8 +176,8 @@ int IPASoftSimple::init(const IPASettings &settings,
 	}
 
 	{
-		void *mem = mmap(nullptr, sizeof(DebayerParams), PROT_WRITE,
-				 MAP_SHARED, fdParams.get(), 0);
+		void *mem = mmap(nullptr, sizeof(DebayerParams) * kDebayerParamsBufferCount,
+				 PROT_WRITE, MAP_SHARED, fdParams.get(), 0);
 		if (mem == MAP_FAILED) {
 			LOG(IPASoft, Error) << "Unable to map Parameters";
 			return -errno;
@@ -159,8 +187,8 @@ int IPASoftSimple::init(const IPASettings &settings,
 	}
 
 	{
-		void *mem = mmap(nullptr, sizeof(SwIspStats), PROT_READ,
-				 MAP_SHARED, fdStats.get(), 0);
+		void *mem = mmap(nullptr, sizeof(SwIspStats) * kSwIspStatsBufferCount,
+				 PROT_READ, MAP_SHARED, fdStats.get(), 0);
 		if (mem == MAP_FAILED) {
 			LOG(IPASoft, Error) << "Unable to map Statistics";
 			return -errno;
@@ -245,34 +273,21 @@ void IPASoftSimple::stop()
 {
 }
 
-void IPASoftSimple::processStats(const ControlList &sensorControls)
+void IPASoftSimple::fillParamsBuffer(const uint32_t frame, const uint32_t bufferId)
 {
-	SwIspStats::Histogram histogram = stats_->yHistogram;
-	if (ignoreUpdates_ > 0)
-		blackLevel_.update(histogram);
-	const uint8_t blackLevel = blackLevel_.get();
+	if (bufferId >= kDebayerParamsBufferCount) {
+		LOG(IPASoft, Error) << "Invalid parameters buffer " << bufferId;
+		return;
+	}
 
-	/*
-	 * Black level must be subtracted to get the correct AWB ratios, they
-	 * would be off if they were computed from the whole brightness range
-	 * rather than from the sensor range.
-	 */
-	const uint64_t nPixels = std::accumulate(
-		histogram.begin(), histogram.end(), 0);
-	const uint64_t offset = blackLevel * nPixels;
-	const uint64_t sumR = stats_->sumR_ - offset / 4;
-	const uint64_t sumG = stats_->sumG_ - offset / 2;
-	const uint64_t sumB = stats_->sumB_ - offset / 4;
+	DebayerParams *params = &params_[bufferId];
+	const uint8_t blackLevel = blackLevel_.get();
 
-	/*
-	 * Calculate red and blue gains for AWB.
-	 * Clamp max gain at 4.0, this also avoids 0 division.
-	 * Gain: 128 = 0.5, 256 = 1.0, 512 = 2.0, etc.
-	 */
-	const unsigned int gainR = sumR <= sumG / 4 ? 1024 : 256 * sumG / sumR;
-	const unsigned int gainB = sumB <= sumG / 4 ? 1024 : 256 * sumG / sumB;
-	/* Green gain and gamma values are fixed */
-	constexpr unsigned int gainG = 256;
+	if (ccm_.enabled()) {
+		fillCcmParams(params, blackLevel);
+		paramsBufferReady.emit(frame);
+		return;
+	}
 
 	/* Update the gamma table if needed */
 	if (blackLevel != lastBlackLevel_) {
@@ -287,36 +302,95 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 		lastBlackLevel_ = blackLevel;
 	}
 
+	/* Green gain and gamma values are fixed */
+	constexpr unsigned int gainG = 256;
+
 	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
 		constexpr unsigned int div =
 			DebayerParams::kRGBLookupSize * 256 / kGammaLookupSize;
 		unsigned int idx;
 
 		/* Apply gamma after gain! */
-		idx = std::min({ i * gainR / div, (kGammaLookupSize - 1) });
-		params_->red[i] = gammaTable_[idx];
+		idx = std::min({ i * gainR_ / div, (kGammaLookupSize - 1) });
+		params->red[i] = gammaTable_[idx];
 
 		idx = std::min({ i * gainG / div, (kGammaLookupSize - 1) });
-		params_->green[i] = gammaTable_[idx];
+		params->green[i] = gammaTable_[idx];
 
-		idx = std::min({ i * gainB / div, (kGammaLookupSize - 1) });
-		params_->blue[i] = gammaTable_[idx];
+		idx = std::min({ i * gainB_ / div, (kGammaLookupSize - 1) });
+		params->blue[i] = gammaTable_[idx];
 	}
 
-	setIspParams.emit();
+	paramsBufferReady.emit(frame);
+}
 
-	/* \todo Switch to the libipa/algorithm.h API someday. */
+void IPASoftSimple::fillCcmParams(DebayerParams *params, uint8_t blackLevel)
+{
+	const ipa::Matrix<float, 3, 3> &ccm = ccm_.get();
+	const float gains[3] = { gainR_ / 256.0f, 1.0f, gainB_ / 256.0f };
+	const float divisor = DebayerParams::kRGBLookupSize - blackLevel - 1.0;
+	DebayerParams::CcmLookupTable *tables[3] = {
+		&params->redCcm, &params->greenCcm, &params->blueCcm
+	};
+
+	auto toFixed = [](float value) {
+		return static_cast<int16_t>(std::clamp(std::lround(value),
+						       static_cast<long>(INT16_MIN),
+						       static_cast<long>(INT16_MAX)));
+	};
 
 	/*
-	 * AE / AGC, use 2 frames delay to make sure that the exposure and
-	 * the gain set have applied to the camera sensor.
-	 * \todo This could be handled better with DelayedControls.
+	 * Subtract the black level, scale the input range to the gamma table
+	 * range and apply the white balance gain and CCM column of each input
+	 * color.
 	 */
-	if (ignoreUpdates_ > 0) {
-		--ignoreUpdates_;
+	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+		const float value = std::max(static_cast<int>(i) - blackLevel, 0) /
+				    divisor * (DebayerParams::kGammaLookupSize - 1);
+
+		for (unsigned int c = 0; c < 3; c++) {
+			const float v = value * gains[c];
+			(*tables[c])[i] = { toFixed(ccm[0][c] * v),
+					    toFixed(ccm[1][c] * v),
+					    toFixed(ccm[2][c] * v) };
+		}
+	}
+
+	params->gammaLut = ccmGammaTable_;
+}
+
+void IPASoftSimple::processStats([[maybe_unused]] const uint32_t frame,
+				  const uint32_t bufferId,
+				  const ControlList &sensorControls)
+{
+	if (bufferId >= kSwIspStatsBufferCount) {
+		LOG(IPASoft, Error) << "Invalid statistics buffer " << bufferId;
 		return;
 	}
 
+	/*
+	 * Read the statistics in place and return the buffer as soon as they
+	 * have been read, the ISP drops statistics when it runs out of
+	 * buffers.
+	 */
+	const SwIspStats &stats = stats_[bufferId];
+	const SwIspStats::Histogram &histogram = stats.yHistogram;
+	if (ignoreUpdates_ > 0)
+		blackLevel_.update(histogram);
+	const uint8_t blackLevel = blackLevel_.get();
+
+	/*
+	 * Black level must be subtracted to get the correct AWB ratios, they
+	 * would be off if they were computed from the whole brightness range
+	 * rather than from the sensor range.
+	 */
+	const uint64_t nPixels = std::accumulate(
+		histogram.begin(), histogram.end(), 0);
+	const uint64_t offset = blackLevel * nPixels;
+	const uint64_t sumR = stats.sumR_ - offset / 4;
+	const uint64_t sumG = stats.sumG_ - offset / 2;
+	const uint64_t sumB = stats.sumB_ - offset / 4;
+
 	/*
 	 * Calculate Mean Sample Value (MSV) according to formula from:
 	 * https://www.araa.asn.au/acra/acra2007/papers/paper84final.pdf
@@ -329,14 +403,40 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 	const unsigned int yHistValsPerBinMod =
 		histogramSize / (histogramSize % kExposureBinsCount + 1);
 	int exposureBins[kExposureBinsCount] = {};
-	unsigned int denom = 0;
-	unsigned int num = 0;
 
 	for (unsigned int i = 0; i < histogramSize; i++) {
 		unsigned int idx = (i - (i / yHistValsPerBinMod)) / yHistValsPerBin;
-		exposureBins[idx] += stats_->yHistogram[blackLevelHistIdx + i];
+		exposureBins[idx] += histogram[blackLevelHistIdx + i];
 	}
 
+	/* The statistics buffer isn't accessed past this point. */
+	statsProcessed.emit(bufferId);
+
+	/*
+	 * Calculate red and blue gains for AWB, applied to the parameters of the
+	 * next frames by fillParamsBuffer().
+	 * Clamp max gain at 4.0, this also avoids 0 division.
+	 */
+	gainR_ = sumR <= sumG / 4 ? 1024 : 256 * sumG / sumR;
+	gainB_ = sumB <= sumG / 4 ? 1024 : 256 * sumG / sumB;
+
+	ccm_.update(sumR, sumG, sumB);
+
+	/* \todo Switch to the libipa/algorithm.h API someday. */
+
+	/*
+	 * AE / AGC, use 2 frames delay to make sure that the exposure and
+	 * the gain set have applied to the camera sensor.
+	 * \todo This could be handled better with DelayedControls.
+	 */
+	if (ignoreUpdates_ > 0) {
+		--ignoreUpdates_;
+		return;
+	}
+
+	unsigned int denom = 0;
+	unsigned int num = 0;
+
 	for (unsigned int i = 0; i < kExposureBinsCount; i++) {
 		LOG(IPASoft, Debug) << i << ": " << exposureBins[i];
 		denom += exposureBins[i];
@@ -370,7 +470,7 @@ void IPASoftSimple::processStats(const ControlList &sensorControls)
 
 	LOG(IPASoft, Debug) << "exposureMSV " << exposureMSV
 			    << " exp " << exposure_ << " again " << again_
-			    << " gain R/B " << gainR << "/" << gainB
+			    << " gain R/B " << gainR_ << "/" << gainB_
 			    << " black level " << static_cast<unsigned int>(blackLevel);
 }
 
@@ -11,7 +11,9 @@
 #include <sys/stat.h>
 #include <unistd.h>
 
+#include <chrono>
 #include <iostream>
+#include <thread>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
@@ -25,6 +27,10 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(IPAVimc)
 
+using namespace std::literals::chrono_literals;
+
+static constexpr std::chrono::milliseconds kInitDelay = 200ms;
+
 class IPAVimc : public ipa::vimc::IPAVimcInterface
 {
 public:
@@ -89,6 +95,12 @@ int IPAVimc::init(const IPASettings &settings,
 
 	*outFlags |= ipa::vimc::TestFlag::Flag1;
 
+	/* Delay the reply to let tests exercise IPC call timeouts. */
+	if (inFlags & ipa::vimc::TestFlag::Flag3) {
+		std::this_thread::sleep_for(kInitDelay);
+		*outFlags |= ipa::vimc::TestFlag::Flag3;
+	}
+
 	File conf(settings.configurationFile);
 	if (!conf.open(File::OpenModeFlag::ReadOnly)) {
 		LOG(IPAVimc, Error) << "Failed to open configuration file";
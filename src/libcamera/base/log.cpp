@@ -7,14 +7,21 @@
 
 #include <libcamera/base/log.h>
 
+#include <algorithm>
 #include <array>
+#include <atomic>
+#include <chrono>
 #include <fstream>
 #include <iostream>
 #include <list>
+#include <memory>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <string_view>
+#include <sys/types.h>
 #include <syslog.h>
+#include <thread>
 #include <time.h>
 #include <unordered_set>
 
@@ -52,6 +59,13 @@
  * of the file. The file must be writable and is truncated if it exists. If any
  * error occurs when opening the file, the file is ignored and the log is output
  * to std::cerr.
+ *
+ * Log messages are written synchronously by default. When the
+ * LIBCAMERA_LOG_ASYNC environment variable is set, messages are instead queued
+ * to per-thread ring buffers and written by a dedicated thread, moving the cost
+ * of writing to the log destination out of the logging threads. Messages that
+ * don't fit in the ring buffer are dropped, and the number of dropped messages
+ * is reported in the log.
  */
 
 /**
@@ -97,6 +111,24 @@ static const char *log_severity_name(LogSeverity severity)
 		return "UNKWN";
 }
 
+/**
+ * \brief A log message ready to be written to the log output
+ *
+ * The LogRecord structure stores all the information about a log message
+ * needed by the log output, without owning the strings. It decouples the
+ * log output from the LogMessage, to allow writing messages from a different
+ * thread than the one that has logged them.
+ */
+struct LogRecord {
+	utils::time_point timestamp;
+	pid_t threadId;
+	LogSeverity severity;
+	const LogCategory *category;
+	std::string_view fileInfo;
+	std::string_view prefix;
+	std::string_view msg;
+};
+
 /**
  * \brief Log output
  *
@@ -112,6 +144,7 @@ public:
 
 	bool isValid() const;
 	void write(const LogMessage &msg);
+	void write(const LogRecord &record);
 	void write(const std::string &msg);
 
 private:
@@ -206,6 +239,18 @@ constexpr const char *kColorBrightWhite = "\033[1;37m";
  * \param[in] msg Message to write
  */
 void LogOutput::write(const LogMessage &msg)
+{
+	const std::string text = msg.msg();
+
+	write(LogRecord{ msg.timestamp(), Thread::currentId(), msg.severity(),
+			 &msg.category(), msg.fileInfo(), msg.prefix(), text });
+}
+
+/**
+ * \brief Write record to log output
+ * \param[in] record Record to write
+ */
+void LogOutput::write(const LogRecord &record)
 {
 	static const char *const severityColors[] = {
 		kColorBrightCyan,
@@ -220,7 +265,7 @@ void LogOutput::write(const LogMessage &msg)
 	const char *prefixColor = color_ ? kColorGreen : "";
 	const char *resetColor = color_ ? kColorReset : "";
 	const char *severityColor = "";
-	LogSeverity severity = msg.severity();
+	LogSeverity severity = record.severity;
 	std::string str;
 
 	if (color_) {
@@ -233,22 +278,32 @@ void LogOutput::write(const LogMessage &msg)
 	switch (target_) {
 	case LoggingTargetSyslog:
 		str = std::string(log_severity_name(severity)) + " "
-		    + msg.category().name() + " " + msg.fileInfo() + " ";
-		if (!msg.prefix().empty())
-			str += msg.prefix() + ": ";
-		str += msg.msg();
+		    + record.category->name() + " ";
+		str.append(record.fileInfo);
+		str += " ";
+		if (!record.prefix.empty()) {
+			str.append(record.prefix);
+			str += ": ";
+		}
+		str.append(record.msg);
 		writeSyslog(severity, str);
 		break;
 	case LoggingTargetStream:
 	case LoggingTargetFile:
-		str = "[" + utils::time_point_to_string(msg.timestamp()) + "] ["
-		    + std::to_string(Thread::currentId()) + "] "
+		str = "[" + utils::time_point_to_string(record.timestamp) + "] ["
+		    + std::to_string(record.threadId) + "] "
 		    + severityColor + log_severity_name(severity) + " "
-		    + categoryColor + msg.category().name() + " "
-		    + fileColor + msg.fileInfo() + " ";
-		if (!msg.prefix().empty())
-			str += prefixColor + msg.prefix() + ": ";
-		str += resetColor + msg.msg();
+		    + categoryColor + record.category->name() + " "
+		    + fileColor;
+		str.append(record.fileInfo);
+		str += " ";
+		if (!record.prefix.empty()) {
+			str += prefixColor;
+			str.append(record.prefix);
+			str += ": ";
+		}
+		str += resetColor;
+		str.append(record.msg);
 		writeStream(str);
 		break;
 	default:
@@ -286,6 +341,162 @@ void LogOutput::writeStream(const std::string &str)
 	stream_->flush();
 }
 
+namespace {
+
+/*
+ * Per-thread single-producer single-consumer ring buffer of log records.
+ *
+ * Each record is stored as a RecordHeader followed by the file info, prefix
+ * and message strings, padded to the alignment of the header. The indices
+ * are free-running counters, the offset in the buffer is the index modulo the
+ * buffer size.
+ */
+class LogRing
+{
+public:
+	static constexpr size_t kSize = 64 * 1024;
+
+	LogRing()
+		: head_(0), tail_(0), dropped_(0)
+	{
+	}
+
+	bool push(const LogMessage &msg, const std::string &text);
+	bool pop(LogOutput *output);
+
+	bool empty() const
+	{
+		return head_.load(std::memory_order_acquire) ==
+		       tail_.load(std::memory_order_relaxed);
+	}
+
+	unsigned int takeDropped()
+	{
+		return dropped_.exchange(0, std::memory_order_relaxed);
+	}
+
+private:
+	struct RecordHeader {
+		utils::time_point timestamp;
+		const LogCategory *category;
+		pid_t threadId;
+		LogSeverity severity;
+		uint32_t size;
+		uint32_t fileInfoSize;
+		uint32_t prefixSize;
+		uint32_t msgSize;
+	};
+
+	void write(size_t index, const void *src, size_t size);
+	void read(size_t index, void *dst, size_t size) const;
+
+	alignas(64) std::atomic<size_t> head_;
+	alignas(64) std::atomic<size_t> tail_;
+	std::atomic<unsigned int> dropped_;
+
+	std::array<char, kSize> data_;
+
+	/* Scratch buffers owned by the consumer, reused across records. */
+	std::string fileInfo_;
+	std::string prefix_;
+	std::string msg_;
+};
+
+void LogRing::write(size_t index, const void *src, size_t size)
+{
+	size_t offset = index % kSize;
+	size_t first = std::min(size, kSize - offset);
+
+	memcpy(data_.data() + offset, src, first);
+	memcpy(data_.data(), static_cast<const char *>(src) + first, size - first);
+}
+
+void LogRing::read(size_t index, void *dst, size_t size) const
+{
+	size_t offset = index % kSize;
+	size_t first = std::min(size, kSize - offset);
+
+	memcpy(dst, data_.data() + offset, first);
+	memcpy(static_cast<char *>(dst) + first, data_.data(), size - first);
+}
+
+/*
+ * Queue a message, called by the thread owning the ring. Return false and
+ * count the message as dropped if the ring is full.
+ */
+bool LogRing::push(const LogMessage &msg, const std::string &text)
+{
+	RecordHeader header;
+	header.timestamp = msg.timestamp();
+	header.category = &msg.category();
+	header.threadId = Thread::currentId();
+	header.severity = msg.severity();
+	header.fileInfoSize = msg.fileInfo().size();
+	header.prefixSize = msg.prefix().size();
+	header.msgSize = text.size();
+
+	size_t size = sizeof(header) + header.fileInfoSize + header.prefixSize
+		    + header.msgSize;
+	size = utils::alignUp(size, alignof(RecordHeader));
+	header.size = size;
+
+	size_t head = head_.load(std::memory_order_relaxed);
+	size_t tail = tail_.load(std::memory_order_acquire);
+	if (size > kSize - (head - tail)) {
+		dropped_.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+
+	size_t index = head;
+	write(index, &header, sizeof(header));
+	index += sizeof(header);
+	write(index, msg.fileInfo().data(), header.fileInfoSize);
+	index += header.fileInfoSize;
+	write(index, msg.prefix().data(), header.prefixSize);
+	index += header.prefixSize;
+	write(index, text.data(), header.msgSize);
+
+	head_.store(head + size, std::memory_order_release);
+
+	return true;
+}
+
+/*
+ * Write the oldest queued message to the output, called by the consumer.
+ * Return false if the ring is empty.
+ */
+bool LogRing::pop(LogOutput *output)
+{
+	size_t tail = tail_.load(std::memory_order_relaxed);
+	size_t head = head_.load(std::memory_order_acquire);
+	if (head == tail)
+		return false;
+
+	RecordHeader header;
+	read(tail, &header, sizeof(header));
+
+	size_t index = tail + sizeof(header);
+	fileInfo_.resize(header.fileInfoSize);
+	read(index, fileInfo_.data(), header.fileInfoSize);
+	index += header.fileInfoSize;
+	prefix_.resize(header.prefixSize);
+	read(index, prefix_.data(), header.prefixSize);
+	index += header.prefixSize;
+	msg_.resize(header.msgSize);
+	read(index, msg_.data(), header.msgSize);
+
+	tail_.store(tail + header.size, std::memory_order_release);
+
+	if (output)
+		output->write(LogRecord{ header.timestamp, header.threadId,
+					 header.severity, header.category,
+					 fileInfo_, prefix_, msg_ });
+
+	return true;
+}
+
+} /* namespace */
+
 /**
  * \brief Message logger
  *
@@ -313,6 +524,13 @@ private:
 	void parseLogLevels();
 	static LogSeverity parseLogLevel(const std::string &level);
 
+	void startWriter();
+	void stopWriter();
+	void writerThread();
+	LogRing *threadRing();
+	bool drain();
+	void flush();
+
 	friend LogCategory;
 	void registerCategory(LogCategory *category);
 	LogCategory *findCategory(const char *name) const;
@@ -323,6 +541,18 @@ private:
 	std::list<std::pair<std::string, LogSeverity>> levels_;
 
 	std::shared_ptr<LogOutput> output_;
+
+	std::thread writer_;
+	std::atomic<bool> async_;
+	std::atomic<bool> writerIdle_;
+	bool stopWriter_ LIBCAMERA_TSA_GUARDED_BY(writerMutex_);
+	Mutex writerMutex_;
+	ConditionVariable writerCv_;
+
+	/* Serializes consumption of the rings between the writer and flush(). */
+	Mutex drainMutex_;
+	Mutex ringsMutex_;
+	std::list<std::shared_ptr<LogRing>> rings_ LIBCAMERA_TSA_GUARDED_BY(ringsMutex_);
 };
 
 bool Logger::destroyed_ = false;
@@ -435,6 +665,8 @@ void logSetLevel(const char *category, const char *level)
 
 Logger::~Logger()
 {
+	stopWriter();
+
 	destroyed_ = true;
 
 	for (LogCategory *category : categories_)
@@ -465,6 +697,24 @@ Logger *Logger::instance()
  */
 void Logger::write(const LogMessage &msg)
 {
+	/*
+	 * Fatal messages are written synchronously, after flushing all queued
+	 * messages, as the process is about to abort.
+	 */
+	if (async_.load(std::memory_order_relaxed) &&
+	    msg.severity() != LogFatal) {
+		LogRing *ring = threadRing();
+		ring->push(msg, msg.msg());
+
+		if (writerIdle_.exchange(false, std::memory_order_acq_rel)) {
+			MutexLocker locker(writerMutex_);
+			writerCv_.notify_one();
+		}
+		return;
+	}
+
+	flush();
+
 	std::shared_ptr<LogOutput> output = std::atomic_load(&output_);
 	if (!output)
 		return;
@@ -472,11 +722,160 @@ void Logger::write(const LogMessage &msg)
 	output->write(msg);
 }
 
+/**
+ * \brief Retrieve the log ring of the calling thread
+ *
+ * The ring is created and registered with the writer thread on first use. It
+ * is owned by both the thread and the logger, and is released by the writer
+ * thread once the thread has exited and all its messages have been written.
+ *
+ * \return The log ring of the calling thread
+ */
+LogRing *Logger::threadRing()
+{
+	thread_local std::shared_ptr<LogRing> ring;
+
+	if (!ring) {
+		ring = std::make_shared<LogRing>();
+
+		MutexLocker locker(ringsMutex_);
+		rings_.push_back(ring);
+	}
+
+	return ring.get();
+}
+
+/**
+ * \brief Write all queued messages to the log output
+ *
+ * The messages are written one thread ring at a time, messages from different
+ * threads are thus not strictly ordered. A warning is written for each ring
+ * that had to drop messages since the last drain.
+ *
+ * \return True if any message has been written, false otherwise
+ */
+bool Logger::drain()
+{
+	MutexLocker drainLocker(drainMutex_);
+
+	std::list<std::shared_ptr<LogRing>> rings;
+	{
+		MutexLocker locker(ringsMutex_);
+
+		/* Release the rings of threads that have exited. */
+		rings_.remove_if([](const std::shared_ptr<LogRing> &ring) {
+			return ring.use_count() == 1 && ring->empty();
+		});
+
+		rings = rings_;
+	}
+
+	std::shared_ptr<LogOutput> output = std::atomic_load(&output_);
+	bool written = false;
+
+	for (const std::shared_ptr<LogRing> &ring : rings) {
+		while (ring->pop(output.get()))
+			written = true;
+
+		unsigned int dropped = ring->takeDropped();
+		if (!dropped || !output)
+			continue;
+
+		std::string msg = std::to_string(dropped) + " log messages dropped\n";
+		output->write(LogRecord{ utils::clock::now(), Thread::currentId(),
+					 LogWarning, &LogCategory::defaultCategory(),
+					 {}, {}, msg });
+		written = true;
+	}
+
+	return written;
+}
+
+/**
+ * \brief Synchronously write all queued messages to the log output
+ */
+void Logger::flush()
+{
+	if (!async_.load(std::memory_order_relaxed))
+		return;
+
+	drain();
+}
+
+/**
+ * \brief Start the asynchronous log writer thread
+ */
+void Logger::startWriter()
+{
+	{
+		MutexLocker locker(writerMutex_);
+		stopWriter_ = false;
+	}
+
+	writerIdle_.store(false, std::memory_order_relaxed);
+	writer_ = std::thread(&Logger::writerThread, this);
+	async_.store(true, std::memory_order_release);
+}
+
+/**
+ * \brief Stop the asynchronous log writer thread
+ *
+ * All messages queued before the writer is stopped are written to the log
+ * output. Messages logged afterwards are written synchronously.
+ */
+void Logger::stopWriter()
+{
+	if (!writer_.joinable())
+		return;
+
+	{
+		MutexLocker locker(writerMutex_);
+		stopWriter_ = true;
+	}
+	writerCv_.notify_one();
+	writer_.join();
+
+	drain();
+	async_.store(false, std::memory_order_release);
+	drain();
+}
+
+void Logger::writerThread()
+{
+	while (true) {
+		if (drain())
+			continue;
+
+		/*
+		 * Mark the writer as idle before checking the stop flag and
+		 * sleeping. Producers wake the writer up only when they see
+		 * the idle flag, which keeps the fast path free of syscalls.
+		 * The timeout catches messages queued between the last drain
+		 * and the idle flag being set.
+		 */
+		writerIdle_.store(true, std::memory_order_release);
+
+		MutexLocker locker(writerMutex_);
+		if (stopWriter_)
+			break;
+
+		writerCv_.wait_for(locker, std::chrono::milliseconds(100),
+				   [this]() LIBCAMERA_TSA_REQUIRES(writerMutex_) {
+					   return stopWriter_ ||
+						  !writerIdle_.load(std::memory_order_acquire);
+				   });
+
+		writerIdle_.store(false, std::memory_order_relaxed);
+	}
+}
+
 /**
  * \brief Write a backtrace to the log
  */
 void Logger::backtrace()
 {
+	flush();
+
 	std::shared_ptr<LogOutput> output = std::atomic_load(&output_);
 	if (!output)
 		return;
@@ -511,6 +910,7 @@ int Logger::logSetFile(const char *path, bool color)
 	if (!output->isValid())
 		return -EINVAL;
 
+	flush();
 	std::atomic_store(&output_, output);
 	return 0;
 }
@@ -528,6 +928,7 @@ int Logger::logSetStream(std::ostream *stream, bool color)
 {
 	std::shared_ptr<LogOutput> output =
 		std::make_shared<LogOutput>(stream, color);
+	flush();
 	std::atomic_store(&output_, output);
 	return 0;
 }
@@ -542,6 +943,8 @@ int Logger::logSetStream(std::ostream *stream, bool color)
  */
 int Logger::logSetTarget(enum LoggingTarget target)
 {
+	flush();
+
 	switch (target) {
 	case LoggingTargetSyslog:
 		std::atomic_store(&output_, std::make_shared<LogOutput>());
@@ -583,14 +986,21 @@ void Logger::logSetLevel(const char *category, const char *level)
  * If the environment variable is not set, log to std::cerr. The log messages
  * are then colored by default. This can be overridden by setting the
  * LIBCAMERA_LOG_NO_COLOR environment variable to disable coloring.
+ *
+ * If the LIBCAMERA_LOG_ASYNC environment variable is set, start the writer
+ * thread to write log messages asynchronously.
  */
 Logger::Logger()
+	: async_(false), writerIdle_(false), stopWriter_(false)
 {
 	bool color = !utils::secure_getenv("LIBCAMERA_LOG_NO_COLOR");
 	logSetStream(&std::cerr, color);
 
 	parseLogFile();
 	parseLogLevels();
+
+	if (utils::secure_getenv("LIBCAMERA_LOG_ASYNC"))
+		startWriter();
 }
 
 /**
@@ -8,12 +8,13 @@
 #include <libcamera/base/thread.h>
 
 #include <atomic>
-#include <list>
+#include <string.h>
 #include <sys/syscall.h>
 #include <sys/types.h>
 #include <unistd.h>
 
 #include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/event_dispatcher_epoll.h>
 #include <libcamera/base/event_dispatcher_poll.h>
 #include <libcamera/base/log.h>
 #include <libcamera/base/message.h>
@@ -115,25 +116,142 @@ class ThreadMain;
 
 /**
  * \brief A queue of posted messages
+ *
+ * Messages are posted to the queue by any thread without locking, by pushing
+ * them to a lock-free intrusive stack, the inbox. The thread that owns the
+ * queue collects the inbox when dispatching messages, restores the posting
+ * order, and appends the messages to the list of messages pending delivery.
+ * The list is only accessed with the \ref mutex_ held, which is only contended
+ * when messages are removed or moved from another thread.
  */
 class MessageQueue
 {
 public:
+	~MessageQueue();
+
+	bool post(Message *msg);
+	void collect();
+	Message *take(Message::Type type, Object *receiver = nullptr);
+
 	/**
-	 * \brief List of queued Message instances
+	 * \brief Stack of posted Message instances not yet collected
 	 */
-	std::list<std::unique_ptr<Message>> list_;
+	std::atomic<Message *> inbox_ = nullptr;
 	/**
-	 * \brief Protects the \ref list_
+	 * \brief First Message instance pending delivery
 	 */
-	Mutex mutex_;
+	Message *head_ = nullptr;
+	/**
+	 * \brief Last Message instance pending delivery
+	 */
+	Message *tail_ = nullptr;
 	/**
-	 * \brief The recursion level for recursive Thread::dispatchMessages()
-	 * calls
+	 * \brief Protects the \ref head_ and \ref tail_ list
 	 */
-	unsigned int recursion_ = 0;
+	Mutex mutex_;
 };
 
+MessageQueue::~MessageQueue()
+{
+	MutexLocker locker(mutex_);
+
+	collect();
+
+	while (head_) {
+		Message *msg = head_;
+		head_ = msg->next_;
+		delete msg;
+	}
+}
+
+/**
+ * \brief Post a message to the queue
+ * \param[in] msg The message
+ *
+ * Ownership of the message is transferred to the queue.
+ *
+ * \context This function is \threadsafe.
+ *
+ * \return True if the queue inbox was empty, in which case the thread that
+ * owns the queue may be waiting for events and needs to be woken up
+ */
+bool MessageQueue::post(Message *msg)
+{
+	Message *head = inbox_.load(std::memory_order_relaxed);
+
+	do {
+		msg->next_ = head;
+	} while (!inbox_.compare_exchange_weak(head, msg,
+					       std::memory_order_release,
+					       std::memory_order_relaxed));
+
+	return !head;
+}
+
+/**
+ * \brief Move the messages from the inbox to the list pending delivery
+ */
+void MessageQueue::collect()
+{
+	Message *msg = inbox_.exchange(nullptr, std::memory_order_acquire);
+	if (!msg)
+		return;
+
+	/* The inbox is stored in reverse order, restore the posting order. */
+	Message *last = msg;
+	Message *first = nullptr;
+
+	while (msg) {
+		Message *next = msg->next_;
+		msg->next_ = first;
+		first = msg;
+		msg = next;
+	}
+
+	if (tail_)
+		tail_->next_ = first;
+	else
+		head_ = first;
+
+	tail_ = last;
+}
+
+/**
+ * \brief Remove the first pending message matching a type and receiver
+ * \param[in] type The message type, Message::Type::None matches all types
+ * \param[in] receiver The receiver, nullptr matches all receivers
+ *
+ * Ownership of the message is transferred to the caller.
+ *
+ * \return The message, or nullptr if no pending message matches
+ */
+Message *MessageQueue::take(Message::Type type, Object *receiver)
+{
+	collect();
+
+	Message *prev = nullptr;
+
+	for (Message *msg = head_; msg; prev = msg, msg = msg->next_) {
+		if (type != Message::Type::None && msg->type() != type)
+			continue;
+		if (receiver && msg->receiver_ != receiver)
+			continue;
+
+		if (prev)
+			prev->next_ = msg->next_;
+		else
+			head_ = msg->next_;
+
+		if (tail_ == msg)
+			tail_ = prev;
+
+		msg->next_ = nullptr;
+		return msg;
+	}
+
+	return nullptr;
+}
+
 /**
  * \brief Thread-local internal data
  */
@@ -501,6 +619,11 @@ pid_t Thread::currentId()
  * This function retrieves the internal event dispatcher for the thread. The
  * returned event dispatcher is valid until the thread is destroyed.
  *
+ * If no event dispatcher has been set with setEventDispatcher(), a default
+ * dispatcher is created on the first call. The implementation is selected by
+ * the LIBCAMERA_EVENT_DISPATCHER environment variable, and defaults to an
+ * EventDispatcherPoll.
+ *
  * \context This function is \threadsafe.
  *
  * \return Pointer to the event dispatcher
@@ -508,12 +631,52 @@ pid_t Thread::currentId()
 EventDispatcher *Thread::eventDispatcher()
 {
 	if (!data_->dispatcher_.load(std::memory_order_relaxed))
-		data_->dispatcher_.store(new EventDispatcherPoll(),
+		data_->dispatcher_.store(createEventDispatcher(),
 					 std::memory_order_release);
 
 	return data_->dispatcher_.load(std::memory_order_relaxed);
 }
 
+/**
+ * \brief Set the event dispatcher
+ * \param[in] dispatcher The event dispatcher
+ *
+ * This function sets the event dispatcher used by the thread, overriding the
+ * default implementation. Ownership of the \a dispatcher is transferred to
+ * the thread. It can be used to select an event dispatcher suited to the
+ * thread's workload, such as an EventDispatcherEpoll for threads that monitor
+ * a large number of file descriptors.
+ *
+ * The event dispatcher can't be replaced once set. This function must thus be
+ * called before the thread is started, and before any call to
+ * eventDispatcher() or creation of any event notifier or timer bound to the
+ * thread.
+ */
+void Thread::setEventDispatcher(std::unique_ptr<EventDispatcher> dispatcher)
+{
+	if (data_->dispatcher_.load(std::memory_order_relaxed)) {
+		LOG(Thread, Error) << "Event dispatcher already set";
+		return;
+	}
+
+	data_->dispatcher_.store(dispatcher.release(),
+				 std::memory_order_release);
+}
+
+EventDispatcher *Thread::createEventDispatcher()
+{
+	const char *type = utils::secure_getenv("LIBCAMERA_EVENT_DISPATCHER");
+	if (type && !strcmp(type, "epoll"))
+		return new EventDispatcherEpoll();
+
+	if (type && strcmp(type, "poll"))
+		LOG(Thread, Warning)
+			<< "Unknown event dispatcher '" << type
+			<< "', using poll";
+
+	return new EventDispatcherPoll();
+}
+
 /**
  * \brief Post a message to the thread for the \a receiver
  * \param[in] msg The message
@@ -542,10 +705,15 @@ void Thread::postMessage(std::unique_ptr<Message> msg, Object *receiver)
 
 	ASSERT(data_ == receiver->thread()->data_);
 
-	MutexLocker locker(data_->messages_.mutex_);
-	data_->messages_.list_.push_back(std::move(msg));
-	receiver->pendingMessages_++;
-	locker.unlock();
+	receiver->pendingMessages_.fetch_add(1, std::memory_order_relaxed);
+
+	/*
+	 * Only wake up the thread when posting to an empty inbox. Otherwise a
+	 * previous post has already woken it up, and the thread will collect
+	 * this message along with the previous ones.
+	 */
+	if (!data_->messages_.post(msg.release()))
+		return;
 
 	EventDispatcher *dispatcher =
 		data_->dispatcher_.load(std::memory_order_acquire);
@@ -564,27 +732,17 @@ void Thread::removeMessages(Object *receiver)
 	ASSERT(data_ == receiver->thread()->data_);
 
 	MutexLocker locker(data_->messages_.mutex_);
-	if (!receiver->pendingMessages_)
+	if (!receiver->pendingMessages_.load(std::memory_order_relaxed))
 		return;
 
+	/* Delete the messages after releasing the lock. */
 	std::vector<std::unique_ptr<Message>> toDelete;
-	for (std::unique_ptr<Message> &msg : data_->messages_.list_) {
-		if (!msg)
-			continue;
-		if (msg->receiver_ != receiver)
-			continue;
-
-		/*
-		 * Move the message to the pending deletion list to delete it
-		 * after releasing the lock. The messages list element will
-		 * contain a null pointer, and will be removed when dispatching
-		 * messages.
-		 */
-		toDelete.push_back(std::move(msg));
-		receiver->pendingMessages_--;
+	while (Message *msg = data_->messages_.take(Message::Type::None, receiver)) {
+		toDelete.emplace_back(msg);
+		receiver->pendingMessages_.fetch_sub(1, std::memory_order_relaxed);
 	}
 
-	ASSERT(!receiver->pendingMessages_);
+	ASSERT(!receiver->pendingMessages_.load(std::memory_order_relaxed));
 	locker.unlock();
 
 	toDelete.clear();
@@ -593,10 +751,12 @@ void Thread::removeMessages(Object *receiver)
 /**
  * \brief Dispatch posted messages for this thread
  * \param[in] type The message type
+ * \param[in] receiver The receiver whose messages to dispatch
  *
  * This function immediately dispatches all the messages previously posted for
  * this thread with postMessage() that match the message \a type. If the \a type
- * is Message::Type::None, all messages are dispatched.
+ * is Message::Type::None, all messages are dispatched. If a \a receiver is
+ * given, only the messages posted to that receiver are dispatched.
  *
  * Messages shall only be dispatched from the current thread, typically within
  * the thread from the run() function. Calling this function outside of the
@@ -606,52 +766,31 @@ void Thread::removeMessages(Object *receiver)
  * same thread from an object's message handler. It guarantees delivery of
  * messages in the order they have been posted in all cases.
  */
-void Thread::dispatchMessages(Message::Type type)
+void Thread::dispatchMessages(Message::Type type, Object *receiver)
 {
 	ASSERT(data_ == ThreadData::current());
 
-	++data_->messages_.recursion_;
-
-	MutexLocker locker(data_->messages_.mutex_);
-
-	std::list<std::unique_ptr<Message>> &messages = data_->messages_.list_;
-
-	for (std::unique_ptr<Message> &msg : messages) {
-		if (!msg)
-			continue;
+	MessageQueue &messages = data_->messages_;
 
-		if (type != Message::Type::None && msg->type() != type)
-			continue;
+	/*
+	 * Remove messages from the queue one at a time before delivering them.
+	 * This guarantees in-order delivery when called recursively from a
+	 * message handler, and allows the handler to remove or move pending
+	 * messages.
+	 */
+	while (true) {
+		MutexLocker locker(messages.mutex_);
+		std::unique_ptr<Message> message(messages.take(type, receiver));
+		locker.unlock();
 
-		/*
-		 * Move the message, setting the entry in the list to null. It
-		 * will cause recursive calls to ignore the entry, and the erase
-		 * loop at the end of the function to delete it from the list.
-		 */
-		std::unique_ptr<Message> message = std::move(msg);
+		if (!message)
+			break;
 
-		Object *receiver = message->receiver_;
-		ASSERT(data_ == receiver->thread()->data_);
-		receiver->pendingMessages_--;
+		Object *object = message->receiver_;
+		ASSERT(data_ == object->thread()->data_);
+		object->pendingMessages_.fetch_sub(1, std::memory_order_relaxed);
 
-		locker.unlock();
-		receiver->message(message.get());
-		message.reset();
-		locker.lock();
-	}
-
-	/*
-	 * If the recursion level is 0, erase all null messages in the list. We
-	 * can't do so during recursion, as it would invalidate the iterator of
-	 * the outer calls.
-	 */
-	if (!--data_->messages_.recursion_) {
-		for (auto iter = messages.begin(); iter != messages.end(); ) {
-			if (!*iter)
-				iter = messages.erase(iter);
-			else
-				++iter;
-		}
+		object->message(message.get());
 	}
 }
 
@@ -675,20 +814,13 @@ void Thread::moveObject(Object *object, ThreadData *currentData,
 			ThreadData *targetData)
 {
 	/* Move pending messages to the message queue of the new thread. */
-	if (object->pendingMessages_) {
-		unsigned int movedMessages = 0;
+	if (object->pendingMessages_.load(std::memory_order_relaxed)) {
+		bool wakeup = false;
 
-		for (std::unique_ptr<Message> &msg : currentData->messages_.list_) {
-			if (!msg)
-				continue;
-			if (msg->receiver_ != object)
-				continue;
-
-			targetData->messages_.list_.push_back(std::move(msg));
-			movedMessages++;
-		}
+		while (Message *msg = currentData->messages_.take(Message::Type::None, object))
+			wakeup |= targetData->messages_.post(msg);
 
-		if (movedMessages) {
+		if (wakeup) {
 			EventDispatcher *dispatcher =
 				targetData->dispatcher_.load(std::memory_order_acquire);
 			if (dispatcher)
@@ -9,7 +9,13 @@
 #include "libcamera/internal/dma_buf_allocator.h"
 
 #include <array>
+#include <errno.h>
 #include <fcntl.h>
+#include <fstream>
+#include <list>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string>
 #include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <sys/stat.h>
@@ -22,6 +28,14 @@
 
 #include <libcamera/base/log.h>
 #include <libcamera/base/memfd.h>
+#include <libcamera/base/mutex.h>
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/thread_annotations.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/framebuffer.h"
 
 /**
  * \file dma_buf_allocator.cpp
@@ -50,6 +64,204 @@ static constexpr std::array<DmaBufAllocatorInfo, 4> providerInfos = { {
 
 LOG_DEFINE_CATEGORY(DmaBufAllocator)
 
+namespace {
+
+/*
+ * Default maximum size of the pool of free buffers, in MiB. This is enough to
+ * recycle a set of four 1080p NV12 buffers when a stream is reconfigured,
+ * without keeping too much of the CMA area away from the rest of the system.
+ */
+constexpr std::size_t kDefaultPoolLimit = 16;
+
+/*
+ * Round a buffer size up to its size class. Sizes are rounded to a multiple of
+ * the page size, and split in 8 classes per power of two above 8 pages. This
+ * wastes at most 12.5% of memory, while allowing buffers of slightly different
+ * sizes to be recycled.
+ */
+std::size_t sizeClass(std::size_t size)
+{
+	const std::size_t pageSize = sysconf(_SC_PAGESIZE);
+
+	size = (size + pageSize - 1) & ~(pageSize - 1);
+	if (size <= pageSize * 8)
+		return size;
+
+	unsigned int order = 0;
+	while ((size >> order) > 15)
+		order++;
+
+	std::size_t step = std::size_t(1) << order;
+	return (size + step - 1) & ~(step - 1);
+}
+
+/*
+ * Return the number of references to the file behind a dma-buf \a fd, as
+ * reported by the kernel in /proc/self/fdinfo. All file descriptors, in this
+ * process or others, as well as memory mappings and devices importing the
+ * dma-buf, hold a reference. Return 0 if the number can't be retrieved.
+ */
+unsigned long fileRefCount(int fd)
+{
+	std::ifstream fdinfo("/proc/self/fdinfo/" + std::to_string(fd));
+	std::string line;
+
+	while (std::getline(fdinfo, line)) {
+		if (line.compare(0, 6, "count:"))
+			continue;
+
+		return strtoul(line.c_str() + 6, nullptr, 10);
+	}
+
+	return 0;
+}
+
+} /* namespace */
+
+#ifndef __DOXYGEN__
+class DmaBufAllocator::Pool
+{
+public:
+	Pool(std::size_t limit)
+		: limit_(limit), stats_{}
+	{
+	}
+
+	~Pool()
+	{
+		LOG(DmaBufAllocator, Debug)
+			<< "Pool: " << stats_.hits << " hits, " << stats_.misses
+			<< " misses, " << stats_.evictions << " evictions";
+	}
+
+	bool enabled() const
+	{
+		MutexLocker locker(mutex_);
+		return limit_ != 0;
+	}
+
+	UniqueFD get(std::size_t size)
+	{
+		MutexLocker locker(mutex_);
+
+		for (auto it = buffers_.begin(); it != buffers_.end();) {
+			if (it->size != size) {
+				++it;
+				continue;
+			}
+
+			UniqueFD fd = std::move(it->fd);
+			it = buffers_.erase(it);
+
+			stats_.buffers--;
+			stats_.size -= size;
+
+			/*
+			 * The dma-buf may still be used through a file
+			 * descriptor duplicated by the application, or by a
+			 * device that imported it. Only the reference held by
+			 * the pool may remain for the buffer to be reused,
+			 * otherwise free it.
+			 */
+			if (fileRefCount(fd.get()) != 1) {
+				stats_.evictions++;
+				continue;
+			}
+
+			stats_.hits++;
+			return fd;
+		}
+
+		stats_.misses++;
+		return {};
+	}
+
+	void put(UniqueFD fd, std::size_t size)
+	{
+		MutexLocker locker(mutex_);
+
+		/* Only buffers allocated with a size class can be recycled. */
+		if (!fd.isValid() || size != sizeClass(size) || size > limit_)
+			return;
+
+		trim(limit_ - size);
+
+		buffers_.push_back({ size, std::move(fd) });
+		stats_.buffers++;
+		stats_.size += size;
+	}
+
+	void setLimit(std::size_t limit)
+	{
+		MutexLocker locker(mutex_);
+
+		limit_ = limit;
+		trim(limit_);
+	}
+
+	PoolStats stats() const
+	{
+		MutexLocker locker(mutex_);
+		return stats_;
+	}
+
+private:
+	struct Entry {
+		std::size_t size;
+		UniqueFD fd;
+	};
+
+	/* Free the oldest buffers until the pool size fits in the limit */
+	void trim(std::size_t limit) LIBCAMERA_TSA_REQUIRES(mutex_)
+	{
+		while (stats_.size > limit) {
+			Entry &entry = buffers_.front();
+
+			stats_.evictions++;
+			stats_.buffers--;
+			stats_.size -= entry.size;
+
+			buffers_.pop_front();
+		}
+	}
+
+	mutable Mutex mutex_;
+	std::size_t limit_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	/* Free buffers, from the oldest to the most recently released */
+	std::list<Entry> buffers_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	PoolStats stats_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+};
+
+/*
+ * Private data of the frame buffers created by exportBuffers(), returning the
+ * dma-buf to the pool when the frame buffer is destroyed. The pool gets a
+ * private duplicate of the file descriptor, kept from the creation of the
+ * buffer, as the application may hold on to the plane file descriptors.
+ */
+class DmaBufAllocator::PooledBufferData : public FrameBuffer::Private
+{
+	LIBCAMERA_DECLARE_PUBLIC(FrameBuffer)
+
+public:
+	PooledBufferData(const std::vector<FrameBuffer::Plane> &planes,
+			 std::shared_ptr<Pool> pool, std::size_t size)
+		: FrameBuffer::Private(planes), pool_(std::move(pool)),
+		  fd_(planes[0].fd.dup()), size_(size)
+	{
+	}
+
+	~PooledBufferData() override
+	{
+		pool_->put(std::move(fd_), size_);
+	}
+
+private:
+	std::shared_ptr<Pool> pool_;
+	UniqueFD fd_;
+	std::size_t size_;
+};
+#endif /* __DOXYGEN__ */
+
 /**
  * \class DmaBufAllocator
  * \brief Helper class for dma-buf allocations
@@ -60,6 +272,19 @@ LOG_DEFINE_CATEGORY(DmaBufAllocator)
  * Different providers may provide dma-buffers with different properties for
  * the underlying memory. Which providers are acceptable is specified through
  * the type argument passed to the DmaBufAllocator() constructor.
+ *
+ * Allocating dma-buffers, especially from the CMA heap, is slow, and repeated
+ * allocations fragment memory. To avoid round-trips to the kernel when streams
+ * are reconfigured, the buffers created by exportBuffers() are not freed when
+ * the frame buffers are destroyed, but returned to a pool of free buffers. The
+ * pool is organized by size classes, and subsequent exportBuffers() calls for
+ * a size in the same class reuse the pooled buffers. A pooled buffer is only
+ * reused if nothing else references the dma-buf anymore, such as a file
+ * descriptor duplicated by the application or a device that imported it, and
+ * is freed otherwise. The least recently released buffers are freed when the
+ * pool size exceeds its limit, set with setPoolLimit(). The default limit is
+ * 16 MiB, and can be overridden with the LIBCAMERA_DMABUF_POOL_SIZE
+ * environment variable, expressed in MiB.
  */
 
 /**
@@ -78,6 +303,27 @@ LOG_DEFINE_CATEGORY(DmaBufAllocator)
  * \brief A bitwise combination of DmaBufAllocator::DmaBufAllocatorFlag values
  */
 
+/**
+ * \struct DmaBufAllocator::PoolStats
+ * \brief Statistics of the pool of free buffers
+ *
+ * \var DmaBufAllocator::PoolStats::hits
+ * \brief Number of allocations served from the pool
+ *
+ * \var DmaBufAllocator::PoolStats::misses
+ * \brief Number of allocations that required a new buffer while pooling
+ *
+ * \var DmaBufAllocator::PoolStats::evictions
+ * \brief Number of free buffers released to keep the pool within its limit,
+ * or because they were still referenced when about to be reused
+ *
+ * \var DmaBufAllocator::PoolStats::buffers
+ * \brief Number of free buffers in the pool
+ *
+ * \var DmaBufAllocator::PoolStats::size
+ * \brief Total size of the free buffers in the pool, in bytes
+ */
+
 /**
  * \brief Construct a DmaBufAllocator of a given type
  * \param[in] type The type(s) of the dma-buf providers to allocate from
@@ -114,10 +360,32 @@ DmaBufAllocator::DmaBufAllocator(DmaBufAllocatorFlags type)
 
 	if (!providerHandle_.isValid())
 		LOG(DmaBufAllocator, Error) << "Could not open any dma-buf provider";
+
+	std::size_t limit = kDefaultPoolLimit;
+	const char *poolSize = utils::secure_getenv("LIBCAMERA_DMABUF_POOL_SIZE");
+	if (poolSize) {
+		char *end;
+		errno = 0;
+		unsigned long value = strtoul(poolSize, &end, 10);
+		if (errno || end == poolSize || *end != '\0' ||
+		    value > (SIZE_MAX >> 20)) {
+			LOG(DmaBufAllocator, Error)
+				<< "Invalid LIBCAMERA_DMABUF_POOL_SIZE value '"
+				<< poolSize << "', using " << kDefaultPoolLimit
+				<< " MiB";
+		} else {
+			limit = value;
+		}
+	}
+
+	pool_ = std::make_shared<Pool>(limit << 20);
 }
 
 /**
  * \brief Destroy the DmaBufAllocator instance
+ *
+ * The buffers exported by the allocator stay valid after it is destroyed. The
+ * pool of free buffers is freed when the last exported buffer is destroyed.
  */
 DmaBufAllocator::~DmaBufAllocator() = default;
 
@@ -188,7 +456,8 @@ UniqueFD DmaBufAllocator::allocFromHeap(const char *name, std::size_t size)
  * \param [in] name The name to set for the allocated buffer
  * \param [in] size The size of the buffer to allocate
  *
- * Allocates a dma-buf with read/write access.
+ * Allocates a dma-buf with read/write access. The buffer doesn't go through
+ * the pool of free buffers.
  *
  * If the allocation fails, return an invalid UniqueFD.
  *
@@ -205,4 +474,115 @@ UniqueFD DmaBufAllocator::alloc(const char *name, std::size_t size)
 		return allocFromHeap(name, size);
 }
 
+UniqueFD DmaBufAllocator::allocPooled(const char *name, std::size_t size)
+{
+	if (!pool_->enabled())
+		return alloc(name, size);
+
+	/* Round the size up to its class, for the buffer to be recycled. */
+	size = sizeClass(size);
+
+	UniqueFD fd = pool_->get(size);
+	if (!fd.isValid())
+		return alloc(name, size);
+
+	/* Rename the buffer to help debugging, udmabufs excepted. */
+	if (type_ != DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf &&
+	    ::ioctl(fd.get(), DMA_BUF_SET_NAME, name) < 0)
+		LOG(DmaBufAllocator, Debug)
+			<< "dma-heap renaming failure for " << name;
+
+	return fd;
+}
+
+/**
+ * \brief Allocate and export buffers from the DmaBufAllocator
+ * \param[in] count The number of requested FrameBuffers
+ * \param[in] planeSizes The sizes of planes in each FrameBuffer
+ * \param[out] buffers Array of buffers successfully allocated
+ *
+ * Planes in a FrameBuffer are allocated with a single dma-buf, and are stored
+ * contiguously. The dma-buf is returned to the pool of free buffers when the
+ * FrameBuffer is destroyed.
+ *
+ * \return The number of allocated buffers on success or a negative error code
+ * otherwise
+ */
+int DmaBufAllocator::exportBuffers(unsigned int count,
+				   const std::vector<unsigned int> &planeSizes,
+				   std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+{
+	for (unsigned int i = 0; i < count; ++i) {
+		const std::string name = "frame-" + std::to_string(i);
+
+		std::unique_ptr<FrameBuffer> buffer =
+			createBuffer(name.c_str(), planeSizes);
+		if (!buffer) {
+			LOG(DmaBufAllocator, Error) << "Unable to create buffer";
+
+			buffers->clear();
+			return -ENOMEM;
+		}
+
+		buffers->push_back(std::move(buffer));
+	}
+
+	return count;
+}
+
+std::unique_ptr<FrameBuffer>
+DmaBufAllocator::createBuffer(const char *name,
+			      const std::vector<unsigned int> &planeSizes)
+{
+	std::size_t size = 0;
+	for (unsigned int planeSize : planeSizes)
+		size += planeSize;
+
+	SharedFD fd(allocPooled(name, size));
+	if (!fd.isValid())
+		return nullptr;
+
+	/* The allocated size may have been rounded up. */
+	off_t length = lseek(fd.get(), 0, SEEK_END);
+	if (length < 0)
+		return nullptr;
+
+	std::vector<FrameBuffer::Plane> planes;
+	unsigned int offset = 0;
+
+	for (unsigned int planeSize : planeSizes) {
+		FrameBuffer::Plane plane;
+		plane.fd = fd;
+		plane.offset = offset;
+		plane.length = planeSize;
+		offset += planeSize;
+
+		planes.push_back(std::move(plane));
+	}
+
+	return std::make_unique<FrameBuffer>(
+		std::make_unique<PooledBufferData>(planes, pool_, length));
+}
+
+/**
+ * \brief Set the maximum size of the pool of free buffers
+ * \param[in] limit The maximum size in bytes
+ *
+ * Free buffers are released, from the least recently used, until the pool
+ * size fits in the new \a limit. A zero limit disables pooling.
+ */
+void DmaBufAllocator::setPoolLimit(std::size_t limit)
+{
+	pool_->setLimit(limit);
+}
+
+/**
+ * \brief Retrieve the statistics of the pool of free buffers
+ * \return The pool statistics
+ */
+DmaBufAllocator::PoolStats DmaBufAllocator::poolStats() const
+{
+	return pool_->stats();
+}
+
 } /* namespace libcamera */
@@ -210,6 +210,43 @@ FrameBuffer::Private::~Private()
  * \brief Retrieve the dynamic metadata
  * \return Dynamic metadata for the frame contained in the buffer
  */
+
+/**
+ * \brief Map the frame buffer memory for CPU access
+ * \param[in] flags The access required by the caller
+ *
+ * Mapping and unmapping a buffer for every frame is expensive, as unmapping
+ * large buffers causes TLB shootdowns on all CPU cores. This function instead
+ * maps the buffer the first time it is called, and keeps the mapping alive
+ * until the frame buffer is destroyed. Subsequent calls return the same
+ * mapping, or map the buffer again if the existing mappings don't allow the
+ * access specified by \a flags.
+ *
+ * Callers shall bracket their CPU accesses to the buffer with calls to
+ * MappedFrameBuffer::beginAccess() and MappedFrameBuffer::endAccess().
+ *
+ * This function is thread-safe. The returned mapping is valid for the whole
+ * lifetime of the frame buffer.
+ *
+ * \return The mapping of the buffer, or nullptr if the buffer can't be mapped
+ */
+const MappedFrameBuffer *
+FrameBuffer::Private::map(MappedFrameBuffer::MapFlags flags) const
+{
+	MutexLocker locker(mappingsLock_);
+
+	for (const std::unique_ptr<MappedFrameBuffer> &mapping : mappings_) {
+		if ((mapping->flags() & flags) == flags)
+			return mapping.get();
+	}
+
+	const FrameBuffer *buffer = LIBCAMERA_O_PTR();
+	auto mapping = std::make_unique<MappedFrameBuffer>(buffer, flags);
+	if (!mapping->isValid())
+		return nullptr;
+
+	return mappings_.emplace_back(std::move(mapping)).get();
+}
 #endif /* __DOXYGEN_PUBLIC__ */
 
 /**
@@ -48,6 +48,19 @@ namespace {
  * generated IPA proxies.
  */
 
+/**
+ * \fn template<typename T> void writePOD(std::vector<uint8_t> &vec, size_t pos, T val)
+ * \brief Write POD to byte vector at a given position, in little-endian order
+ * \tparam T Type of POD to write
+ * \param[in] vec Byte vector to write to
+ * \param[in] pos Index in \a vec to write to
+ * \param[in] val Value to write
+ *
+ * This function is meant to be used by the IPA data serializer, and the
+ * generated IPA proxies, to fill in sizes that are only known after the data
+ * they describe has been appended to \a vec.
+ */
+
 /**
  * \fn template<typename T> T readPOD(std::vector<uint8_t>::iterator it, size_t pos,
  * 				      std::vector<uint8_t>::iterator end)
@@ -102,6 +115,29 @@ namespace {
  * of \a data
  */
 
+/**
+ * \fn template<typename T> IPADataSerializer<T>::serialize(
+ * 	const T &data,
+ * 	std::vector<uint8_t> &dataVec,
+ * 	std::vector<SharedFD> &fdsVec,
+ * 	ControlSerializer *cs = nullptr)
+ * \brief Serialize an object by appending to a byte vector and fd vector
+ * \tparam T Type of object to serialize
+ * \param[in] data Object to serialize
+ * \param[inout] dataVec Byte vector to append the serialized data to
+ * \param[inout] fdsVec Fd vector to append the serialized fds to
+ * \param[in] cs ControlSerializer
+ *
+ * This version of serialize() writes the serialized form of \a data at the
+ * end of \a dataVec and \a fdsVec, without allocating intermediate vectors.
+ * Callers can reuse the same vectors across messages, clearing them but
+ * keeping their capacity, to avoid memory allocations altogether once the
+ * vectors have grown to the size of the largest message.
+ *
+ * \a cs is only necessary if the object type \a T or its members contain
+ * ControlList or ControlInfoMap.
+ */
+
 /**
  * \fn template<typename T> IPADataSerializer<T>::deserialize(
  * 	const std::vector<uint8_t> &data,
@@ -189,15 +225,12 @@ namespace {
 #define DEFINE_POD_SERIALIZER(type)					\
 									\
 template<>								\
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>		\
-IPADataSerializer<type>::serialize(const type &data,			\
-				  [[maybe_unused]] ControlSerializer *cs) \
+void IPADataSerializer<type>::serialize(const type &data,		\
+					std::vector<uint8_t> &dataVec,	\
+					[[maybe_unused]] std::vector<SharedFD> &fdsVec, \
+					[[maybe_unused]] ControlSerializer *cs) \
 {									\
-	std::vector<uint8_t> dataVec;					\
-	dataVec.reserve(sizeof(type));					\
 	appendPOD<type>(dataVec, data);					\
-									\
-	return { dataVec, {} };						\
 }									\
 									\
 template<>								\
@@ -251,11 +284,13 @@ DEFINE_POD_SERIALIZER(double)
  * function parameter serdes).
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+void
 IPADataSerializer<std::string>::serialize(const std::string &data,
+					  std::vector<uint8_t> &dataVec,
+					  [[maybe_unused]] std::vector<SharedFD> &fdsVec,
 					  [[maybe_unused]] ControlSerializer *cs)
 {
-	return { { data.cbegin(), data.end() }, {} };
+	dataVec.insert(dataVec.end(), data.cbegin(), data.cend());
 }
 
 template<>
@@ -307,51 +342,53 @@ IPADataSerializer<std::string>::deserialize(std::vector<uint8_t>::const_iterator
  * be used. The serialized ControlInfoMap will have zero length.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
-IPADataSerializer<ControlList>::serialize(const ControlList &data, ControlSerializer *cs)
+void
+IPADataSerializer<ControlList>::serialize(const ControlList &data,
+					  std::vector<uint8_t> &dataVec,
+					  [[maybe_unused]] std::vector<SharedFD> &fdsVec,
+					  ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlList";
 
-	size_t size;
-	std::vector<uint8_t> infoData;
+	const size_t offset = dataVec.size();
+	size_t infoSize = 0;
 	int ret;
 
+	/* Reserve space for the sizes, and serialize in place. */
+	dataVec.resize(offset + 8);
+
 	/*
 	 * \todo Revisit this opportunistic serialization of the
 	 * ControlInfoMap, as it could be fragile
 	 */
 	if (data.infoMap() && !cs->isCached(*data.infoMap())) {
-		size = cs->binarySize(*data.infoMap());
-		infoData.resize(size);
-		ByteStreamBuffer buffer(infoData.data(), infoData.size());
+		infoSize = cs->binarySize(*data.infoMap());
+		dataVec.resize(offset + 8 + infoSize);
+		ByteStreamBuffer buffer(dataVec.data() + offset + 8, infoSize);
 		ret = cs->serialize(*data.infoMap(), buffer);
 
 		if (ret < 0 || buffer.overflow()) {
 			LOG(IPADataSerializer, Error) << "Failed to serialize ControlList's ControlInfoMap";
-			return { {}, {} };
+			dataVec.resize(offset);
+			return;
 		}
 	}
 
-	size = cs->binarySize(data);
-	std::vector<uint8_t> listData(size);
-	ByteStreamBuffer buffer(listData.data(), listData.size());
+	size_t listSize = cs->binarySize(data);
+	dataVec.resize(offset + 8 + infoSize + listSize);
+	ByteStreamBuffer buffer(dataVec.data() + offset + 8 + infoSize, listSize);
 	ret = cs->serialize(data, buffer);
 
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlList";
-		return { {}, {} };
+		dataVec.resize(offset);
+		return;
 	}
 
-	std::vector<uint8_t> dataVec;
-	dataVec.reserve(8 + infoData.size() + listData.size());
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	appendPOD<uint32_t>(dataVec, listData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
-	dataVec.insert(dataVec.end(), listData.begin(), listData.end());
-
-	return { dataVec, {} };
+	writePOD<uint32_t>(dataVec, offset, infoSize);
+	writePOD<uint32_t>(dataVec, offset + 4, listSize);
 }
 
 template<>
@@ -431,29 +468,30 @@ IPADataSerializer<ControlList>::deserialize(std::vector<uint8_t>::const_iterator
  * X bytes - Serialized ControlInfoMap (using ControlSerializer)
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+void
 IPADataSerializer<ControlInfoMap>::serialize(const ControlInfoMap &map,
+					     std::vector<uint8_t> &dataVec,
+					     [[maybe_unused]] std::vector<SharedFD> &fdsVec,
 					     ControlSerializer *cs)
 {
 	if (!cs)
 		LOG(IPADataSerializer, Fatal)
 			<< "ControlSerializer not provided for serialization of ControlInfoMap";
 
+	const size_t offset = dataVec.size();
 	size_t size = cs->binarySize(map);
-	std::vector<uint8_t> infoData(size);
-	ByteStreamBuffer buffer(infoData.data(), infoData.size());
+
+	dataVec.resize(offset + 4 + size);
+	ByteStreamBuffer buffer(dataVec.data() + offset + 4, size);
 	int ret = cs->serialize(map, buffer);
 
 	if (ret < 0 || buffer.overflow()) {
 		LOG(IPADataSerializer, Error) << "Failed to serialize ControlInfoMap";
-		return { {}, {} };
+		dataVec.resize(offset);
+		return;
 	}
 
-	std::vector<uint8_t> dataVec;
-	appendPOD<uint32_t>(dataVec, infoData.size());
-	dataVec.insert(dataVec.end(), infoData.begin(), infoData.end());
-
-	return { dataVec, {} };
+	writePOD<uint32_t>(dataVec, offset, size);
 }
 
 template<>
@@ -521,13 +559,12 @@ IPADataSerializer<ControlInfoMap>::deserialize(std::vector<uint8_t>::const_itera
  * and it will be recursively consumed as necessary.
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+void
 IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
+				       std::vector<uint8_t> &dataVec,
+				       std::vector<SharedFD> &fdsVec,
 				       [[maybe_unused]] ControlSerializer *cs)
 {
-	std::vector<uint8_t> dataVec;
-	std::vector<SharedFD> fdVec;
-
 	/*
 	 * Store as uint32_t to prepare for conversion from validity flag
 	 * to index, and for alignment.
@@ -535,10 +572,7 @@ IPADataSerializer<SharedFD>::serialize(const SharedFD &data,
 	appendPOD<uint32_t>(dataVec, data.isValid());
 
 	if (data.isValid())
-		fdVec.push_back(data);
-
-
-	return { dataVec, fdVec };
+		fdsVec.push_back(data);
 }
 
 template<>
@@ -573,24 +607,16 @@ SharedFD IPADataSerializer<SharedFD>::deserialize(const std::vector<uint8_t> &da
  * 4 bytes - uint32_t Length
  */
 template<>
-std::tuple<std::vector<uint8_t>, std::vector<SharedFD>>
+void
 IPADataSerializer<FrameBuffer::Plane>::serialize(const FrameBuffer::Plane &data,
+						 std::vector<uint8_t> &dataVec,
+						 std::vector<SharedFD> &fdsVec,
 						 [[maybe_unused]] ControlSerializer *cs)
 {
-	std::vector<uint8_t> dataVec;
-	std::vector<SharedFD> fdsVec;
-
-	std::vector<uint8_t> fdBuf;
-	std::vector<SharedFD> fdFds;
-	std::tie(fdBuf, fdFds) =
-		IPADataSerializer<SharedFD>::serialize(data.fd);
-	dataVec.insert(dataVec.end(), fdBuf.begin(), fdBuf.end());
-	fdsVec.insert(fdsVec.end(), fdFds.begin(), fdFds.end());
+	IPADataSerializer<SharedFD>::serialize(data.fd, dataVec, fdsVec);
 
 	appendPOD<uint32_t>(dataVec, data.offset);
 	appendPOD<uint32_t>(dataVec, data.length);
-
-	return { dataVec, fdsVec };
 }
 
 template<>
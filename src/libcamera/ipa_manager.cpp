@@ -9,11 +9,19 @@
 
 #include <algorithm>
 #include <dirent.h>
+#include <errno.h>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
+#include <sys/stat.h>
 #include <sys/types.h>
+#include <unistd.h>
 
 #include <libcamera/base/file.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/unique_fd.h>
 #include <libcamera/base/utils.h>
 
 #include "libcamera/internal/ipa_module.h"
@@ -29,6 +37,12 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(IPAManager)
 
+namespace {
+
+const char *const kCacheHeader = "# libcamera IPA module cache v1";
+
+} /* namespace */
+
 /**
  * \class IPAManager
  * \brief Manager for IPA modules
@@ -102,8 +116,21 @@ IPAManager *IPAManager::self_ = nullptr;
  *
  * The IPAManager class is meant to only be instantiated once, by the
  * CameraManager.
+ *
+ * IPA modules are not discovered at construction time, but indexed the first
+ * time a pipeline handler looks up a module. Opening and parsing every module
+ * is slow on cold storage, so the pipeline handler name of each module is
+ * stored in a cache file, keyed by the module path, modification time and size.
+ * Subsequent indexing only loads the modules that match the pipeline handler
+ * being looked up, and the modules that have changed since they were cached.
+ *
+ * The cache file is stored in the libcamera directory of the XDG cache
+ * directory. Its location can be overridden with the LIBCAMERA_IPA_MODULE_CACHE
+ * environment variable, and the cache is disabled if the variable is set to an
+ * empty string.
  */
 IPAManager::IPAManager()
+	: indexed_(false)
 {
 	if (self_)
 		LOG(IPAManager, Fatal)
@@ -114,21 +141,17 @@ IPAManager::IPAManager()
 		LOG(IPAManager, Warning) << "Public key not valid";
 #endif
 
-	unsigned int ipaCount = 0;
-
 	/* User-specified paths take precedence. */
 	const char *modulePaths = utils::secure_getenv("LIBCAMERA_IPA_MODULE_PATH");
 	if (modulePaths) {
+		userPaths_ = modulePaths;
+
 		for (const auto &dir : utils::split(modulePaths, ":")) {
 			if (dir.empty())
 				continue;
 
-			ipaCount += addDir(dir.c_str());
+			searchDirs_.push_back({ dir, 0, true });
 		}
-
-		if (!ipaCount)
-			LOG(IPAManager, Warning)
-				<< "No IPA found in '" << modulePaths << "'";
 	}
 
 	/*
@@ -144,24 +167,19 @@ IPAManager::IPAManager()
 			<< "libcamera is not installed. Adding '"
 			<< ipaBuildPath << "' to the IPA search path";
 
-		ipaCount += addDir(ipaBuildPath.c_str(), maxDepth);
+		searchDirs_.push_back({ ipaBuildPath, maxDepth, false });
 	}
 
 	/* Finally try to load IPAs from the installed system path. */
-	ipaCount += addDir(IPA_MODULE_DIR);
+	searchDirs_.push_back({ IPA_MODULE_DIR, 0, false });
 
-	if (!ipaCount)
-		LOG(IPAManager, Warning)
-			<< "No IPA found in '" IPA_MODULE_DIR "'";
+	cachePath_ = cachePath();
 
 	self_ = this;
 }
 
 IPAManager::~IPAManager()
 {
-	for (IPAModule *module : modules_)
-		delete module;
-
 	self_ = nullptr;
 }
 
@@ -213,56 +231,299 @@ void IPAManager::parseDir(const char *libDir, unsigned int maxDepth,
 }
 
 /**
- * \brief Load IPA modules from a directory
- * \param[in] libDir The directory to search for IPA modules
- * \param[in] maxDepth The maximum depth of sub-directories to search
+ * \brief Index IPA modules from a directory
+ * \param[in] dir The directory to search for IPA modules
+ * \param[inout] cache The module cache
+ * \param[out] cacheUpdated Set to true if the cache has been updated
  *
- * This function tries to create an IPAModule instance for every shared object
- * found in \a libDir, and skips invalid IPA modules.
+ * This function adds an entry to the module index for every IPA module found
+ * in \a dir, and skips invalid IPA modules. Modules found in the \a cache with
+ * a matching modification time and size are indexed without being loaded.
+ * Other modules are loaded to retrieve their information, and added to the
+ * \a cache.
  *
- * Sub-directories are searched up to a depth of \a maxDepth. A \a maxDepth
- * value of 0 only searches the directory specified in \a libDir.
+ * Sub-directories are searched up to a depth of \a dir.maxDepth. A maxDepth
+ * value of 0 only searches the directory specified in \a dir.path.
  *
- * \return Number of modules loaded by this call
+ * \return Number of modules indexed by this call
  */
-unsigned int IPAManager::addDir(const char *libDir, unsigned int maxDepth)
+unsigned int IPAManager::addDir(const SearchDir &dir,
+				std::map<std::string, CacheEntry> &cache,
+				bool &cacheUpdated)
 {
 	std::vector<std::string> files;
 
-	parseDir(libDir, maxDepth, files);
+	parseDir(dir.path.c_str(), dir.maxDepth, files);
 
 	/* Ensure a stable ordering of modules. */
 	std::sort(files.begin(), files.end());
 
 	unsigned int count = 0;
 	for (const std::string &file : files) {
-		IPAModule *ipaModule = new IPAModule(file);
-		if (!ipaModule->isValid()) {
-			delete ipaModule;
+		struct stat st;
+		if (stat(file.c_str(), &st) < 0)
 			continue;
+
+		int64_t mtime = st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+		ModuleEntry entry{ file, {}, nullptr };
+
+		auto it = cache.find(file);
+		if (it != cache.end() && it->second.mtime == mtime &&
+		    it->second.size == st.st_size) {
+			entry.pipelineName = it->second.pipelineName;
+		} else {
+			auto ipaModule = std::make_unique<IPAModule>(file);
+			if (ipaModule->isValid()) {
+				LOG(IPAManager, Debug)
+					<< "Loaded IPA module '" << file << "'";
+
+				entry.pipelineName = ipaModule->info().pipelineName;
+				entry.module = std::move(ipaModule);
+			}
+
+			/* Cache invalid modules too, to skip them next time. */
+			cache[file] = { mtime, st.st_size, entry.pipelineName };
+			cacheUpdated = true;
 		}
 
-		LOG(IPAManager, Debug) << "Loaded IPA module '" << file << "'";
+		if (entry.pipelineName.empty())
+			continue;
 
-		modules_.push_back(ipaModule);
+		modules_.push_back(std::move(entry));
 		count++;
 	}
 
 	return count;
 }
 
+/**
+ * \brief Index the IPA modules from all search directories
+ */
+void IPAManager::indexModules()
+{
+	std::map<std::string, CacheEntry> cache = loadCache();
+	bool cacheUpdated = false;
+
+	unsigned int userCount = 0;
+	unsigned int ipaCount = 0;
+
+	for (const SearchDir &dir : searchDirs_) {
+		unsigned int count = addDir(dir, cache, cacheUpdated);
+
+		if (dir.user)
+			userCount += count;
+		ipaCount += count;
+	}
+
+	if (!userPaths_.empty() && !userCount)
+		LOG(IPAManager, Warning)
+			<< "No IPA found in '" << userPaths_ << "'";
+
+	if (!ipaCount)
+		LOG(IPAManager, Warning)
+			<< "No IPA found in '" IPA_MODULE_DIR "'";
+
+	/* Drop the cache entries of modules that have been removed. */
+	for (auto it = cache.begin(); it != cache.end();) {
+		if (!File::exists(it->first)) {
+			it = cache.erase(it);
+			cacheUpdated = true;
+		} else {
+			++it;
+		}
+	}
+
+	if (cacheUpdated)
+		saveCache(cache);
+
+	indexed_ = true;
+}
+
+/**
+ * \brief Retrieve the path to the IPA module cache file
+ * \return The path to the cache file, or an empty string if the cache is
+ * disabled
+ */
+std::string IPAManager::cachePath()
+{
+	const char *path = utils::secure_getenv("LIBCAMERA_IPA_MODULE_CACHE");
+	if (path)
+		return path;
+
+	std::string dir;
+	const char *xdgCache = utils::secure_getenv("XDG_CACHE_HOME");
+	const char *home = utils::secure_getenv("HOME");
+	if (xdgCache && xdgCache[0] == '/')
+		dir = xdgCache;
+	else if (home && home[0] == '/')
+		dir = std::string(home) + "/.cache";
+	else
+		return {};
+
+	return dir + "/libcamera/ipa_modules";
+}
+
+/**
+ * \brief Load the IPA module cache
+ *
+ * The cache file stores one module per line, with the module path,
+ * modification time in nanoseconds, size and pipeline handler name separated
+ * by tabulations. The pipeline handler name is empty for invalid modules.
+ *
+ * \return The cache entries, indexed by module path
+ */
+std::map<std::string, IPAManager::CacheEntry> IPAManager::loadCache() const
+{
+	std::map<std::string, CacheEntry> cache;
+
+	if (cachePath_.empty())
+		return cache;
+
+	std::ifstream file(cachePath_);
+	if (!file.is_open())
+		return cache;
+
+	std::string line;
+	if (!std::getline(file, line) || line != kCacheHeader)
+		return cache;
+
+	while (std::getline(file, line)) {
+		std::vector<std::string> fields;
+		for (const auto &field : utils::split(line, "\t"))
+			fields.push_back(field);
+
+		if (fields.size() != 4 || fields[0].empty())
+			continue;
+
+		char *end;
+		int64_t mtime = strtoll(fields[1].c_str(), &end, 10);
+		if (*end != '\0')
+			continue;
+		int64_t size = strtoll(fields[2].c_str(), &end, 10);
+		if (*end != '\0')
+			continue;
+
+		cache[fields[0]] = { mtime, size, fields[3] };
+	}
+
+	LOG(IPAManager, Debug)
+		<< "Loaded " << cache.size() << " entries from IPA module cache '"
+		<< cachePath_ << "'";
+
+	return cache;
+}
+
+/**
+ * \brief Store the IPA module cache
+ * \param[in] cache The cache entries
+ *
+ * The cache is written to a uniquely named temporary file, synced to storage,
+ * and then atomically renamed over the cache file. Concurrent updates from
+ * multiple processes, or a crash while writing, thus never leave a partially
+ * written cache behind. Failures are not fatal, and only result in a slower
+ * indexing next time.
+ */
+void IPAManager::saveCache(const std::map<std::string, CacheEntry> &cache) const
+{
+	if (cachePath_.empty())
+		return;
+
+	/* Create the parent directories of the cache file if needed. */
+	size_t pos = cachePath_.find('/', 1);
+	while (pos != std::string::npos) {
+		std::string dir = cachePath_.substr(0, pos);
+		if (mkdir(dir.c_str(), 0700) < 0 && errno != EEXIST) {
+			LOG(IPAManager, Debug)
+				<< "Failed to create IPA module cache directory '"
+				<< dir << "': " << strerror(errno);
+			return;
+		}
+
+		pos = cachePath_.find('/', pos + 1);
+	}
+
+	std::ostringstream data;
+	data << kCacheHeader << "\n";
+
+	for (const auto &[path, entry] : cache) {
+		/* Skip paths that can't be stored in the cache. */
+		if (path.find_first_of("\t\n") != std::string::npos ||
+		    entry.pipelineName.find_first_of("\t\n") != std::string::npos)
+			continue;
+
+		data << path << "\t" << entry.mtime << "\t" << entry.size
+		     << "\t" << entry.pipelineName << "\n";
+	}
+
+	std::string tmpPath = cachePath_ + ".XXXXXX";
+	UniqueFD fd(mkstemp(tmpPath.data()));
+	if (!fd.isValid()) {
+		LOG(IPAManager, Debug)
+			<< "Failed to create IPA module cache '" << cachePath_
+			<< "': " << strerror(errno);
+		return;
+	}
+
+	const std::string content = data.str();
+	size_t written = 0;
+	while (written < content.size()) {
+		ssize_t ret = write(fd.get(), content.data() + written,
+				    content.size() - written);
+		if (ret < 0 && errno == EINTR)
+			continue;
+		if (ret <= 0)
+			break;
+		written += ret;
+	}
+
+	if (written != content.size() || fsync(fd.get()) < 0) {
+		LOG(IPAManager, Debug)
+			<< "Failed to write IPA module cache '" << cachePath_
+			<< "': " << strerror(errno);
+		unlink(tmpPath.c_str());
+		return;
+	}
+
+	fd.reset();
+
+	if (rename(tmpPath.c_str(), cachePath_.c_str()) < 0) {
+		LOG(IPAManager, Debug)
+			<< "Failed to replace IPA module cache '" << cachePath_
+			<< "': " << strerror(errno);
+		unlink(tmpPath.c_str());
+	}
+}
+
 /**
  * \brief Retrieve an IPA module that matches a given pipeline handler
  * \param[in] pipe The pipeline handler
  * \param[in] minVersion Minimum acceptable version of IPA module
  * \param[in] maxVersion Maximum acceptable version of IPA module
+ *
+ * The IPA modules are indexed on the first call. Modules are then only loaded
+ * when their pipeline handler name matches \a pipe.
  */
 IPAModule *IPAManager::module(PipelineHandler *pipe, uint32_t minVersion,
 			      uint32_t maxVersion)
 {
-	for (IPAModule *module : modules_) {
-		if (module->match(pipe, minVersion, maxVersion))
-			return module;
+	if (!indexed_)
+		indexModules();
+
+	for (ModuleEntry &entry : modules_) {
+		if (entry.pipelineName != pipe->name())
+			continue;
+
+		if (!entry.module) {
+			entry.module = std::make_unique<IPAModule>(entry.path);
+			LOG(IPAManager, Debug)
+				<< "Loaded IPA module '" << entry.path << "'";
+		}
+
+		if (!entry.module->isValid())
+			continue;
+
+		if (entry.module->match(pipe, minVersion, maxVersion))
+			return entry.module.get();
 	}
 
 	return nullptr;
@@ -7,7 +7,15 @@
 
 #include "libcamera/internal/ipc_pipe.h"
 
+#include <algorithm>
+#include <errno.h>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+
+#include <libcamera/base/event_dispatcher.h>
 #include <libcamera/base/log.h>
+#include <libcamera/base/thread.h>
 
 /**
  * \file ipc_pipe.h
@@ -153,20 +161,81 @@ IPCUnixSocket::Payload IPCMessage::payload() const
  * \brief IPC message pipe for IPA isolation
  *
  * Virtual class to model an IPC message pipe for use by IPA proxies for IPA
- * isolation. sendSync() and sendAsync() must be implemented, and the recvMessage
- * signal must be emitted whenever new data is available.
+ * isolation. sendAsync() must be implemented, and implementations must pass
+ * all received messages to handleMessage().
+ *
+ * The IPCPipe base class matches replies to calls issued with sendCall() or
+ * sendSync() using the cookie of the message header, enforces the call
+ * timeout, and records a histogram of the call latencies and the number of
+ * calls that timed out. Messages that are not replies to a pending call are
+ * emitted through the recv signal.
+ */
+
+/**
+ * \typedef IPCPipe::Completion
+ * \brief Function called when a call issued with sendCall() completes
+ *
+ * The \a ret argument is 0 when a reply has been received, in which case the
+ * reply is stored in \a out, or a negative error code otherwise.
+ */
+
+/**
+ * \var IPCPipe::kLatencyBuckets
+ * \brief Number of buckets of the call latency histogram
+ */
+
+/**
+ * \typedef IPCPipe::LatencyHistogram
+ * \brief Histogram of the call latencies
+ *
+ * Bucket 0 counts the calls that completed in less than 1µs, and bucket \a n
+ * counts the calls that completed in [2^(n-1), 2^n[ µs. The last bucket counts
+ * all longer calls. Calls that timed out are not included, they are counted by
+ * timeouts().
  */
 
 /**
  * \brief Construct an IPCPipe instance
+ *
+ * The call timeout defaults to 2 seconds, and can be overridden with the
+ * LIBCAMERA_IPA_IPC_TIMEOUT environment variable, expressed in milliseconds.
  */
 IPCPipe::IPCPipe()
-	: connected_(false)
+	: connected_(false), timeout_(2000), latency_{}, timeouts_(0)
 {
+	const char *timeout = utils::secure_getenv("LIBCAMERA_IPA_IPC_TIMEOUT");
+	if (timeout) {
+		char *end;
+		unsigned long value = strtoul(timeout, &end, 10);
+		if (*end == '\0' && value > 0)
+			timeout_ = std::chrono::milliseconds(value);
+		else
+			LOG(IPCPipe, Warning)
+				<< "Invalid IPC timeout '" << timeout << "'";
+	}
+
+	timer_.timeout.connect(this, &IPCPipe::expireCalls);
 }
 
 IPCPipe::~IPCPipe()
 {
+	unsigned int calls = 0;
+	for (unsigned int count : latency_)
+		calls += count;
+
+	if (!calls && !timeouts_)
+		return;
+
+	LOG(IPCPipe, Debug) << [&]() {
+		std::stringstream ss;
+		ss << "Call latency histogram (" << calls << " calls, "
+		   << timeouts_ << " timeouts):";
+		for (unsigned int i = 0; i < latency_.size(); ++i) {
+			if (latency_[i])
+				ss << " <" << (1u << i) << "µs: " << latency_[i];
+		}
+		return ss.str();
+	}();
 }
 
 /**
@@ -179,13 +248,13 @@ IPCPipe::~IPCPipe()
  */
 
 /**
- * \fn IPCPipe::sendSync()
  * \brief Send a message over IPC synchronously
  * \param[in] in Data to send
  * \param[in] out IPCMessage instance in which to receive data, if applicable
  *
- * This function will not return until a response is received. The event loop
- * will still continue to execute, however.
+ * This function will not return until a response is received or the call
+ * times out. The event loop will still continue to execute, however. Callers
+ * that can't tolerate reentrancy should use sendCall() instead.
  *
  * \return Zero on success, negative error code otherwise
  *
@@ -193,6 +262,65 @@ IPCPipe::~IPCPipe()
  * processes, to avoid reintrancy in the caller, and carefully document what
  * the caller needs to implement to make this safe.
  */
+int IPCPipe::sendSync(const IPCMessage &in, IPCMessage *out)
+{
+	bool done = false;
+	int result = 0;
+
+	int ret = sendCall(in, [&](int status, IPCMessage &response) {
+		result = status;
+		if (!status && out)
+			*out = std::move(response);
+		done = true;
+	});
+	if (!ret) {
+		while (!done)
+			Thread::current()->eventDispatcher()->processEvents();
+
+		ret = result;
+	}
+
+	if (ret)
+		LOG(IPCPipe, Error) << "Failed to call sync";
+
+	return ret;
+}
+
+/**
+ * \brief Send a message over IPC and complete asynchronously
+ * \param[in] in Data to send
+ * \param[in] completion Function to call when the call completes
+ *
+ * This function sends the message \a in and returns immediately. The
+ * \a completion function is called from the event loop of the calling thread
+ * when the reply is received, or when the call times out. It is not called if
+ * sending the message fails, or if the IPCPipe is destroyed before the call
+ * completes.
+ *
+ * \return Zero on success, negative error code otherwise
+ */
+int IPCPipe::sendCall(const IPCMessage &in, Completion completion)
+{
+	uint32_t cookie = in.header().cookie;
+	utils::time_point now = utils::clock::now();
+
+	auto [iter, inserted] =
+		callData_.insert({ cookie, { std::move(completion), now, now + timeout_ } });
+	if (!inserted) {
+		LOG(IPCPipe, Error) << "Call " << cookie << " already pending";
+		return -EBUSY;
+	}
+
+	int ret = sendAsync(in);
+	if (ret) {
+		callData_.erase(iter);
+		return ret;
+	}
+
+	armTimer();
+
+	return 0;
+}
 
 /**
  * \fn IPCPipe::sendAsync()
@@ -212,6 +340,144 @@ IPCPipe::~IPCPipe()
  * connect to this to receive messages.
  */
 
+/**
+ * \fn IPCPipe::setTimeout()
+ * \brief Set the timeout for calls
+ * \param[in] timeout The call timeout
+ *
+ * The timeout applies to calls issued after this function returns.
+ */
+
+/**
+ * \fn IPCPipe::timeout()
+ * \brief Retrieve the timeout for calls
+ * \return The call timeout
+ */
+
+/**
+ * \fn IPCPipe::latency()
+ * \brief Retrieve the histogram of the latencies of the completed calls
+ * \return The call latency histogram
+ */
+
+/**
+ * \fn IPCPipe::timeouts()
+ * \brief Retrieve the number of calls that timed out
+ * \return The number of calls that timed out
+ */
+
+/**
+ * \brief Handle a message received over IPC
+ * \param[in] payload The received payload
+ *
+ * Implementations of the IPCPipe class shall call this function for every
+ * payload they receive. If the payload is the reply to a pending call, the
+ * call is completed. Late replies to the most recent calls that have timed out
+ * are dropped. Other messages are emitted through the recv signal.
+ */
+void IPCPipe::handleMessage(IPCUnixSocket::Payload &payload)
+{
+	if (payload.data.size() < sizeof(IPCMessage::Header)) {
+		LOG(IPCPipe, Error) << "Not enough data received";
+		return;
+	}
+
+	IPCMessage message(payload);
+
+	auto iter = callData_.find(message.header().cookie);
+	if (iter == callData_.end()) {
+		auto expired = std::find(expiredCalls_.begin(), expiredCalls_.end(),
+					 message.header().cookie);
+		if (expired != expiredCalls_.end()) {
+			expiredCalls_.erase(expired);
+			LOG(IPCPipe, Warning)
+				<< "Dropping late reply to call "
+				<< message.header().cookie;
+			return;
+		}
+
+		/* Received unexpected data, this means it's a call from the IPA. */
+		recv.emit(message);
+		return;
+	}
+
+	CallData call = std::move(iter->second);
+	callData_.erase(iter);
+	armTimer();
+
+	complete(call, 0, message);
+}
+
+void IPCPipe::complete(CallData &call, int ret, IPCMessage &out)
+{
+	if (ret == -ETIMEDOUT) {
+		timeouts_++;
+	} else {
+		std::chrono::microseconds latency =
+			std::chrono::duration_cast<std::chrono::microseconds>(utils::clock::now() - call.start);
+
+		unsigned int bucket = 0;
+		while (bucket < latency_.size() - 1 && latency.count() >= (1 << bucket))
+			bucket++;
+
+		latency_[bucket]++;
+	}
+
+	call.completion(ret, out);
+}
+
+void IPCPipe::armTimer()
+{
+	if (callData_.empty()) {
+		timer_.stop();
+		return;
+	}
+
+	auto earliest = std::min_element(callData_.begin(), callData_.end(),
+					  [](const auto &a, const auto &b) {
+						  return a.second.deadline < b.second.deadline;
+					  });
+
+	if (!timer_.isRunning() || timer_.deadline() != earliest->second.deadline)
+		timer_.start(earliest->second.deadline);
+}
+
+void IPCPipe::expireCalls()
+{
+	utils::time_point now = utils::clock::now();
+	std::vector<CallData> expired;
+
+	for (auto iter = callData_.begin(); iter != callData_.end();) {
+		if (iter->second.deadline > now) {
+			++iter;
+			continue;
+		}
+
+		LOG(IPCPipe, Error) << "Call " << iter->first << " timeout!";
+
+		/*
+		 * Remember the cookie to drop the late reply. A peer that
+		 * never replies must not make the list grow without bound,
+		 * only keep the most recent calls.
+		 */
+		if (expiredCalls_.size() == kMaxExpiredCalls)
+			expiredCalls_.pop_front();
+		expiredCalls_.push_back(iter->first);
+		expired.push_back(std::move(iter->second));
+		iter = callData_.erase(iter);
+	}
+
+	armTimer();
+
+	/*
+	 * Complete the calls after updating the pending calls, as the
+	 * completion functions may issue new calls.
+	 */
+	IPCMessage empty;
+	for (CallData &call : expired)
+		complete(call, -ETIMEDOUT, empty);
+}
+
 /**
  * \var IPCPipe::connected_
  * \brief Flag to indicate if the IPCPipe instance is connected
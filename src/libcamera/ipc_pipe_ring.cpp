@@ -0,0 +1,87 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Image Processing Algorithm IPC module using shared memory ring buffers
+ */
+
+#include "libcamera/internal/ipc_pipe_ring.h"
+
+#include <string>
+#include <vector>
+
+#include <libcamera/base/log.h>
+
+#include "libcamera/internal/ipc_pipe.h"
+#include "libcamera/internal/ipc_ring.h"
+#include "libcamera/internal/process.h"
+
+namespace libcamera {
+
+LOG_DECLARE_CATEGORY(IPCPipe)
+
+IPCPipeRing::IPCPipeRing(const char *ipaModulePath,
+			 const char *ipaProxyWorkerPath)
+	: IPCPipe()
+{
+	std::vector<int> fds;
+	std::vector<std::string> args;
+	args.push_back(ipaModulePath);
+
+	ring_ = std::make_unique<IPCRing>();
+	IPCRing::Handle handle = ring_->create();
+	if (!handle.socket.isValid()) {
+		LOG(IPCPipe, Error) << "Failed to create IPC ring";
+		return;
+	}
+	ring_->readyRead.connect(this, &IPCPipeRing::readyRead);
+
+	/*
+	 * The proxy worker receives the socket first, as for the
+	 * IPCPipeUnixSocket, followed by the ring file descriptors.
+	 */
+	for (const UniqueFD *fd : { &handle.socket, &handle.memory,
+				    &handle.rxDoorbell, &handle.txDoorbell }) {
+		args.push_back(std::to_string(fd->get()));
+		fds.push_back(fd->get());
+	}
+
+	proc_ = std::make_unique<Process>();
+	int ret = proc_->start(ipaProxyWorkerPath, args, fds);
+	if (ret) {
+		LOG(IPCPipe, Error)
+			<< "Failed to start proxy worker process";
+		return;
+	}
+
+	connected_ = true;
+}
+
+IPCPipeRing::~IPCPipeRing()
+{
+}
+
+int IPCPipeRing::sendAsync(const IPCMessage &data)
+{
+	int ret = ring_->send(data.payload());
+	if (ret) {
+		LOG(IPCPipe, Error) << "Failed to call async";
+		return ret;
+	}
+
+	return 0;
+}
+
+void IPCPipeRing::readyRead()
+{
+	/* Reuse the payload buffers across messages. */
+	int ret = ring_->receive(&payload_);
+	if (ret) {
+		LOG(IPCPipe, Error) << "Receive message failed" << ret;
+		return;
+	}
+
+	handleMessage(payload_);
+}
+
+} /* namespace libcamera */
@@ -9,17 +9,12 @@
 
 #include <vector>
 
-#include <libcamera/base/event_dispatcher.h>
 #include <libcamera/base/log.h>
-#include <libcamera/base/thread.h>
-#include <libcamera/base/timer.h>
 
 #include "libcamera/internal/ipc_pipe.h"
 #include "libcamera/internal/ipc_unixsocket.h"
 #include "libcamera/internal/process.h"
 
-using namespace std::chrono_literals;
-
 namespace libcamera {
 
 LOG_DECLARE_CATEGORY(IPCPipe)
@@ -57,22 +52,6 @@ IPCPipeUnixSocket::~IPCPipeUnixSocket()
 {
 }
 
-int IPCPipeUnixSocket::sendSync(const IPCMessage &in, IPCMessage *out)
-{
-	IPCUnixSocket::Payload response;
-
-	int ret = call(in.payload(), &response, in.header().cookie);
-	if (ret) {
-		LOG(IPCPipe, Error) << "Failed to call sync";
-		return ret;
-	}
-
-	if (out)
-		*out = IPCMessage(response);
-
-	return 0;
-}
-
 int IPCPipeUnixSocket::sendAsync(const IPCMessage &data)
 {
 	int ret = socket_->send(data.payload());
@@ -93,55 +72,7 @@ void IPCPipeUnixSocket::readyRead()
 		return;
 	}
 
-	/* \todo Use span to avoid the double copy when callData is found. */
-	if (payload.data.size() < sizeof(IPCMessage::Header)) {
-		LOG(IPCPipe, Error) << "Not enough data received";
-		return;
-	}
-
-	IPCMessage ipcMessage(payload);
-
-	auto callData = callData_.find(ipcMessage.header().cookie);
-	if (callData != callData_.end()) {
-		*callData->second.response = std::move(payload);
-		callData->second.done = true;
-		return;
-	}
-
-	/* Received unexpected data, this means it's a call from the IPA. */
-	recv.emit(ipcMessage);
-}
-
-int IPCPipeUnixSocket::call(const IPCUnixSocket::Payload &message,
-			    IPCUnixSocket::Payload *response, uint32_t cookie)
-{
-	Timer timeout;
-	int ret;
-
-	const auto result = callData_.insert({ cookie, { response, false } });
-	const auto &iter = result.first;
-
-	ret = socket_->send(message);
-	if (ret) {
-		callData_.erase(iter);
-		return ret;
-	}
-
-	/* \todo Make this less dangerous, see IPCPipe::sendSync() */
-	timeout.start(2000ms);
-	while (!iter->second.done) {
-		if (!timeout.isRunning()) {
-			LOG(IPCPipe, Error) << "Call timeout!";
-			callData_.erase(iter);
-			return -ETIMEDOUT;
-		}
-
-		Thread::current()->eventDispatcher()->processEvents();
-	}
-
-	callData_.erase(iter);
-
-	return 0;
+	handleMessage(payload);
 }
 
 } /* namespace libcamera */
@@ -10,9 +10,13 @@
 #include <algorithm>
 #include <errno.h>
 #include <map>
+#include <string.h>
+#include <sys/ioctl.h>
 #include <sys/mman.h>
 #include <unistd.h>
 
+#include <linux/dma-buf.h>
+
 #include <libcamera/base/log.h>
 
 /**
@@ -176,8 +180,13 @@ MappedBuffer::~MappedBuffer()
  * Construct an object to map a frame buffer for CPU access. The mapping can be
  * made as Read only, Write only or support Read and Write operations by setting
  * the MapFlag flags accordingly.
+ *
+ * The mapping is kept until the object is destroyed. Users that access the same
+ * buffer repeatedly should use FrameBuffer::Private::map() instead, to avoid
+ * mapping and unmapping the buffer for every access.
  */
 MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
+	: flags_(flags)
 {
 	ASSERT(!buffer->planes().empty());
 	planes_.reserve(buffer->planes().size());
@@ -238,6 +247,77 @@ MappedFrameBuffer::MappedFrameBuffer(const FrameBuffer *buffer, MapFlags flags)
 
 		planes_.emplace_back(info.address + plane.offset, plane.length);
 	}
+
+	/*
+	 * Record the file descriptors to synchronize for CPU access. Those
+	 * that are not dmabufs, such as memfds, are dropped by the first
+	 * synchronization, which fails for them.
+	 */
+	for (const FrameBuffer::Plane &plane : buffer->planes()) {
+		if (std::find(dmabufs_.begin(), dmabufs_.end(), plane.fd) ==
+		    dmabufs_.end())
+			dmabufs_.push_back(plane.fd);
+	}
+}
+
+/**
+ * \fn MappedFrameBuffer::flags()
+ * \brief Retrieve the protection flags of the mapping
+ * \return The flags the buffer has been mapped with
+ */
+
+/**
+ * \brief Start CPU access to the mapped buffer
+ * \param[in] access The type of access
+ *
+ * Buffers backed by dmabufs may be mapped as cached memory, in which case the
+ * CPU caches need to be synchronized with the device. This function shall be
+ * called before accessing the buffer memory through the CPU, and each call
+ * shall be paired with a call to endAccess() with the same \a access flags
+ * once the CPU access completes.
+ *
+ * The beginAccess() and endAccess() functions shall not be called
+ * concurrently from multiple threads.
+ */
+void MappedFrameBuffer::beginAccess(MapFlags access) const
+{
+	sync(DMA_BUF_SYNC_START, access);
+}
+
+/**
+ * \brief End CPU access to the mapped buffer
+ * \param[in] access The type of access, as passed to beginAccess()
+ */
+void MappedFrameBuffer::endAccess(MapFlags access) const
+{
+	sync(DMA_BUF_SYNC_END, access);
+}
+
+void MappedFrameBuffer::sync(uint64_t step, MapFlags access) const
+{
+	struct dma_buf_sync sync = {};
+	sync.flags = step;
+
+	if (access & MapFlag::Read)
+		sync.flags |= DMA_BUF_SYNC_READ;
+	if (access & MapFlag::Write)
+		sync.flags |= DMA_BUF_SYNC_WRITE;
+
+	for (auto it = dmabufs_.begin(); it != dmabufs_.end();) {
+		if (ioctl(it->get(), DMA_BUF_IOCTL_SYNC, &sync) < 0) {
+			/* The file descriptor isn't a dmabuf, don't sync it again. */
+			if (errno == ENOTTY) {
+				it = dmabufs_.erase(it);
+				continue;
+			}
+
+			LOG(Buffer, Warning)
+				<< "Failed to synchronize dmabuf: "
+				<< strerror(errno);
+		}
+
+		++it;
+	}
 }
 
 } /* namespace libcamera */
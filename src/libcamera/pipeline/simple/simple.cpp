@@ -32,6 +32,7 @@
 #include "libcamera/internal/camera_sensor.h"
 #include "libcamera/internal/converter.h"
 #include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/formats.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/pipeline_handler.h"
 #include "libcamera/internal/software_isp/software_isp.h"
@@ -291,7 +292,7 @@ private:
 	void conversionInputDone(FrameBuffer *buffer);
 	void conversionOutputDone(FrameBuffer *buffer);
 
-	void ispStatsReady();
+	void ispStatsReady(uint32_t frame, uint32_t bufferId);
 	void setSensorControls(const ControlList &sensorControls);
 };
 
@@ -532,22 +533,13 @@ int SimpleCameraData::init()
 			LOG(SimplePipeline, Warning)
 				<< "Failed to create software ISP, disabling software debayering";
 			swIsp_.reset();
+			streams_.resize(1);
 		} else {
 			/*
-			 * The inputBufferReady signal is emitted from the soft ISP thread,
-			 * and needs to be handled in the pipeline handler thread. Signals
-			 * implement queued delivery, but this works transparently only if
-			 * the receiver is bound to the target thread. As the
-			 * SimpleCameraData class doesn't inherit from the Object class, it
-			 * is not bound to any thread, and the signal would be delivered
-			 * synchronously. Instead, connect the signal to a lambda function
-			 * bound explicitly to the pipe, which is bound to the pipeline
-			 * handler thread. The function then simply forwards the call to
-			 * conversionInputDone().
+			 * The soft ISP signals are emitted in the pipeline handler
+			 * thread, where the soft ISP has been created.
 			 */
-			swIsp_->inputBufferReady.connect(pipe, [this](FrameBuffer *buffer) {
-				this->conversionInputDone(buffer);
-			});
+			swIsp_->inputBufferReady.connect(this, &SimpleCameraData::conversionInputDone);
 			swIsp_->outputBufferReady.connect(this, &SimpleCameraData::conversionOutputDone);
 			swIsp_->ispStatsReady.connect(this, &SimpleCameraData::ispStatsReady);
 			swIsp_->setSensorControls.connect(this, &SimpleCameraData::setSensorControls);
@@ -864,7 +856,8 @@ void SimpleCameraData::bufferReady(FrameBuffer *buffer)
 		if (converter_)
 			converter_->queueBuffers(buffer, conversionQueue_.front());
 		else
-			swIsp_->queueBuffers(buffer, conversionQueue_.front());
+			swIsp_->queueBuffers(request->sequence(), buffer,
+					     conversionQueue_.front());
 
 		conversionQueue_.pop();
 		return;
@@ -891,10 +884,11 @@ void SimpleCameraData::conversionOutputDone(FrameBuffer *buffer)
 		pipe->completeRequest(request);
 }
 
-void SimpleCameraData::ispStatsReady()
+void SimpleCameraData::ispStatsReady(uint32_t frame, uint32_t bufferId)
 {
 	/* \todo Use the DelayedControls class */
-	swIsp_->processStats(sensor_->getControls({ V4L2_CID_ANALOGUE_GAIN,
+	swIsp_->processStats(frame, bufferId,
+			     sensor_->getControls({ V4L2_CID_ANALOGUE_GAIN,
 						    V4L2_CID_EXPOSURE }));
 }
 
@@ -977,6 +971,27 @@ static Size adjustSize(const Size &requestedSize, const SizeRange &supportedSize
 		.grownBy(supportedSizes.min);
 }
 
+static bool adjustBinnedStream(StreamConfiguration &cfg,
+			       const StreamConfiguration &fullCfg)
+{
+	/*
+	 * Bin by 4 when a size that small is requested and the full stream
+	 * size allows it, by 2 otherwise.
+	 */
+	unsigned int factor = 2;
+	if (cfg.size.width * 4 <= fullCfg.size.width &&
+	    fullCfg.size.width % 4 == 0 && fullCfg.size.height % 4 == 0)
+		factor = 4;
+
+	Size size(fullCfg.size.width / factor, fullCfg.size.height / factor);
+	bool adjusted = cfg.pixelFormat != fullCfg.pixelFormat || cfg.size != size;
+
+	cfg.pixelFormat = fullCfg.pixelFormat;
+	cfg.size = size;
+
+	return adjusted;
+}
+
 } /* namespace */
 
 CameraConfiguration::Status SimpleCameraConfiguration::validate()
@@ -1080,10 +1095,35 @@ CameraConfiguration::Status SimpleCameraConfiguration::validate()
 	for (unsigned int i = 0; i < config_.size(); ++i) {
 		StreamConfiguration &cfg = config_[i];
 
+		/*
+		 * The second stream of the Software ISP is binned from the
+		 * first one, in the same RGB format.
+		 */
+		if (i > 0 && data_->swIsp_) {
+			if (adjustBinnedStream(cfg, config_[0]))
+				status = Adjusted;
+
+			std::tie(cfg.stride, cfg.frameSize) =
+				data_->swIsp_->strideAndFrameSize(cfg.pixelFormat,
+								  cfg.size);
+			if (cfg.stride == 0)
+				return Invalid;
+
+			cfg.bufferCount = 3;
+			continue;
+		}
+
 		/* Adjust the pixel format and size. */
 		auto it = std::find(pipeConfig_->outputFormats.begin(),
 				    pipeConfig_->outputFormats.end(),
 				    cfg.pixelFormat);
+
+		/* Binning is only supported by the Software ISP in RGB formats. */
+		if (it != pipeConfig_->outputFormats.end() && config_.size() > 1 &&
+		    data_->swIsp_ &&
+		    PixelFormatInfo::info(*it).colourEncoding != PixelFormatInfo::ColourEncodingRGB)
+			it = pipeConfig_->outputFormats.end();
+
 		if (it == pipeConfig_->outputFormats.end())
 			it = pipeConfig_->outputFormats.begin();
 
@@ -1544,6 +1584,10 @@ bool SimplePipelineHandler::match(DeviceEnumerator *enumerator)
 
 	swIspEnabled_ = info->swIspEnabled;
 
+	/* The Software ISP can produce a full and a binned stream. */
+	if (!converter_ && swIspEnabled_)
+		numStreams = SoftwareIsp::kMaxStreams;
+
 	/* Locate the sensors. */
 	std::vector<MediaEntity *> sensors = locateSensors();
 	if (sensors.empty()) {
@@ -6,9 +6,11 @@
  */
 
 #include <algorithm>
+#include <errno.h>
 #include <iomanip>
 #include <map>
 #include <math.h>
+#include <string.h>
 #include <tuple>
 
 #include <linux/media-bus-format.h>
@@ -47,7 +49,7 @@ class VimcCameraData : public Camera::Private
 {
 public:
 	VimcCameraData(PipelineHandler *pipe, MediaDevice *media)
-		: Camera::Private(pipe), media_(media)
+		: Camera::Private(pipe), media_(media), ipaConfigureStatus_(0)
 	{
 	}
 
@@ -66,6 +68,7 @@ public:
 
 	std::unique_ptr<ipa::vimc::IPAProxyVimc> ipa_;
 	std::vector<std::unique_ptr<FrameBuffer>> mockIPABufs_;
+	int ipaConfigureStatus_;
 };
 
 class VimcCameraConfiguration : public CameraConfiguration
@@ -333,7 +336,22 @@ int PipelineHandlerVimc::configure(Camera *camera, CameraConfiguration *config)
 		IPACameraSensorInfo sensorInfo;
 		data->sensor_->sensorInfo(&sensorInfo);
 
-		data->ipa_->configure(sensorInfo, streamConfig, entityControls);
+		/*
+		 * Configure the IPA asynchronously, the result is checked when
+		 * the camera is started. Replies from the IPA are delivered in
+		 * order, so the completion has run by the time start() returns.
+		 */
+		data->ipaConfigureStatus_ = -EINPROGRESS;
+		data->ipa_->configureAsync(sensorInfo, streamConfig, entityControls,
+					   [data](int status, int32_t result) {
+						   if (status >= 0)
+							   status = result;
+						   if (status < 0)
+							   LOG(VIMC, Error)
+								   << "Failed to configure IPA: "
+								   << strerror(-status);
+						   data->ipaConfigureStatus_ = status;
+					   });
 	}
 
 	return 0;
@@ -371,6 +389,13 @@ int PipelineHandlerVimc::start(Camera *camera, [[maybe_unused]] const ControlLis
 		return ret;
 	}
 
+	if (data->ipaConfigureStatus_ < 0) {
+		ret = data->ipaConfigureStatus_;
+		data->ipa_->stop();
+		data->video_->releaseBuffers();
+		return ret;
+	}
+
 	ret = data->video_->streamOn();
 	if (ret < 0) {
 		data->ipa_->stop();
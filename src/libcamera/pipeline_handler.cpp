@@ -25,6 +25,7 @@
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/request.h"
+#include "libcamera/internal/trace.h"
 #include "libcamera/internal/tracepoints.h"
 
 /**
@@ -47,6 +48,14 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(Pipeline)
 
+namespace {
+
+const TraceEvent traceRequest("request", "request", "request", "cookie");
+const TraceEvent traceRequestDeviceQueue("request", "device_queue", "request",
+					 "sequence");
+
+} /* namespace */
+
 /**
  * \class PipelineHandler
  * \brief Create and manage cameras based on a set of media devices
@@ -413,6 +422,8 @@ void PipelineHandler::registerRequest(Request *request)
 void PipelineHandler::queueRequest(Request *request)
 {
 	LIBCAMERA_TRACEPOINT(request_queue, request);
+	traceRequest.asyncBegin(reinterpret_cast<uintptr_t>(request),
+				request->cookie());
 
 	waitingRequests_.push(request);
 
@@ -432,6 +443,9 @@ void PipelineHandler::doQueueRequest(Request *request)
 
 	request->_d()->sequence_ = data->requestSequence_++;
 
+	traceRequestDeviceQueue.instant(reinterpret_cast<uintptr_t>(request),
+					request->sequence());
+
 	if (request->_d()->cancelled_) {
 		completeRequest(request);
 		return;
@@ -21,6 +21,7 @@
 #include "libcamera/internal/camera.h"
 #include "libcamera/internal/camera_controls.h"
 #include "libcamera/internal/framebuffer.h"
+#include "libcamera/internal/trace.h"
 #include "libcamera/internal/tracepoints.h"
 
 /**
@@ -38,6 +39,14 @@ namespace libcamera {
 
 LOG_DEFINE_CATEGORY(Request)
 
+namespace {
+
+const TraceEvent traceRequest("request", "request", "request", "cookie");
+const TraceEvent traceRequestCompleteBuffer("request", "complete_buffer",
+					    "request", "buffer");
+
+} /* namespace */
+
 #ifndef __DOXYGEN_PUBLIC__
 /**
  * \class Request::Private
@@ -98,6 +107,8 @@ bool Request::Private::hasPendingBuffers() const
 bool Request::Private::completeBuffer(FrameBuffer *buffer)
 {
 	LIBCAMERA_TRACEPOINT(request_complete_buffer, this, buffer);
+	traceRequestCompleteBuffer.instant(reinterpret_cast<uintptr_t>(_o<Request>()),
+					   reinterpret_cast<uintptr_t>(buffer));
 
 	int ret = pending_.erase(buffer);
 	ASSERT(ret == 1);
@@ -129,6 +140,8 @@ void Request::Private::complete()
 	LOG(Request, Debug) << request->toString();
 
 	LIBCAMERA_TRACEPOINT(request_complete, this);
+	traceRequest.asyncEnd(reinterpret_cast<uintptr_t>(request),
+			      request->cookie());
 }
 
 void Request::Private::doCancelRequest()
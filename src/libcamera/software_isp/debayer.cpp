@@ -23,24 +23,105 @@ namespace libcamera {
  * \brief Size of a color lookup table
  */
 
+/**
+ * \var DebayerParams::kGammaLookupSize
+ * \brief Size of the gamma lookup table
+ */
+
+/**
+ * \struct DebayerParams::CcmColumn
+ * \brief Contribution of an input color value to the output colors
+ *
+ * The values are expressed as indices in the gamma lookup table and may be
+ * negative.
+ *
+ * \var DebayerParams::CcmColumn::r
+ * \brief Contribution to the red output
+ *
+ * \var DebayerParams::CcmColumn::g
+ * \brief Contribution to the green output
+ *
+ * \var DebayerParams::CcmColumn::b
+ * \brief Contribution to the blue output
+ */
+
 /**
  * \typedef DebayerParams::ColorLookupTable
  * \brief Type of the lookup tables for red, green, blue values
  */
 
+/**
+ * \typedef DebayerParams::CcmLookupTable
+ * \brief Type of the color correction lookup tables for red, green, blue values
+ */
+
+/**
+ * \typedef DebayerParams::GammaLookupTable
+ * \brief Type of the gamma lookup table
+ */
+
 /**
  * \var DebayerParams::red
  * \brief Lookup table for red color, mapping input values to output values
+ *
+ * Only used when the color correction matrix is disabled.
  */
 
 /**
  * \var DebayerParams::green
  * \brief Lookup table for green color, mapping input values to output values
+ *
+ * Only used when the color correction matrix is disabled.
  */
 
 /**
  * \var DebayerParams::blue
  * \brief Lookup table for blue color, mapping input values to output values
+ *
+ * Only used when the color correction matrix is disabled.
+ */
+
+/**
+ * \var DebayerParams::redCcm
+ * \brief Color correction lookup table for the red input
+ *
+ * The table maps red input values to their contribution to the red, green and
+ * blue outputs, combining the white balance gain, the black level and the
+ * first column of the color correction matrix. Only used when the color
+ * correction matrix is enabled.
+ */
+
+/**
+ * \var DebayerParams::greenCcm
+ * \brief Color correction lookup table for the green input
+ *
+ * \sa DebayerParams::redCcm
+ */
+
+/**
+ * \var DebayerParams::blueCcm
+ * \brief Color correction lookup table for the blue input
+ *
+ * \sa DebayerParams::redCcm
+ */
+
+/**
+ * \var DebayerParams::gammaLut
+ * \brief Gamma lookup table applied to the color corrected values
+ *
+ * The sum of the contributions of the red, green and blue inputs to an output
+ * color, clamped to the table size, is looked up in this table to produce the
+ * output value. Only used when the color correction matrix is enabled.
+ */
+
+/**
+ * \var kDebayerParamsBufferCount
+ * \brief Number of DebayerParams buffers shared between the Software ISP and IPA
+ *
+ * The parameters are stored in per-frame buffers, indexed by frame number,
+ * allowing the IPA to fill the parameters of a frame while the Software ISP
+ * processes the previous frames. The number of buffers must be larger than the
+ * number of frames being processed concurrently.
  */
 
 /**
@@ -57,10 +138,15 @@ Debayer::~Debayer()
 }
 
 /**
- * \fn int Debayer::configure(const StreamConfiguration &inputCfg, const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs)
+ * \fn int Debayer::configure(const StreamConfiguration &inputCfg, const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs, bool ccmEnabled)
  * \brief Configure the debayer object according to the passed in parameters.
  * \param[in] inputCfg The input configuration.
  * \param[in] outputCfgs The output configurations.
+ * \param[in] ccmEnabled Whether a color correction matrix is applied.
+ *
+ * An output smaller than the input is cropped from the centre of the input.
+ * When two outputs are configured, the second output is binned from the first
+ * one, with a binning factor of 2 or 4.
  *
  * \return 0 on success, a negative errno on failure.
  */
@@ -94,14 +180,20 @@ Debayer::~Debayer()
  */
 
 /**
- * \fn void Debayer::process(FrameBuffer *input, FrameBuffer *output, DebayerParams params)
+ * \fn void Debayer::process(uint32_t frame, FrameBuffer *input, const std::vector<FrameBuffer *> &outputs, const DebayerParams *params)
  * \brief Process the bayer data into the requested format.
+ * \param[in] frame The frame number.
  * \param[in] input The input buffer.
- * \param[in] output The output buffer.
+ * \param[in] outputs The output buffers, ordered as the configured outputs.
  * \param[in] params The parameters to be used in debayering.
  *
- * \note DebayerParams is passed by value deliberately so that a copy is passed
- * when this is run in another thread by invokeMethod().
+ * All the outputs are produced in a single pass over the input. An output
+ * buffer may be null, in which case the corresponding output is not produced.
+ *
+ * The parameters are stored in a per-frame buffer that must not be modified
+ * until the inputBufferReady signal is emitted for the frame. The signal is
+ * emitted for every processed frame, after the outputBufferReady signals, even
+ * if processing fails.
  */
 
 /**
@@ -11,17 +11,37 @@
 
 #include "debayer_cpu.h"
 
+#include <algorithm>
 #include <stdlib.h>
+#include <string.h>
+#include <thread>
 #include <time.h>
 
+#include <libcamera/base/utils.h>
+
 #include <libcamera/formats.h>
 
 #include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/formats.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
+#include "libcamera/internal/trace.h"
+
+#if defined(__ARM_NEON)
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(__i386__)
+#include <smmintrin.h>
+#endif
 
 namespace libcamera {
 
+namespace {
+
+const TraceEvent traceDebayer("isp", "debayer", "frame");
+const TraceEvent traceDebayerStripe("isp", "debayer_stripe", "stripe");
+
+} /* namespace */
+
 /**
  * \class DebayerCpu
  * \brief Class for debayering on the CPU
@@ -40,35 +60,172 @@ DebayerCpu::DebayerCpu(std::unique_ptr<SwStatsCpu> stats)
 	 * Reading from uncached buffers may be very slow.
 	 * In such a case, it's better to copy input buffer data to normal memory.
 	 * But in case of cached buffers, copying the data is unnecessary overhead.
-	 * enable_input_memcpy_ makes this behavior configurable.  At the moment, we
-	 * always set it to true as the safer choice but this should be changed in
-	 * future.
+	 * Copying is the safer choice and is enabled by default. It can be
+	 * disabled through the LIBCAMERA_SOFTISP_NO_INPUT_COPY environment
+	 * variable when the input buffers are known to be cached, the CPU
+	 * access being then synchronized with DMA_BUF_IOCTL_SYNC.
 	 */
-	enableInputMemcpy_ = true;
+	enableInputMemcpy_ = !utils::secure_getenv("LIBCAMERA_SOFTISP_NO_INPUT_COPY");
 
 	/* Initialize color lookup tables */
 	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++)
 		red_[i] = green_[i] = blue_[i] = i;
+	ccmEnabled_ = false;
+	binning_ = 1;
+
+	/*
+	 * Frames are split in horizontal stripes debayered concurrently, one
+	 * per thread. Default to one thread per CPU core, the number can be
+	 * overridden through the LIBCAMERA_SOFTISP_THREADS environment
+	 * variable.
+	 */
+	threadCount_ = std::thread::hardware_concurrency();
+
+	const char *threads = utils::secure_getenv("LIBCAMERA_SOFTISP_THREADS");
+	if (threads)
+		threadCount_ = strtoul(threads, nullptr, 10);
+
+	threadCount_ = std::clamp(threadCount_, 1U, kMaxThreads);
+
+	/*
+	 * Use the SIMD implementation of the unpacked formats when supported
+	 * by the CPU. It can be disabled through the
+	 * LIBCAMERA_SOFTISP_NO_SIMD environment variable, to compare against
+	 * the reference scalar implementation.
+	 */
+#if defined(__ARM_NEON)
+	enableSimd_ = true;
+#elif defined(__x86_64__) || defined(__i386__)
+	enableSimd_ = __builtin_cpu_supports("sse4.1");
+#else
+	enableSimd_ = false;
+#endif
+
+	if (utils::secure_getenv("LIBCAMERA_SOFTISP_NO_SIMD"))
+		enableSimd_ = false;
+}
+
+DebayerCpu::~DebayerCpu()
+{
+	/* Stop the workers before the stripes they reference go away */
+	stripeWorkers_.clear();
 }
 
-DebayerCpu::~DebayerCpu() = default;
+/**
+ * \class DebayerCpu::StripeWorker
+ * \brief Debayer one stripe of each frame in an internal thread
+ *
+ * The DebayerCpu processes the first stripe of a frame in the calling thread
+ * and hands the other stripes to one StripeWorker each. A worker sleeps until
+ * queue() is called, processes its stripe of the current frame and goes back
+ * to sleep. waitIdle() blocks until the queued stripe has been processed.
+ */
+DebayerCpu::StripeWorker::StripeWorker(DebayerCpu *debayer, unsigned int stripe)
+	: debayer_(debayer), stripe_(stripe), running_(false), pending_(false)
+{
+}
+
+DebayerCpu::StripeWorker::~StripeWorker()
+{
+	{
+		MutexLocker locker(mutex_);
+		running_ = false;
+	}
+
+	cv_.notify_all();
+	wait();
+}
+
+void DebayerCpu::StripeWorker::start()
+{
+	{
+		MutexLocker locker(mutex_);
+		running_ = true;
+	}
+
+	Thread::start();
+}
+
+void DebayerCpu::StripeWorker::queue()
+{
+	{
+		MutexLocker locker(mutex_);
+		pending_ = true;
+	}
+
+	cv_.notify_all();
+}
+
+void DebayerCpu::StripeWorker::waitIdle()
+{
+	MutexLocker locker(mutex_);
+
+	cv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+		return !pending_;
+	});
+}
+
+void DebayerCpu::StripeWorker::run()
+{
+	MutexLocker locker(mutex_);
+
+	while (1) {
+		cv_.wait(locker, [&]() LIBCAMERA_TSA_REQUIRES(mutex_) {
+			return !running_ || pending_;
+		});
+
+		if (!running_)
+			break;
+
+		locker.unlock();
+		debayer_->processStripe(stripe_);
+		locker.lock();
+
+		pending_ = false;
+		cv_.notify_all();
+	}
+}
 
 #define DECLARE_SRC_POINTERS(pixel_t)                            \
 	const pixel_t *prev = (const pixel_t *)src[0] + xShift_; \
 	const pixel_t *curr = (const pixel_t *)src[1] + xShift_; \
 	const pixel_t *next = (const pixel_t *)src[2] + xShift_;
 
+/*
+ * Store a pixel from the interpolated blue, green and red values. Without CCM
+ * the values are looked up in the per-channel gain and gamma tables. With CCM
+ * the per-channel CCM tables give the contribution of each input channel to
+ * the three output channels, in fixed point gamma table indices, and the sums
+ * are looked up in the gamma table.
+ */
+#define STORE_PIXEL(b_, g_, r_)                                            \
+	if constexpr (ccmEnabled) {                                        \
+		const DebayerParams::CcmColumn &blue = blueCcm_[b_];       \
+		const DebayerParams::CcmColumn &green = greenCcm_[g_];     \
+		const DebayerParams::CcmColumn &red = redCcm_[r_];         \
+		int ccmB = blue.b + green.b + red.b;                       \
+		int ccmG = blue.g + green.g + red.g;                       \
+		int ccmR = blue.r + green.r + red.r;                       \
+		*dst++ = gammaLut_[std::clamp(ccmB, 0, kGammaLastIndex)];  \
+		*dst++ = gammaLut_[std::clamp(ccmG, 0, kGammaLastIndex)];  \
+		*dst++ = gammaLut_[std::clamp(ccmR, 0, kGammaLastIndex)];  \
+	} else {                                                           \
+		*dst++ = blue_[b_];                                        \
+		*dst++ = green_[g_];                                       \
+		*dst++ = red_[r_];                                         \
+	}                                                                  \
+	if constexpr (addAlphaByte)                                        \
+		*dst++ = 255;
+
 /*
  * RGR
  * GBG
  * RGR
  */
-#define BGGR_BGR888(p, n, div)                                                                \
-	*dst++ = blue_[curr[x] / (div)];                                                      \
-	*dst++ = green_[(prev[x] + curr[x - p] + curr[x + n] + next[x]) / (4 * (div))];       \
-	*dst++ = red_[(prev[x - p] + prev[x + n] + next[x - p] + next[x + n]) / (4 * (div))]; \
-	if constexpr (addAlphaByte)                                                           \
-		*dst++ = 255;                                                                 \
+#define BGGR_BGR888(p, n, div)                                                         \
+	STORE_PIXEL(curr[x] / (div),                                                   \
+		    (prev[x] + curr[x - p] + curr[x + n] + next[x]) / (4 * (div)),     \
+		    (prev[x - p] + prev[x + n] + next[x - p] + next[x + n]) / (4 * (div))) \
 	x++;
 
 /*
@@ -76,12 +233,10 @@ DebayerCpu::~DebayerCpu() = default;
  * RGR
  * GBG
  */
-#define GRBG_BGR888(p, n, div)                                    \
-	*dst++ = blue_[(prev[x] + next[x]) / (2 * (div))];        \
-	*dst++ = green_[curr[x] / (div)];                         \
-	*dst++ = red_[(curr[x - p] + curr[x + n]) / (2 * (div))]; \
-	if constexpr (addAlphaByte)                               \
-		*dst++ = 255;                                     \
+#define GRBG_BGR888(p, n, div)                                 \
+	STORE_PIXEL((prev[x] + next[x]) / (2 * (div)),         \
+		    curr[x] / (div),                           \
+		    (curr[x - p] + curr[x + n]) / (2 * (div))) \
 	x++;
 
 /*
@@ -89,12 +244,10 @@ DebayerCpu::~DebayerCpu() = default;
  * BGB
  * GRG
  */
-#define GBRG_BGR888(p, n, div)                                     \
-	*dst++ = blue_[(curr[x - p] + curr[x + n]) / (2 * (div))]; \
-	*dst++ = green_[curr[x] / (div)];                          \
-	*dst++ = red_[(prev[x] + next[x]) / (2 * (div))];          \
-	if constexpr (addAlphaByte)                                \
-		*dst++ = 255;                                      \
+#define GBRG_BGR888(p, n, div)                                 \
+	STORE_PIXEL((curr[x - p] + curr[x + n]) / (2 * (div)), \
+		    curr[x] / (div),                           \
+		    (prev[x] + next[x]) / (2 * (div)))         \
 	x++;
 
 /*
@@ -102,15 +255,13 @@ DebayerCpu::~DebayerCpu() = default;
  * GRG
  * BGB
  */
-#define RGGB_BGR888(p, n, div)                                                                 \
-	*dst++ = blue_[(prev[x - p] + prev[x + n] + next[x - p] + next[x + n]) / (4 * (div))]; \
-	*dst++ = green_[(prev[x] + curr[x - p] + curr[x + n] + next[x]) / (4 * (div))];        \
-	*dst++ = red_[curr[x] / (div)];                                                        \
-	if constexpr (addAlphaByte)                                                            \
-		*dst++ = 255;                                                                  \
+#define RGGB_BGR888(p, n, div)                                                              \
+	STORE_PIXEL((prev[x - p] + prev[x + n] + next[x - p] + next[x + n]) / (4 * (div)), \
+		    (prev[x] + curr[x - p] + curr[x + n] + next[x]) / (4 * (div)),          \
+		    curr[x] / (div))                                                        \
 	x++;
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer8_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint8_t)
@@ -121,7 +272,7 @@ void DebayerCpu::debayer8_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer8_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint8_t)
@@ -132,7 +283,7 @@ void DebayerCpu::debayer8_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
@@ -144,7 +295,7 @@ void DebayerCpu::debayer10_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
@@ -156,7 +307,7 @@ void DebayerCpu::debayer10_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer12_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
@@ -168,7 +319,7 @@ void DebayerCpu::debayer12_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer12_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	DECLARE_SRC_POINTERS(uint16_t)
@@ -180,7 +331,7 @@ void DebayerCpu::debayer12_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10P_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	const int widthInBytes = window_.width * 5 / 4;
@@ -206,7 +357,7 @@ void DebayerCpu::debayer10P_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10P_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	const int widthInBytes = window_.width * 5 / 4;
@@ -227,7 +378,7 @@ void DebayerCpu::debayer10P_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	const int widthInBytes = window_.width * 5 / 4;
@@ -248,7 +399,7 @@ void DebayerCpu::debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
-template<bool addAlphaByte>
+template<bool addAlphaByte, bool ccmEnabled>
 void DebayerCpu::debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[])
 {
 	const int widthInBytes = window_.width * 5 / 4;
@@ -269,6 +420,309 @@ void DebayerCpu::debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[])
 	}
 }
 
+namespace {
+
+/*
+ * SIMD implementation of the interpolation of unpacked Bayer data.
+ *
+ * For every pixel of a line the vectorized code computes the same averages as
+ * the scalar BGGR_BGR888, GBRG_BGR888, GRBG_BGR888 and RGGB_BGR888 macros,
+ * 16 pixels at a time using 16-bit lanes. As the divisors are powers of 2 the
+ * integer divisions are shifts and the output is bit-exact with the scalar
+ * implementation.
+ *
+ * interpolate16() stores the interpolated values of 16 pixels to separate blue,
+ * green and red arrays. The lookups and the interleaving are left to the
+ * caller, which keeps its output pointer in a register. There is no SIMD
+ * gather of bytes on SSE4.1, the lookups are thus scalar on all architectures.
+ */
+
+constexpr unsigned int divShift(unsigned int div)
+{
+	return div > 1 ? 1 + divShift(div / 2) : 0;
+}
+
+#if defined(__ARM_NEON)
+
+inline uint16x8_t loadPixels(const uint8_t *src)
+{
+	return vmovl_u8(vld1_u8(src));
+}
+
+inline uint16x8_t loadPixels(const uint16_t *src)
+{
+	return vld1q_u16(src);
+}
+
+template<typename pixel_t, unsigned int div, bool grgrLine>
+inline void interpolate8(const pixel_t *prev, const pixel_t *curr,
+			 const pixel_t *next, uint16x8_t &b, uint16x8_t &g,
+			 uint16x8_t &r)
+{
+	static const uint16_t oddLanes[8] = { 0, 0xffff, 0, 0xffff, 0, 0xffff, 0, 0xffff };
+	const uint16x8_t odd = vld1q_u16(oddLanes);
+	const int16x8_t shift0 = vdupq_n_s16(-static_cast<int>(divShift(div)));
+	const int16x8_t shift1 = vdupq_n_s16(-static_cast<int>(divShift(div) + 1));
+	const int16x8_t shift2 = vdupq_n_s16(-static_cast<int>(divShift(div) + 2));
+
+	uint16x8_t h2 = vaddq_u16(loadPixels(curr - 1), loadPixels(curr + 1));
+	uint16x8_t v2 = vaddq_u16(loadPixels(prev), loadPixels(next));
+	uint16x8_t d4 = vaddq_u16(vaddq_u16(loadPixels(prev - 1), loadPixels(prev + 1)),
+				  vaddq_u16(loadPixels(next - 1), loadPixels(next + 1)));
+
+	uint16x8_t c = vshlq_u16(loadPixels(curr), shift0);
+	uint16x8_t cross = vshlq_u16(vaddq_u16(h2, v2), shift2);
+	uint16x8_t diag = vshlq_u16(d4, shift2);
+	uint16x8_t horiz = vshlq_u16(h2, shift1);
+	uint16x8_t vert = vshlq_u16(v2, shift1);
+
+	if constexpr (!grgrLine) {
+		/* Even pixels are BGGR, odd pixels GBRG */
+		b = vbslq_u16(odd, horiz, c);
+		g = vbslq_u16(odd, c, cross);
+		r = vbslq_u16(odd, vert, diag);
+	} else {
+		/* Even pixels are GRBG, odd pixels RGGB */
+		b = vbslq_u16(odd, diag, vert);
+		g = vbslq_u16(odd, cross, c);
+		r = vbslq_u16(odd, c, horiz);
+	}
+}
+
+template<typename pixel_t, unsigned int div, bool grgrLine>
+inline void interpolate16(const pixel_t *prev, const pixel_t *curr,
+			  const pixel_t *next, uint8_t *b, uint8_t *g, uint8_t *r)
+{
+	uint16x8_t b0, g0, r0, b1, g1, r1;
+
+	interpolate8<pixel_t, div, grgrLine>(prev, curr, next, b0, g0, r0);
+	interpolate8<pixel_t, div, grgrLine>(prev + 8, curr + 8, next + 8, b1, g1, r1);
+
+	vst1q_u8(b, vcombine_u8(vqmovn_u16(b0), vqmovn_u16(b1)));
+	vst1q_u8(g, vcombine_u8(vqmovn_u16(g0), vqmovn_u16(g1)));
+	vst1q_u8(r, vcombine_u8(vqmovn_u16(r0), vqmovn_u16(r1)));
+}
+
+#define DEBAYER_SIMD_TARGET
+#define DEBAYER_SIMD_AVAILABLE
+
+#elif defined(__x86_64__) || defined(__i386__)
+
+#define DEBAYER_SIMD_TARGET __attribute__((target("sse4.1")))
+#define DEBAYER_SIMD_AVAILABLE
+
+DEBAYER_SIMD_TARGET inline __m128i loadPixels(const uint8_t *src)
+{
+	return _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(src)));
+}
+
+DEBAYER_SIMD_TARGET inline __m128i loadPixels(const uint16_t *src)
+{
+	return _mm_loadu_si128(reinterpret_cast<const __m128i *>(src));
+}
+
+template<typename pixel_t, unsigned int div, bool grgrLine>
+DEBAYER_SIMD_TARGET inline void
+interpolate8(const pixel_t *prev, const pixel_t *curr, const pixel_t *next,
+	     __m128i &b, __m128i &g, __m128i &r)
+{
+	constexpr int shift = divShift(div);
+
+	__m128i h2 = _mm_add_epi16(loadPixels(curr - 1), loadPixels(curr + 1));
+	__m128i v2 = _mm_add_epi16(loadPixels(prev), loadPixels(next));
+	__m128i d4 = _mm_add_epi16(_mm_add_epi16(loadPixels(prev - 1), loadPixels(prev + 1)),
+				   _mm_add_epi16(loadPixels(next - 1), loadPixels(next + 1)));
+
+	__m128i c = _mm_srli_epi16(loadPixels(curr), shift);
+	__m128i cross = _mm_srli_epi16(_mm_add_epi16(h2, v2), shift + 2);
+	__m128i diag = _mm_srli_epi16(d4, shift + 2);
+	__m128i horiz = _mm_srli_epi16(h2, shift + 1);
+	__m128i vert = _mm_srli_epi16(v2, shift + 1);
+
+	/* 0xaa selects the odd lanes from the second operand */
+	if constexpr (!grgrLine) {
+		/* Even pixels are BGGR, odd pixels GBRG */
+		b = _mm_blend_epi16(c, horiz, 0xaa);
+		g = _mm_blend_epi16(cross, c, 0xaa);
+		r = _mm_blend_epi16(diag, vert, 0xaa);
+	} else {
+		/* Even pixels are GRBG, odd pixels RGGB */
+		b = _mm_blend_epi16(vert, diag, 0xaa);
+		g = _mm_blend_epi16(c, cross, 0xaa);
+		r = _mm_blend_epi16(horiz, c, 0xaa);
+	}
+}
+
+template<typename pixel_t, unsigned int div, bool grgrLine>
+DEBAYER_SIMD_TARGET inline void
+interpolate16(const pixel_t *prev, const pixel_t *curr, const pixel_t *next,
+	      uint8_t *b, uint8_t *g, uint8_t *r)
+{
+	__m128i b0, g0, r0, b1, g1, r1;
+
+	interpolate8<pixel_t, div, grgrLine>(prev, curr, next, b0, g0, r0);
+	interpolate8<pixel_t, div, grgrLine>(prev + 8, curr + 8, next + 8, b1, g1, r1);
+
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(b), _mm_packus_epi16(b0, b1));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(g), _mm_packus_epi16(g0, g1));
+	_mm_storeu_si128(reinterpret_cast<__m128i *>(r), _mm_packus_epi16(r0, r1));
+}
+
+#endif
+
+#ifdef DEBAYER_SIMD_AVAILABLE
+
+constexpr bool kSimdAvailable = true;
+
+#else
+
+#define DEBAYER_SIMD_TARGET
+
+constexpr bool kSimdAvailable = false;
+
+/* Never called, the SIMD functions are only selected when SIMD is available */
+template<typename pixel_t, unsigned int div, bool grgrLine>
+void interpolate16(const pixel_t *prev, const pixel_t *curr, const pixel_t *next,
+		   uint8_t *b, uint8_t *g, uint8_t *r);
+
+#endif /* DEBAYER_SIMD_AVAILABLE */
+
+} /* namespace */
+
+/*
+ * The SIMD functions are only selected when the CPU supports the SIMD target,
+ * compile them for that target to inline the interpolation helpers.
+ */
+template<typename pixel_t, unsigned int div, bool addAlphaByte, bool ccmEnabled>
+DEBAYER_SIMD_TARGET void DebayerCpu::debayerSimd_BGBG_BGR888(uint8_t *dst, const uint8_t *src[])
+{
+	DECLARE_SRC_POINTERS(pixel_t)
+
+	int x = 0;
+
+	if constexpr (kSimdAvailable) {
+		for (; x + 16 <= (int)window_.width; x += 16) {
+			uint8_t b[16], g[16], r[16];
+
+			interpolate16<pixel_t, div, false>(prev + x, curr + x,
+							    next + x, b, g, r);
+
+			for (unsigned int i = 0; i < 16; i++) {
+				STORE_PIXEL(b[i], g[i], r[i])
+			}
+		}
+	}
+
+	/* Process the remaining pixels with the scalar implementation */
+	for (; x < (int)window_.width;) {
+		BGGR_BGR888(1, 1, div)
+		GBRG_BGR888(1, 1, div)
+	}
+}
+
+template<typename pixel_t, unsigned int div, bool addAlphaByte, bool ccmEnabled>
+DEBAYER_SIMD_TARGET void DebayerCpu::debayerSimd_GRGR_BGR888(uint8_t *dst, const uint8_t *src[])
+{
+	DECLARE_SRC_POINTERS(pixel_t)
+
+	int x = 0;
+
+	if constexpr (kSimdAvailable) {
+		for (; x + 16 <= (int)window_.width; x += 16) {
+			uint8_t b[16], g[16], r[16];
+
+			interpolate16<pixel_t, div, true>(prev + x, curr + x,
+							   next + x, b, g, r);
+
+			for (unsigned int i = 0; i < 16; i++) {
+				STORE_PIXEL(b[i], g[i], r[i])
+			}
+		}
+	}
+
+	/* Process the remaining pixels with the scalar implementation */
+	for (; x < (int)window_.width;) {
+		GRBG_BGR888(1, 1, div)
+		RGGB_BGR888(1, 1, div)
+	}
+}
+
+namespace {
+
+template<typename pixel_t, bool csi2Packed>
+inline unsigned int bayerPixel(const uint8_t *line, unsigned int x)
+{
+	/* Only the 8 most significant bits of CSI-2 packed pixels are used */
+	if constexpr (csi2Packed)
+		return line[x / 4 * 5 + x % 4];
+	else
+		return reinterpret_cast<const pixel_t *>(line)[x];
+}
+
+} /* namespace */
+
+/*
+ * Superpixel binning: each output pixel is the average of the red, green and
+ * blue pixels of a block of factor x factor input pixels, without
+ * interpolation. The block is made of (factor / 2)^2 2x2 Bayer patterns, and
+ * is processed in factor / 2 line pairs.
+ */
+template<typename pixel_t, bool csi2Packed, unsigned int div, unsigned int factor,
+	 bool addAlphaByte, bool ccmEnabled>
+void DebayerCpu::binLinePair(uint8_t *dst, const uint8_t *src[], Stripe &stripe,
+			     unsigned int pair)
+{
+	constexpr unsigned int kPatterns = (factor / 2) * (factor / 2);
+	const uint8_t *redLine = src[binRedLine_];
+	const uint8_t *blueLine = src[1 - binRedLine_];
+	const unsigned int redX = binRedX_;
+	const unsigned int blueX = 1 - binRedX_;
+	const unsigned int width = window_.width / factor;
+	uint32_t *sums = stripe.binSums.data();
+
+	for (unsigned int i = 0, x = 0; i < width; i++) {
+		unsigned int r = 0, g = 0, b = 0;
+
+		for (unsigned int j = 0; j < factor / 2; j++, x += 2) {
+			r += bayerPixel<pixel_t, csi2Packed>(redLine, x + redX);
+			g += bayerPixel<pixel_t, csi2Packed>(redLine, x + blueX);
+			g += bayerPixel<pixel_t, csi2Packed>(blueLine, x + redX);
+			b += bayerPixel<pixel_t, csi2Packed>(blueLine, x + blueX);
+		}
+
+		if constexpr (factor > 2) {
+			if (pair == 0) {
+				*sums++ = r;
+				*sums++ = g;
+				*sums++ = b;
+				continue;
+			}
+
+			r += *sums++;
+			g += *sums++;
+			b += *sums++;
+		}
+
+		STORE_PIXEL(b / (kPatterns * div), g / (2 * kPatterns * div),
+			    r / (kPatterns * div))
+	}
+}
+
+template<typename pixel_t, bool csi2Packed, unsigned int div>
+DebayerCpu::binFn DebayerCpu::binFunction(bool addAlphaByte, bool ccmEnabled)
+{
+#define BIN_FUNCTION(factor)                                                                   \
+	(addAlphaByte                                                                           \
+		 ? (ccmEnabled ? &DebayerCpu::binLinePair<pixel_t, csi2Packed, div, factor, true, true>   \
+			       : &DebayerCpu::binLinePair<pixel_t, csi2Packed, div, factor, true, false>) \
+		 : (ccmEnabled ? &DebayerCpu::binLinePair<pixel_t, csi2Packed, div, factor, false, true>  \
+			       : &DebayerCpu::binLinePair<pixel_t, csi2Packed, div, factor, false, false>))
+
+	return binning_ == 4 ? BIN_FUNCTION(4) : BIN_FUNCTION(2);
+
+#undef BIN_FUNCTION
+}
+
 static bool isStandardBayerOrder(BayerFormat::Order order)
 {
 	return order == BayerFormat::BGGR || order == BayerFormat::GBRG ||
@@ -296,7 +750,9 @@ int DebayerCpu::getInputConfig(PixelFormat inputFormat, DebayerInputConfig &conf
 								  formats::ARGB8888,
 								  formats::BGR888,
 								  formats::XBGR8888,
-								  formats::ABGR8888 });
+								  formats::ABGR8888,
+								  formats::NV12,
+								  formats::YUYV });
 		return 0;
 	}
 
@@ -311,7 +767,9 @@ int DebayerCpu::getInputConfig(PixelFormat inputFormat, DebayerInputConfig &conf
 								  formats::ARGB8888,
 								  formats::BGR888,
 								  formats::XBGR8888,
-								  formats::ABGR8888 });
+								  formats::ABGR8888,
+								  formats::NV12,
+								  formats::YUYV });
 		return 0;
 	}
 
@@ -333,6 +791,17 @@ int DebayerCpu::getOutputConfig(PixelFormat outputFormat, DebayerOutputConfig &c
 		return 0;
 	}
 
+	/* Bits per pixel of the first plane for semi-planar formats */
+	if (outputFormat == formats::NV12) {
+		config.bpp = 8;
+		return 0;
+	}
+
+	if (outputFormat == formats::YUYV) {
+		config.bpp = 16;
+		return 0;
+	}
+
 	LOG(Debayer, Info)
 		<< "Unsupported output format " << outputFormat.toString();
 	return -EINVAL;
@@ -364,7 +833,82 @@ int DebayerCpu::setupStandardBayerOrder(BayerFormat::Order order)
 	return 0;
 }
 
-int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputFormat)
+/*
+ * Select the binning function and locate the red and blue pixels in the 2x2
+ * Bayer pattern. As the binned pixels are not interpolated, this doesn't
+ * require any shifting of the window.
+ */
+int DebayerCpu::setBinningFunction(const BayerFormat &bayerFormat, bool addAlphaByte,
+				   bool ccmEnabled)
+{
+	switch (bayerFormat.order) {
+	case BayerFormat::BGGR:
+		binRedX_ = 1;
+		binRedLine_ = 1;
+		break;
+	case BayerFormat::GBRG:
+		binRedX_ = 0;
+		binRedLine_ = 1;
+		break;
+	case BayerFormat::GRBG:
+		binRedX_ = 1;
+		binRedLine_ = 0;
+		break;
+	case BayerFormat::RGGB:
+		binRedX_ = 0;
+		binRedLine_ = 0;
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	if (bayerFormat.packing == BayerFormat::Packing::None) {
+		switch (bayerFormat.bitDepth) {
+		case 8:
+			bin_ = binFunction<uint8_t, false, 1>(addAlphaByte, ccmEnabled);
+			return 0;
+		case 10:
+			bin_ = binFunction<uint16_t, false, 4>(addAlphaByte, ccmEnabled);
+			return 0;
+		case 12:
+			bin_ = binFunction<uint16_t, false, 16>(addAlphaByte, ccmEnabled);
+			return 0;
+		default:
+			return -EINVAL;
+		}
+	}
+
+	if (bayerFormat.packing == BayerFormat::Packing::CSI2 &&
+	    bayerFormat.bitDepth == 10) {
+		bin_ = binFunction<uint8_t, true, 1>(addAlphaByte, ccmEnabled);
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+#define SET_DEBAYER_METHODS(method0, method1)                                                              \
+	debayer0_ = addAlphaByte                                                                           \
+			    ? (ccmEnabled ? &DebayerCpu::method0<true, true> : &DebayerCpu::method0<true, false>)   \
+			    : (ccmEnabled ? &DebayerCpu::method0<false, true> : &DebayerCpu::method0<false, false>); \
+	debayer1_ = addAlphaByte                                                                           \
+			    ? (ccmEnabled ? &DebayerCpu::method1<true, true> : &DebayerCpu::method1<true, false>)   \
+			    : (ccmEnabled ? &DebayerCpu::method1<false, true> : &DebayerCpu::method1<false, false>);
+
+#define SET_DEBAYER_SIMD_METHODS(pixel_t, div)                                                                                      \
+	debayer0_ = addAlphaByte                                                                                                    \
+			    ? (ccmEnabled ? &DebayerCpu::debayerSimd_BGBG_BGR888<pixel_t, div, true, true>                          \
+					  : &DebayerCpu::debayerSimd_BGBG_BGR888<pixel_t, div, true, false>)                        \
+			    : (ccmEnabled ? &DebayerCpu::debayerSimd_BGBG_BGR888<pixel_t, div, false, true>                         \
+					  : &DebayerCpu::debayerSimd_BGBG_BGR888<pixel_t, div, false, false>);                      \
+	debayer1_ = addAlphaByte                                                                                                    \
+			    ? (ccmEnabled ? &DebayerCpu::debayerSimd_GRGR_BGR888<pixel_t, div, true, true>                          \
+					  : &DebayerCpu::debayerSimd_GRGR_BGR888<pixel_t, div, true, false>)                        \
+			    : (ccmEnabled ? &DebayerCpu::debayerSimd_GRGR_BGR888<pixel_t, div, false, true>                         \
+					  : &DebayerCpu::debayerSimd_GRGR_BGR888<pixel_t, div, false, false>);
+
+int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputFormat,
+				    bool ccmEnabled)
 {
 	BayerFormat bayerFormat =
 		BayerFormat::fromPixelFormat(inputFormat);
@@ -372,6 +916,7 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 
 	xShift_ = 0;
 	swapRedBlueGains_ = false;
+	convert_ = nullptr;
 
 	auto invalidFmt = []() -> int {
 		LOG(Debayer, Error) << "Unsupported input output format combination";
@@ -385,6 +930,13 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 		[[fallthrough]];
 	case formats::RGB888:
 		break;
+	/* YUV formats are converted from RGB888 lines */
+	case formats::NV12:
+		convert_ = &DebayerCpu::convertNV12;
+		break;
+	case formats::YUYV:
+		convert_ = &DebayerCpu::convertYUYV;
+		break;
 	case formats::XBGR8888:
 	case formats::ABGR8888:
 		addAlphaByte = true;
@@ -414,23 +966,39 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 		return invalidFmt();
 	}
 
+	if (binning_ > 1 &&
+	    setBinningFunction(bayerFormat, addAlphaByte, ccmEnabled) != 0)
+		return invalidFmt();
+
 	if ((bayerFormat.bitDepth == 8 || bayerFormat.bitDepth == 10 || bayerFormat.bitDepth == 12) &&
 	    bayerFormat.packing == BayerFormat::Packing::None &&
 	    isStandardBayerOrder(bayerFormat.order)) {
 		switch (bayerFormat.bitDepth) {
 		case 8:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer8_BGBG_BGR888<true> : &DebayerCpu::debayer8_BGBG_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer8_GRGR_BGR888<true> : &DebayerCpu::debayer8_GRGR_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer8_BGBG_BGR888, debayer8_GRGR_BGR888)
 			break;
 		case 10:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer10_BGBG_BGR888<true> : &DebayerCpu::debayer10_BGBG_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer10_GRGR_BGR888<true> : &DebayerCpu::debayer10_GRGR_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer10_BGBG_BGR888, debayer10_GRGR_BGR888)
 			break;
 		case 12:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer12_BGBG_BGR888<true> : &DebayerCpu::debayer12_BGBG_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer12_GRGR_BGR888<true> : &DebayerCpu::debayer12_GRGR_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer12_BGBG_BGR888, debayer12_GRGR_BGR888)
 			break;
 		}
+
+		if (enableSimd_) {
+			switch (bayerFormat.bitDepth) {
+			case 8:
+				SET_DEBAYER_SIMD_METHODS(uint8_t, 1)
+				break;
+			case 10:
+				SET_DEBAYER_SIMD_METHODS(uint16_t, 4)
+				break;
+			case 12:
+				SET_DEBAYER_SIMD_METHODS(uint16_t, 16)
+				break;
+			}
+		}
+
 		setupStandardBayerOrder(bayerFormat.order);
 		return 0;
 	}
@@ -439,20 +1007,16 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 	    bayerFormat.packing == BayerFormat::Packing::CSI2) {
 		switch (bayerFormat.order) {
 		case BayerFormat::BGGR:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer10P_BGBG_BGR888<true> : &DebayerCpu::debayer10P_BGBG_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer10P_GRGR_BGR888<true> : &DebayerCpu::debayer10P_GRGR_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer10P_BGBG_BGR888, debayer10P_GRGR_BGR888)
 			return 0;
 		case BayerFormat::GBRG:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer10P_GBGB_BGR888<true> : &DebayerCpu::debayer10P_GBGB_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer10P_RGRG_BGR888<true> : &DebayerCpu::debayer10P_RGRG_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer10P_GBGB_BGR888, debayer10P_RGRG_BGR888)
 			return 0;
 		case BayerFormat::GRBG:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer10P_GRGR_BGR888<true> : &DebayerCpu::debayer10P_GRGR_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer10P_BGBG_BGR888<true> : &DebayerCpu::debayer10P_BGBG_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer10P_GRGR_BGR888, debayer10P_BGBG_BGR888)
 			return 0;
 		case BayerFormat::RGGB:
-			debayer0_ = addAlphaByte ? &DebayerCpu::debayer10P_RGRG_BGR888<true> : &DebayerCpu::debayer10P_RGRG_BGR888<false>;
-			debayer1_ = addAlphaByte ? &DebayerCpu::debayer10P_GBGB_BGR888<true> : &DebayerCpu::debayer10P_GBGB_BGR888<false>;
+			SET_DEBAYER_METHODS(debayer10P_RGRG_BGR888, debayer10P_GBGB_BGR888)
 			return 0;
 		default:
 			break;
@@ -463,7 +1027,8 @@ int DebayerCpu::setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputF
 }
 
 int DebayerCpu::configure(const StreamConfiguration &inputCfg,
-			  const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs)
+			  const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs,
+			  bool ccmEnabled)
 {
 	if (getInputConfig(inputCfg.pixelFormat, inputConfig_) != 0)
 		return -EINVAL;
@@ -482,7 +1047,7 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 
 	inputConfig_.stride = inputCfg.stride;
 
-	if (outputCfgs.size() != 1) {
+	if (outputCfgs.empty() || outputCfgs.size() > 2) {
 		LOG(Debayer, Error)
 			<< "Unsupported number of output streams: "
 			<< outputCfgs.size();
@@ -491,6 +1056,36 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 
 	const StreamConfiguration &outputCfg = outputCfgs[0];
 	SizeRange outSizeRange = sizes(inputCfg.pixelFormat, inputCfg.size);
+	bool yuvOutput = PixelFormatInfo::info(outputCfg.pixelFormat).colourEncoding ==
+			 PixelFormatInfo::ColourEncodingYUV;
+
+	/*
+	 * Binning is enabled explicitly by configuring a second output, binned
+	 * from the window of the first output in a single pass over the input.
+	 * Requests that only capture the second output then skip debayering at
+	 * full resolution. Binning is implemented for the RGB output formats
+	 * only.
+	 */
+	binning_ = 1;
+
+	if (outputCfgs.size() == 2) {
+		const StreamConfiguration &binnedCfg = outputCfgs[1];
+
+		for (unsigned int factor : { 2, 4 }) {
+			if (binnedCfg.size * factor == outputCfg.size)
+				binning_ = factor;
+		}
+
+		if (binning_ == 1 || yuvOutput ||
+		    binnedCfg.pixelFormat != outputCfg.pixelFormat ||
+		    inputConfig_.patternSize.height != 2) {
+			LOG(Debayer, Error)
+				<< "Unsupported binned output " << binnedCfg.toString()
+				<< " for output " << outputCfg.toString();
+			return -EINVAL;
+		}
+	}
+
 	std::tie(outputConfig_.stride, outputConfig_.frameSize) =
 		strideAndFrameSize(outputCfg.pixelFormat, outputCfg.size);
 
@@ -502,9 +1097,26 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 		return -EINVAL;
 	}
 
-	if (setDebayerFunctions(inputCfg.pixelFormat, outputCfg.pixelFormat) != 0)
+	if (binning_ > 1) {
+		const StreamConfiguration &binnedCfg = outputCfgs[1];
+
+		std::tie(binnedOutputConfig_.stride, binnedOutputConfig_.frameSize) =
+			strideAndFrameSize(binnedCfg.pixelFormat, binnedCfg.size);
+
+		if (binnedOutputConfig_.stride != binnedCfg.stride) {
+			LOG(Debayer, Error)
+				<< "Invalid binned output stride: "
+				<< binnedCfg.stride << " (" << binnedOutputConfig_.stride << ")";
+			return -EINVAL;
+		}
+	}
+
+	if (setDebayerFunctions(inputCfg.pixelFormat, outputCfg.pixelFormat,
+				ccmEnabled) != 0)
 		return -EINVAL;
 
+	ccmEnabled_ = ccmEnabled;
+
 	window_.x = ((inputCfg.size.width - outputCfg.size.width) / 2) &
 		    ~(inputConfig_.patternSize.width - 1);
 	window_.y = ((inputCfg.size.height - outputCfg.size.height) / 2) &
@@ -520,10 +1132,7 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 	lineBufferLength_ = window_.width * inputConfig_.bpp / 8 +
 			    2 * lineBufferPadding_;
 
-	if (enableInputMemcpy_) {
-		for (unsigned int i = 0; i <= inputConfig_.patternSize.height; i++)
-			lineBuffers_[i].resize(lineBufferLength_);
-	}
+	setupStripes();
 
 	measuredFrames_ = 0;
 	frameProcessTime_ = 0;
@@ -531,6 +1140,60 @@ int DebayerCpu::configure(const StreamConfiguration &inputCfg,
 	return 0;
 }
 
+/*
+ * Split the window in horizontal stripes, one per thread, and (re)start the
+ * workers processing all but the first stripe. Stripe boundaries are aligned
+ * to the Bayer pattern height, or to the binned block height. The lines above
+ * and below a stripe needed for interpolation are read from the neighbouring
+ * stripes, which is safe as the input is never written to.
+ */
+void DebayerCpu::setupStripes()
+{
+	const unsigned int patternHeight = inputConfig_.patternSize.height;
+	const unsigned int align = std::max(patternHeight, binning_);
+	const unsigned int count =
+		std::clamp(window_.height / kMinStripeHeight, 1U, threadCount_);
+
+	stripeWorkers_.clear();
+	stripes_.clear();
+	stripes_.resize(count);
+
+	for (unsigned int i = 0; i < count; i++) {
+		Stripe &stripe = stripes_[i];
+
+		stripe.yStart = window_.y +
+				((window_.height * i / count) & ~(align - 1));
+		stripe.yEnd = window_.y +
+			      ((window_.height * (i + 1) / count) & ~(align - 1));
+
+		if (enableInputMemcpy_) {
+			for (unsigned int j = 0; j <= patternHeight; j++)
+				stripe.lineBuffers[j].resize(lineBufferLength_);
+		}
+
+		if (convert_) {
+			for (std::vector<uint8_t> &line : stripe.rgbLines)
+				line.resize(window_.width * 3);
+		}
+
+		if (binning_ > 2)
+			stripe.binSums.resize(window_.width / binning_ * 3);
+	}
+
+	/* The last stripe extends to the bottom of the window */
+	stripes_.back().yEnd = window_.y + window_.height;
+
+	stats_->setStripeCount(count);
+
+	for (unsigned int i = 1; i < count; i++) {
+		stripeWorkers_.push_back(std::make_unique<StripeWorker>(this, i));
+		stripeWorkers_.back()->start();
+	}
+
+	LOG(Debayer, Debug)
+		<< "Processing frames in " << count << " stripe(s)";
+}
+
 /*
  * Get width and height at which the bayer-pattern repeats.
  * Return pattern-size or an empty Size for an unsupported inputFormat.
@@ -565,11 +1228,16 @@ DebayerCpu::strideAndFrameSize(const PixelFormat &outputFormat, const Size &size
 
 	/* round up to multiple of 8 for 64 bits alignment */
 	unsigned int stride = (size.width * config.bpp / 8 + 7) & ~7;
+	unsigned int frameSize = stride * size.height;
+
+	/* Add the interleaved chroma plane, subsampled vertically */
+	if (outputFormat == formats::NV12)
+		frameSize += stride * size.height / 2;
 
-	return std::make_tuple(stride, stride * size.height);
+	return std::make_tuple(stride, frameSize);
 }
 
-void DebayerCpu::setupInputMemcpy(const uint8_t *linePointers[])
+void DebayerCpu::setupInputMemcpy(Stripe &stripe, const uint8_t *linePointers[])
 {
 	const unsigned int patternHeight = inputConfig_.patternSize.height;
 
@@ -577,14 +1245,14 @@ void DebayerCpu::setupInputMemcpy(const uint8_t *linePointers[])
 		return;
 
 	for (unsigned int i = 0; i < patternHeight; i++) {
-		memcpy(lineBuffers_[i].data(),
+		memcpy(stripe.lineBuffers[i].data(),
 		       linePointers[i + 1] - lineBufferPadding_,
 		       lineBufferLength_);
-		linePointers[i + 1] = lineBuffers_[i].data() + lineBufferPadding_;
+		linePointers[i + 1] = stripe.lineBuffers[i].data() + lineBufferPadding_;
 	}
 
-	/* Point lineBufferIndex_ to first unused lineBuffer */
-	lineBufferIndex_ = patternHeight;
+	/* Point lineBufferIndex to first unused lineBuffer */
+	stripe.lineBufferIndex = patternHeight;
 }
 
 void DebayerCpu::shiftLinePointers(const uint8_t *linePointers[], const uint8_t *src)
@@ -598,88 +1266,123 @@ void DebayerCpu::shiftLinePointers(const uint8_t *linePointers[], const uint8_t
 				      (patternHeight / 2) * (int)inputConfig_.stride;
 }
 
-void DebayerCpu::memcpyNextLine(const uint8_t *linePointers[])
+void DebayerCpu::memcpyNextLine(Stripe &stripe, const uint8_t *linePointers[])
 {
 	const unsigned int patternHeight = inputConfig_.patternSize.height;
 
 	if (!enableInputMemcpy_)
 		return;
 
-	memcpy(lineBuffers_[lineBufferIndex_].data(),
+	memcpy(stripe.lineBuffers[stripe.lineBufferIndex].data(),
 	       linePointers[patternHeight] - lineBufferPadding_,
 	       lineBufferLength_);
-	linePointers[patternHeight] = lineBuffers_[lineBufferIndex_].data()
+	linePointers[patternHeight] = stripe.lineBuffers[stripe.lineBufferIndex].data()
 				    + lineBufferPadding_;
 
-	lineBufferIndex_ = (lineBufferIndex_ + 1) % (patternHeight + 1);
+	stripe.lineBufferIndex = (stripe.lineBufferIndex + 1) % (patternHeight + 1);
 }
 
-void DebayerCpu::process2(const uint8_t *src, uint8_t *dst)
+void DebayerCpu::process2(const uint8_t *src, uint8_t *dst, unsigned int stripe)
 {
-	unsigned int yEnd = window_.y + window_.height;
+	Stripe &s = stripes_[stripe];
+	unsigned int yEnd = s.yEnd;
+	/* Only the last stripe needs to handle the bottom lines of the frame */
+	const bool lastLines = window_.y == 0 && s.yEnd == window_.y + window_.height;
 	/* Holds [0] previous- [1] current- [2] next-line */
 	const uint8_t *linePointers[3];
 
-	/* Adjust src to top left corner of the window */
-	src += window_.y * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	/* Binned output produced from the same input lines, if any */
+	uint8_t *binnedDst = frameDstBinned_;
+	const unsigned int pairsPerBlock = binning_ / 2;
+
+	/* Adjust src and dst to top left corner of the stripe */
+	src += s.yStart * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	dst += (s.yStart - window_.y) * outputConfig_.stride;
+	if (binnedDst)
+		binnedDst += (s.yStart - window_.y) / binning_ * binnedOutputConfig_.stride;
 
 	/* [x] becomes [x - 1] after initial shiftLinePointers() call */
-	if (window_.y) {
+	if (s.yStart) {
 		linePointers[1] = src - inputConfig_.stride; /* previous-line */
 		linePointers[2] = src;
 	} else {
-		/* window_.y == 0, use the next line as prev line */
+		/* s.yStart == 0, use the next line as prev line */
 		linePointers[1] = src + inputConfig_.stride;
 		linePointers[2] = src;
-		/* Last 2 lines also need special handling */
-		yEnd -= 2;
 	}
 
-	setupInputMemcpy(linePointers);
+	/* Last 2 lines also need special handling */
+	if (lastLines)
+		yEnd -= 2;
+
+	setupInputMemcpy(s, linePointers);
+
+	for (unsigned int y = s.yStart; y < yEnd; y += 2) {
+		uint8_t *dst0 = convert_ ? s.rgbLines[0].data() : dst;
+		uint8_t *dst1 = convert_ ? s.rgbLines[1].data() : dst + outputConfig_.stride;
 
-	for (unsigned int y = window_.y; y < yEnd; y += 2) {
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(y, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		stats_->processLine0(y, linePointers, stripe);
+		(this->*debayer0_)(dst0, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer1_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		(this->*debayer1_)(dst1, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		if (convert_)
+			(this->*convert_)(dst, y - window_.y, s);
+		dst += 2 * outputConfig_.stride;
+
+		if (binnedDst) {
+			unsigned int pair = (y - window_.y) / 2 % pairsPerBlock;
+
+			(this->*bin_)(binnedDst, linePointers, s, pair);
+			if (pair == pairsPerBlock - 1)
+				binnedDst += binnedOutputConfig_.stride;
+		}
 	}
 
-	if (window_.y == 0) {
+	if (lastLines) {
+		uint8_t *dst0 = convert_ ? s.rgbLines[0].data() : dst;
+		uint8_t *dst1 = convert_ ? s.rgbLines[1].data() : dst + outputConfig_.stride;
+
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(yEnd, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		stats_->processLine0(yEnd, linePointers, stripe);
+		(this->*debayer0_)(dst0, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
 		/* next line may point outside of src, use prev. */
 		linePointers[2] = linePointers[0];
-		(this->*debayer1_)(dst, linePointers);
-		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+		(this->*debayer1_)(dst1, linePointers);
+
+		if (convert_)
+			(this->*convert_)(dst, yEnd - window_.y, s);
+
+		if (binnedDst) {
+			unsigned int pair = (yEnd - window_.y) / 2 % pairsPerBlock;
+
+			(this->*bin_)(binnedDst, linePointers, s, pair);
+		}
 	}
 }
 
-void DebayerCpu::process4(const uint8_t *src, uint8_t *dst)
+void DebayerCpu::process4(const uint8_t *src, uint8_t *dst, unsigned int stripe)
 {
-	const unsigned int yEnd = window_.y + window_.height;
+	Stripe &s = stripes_[stripe];
 	/*
 	 * This holds pointers to [0] 2-lines-up [1] 1-line-up [2] current-line
 	 * [3] 1-line-down [4] 2-lines-down.
 	 */
 	const uint8_t *linePointers[5];
 
-	/* Adjust src to top left corner of the window */
-	src += window_.y * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	/* Adjust src and dst to top left corner of the stripe */
+	src += s.yStart * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	dst += (s.yStart - window_.y) * outputConfig_.stride;
 
 	/* [x] becomes [x - 1] after initial shiftLinePointers() call */
 	linePointers[1] = src - 2 * inputConfig_.stride;
@@ -687,78 +1390,314 @@ void DebayerCpu::process4(const uint8_t *src, uint8_t *dst)
 	linePointers[3] = src;
 	linePointers[4] = src + inputConfig_.stride;
 
-	setupInputMemcpy(linePointers);
+	setupInputMemcpy(s, linePointers);
+
+	for (unsigned int y = s.yStart; y < s.yEnd; y += 4) {
+		uint8_t *dst0 = convert_ ? s.rgbLines[0].data() : dst;
+		uint8_t *dst1 = convert_ ? s.rgbLines[1].data() : dst + outputConfig_.stride;
 
-	for (unsigned int y = window_.y; y < yEnd; y += 4) {
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine0(y, linePointers);
-		(this->*debayer0_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		stats_->processLine0(y, linePointers, stripe);
+		(this->*debayer0_)(dst0, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer1_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		(this->*debayer1_)(dst1, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		if (convert_)
+			(this->*convert_)(dst, y - window_.y, s);
+		dst += 2 * outputConfig_.stride;
+
+		dst0 = convert_ ? s.rgbLines[0].data() : dst;
+		dst1 = convert_ ? s.rgbLines[1].data() : dst + outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		stats_->processLine2(y, linePointers);
-		(this->*debayer2_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		stats_->processLine2(y, linePointers, stripe);
+		(this->*debayer2_)(dst0, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
 
 		shiftLinePointers(linePointers, src);
-		memcpyNextLine(linePointers);
-		(this->*debayer3_)(dst, linePointers);
+		memcpyNextLine(s, linePointers);
+		(this->*debayer3_)(dst1, linePointers);
 		src += inputConfig_.stride;
-		dst += outputConfig_.stride;
+
+		if (convert_)
+			(this->*convert_)(dst, y + 2 - window_.y, s);
+		dst += 2 * outputConfig_.stride;
+	}
+}
+
+/*
+ * Process a stripe when only the binned output is produced. The binned pixels
+ * are not interpolated, so only the lines of the current pair are needed.
+ */
+void DebayerCpu::processBinned(const uint8_t *src, uint8_t *dst, unsigned int stripe)
+{
+	Stripe &s = stripes_[stripe];
+	const unsigned int pairsPerBlock = binning_ / 2;
+	const unsigned int lineLength = window_.width * inputConfig_.bpp / 8;
+	/* Holds [1] current- [2] next-line, as expected by the statistics */
+	const uint8_t *linePointers[3];
+
+	/* Adjust src and dst to top left corner of the stripe */
+	src += s.yStart * inputConfig_.stride + window_.x * inputConfig_.bpp / 8;
+	dst += (s.yStart - window_.y) / binning_ * binnedOutputConfig_.stride;
+
+	for (unsigned int y = s.yStart; y < s.yEnd; y += 2) {
+		unsigned int pair = (y - window_.y) / 2 % pairsPerBlock;
+
+		linePointers[1] = src;
+		linePointers[2] = src + inputConfig_.stride;
+
+		if (enableInputMemcpy_) {
+			for (unsigned int i = 0; i < 2; i++) {
+				memcpy(s.lineBuffers[i].data(), linePointers[i + 1],
+				       lineLength);
+				linePointers[i + 1] = s.lineBuffers[i].data();
+			}
+		}
+
+		stats_->processLine0(y, linePointers, stripe);
+		(this->*bin_)(dst, &linePointers[1], s, pair);
+		src += 2 * inputConfig_.stride;
+
+		if (pair == pairsPerBlock - 1)
+			dst += binnedOutputConfig_.stride;
+	}
+}
+
+/*
+ * RGB to YUV conversion, using the BT.601 limited range encoding. The RGB888
+ * lines hold the blue, green and red components of each pixel in that order.
+ */
+static inline uint8_t rgbToY(int r, int g, int b)
+{
+	return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t rgbToU(int r, int g, int b)
+{
+	return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t rgbToV(int r, int g, int b)
+{
+	return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+/*
+ * Convert the two RGB888 lines of a stripe to NV12. The chroma is computed
+ * from the average of each 2x2 block of pixels.
+ */
+void DebayerCpu::convertNV12(uint8_t *dst, unsigned int row, const Stripe &stripe)
+{
+	const uint8_t *rgb0 = stripe.rgbLines[0].data();
+	const uint8_t *rgb1 = stripe.rgbLines[1].data();
+	uint8_t *y0 = dst;
+	uint8_t *y1 = dst + outputConfig_.stride;
+	uint8_t *uv = frameDstUV_ + row / 2 * outputConfig_.stride;
+
+	for (unsigned int x = 0; x < window_.width; x += 2) {
+		y0[0] = rgbToY(rgb0[2], rgb0[1], rgb0[0]);
+		y0[1] = rgbToY(rgb0[5], rgb0[4], rgb0[3]);
+		y1[0] = rgbToY(rgb1[2], rgb1[1], rgb1[0]);
+		y1[1] = rgbToY(rgb1[5], rgb1[4], rgb1[3]);
+
+		int b = (rgb0[0] + rgb0[3] + rgb1[0] + rgb1[3] + 2) >> 2;
+		int g = (rgb0[1] + rgb0[4] + rgb1[1] + rgb1[4] + 2) >> 2;
+		int r = (rgb0[2] + rgb0[5] + rgb1[2] + rgb1[5] + 2) >> 2;
+		uv[0] = rgbToU(r, g, b);
+		uv[1] = rgbToV(r, g, b);
+
+		rgb0 += 6;
+		rgb1 += 6;
+		y0 += 2;
+		y1 += 2;
+		uv += 2;
+	}
+}
+
+/*
+ * Convert the two RGB888 lines of a stripe to YUYV. The chroma is computed
+ * from the average of each pair of horizontal pixels.
+ */
+void DebayerCpu::convertYUYV(uint8_t *dst, [[maybe_unused]] unsigned int row,
+			     const Stripe &stripe)
+{
+	for (unsigned int i = 0; i < 2; i++) {
+		const uint8_t *rgb = stripe.rgbLines[i].data();
+		uint8_t *yuyv = dst + i * outputConfig_.stride;
+
+		for (unsigned int x = 0; x < window_.width; x += 2) {
+			int b = (rgb[0] + rgb[3] + 1) >> 1;
+			int g = (rgb[1] + rgb[4] + 1) >> 1;
+			int r = (rgb[2] + rgb[5] + 1) >> 1;
+
+			yuyv[0] = rgbToY(rgb[2], rgb[1], rgb[0]);
+			yuyv[1] = rgbToU(r, g, b);
+			yuyv[2] = rgbToY(rgb[5], rgb[4], rgb[3]);
+			yuyv[3] = rgbToV(r, g, b);
+
+			rgb += 6;
+			yuyv += 4;
+		}
 	}
 }
 
+void DebayerCpu::processStripe(unsigned int stripe)
+{
+	TraceScope trace(traceDebayerStripe, stripe);
+
+	if (!frameDst_)
+		processBinned(frameSrc_, frameDstBinned_, stripe);
+	else if (inputConfig_.patternSize.height == 2)
+		process2(frameSrc_, frameDst_, stripe);
+	else
+		process4(frameSrc_, frameDst_, stripe);
+}
+
 static inline int64_t timeDiff(timespec &after, timespec &before)
 {
 	return (after.tv_sec - before.tv_sec) * 1000000000LL +
 	       (int64_t)after.tv_nsec - (int64_t)before.tv_nsec;
 }
 
-void DebayerCpu::process(FrameBuffer *input, FrameBuffer *output, DebayerParams params)
+void DebayerCpu::process(uint32_t frame, FrameBuffer *input,
+			 const std::vector<FrameBuffer *> &outputs,
+			 const DebayerParams *params)
 {
 	timespec frameStartTime;
 
+	traceDebayer.begin(frame);
+
 	if (measuredFrames_ < DebayerCpu::kLastFrameToMeasure) {
 		frameStartTime = {};
 		clock_gettime(CLOCK_MONOTONIC_RAW, &frameStartTime);
 	}
 
-	green_ = params.green;
-	red_ = swapRedBlueGains_ ? params.blue : params.red;
-	blue_ = swapRedBlueGains_ ? params.red : params.blue;
+	if (ccmEnabled_) {
+		/*
+		 * When swapping the red and blue inputs, the red and blue
+		 * outputs must be swapped too.
+		 */
+		if (swapRedBlueGains_) {
+			for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+				const DebayerParams::CcmColumn &r = params->redCcm[i];
+				const DebayerParams::CcmColumn &g = params->greenCcm[i];
+				const DebayerParams::CcmColumn &b = params->blueCcm[i];
+
+				redCcm_[i] = { b.b, b.g, b.r };
+				greenCcm_[i] = { g.b, g.g, g.r };
+				blueCcm_[i] = { r.b, r.g, r.r };
+			}
+		} else {
+			redCcm_ = params->redCcm;
+			greenCcm_ = params->greenCcm;
+			blueCcm_ = params->blueCcm;
+		}
+		gammaLut_ = params->gammaLut;
+	} else {
+		green_ = params->green;
+		red_ = swapRedBlueGains_ ? params->blue : params->red;
+		blue_ = swapRedBlueGains_ ? params->red : params->blue;
+	}
+
+	/*
+	 * The outputs are ordered as configured. The binned output, if any, is
+	 * the last one. An output may be null when the request doesn't
+	 * contain a buffer for it.
+	 */
+	FrameBuffer *output = outputs[0];
+	FrameBuffer *binnedOutput = binning_ > 1 ? outputs[1] : nullptr;
 
 	/* Copy metadata from the input buffer */
-	FrameMetadata &metadata = output->_d()->metadata();
-	metadata.status = input->metadata().status;
-	metadata.sequence = input->metadata().sequence;
-	metadata.timestamp = input->metadata().timestamp;
-
-	MappedFrameBuffer in(input, MappedFrameBuffer::MapFlag::Read);
-	MappedFrameBuffer out(output, MappedFrameBuffer::MapFlag::Write);
-	if (!in.isValid() || !out.isValid()) {
+	for (FrameBuffer *buffer : { output, binnedOutput }) {
+		if (!buffer)
+			continue;
+
+		FrameMetadata &metadata = buffer->_d()->metadata();
+		metadata.status = input->metadata().status;
+		metadata.sequence = input->metadata().sequence;
+		metadata.timestamp = input->metadata().timestamp;
+	}
+
+	using MapFlag = MappedFrameBuffer::MapFlag;
+
+	/*
+	 * The mappings are cached in the buffers, avoiding the cost of mapping
+	 * and unmapping every buffer for every frame.
+	 */
+	const MappedFrameBuffer *in = input->_d()->map(MapFlag::Read);
+	const MappedFrameBuffer *out = nullptr;
+	const MappedFrameBuffer *binnedOut = nullptr;
+	if (output)
+		out = output->_d()->map(MapFlag::Write);
+	if (binnedOutput)
+		binnedOut = binnedOutput->_d()->map(MapFlag::Write);
+
+	if (!in || (output && !out) || (binnedOutput && !binnedOut)) {
 		LOG(Debayer, Error) << "mmap-ing buffer(s) failed";
-		metadata.status = FrameMetadata::FrameError;
+		traceDebayer.end();
+
+		/* Complete the frame, the parameters buffer is then released. */
+		for (FrameBuffer *buffer : { output, binnedOutput }) {
+			if (!buffer)
+				continue;
+
+			buffer->_d()->metadata().status = FrameMetadata::FrameError;
+			outputBufferReady.emit(buffer);
+		}
+		inputBufferReady.emit(input);
 		return;
 	}
 
+	in->beginAccess(MapFlag::Read);
+	if (out)
+		out->beginAccess(MapFlag::Write);
+	if (binnedOut)
+		binnedOut->beginAccess(MapFlag::Write);
+
 	stats_->startFrame();
 
-	if (inputConfig_.patternSize.height == 2)
-		process2(in.planes()[0].data(), out.planes()[0].data());
-	else
-		process4(in.planes()[0].data(), out.planes()[0].data());
+	frameSrc_ = in->planes()[0].data();
+	frameDst_ = nullptr;
+	frameDstUV_ = nullptr;
+	if (out) {
+		frameDst_ = out->planes()[0].data();
+		/* The chroma plane may be described as a separate plane or not */
+		frameDstUV_ = out->planes().size() > 1
+			    ? out->planes()[1].data()
+			    : frameDst_ + outputConfig_.stride * window_.height;
+	}
+	frameDstBinned_ = binnedOut ? binnedOut->planes()[0].data() : nullptr;
+
+	for (auto &worker : stripeWorkers_)
+		worker->queue();
+
+	processStripe(0);
 
-	metadata.planes()[0].bytesused = out.planes()[0].size();
+	for (auto &worker : stripeWorkers_)
+		worker->waitIdle();
+
+	in->endAccess(MapFlag::Read);
+	if (out)
+		out->endAccess(MapFlag::Write);
+	if (binnedOut)
+		binnedOut->endAccess(MapFlag::Write);
+
+	if (out) {
+		FrameMetadata &metadata = output->_d()->metadata();
+		for (unsigned int i = 0; i < out->planes().size(); i++)
+			metadata.planes()[i].bytesused = out->planes()[i].size();
+	}
+
+	if (binnedOut)
+		binnedOutput->_d()->metadata().planes()[0].bytesused =
+			binnedOut->planes()[0].size();
 
 	/* Measure before emitting signals */
 	if (measuredFrames_ < DebayerCpu::kLastFrameToMeasure &&
@@ -777,8 +1716,13 @@ void DebayerCpu::process(FrameBuffer *input, FrameBuffer *output, DebayerParams
 		}
 	}
 
-	stats_->finishFrame();
-	outputBufferReady.emit(output);
+	stats_->finishFrame(frame);
+	traceDebayer.end();
+
+	if (output)
+		outputBufferReady.emit(output);
+	if (binnedOutput)
+		outputBufferReady.emit(binnedOutput);
 	inputBufferReady.emit(input);
 }
 
@@ -15,7 +15,9 @@
 #include <stdint.h>
 #include <vector>
 
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/object.h>
+#include <libcamera/base/thread.h>
 
 #include "libcamera/internal/bayer_format.h"
 
@@ -31,12 +33,15 @@ public:
 	~DebayerCpu();
 
 	int configure(const StreamConfiguration &inputCfg,
-		      const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs);
+		      const std::vector<std::reference_wrapper<StreamConfiguration>> &outputCfgs,
+		      bool ccmEnabled);
 	Size patternSize(PixelFormat inputFormat);
 	std::vector<PixelFormat> formats(PixelFormat input);
 	std::tuple<unsigned int, unsigned int>
 	strideAndFrameSize(const PixelFormat &outputFormat, const Size &size);
-	void process(FrameBuffer *input, FrameBuffer *output, DebayerParams params);
+	void process(uint32_t frame, FrameBuffer *input,
+		     const std::vector<FrameBuffer *> &outputs,
+		     const DebayerParams *params);
 	SizeRange sizes(PixelFormat inputFormat, const Size &inputSize);
 
 	/**
@@ -47,11 +52,20 @@ public:
 	const SharedFD &getStatsFD() { return stats_->getStatsFD(); }
 
 	/**
-	 * \brief Get the output frame size
+	 * \brief Release a statistics buffer
+	 * \param[in] bufferId The index of the statistics buffer
 	 *
-	 * \return The output frame size
+	 * \context This function is \threadsafe.
 	 */
-	unsigned int frameSize() { return outputConfig_.frameSize; }
+	void releaseStatsBuffer(uint32_t bufferId) { stats_->releaseBuffer(bufferId); }
+
+	/**
+	 * \brief Stop processing frames
+	 *
+	 * Invoked in the debayer thread when stopping, after all the frames
+	 * queued for processing have been processed.
+	 */
+	void stop() {}
 
 private:
 	/**
@@ -84,30 +98,111 @@ private:
 	 */
 	using debayerFn = void (DebayerCpu::*)(uint8_t *dst, const uint8_t *src[]);
 
+	struct Stripe;
+
+	/**
+	 * \brief Called to convert 2 debayered RGB888 lines to the output format
+	 * \param[out] dst Pointer to the start of the first output line to write
+	 * \param[in] row The index of the first line in the output window
+	 * \param[in] stripe The stripe holding the RGB888 lines
+	 */
+	using convertFn = void (DebayerCpu::*)(uint8_t *dst, unsigned int row,
+					       const Stripe &stripe);
+
+	/**
+	 * \brief Called to bin 2 lines of Bayer input data to output format
+	 * \param[out] dst Pointer to the start of the output line to write
+	 * \param[in] src The 2 input lines
+	 * \param[in] stripe The stripe being processed
+	 * \param[in] pair The index of the line pair in the binned block
+	 *
+	 * Each output pixel is computed from a block of binning_ x binning_
+	 * input pixels. When the block spans multiple line pairs, the partial
+	 * sums of the first pair are stored in the stripe and the output line
+	 * is written when processing the last pair.
+	 */
+	using binFn = void (DebayerCpu::*)(uint8_t *dst, const uint8_t *src[],
+					   Stripe &stripe, unsigned int pair);
+
+	/* Max. supported Bayer pattern height is 4, debayering this requires 5 lines */
+	static constexpr unsigned int kMaxLineBuffers = 5;
+
+	/*
+	 * A horizontal band of the output window, processed independently of
+	 * the other stripes. yStart and yEnd are in input frame lines. The
+	 * line buffers are per stripe as the stripes are processed
+	 * concurrently.
+	 */
+	struct Stripe {
+		unsigned int yStart;
+		unsigned int yEnd;
+		std::vector<uint8_t> lineBuffers[kMaxLineBuffers];
+		unsigned int lineBufferIndex;
+		/* RGB888 lines converted to the output format for YUV outputs */
+		std::vector<uint8_t> rgbLines[2];
+		/* Partial sums of the binned blocks spanning multiple line pairs */
+		std::vector<uint32_t> binSums;
+	};
+
+	class StripeWorker : public Thread
+	{
+	public:
+		StripeWorker(DebayerCpu *debayer, unsigned int stripe);
+		~StripeWorker();
+
+		void start();
+		void queue();
+		void waitIdle();
+
+	protected:
+		void run() override;
+
+	private:
+		DebayerCpu *debayer_;
+		const unsigned int stripe_;
+
+		Mutex mutex_;
+		ConditionVariable cv_;
+
+		bool running_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+		bool pending_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
+	};
+
 	/* 8-bit raw bayer format */
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer8_BGBG_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer8_GRGR_BGR888(uint8_t *dst, const uint8_t *src[]);
 	/* unpacked 10-bit raw bayer format */
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10_BGBG_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10_GRGR_BGR888(uint8_t *dst, const uint8_t *src[]);
 	/* unpacked 12-bit raw bayer format */
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer12_BGBG_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer12_GRGR_BGR888(uint8_t *dst, const uint8_t *src[]);
 	/* CSI-2 packed 10-bit raw bayer format (all the 4 orders) */
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10P_BGBG_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10P_GRGR_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10P_GBGB_BGR888(uint8_t *dst, const uint8_t *src[]);
-	template<bool addAlphaByte>
+	template<bool addAlphaByte, bool ccmEnabled>
 	void debayer10P_RGRG_BGR888(uint8_t *dst, const uint8_t *src[]);
+	/* SIMD implementation of the unpacked raw bayer formats */
+	template<typename pixel_t, unsigned int div, bool addAlphaByte, bool ccmEnabled>
+	void debayerSimd_BGBG_BGR888(uint8_t *dst, const uint8_t *src[]);
+	template<typename pixel_t, unsigned int div, bool addAlphaByte, bool ccmEnabled>
+	void debayerSimd_GRGR_BGR888(uint8_t *dst, const uint8_t *src[]);
+	/* Superpixel binning of all the supported raw bayer formats */
+	template<typename pixel_t, bool csi2Packed, unsigned int div, unsigned int factor,
+		 bool addAlphaByte, bool ccmEnabled>
+	void binLinePair(uint8_t *dst, const uint8_t *src[], Stripe &stripe, unsigned int pair);
+	template<typename pixel_t, bool csi2Packed, unsigned int div>
+	binFn binFunction(bool addAlphaByte, bool ccmEnabled);
 
 	struct DebayerInputConfig {
 		Size patternSize;
@@ -125,34 +220,63 @@ private:
 	int getInputConfig(PixelFormat inputFormat, DebayerInputConfig &config);
 	int getOutputConfig(PixelFormat outputFormat, DebayerOutputConfig &config);
 	int setupStandardBayerOrder(BayerFormat::Order order);
-	int setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputFormat);
-	void setupInputMemcpy(const uint8_t *linePointers[]);
+	int setDebayerFunctions(PixelFormat inputFormat, PixelFormat outputFormat,
+				bool ccmEnabled);
+	int setBinningFunction(const BayerFormat &bayerFormat, bool addAlphaByte,
+			       bool ccmEnabled);
+	void setupStripes();
+	void setupInputMemcpy(Stripe &stripe, const uint8_t *linePointers[]);
 	void shiftLinePointers(const uint8_t *linePointers[], const uint8_t *src);
-	void memcpyNextLine(const uint8_t *linePointers[]);
-	void process2(const uint8_t *src, uint8_t *dst);
-	void process4(const uint8_t *src, uint8_t *dst);
+	void memcpyNextLine(Stripe &stripe, const uint8_t *linePointers[]);
+	void process2(const uint8_t *src, uint8_t *dst, unsigned int stripe);
+	void process4(const uint8_t *src, uint8_t *dst, unsigned int stripe);
+	void processBinned(const uint8_t *src, uint8_t *dst, unsigned int stripe);
+	void processStripe(unsigned int stripe);
+	void convertNV12(uint8_t *dst, unsigned int row, const Stripe &stripe);
+	void convertYUYV(uint8_t *dst, unsigned int row, const Stripe &stripe);
 
-	/* Max. supported Bayer pattern height is 4, debayering this requires 5 lines */
-	static constexpr unsigned int kMaxLineBuffers = 5;
+	/* Stripes smaller than this are not worth the synchronization cost */
+	static constexpr unsigned int kMinStripeHeight = 16;
+	static constexpr unsigned int kMaxThreads = 8;
+	static constexpr int kGammaLastIndex = DebayerParams::kGammaLookupSize - 1;
 
 	DebayerParams::ColorLookupTable red_;
 	DebayerParams::ColorLookupTable green_;
 	DebayerParams::ColorLookupTable blue_;
+	DebayerParams::CcmLookupTable redCcm_;
+	DebayerParams::CcmLookupTable greenCcm_;
+	DebayerParams::CcmLookupTable blueCcm_;
+	DebayerParams::GammaLookupTable gammaLut_;
 	debayerFn debayer0_;
 	debayerFn debayer1_;
 	debayerFn debayer2_;
 	debayerFn debayer3_;
+	convertFn convert_;
+	binFn bin_;
 	Rectangle window_;
 	DebayerInputConfig inputConfig_;
 	DebayerOutputConfig outputConfig_;
+	DebayerOutputConfig binnedOutputConfig_;
 	std::unique_ptr<SwStatsCpu> stats_;
-	std::vector<uint8_t> lineBuffers_[kMaxLineBuffers];
+	std::vector<Stripe> stripes_;
+	/* Stripe 0 is processed by the calling thread, stripe i by worker i - 1 */
+	std::vector<std::unique_ptr<StripeWorker>> stripeWorkers_;
+	unsigned int threadCount_;
+	/* Mapped input and output of the frame being processed */
+	const uint8_t *frameSrc_;
+	uint8_t *frameDst_;
+	uint8_t *frameDstUV_;
+	uint8_t *frameDstBinned_;
 	unsigned int lineBufferLength_;
 	unsigned int lineBufferPadding_;
-	unsigned int lineBufferIndex_;
 	unsigned int xShift_; /* Offset of 0/1 applied to window_.x */
+	unsigned int binning_; /* Binning factor of the binned output, 1 if none */
+	unsigned int binRedX_; /* Column of the red pixel in the 2x2 block */
+	unsigned int binRedLine_; /* Line of the red pixel in the 2x2 block */
 	bool enableInputMemcpy_;
+	bool enableSimd_;
 	bool swapRedBlueGains_;
+	bool ccmEnabled_;
 	unsigned int measuredFrames_;
 	int64_t frameProcessTime_;
 	/* Skip 30 frames for things to stabilize then measure 30 frames */
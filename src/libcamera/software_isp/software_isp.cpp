@@ -7,7 +7,7 @@
 
 #include "libcamera/internal/software_isp/software_isp.h"
 
-#include <cmath>
+#include <algorithm>
 #include <stdint.h>
 #include <sys/mman.h>
 #include <sys/types.h>
@@ -17,6 +17,7 @@
 #include <libcamera/stream.h>
 
 #include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/formats.h"
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/ipa_manager.h"
 #include "libcamera/internal/mapped_framebuffer.h"
@@ -36,6 +37,18 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
 /**
  * \class SoftwareIsp
  * \brief Class for the Software ISP
+ *
+ * The Software ISP processes frames in a worker thread. Its signals are
+ * emitted in the thread the SoftwareIsp is bound to, which is the thread it
+ * has been created in.
+ */
+
+/**
+ * \var SoftwareIsp::kMaxStreams
+ * \brief Maximum number of output streams
+ *
+ * The Software ISP can produce a second, binned, stream from the same input
+ * frame, at half or quarter of the resolution of the first stream.
  */
 
 /**
@@ -51,6 +64,9 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
 /**
  * \var SoftwareIsp::ispStatsReady
  * \brief A signal emitted when the statistics for IPA are ready
+ *
+ * The signal carries the frame number and the index of the statistics buffer
+ * holding the statistics for that frame.
  */
 
 /**
@@ -68,31 +84,18 @@ LOG_DEFINE_CATEGORY(SoftwareIsp)
 SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 	: dmaHeap_(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
 		   DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
-		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf)
+		   DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf),
+	  ccmEnabled_(false), running_(false)
 {
-	/*
-	 * debayerParams_ must be initialized because the initial value is used for
-	 * the first two frames, i.e. until stats processing starts providing its
-	 * own parameters.
-	 *
-	 * \todo This should be handled in the same place as the related
-	 * operations, in the IPA module.
-	 */
-	std::array<uint8_t, 256> gammaTable;
-	for (unsigned int i = 0; i < 256; i++)
-		gammaTable[i] = UINT8_MAX * std::pow(i / 256.0, 0.5);
-	for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
-		debayerParams_.red[i] = gammaTable[i];
-		debayerParams_.green[i] = gammaTable[i];
-		debayerParams_.blue[i] = gammaTable[i];
-	}
+	paramsBuffersBusy_.fill(false);
 
 	if (!dmaHeap_.isValid()) {
 		LOG(SoftwareIsp, Error) << "Failed to create DmaBufAllocator object";
 		return;
 	}
 
-	sharedParams_ = SharedMemObject<DebayerParams>("softIsp_params");
+	sharedParams_ = SharedMemObject<std::array<DebayerParams, kDebayerParamsBufferCount>>(
+		"softIsp_params");
 	if (!sharedParams_) {
 		LOG(SoftwareIsp, Error) << "Failed to create shared memory for parameters";
 		return;
@@ -127,14 +130,16 @@ SoftwareIsp::SoftwareIsp(PipelineHandler *pipe, const CameraSensor *sensor)
 	int ret = ipa_->init(IPASettings{ ipaTuningFile, sensor->model() },
 			     debayer_->getStatsFD(),
 			     sharedParams_.fd(),
-			     sensor->controls());
+			     sensor->controls(),
+			     &ccmEnabled_);
 	if (ret) {
 		LOG(SoftwareIsp, Error) << "IPA init failed";
 		debayer_.reset();
 		return;
 	}
 
-	ipa_->setIspParams.connect(this, &SoftwareIsp::saveIspParams);
+	ipa_->paramsBufferReady.connect(this, &SoftwareIsp::paramsBufferReady);
+	ipa_->statsProcessed.connect(this, &SoftwareIsp::statsProcessed);
 	ipa_->setSensorControls.connect(this, &SoftwareIsp::setSensorCtrls);
 
 	debayer_->moveToThread(&ispWorkerThread_);
@@ -158,15 +163,19 @@ SoftwareIsp::~SoftwareIsp()
 
 /**
  * \brief Process the statistics gathered
+ * \param[in] frame The frame number
+ * \param[in] bufferId The index of the statistics buffer
  * \param[in] sensorControls The sensor controls
  *
  * Requests the IPA to calculate new parameters for ISP and new control
- * values for the sensor.
+ * values for the sensor. The statistics buffer is returned to the ISP once the
+ * IPA has read it.
  */
-void SoftwareIsp::processStats(const ControlList &sensorControls)
+void SoftwareIsp::processStats(const uint32_t frame, const uint32_t bufferId,
+			       const ControlList &sensorControls)
 {
 	ASSERT(ipa_);
-	ipa_->processStats(sensorControls);
+	ipa_->processStats(frame, bufferId, sensorControls);
 }
 
 /**
@@ -235,7 +244,11 @@ int SoftwareIsp::configure(const StreamConfiguration &inputCfg,
 	if (ret < 0)
 		return ret;
 
-	return debayer_->configure(inputCfg, outputCfgs);
+	streams_.clear();
+	for (const StreamConfiguration &cfg : outputCfgs)
+		streams_.push_back(cfg.stream());
+
+	return debayer_->configure(inputCfg, outputCfgs, ccmEnabled_);
 }
 
 /**
@@ -251,39 +264,40 @@ int SoftwareIsp::exportBuffers(const Stream *stream, unsigned int count,
 {
 	ASSERT(debayer_ != nullptr);
 
-	/* single output for now */
 	if (stream == nullptr)
 		return -EINVAL;
 
-	for (unsigned int i = 0; i < count; i++) {
-		const std::string name = "frame-" + std::to_string(i);
-		const size_t frameSize = debayer_->frameSize();
+	const StreamConfiguration &config = stream->configuration();
+	const PixelFormatInfo &info = PixelFormatInfo::info(config.pixelFormat);
 
-		FrameBuffer::Plane outPlane;
-		outPlane.fd = SharedFD(dmaHeap_.alloc(name.c_str(), frameSize));
-		if (!outPlane.fd.isValid()) {
-			LOG(SoftwareIsp, Error)
-				<< "failed to allocate a dma_buf";
-			return -ENOMEM;
-		}
-		outPlane.offset = 0;
-		outPlane.length = frameSize;
-
-		std::vector<FrameBuffer::Plane> planes{ outPlane };
-		buffers->emplace_back(std::make_unique<FrameBuffer>(std::move(planes)));
-	}
+	/*
+	 * All the planes of a frame are stored in a single dma_buf. The
+	 * buffers are recycled by the allocator when they are freed, avoiding
+	 * new allocations when the streams are reconfigured.
+	 */
+	std::vector<unsigned int> planeSizes;
+	for (unsigned int i = 0; i < info.numPlanes(); i++)
+		planeSizes.push_back(info.planeSize(config.size.height, i,
+						    config.stride));
 
-	return count;
+	return dmaHeap_.exportBuffers(count, planeSizes, buffers);
 }
 
 /**
  * \brief Queue buffers to Software ISP
+ * \param[in] frame The frame number
  * \param[in] input The input framebuffer
  * \param[in] outputs The container holding the output stream pointers and
  * their respective frame buffer outputs
+ *
+ * The buffers are processed once the IPA has filled the parameters buffer for
+ * the frame. The parameters buffers are indexed by frame number. If the buffer
+ * for the frame is still used by an earlier frame, the IPA is only asked to
+ * fill it once the earlier frame has been processed.
+ *
  * \return 0 on success, a negative errno on failure
  */
-int SoftwareIsp::queueBuffers(FrameBuffer *input,
+int SoftwareIsp::queueBuffers(uint32_t frame, FrameBuffer *input,
 			      const std::map<const Stream *, FrameBuffer *> &outputs)
 {
 	/*
@@ -296,16 +310,40 @@ int SoftwareIsp::queueBuffers(FrameBuffer *input,
 	for (auto [stream, buffer] : outputs) {
 		if (!buffer)
 			return -EINVAL;
-		if (outputs.size() != 1) /* only single stream atm */
+		if (std::find(streams_.begin(), streams_.end(), stream) == streams_.end())
 			return -EINVAL;
 	}
 
-	for (auto iter = outputs.begin(); iter != outputs.end(); iter++)
-		process(input, iter->second);
+	pendingFrames_[frame] = { input, outputs };
+	waitingFrames_.push_back(frame);
+	fillParamsBuffers();
 
 	return 0;
 }
 
+/*
+ * Ask the IPA to fill the parameters buffers of the waiting frames, in order,
+ * until a frame's buffer is still in use.
+ */
+void SoftwareIsp::fillParamsBuffers()
+{
+	if (!running_)
+		return;
+
+	while (!waitingFrames_.empty()) {
+		uint32_t frame = waitingFrames_.front();
+		unsigned int index = frame % kDebayerParamsBufferCount;
+
+		if (paramsBuffersBusy_[index])
+			break;
+
+		paramsBuffersBusy_[index] = true;
+		waitingFrames_.pop_front();
+
+		ipa_->fillParamsBuffer(frame, index);
+	}
+}
+
 /**
  * \brief Starts the Software ISP streaming operation
  * \return 0 on success, any other value indicates an error
@@ -317,34 +355,98 @@ int SoftwareIsp::start()
 		return ret;
 
 	ispWorkerThread_.start();
+	running_ = true;
 	return 0;
 }
 
 /**
  * \brief Stops the Software ISP streaming operation
+ *
+ * The frames whose parameters buffer has been filled by the IPA are processed
+ * and completed. All other queued frames are completed with the FrameCancelled
+ * status.
  */
 void SoftwareIsp::stop()
 {
+	/*
+	 * Stop the IPA first, while the worker thread still runs. The
+	 * parameters buffers filled by the IPA are delivered while it stops,
+	 * and their frames are queued to the worker. The IPA must not be asked
+	 * to fill any other buffer from then on.
+	 */
+	running_ = false;
+	ipa_->stop();
+
+	if (ispWorkerThread_.isRunning())
+		debayer_->invokeMethod(&DebayerCpu::stop, ConnectionTypeBlocking);
+
 	ispWorkerThread_.exit();
 	ispWorkerThread_.wait();
 
-	ipa_->stop();
+	/* Deliver the completion of the frames processed by the worker. */
+	Thread::current()->dispatchMessages(Message::Type::InvokeMessage, this);
+
+	for (auto &[frame, pending] : pendingFrames_) {
+		for (auto &[stream, buffer] : pending.outputs) {
+			buffer->_d()->metadata().status = FrameMetadata::FrameCancelled;
+			outputBufferReady.emit(buffer);
+		}
+
+		pending.input->_d()->metadata().status = FrameMetadata::FrameCancelled;
+		inputBufferReady.emit(pending.input);
+	}
+
+	pendingFrames_.clear();
+	waitingFrames_.clear();
+	processingFrames_.clear();
+	paramsBuffersBusy_.fill(false);
 }
 
 /**
  * \brief Passes the input framebuffer to the ISP worker to process
+ * \param[in] frame The frame number
  * \param[in] input The input framebuffer
- * \param[out] output The framebuffer to write the processed frame to
+ * \param[out] outputs The framebuffers to write the processed frame to
+ *
+ * The frame is processed with the parameters stored in the parameters buffer
+ * associated with \a frame. The \a outputs are ordered as the configured
+ * streams, with a null buffer for the streams not being captured. All the
+ * outputs are produced in a single pass over the input.
  */
-void SoftwareIsp::process(FrameBuffer *input, FrameBuffer *output)
+void SoftwareIsp::process(uint32_t frame, FrameBuffer *input,
+			  const std::vector<FrameBuffer *> &outputs)
 {
+	const DebayerParams *params =
+		&(*sharedParams_)[frame % kDebayerParamsBufferCount];
+
 	debayer_->invokeMethod(&DebayerCpu::process,
-			       ConnectionTypeQueued, input, output, debayerParams_);
+			       ConnectionTypeQueued, frame, input, outputs, params);
 }
 
-void SoftwareIsp::saveIspParams()
+void SoftwareIsp::paramsBufferReady(uint32_t frame)
 {
-	debayerParams_ = *sharedParams_;
+	/*
+	 * Leave the frame pending if the worker thread has been stopped, it
+	 * is cancelled by stop().
+	 */
+	if (!ispWorkerThread_.isRunning())
+		return;
+
+	auto it = pendingFrames_.find(frame);
+	if (it == pendingFrames_.end())
+		return;
+
+	const PendingFrame &pending = it->second;
+	std::vector<FrameBuffer *> outputs;
+	for (const Stream *stream : streams_) {
+		auto output = pending.outputs.find(stream);
+		outputs.push_back(output != pending.outputs.end() ? output->second : nullptr);
+	}
+
+	processingFrames_[pending.input] = frame;
+	process(frame, pending.input, outputs);
+
+	pendingFrames_.erase(it);
 }
 
 void SoftwareIsp::setSensorCtrls(const ControlList &sensorControls)
@@ -352,13 +454,26 @@ void SoftwareIsp::setSensorCtrls(const ControlList &sensorControls)
 	setSensorControls.emit(sensorControls);
 }
 
-void SoftwareIsp::statsReady()
+void SoftwareIsp::statsReady(uint32_t frame, uint32_t bufferId)
 {
-	ispStatsReady.emit();
+	ispStatsReady.emit(frame, bufferId);
+}
+
+void SoftwareIsp::statsProcessed(uint32_t bufferId)
+{
+	debayer_->releaseStatsBuffer(bufferId);
 }
 
 void SoftwareIsp::inputReady(FrameBuffer *input)
 {
+	/* The frame has been processed, release its parameters buffer. */
+	auto it = processingFrames_.find(input);
+	if (it != processingFrames_.end()) {
+		paramsBuffersBusy_[it->second % kDebayerParamsBufferCount] = false;
+		processingFrames_.erase(it);
+		fillParamsBuffers();
+	}
+
 	inputBufferReady.emit(input);
 }
 
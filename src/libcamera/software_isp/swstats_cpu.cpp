@@ -11,6 +11,8 @@
 
 #include "swstats_cpu.h"
 
+#include <algorithm>
+
 #include <libcamera/base/log.h>
 
 #include <libcamera/stream.h>
@@ -45,6 +47,11 @@ namespace libcamera {
  * \fn const SharedFD &SwStatsCpu::getStatsFD()
  * \brief Get the file descriptor for the statistics
  *
+ * The file descriptor refers to a shared memory region holding an array of
+ * kSwIspStatsBufferCount SwIspStats buffers. The statistics of each frame are
+ * stored in the buffer whose index is signalled by statsReady, and the buffer
+ * must be released with releaseBuffer() once the statistics have been read.
+ *
  * \return The file descriptor
  */
 
@@ -62,10 +69,11 @@ namespace libcamera {
  */
 
 /**
- * \fn void SwStatsCpu::processLine0(unsigned int y, const uint8_t *src[])
+ * \fn void SwStatsCpu::processLine0(unsigned int y, const uint8_t *src[], unsigned int stripe)
  * \brief Process line 0
  * \param[in] y The y coordinate.
  * \param[in] src The input data.
+ * \param[in] stripe The index of the stripe the line belongs to.
  *
  * This function processes line 0 for input formats with
  * patternSize height == 1.
@@ -74,10 +82,11 @@ namespace libcamera {
  */
 
 /**
- * \fn void SwStatsCpu::processLine2(unsigned int y, const uint8_t *src[])
+ * \fn void SwStatsCpu::processLine2(unsigned int y, const uint8_t *src[], unsigned int stripe)
  * \brief Process line 2 and 3
  * \param[in] y The y coordinate.
  * \param[in] src The input data.
+ * \param[in] stripe The index of the stripe the line belongs to.
  *
  * This function processes line 2 and 3 for input formats with
  * patternSize height == 4.
@@ -85,14 +94,19 @@ namespace libcamera {
  */
 
 /**
- * \var Signal<> SwStatsCpu::statsReady
+ * \var Signal<uint32_t, uint32_t> SwStatsCpu::statsReady
  * \brief Signals that the statistics are ready
+ *
+ * The signal carries the frame number and the index of the buffer, in the
+ * shared memory ring of statistics buffers, holding the statistics for that
+ * frame.
  */
 
 /**
  * \typedef SwStatsCpu::statsProcessFn
  * \brief Called when there is data to get statistics from
  * \param[in] src The input data
+ * \param[out] stats The statistics to accumulate the line's data into
  *
  * These functions take an array of (patternSize_.height + 1) src
  * pointers each pointing to a line in the source image. The middle
@@ -130,8 +144,10 @@ namespace libcamera {
 LOG_DEFINE_CATEGORY(SwStatsCpu)
 
 SwStatsCpu::SwStatsCpu()
-	: sharedStats_("softIsp_stats")
+	: sharedStats_("softIsp_stats"), stripeStats_(1), bufferId_(-1)
 {
+	busy_.fill(false);
+
 	if (!sharedStats_)
 		LOG(SwStatsCpu, Error)
 			<< "Failed to create shared memory for statistics";
@@ -157,14 +173,14 @@ static constexpr unsigned int kBlueYMul = 29; /* 0.114 * 256 */
 	yVal = r * kRedYMul;               \
 	yVal += g * kGreenYMul;            \
 	yVal += b * kBlueYMul;             \
-	stats_.yHistogram[yVal * SwIspStats::kYHistogramSize / (256 * 256 * (div))]++;
+	stats.yHistogram[yVal * SwIspStats::kYHistogramSize / (256 * 256 * (div))]++;
 
 #define SWSTATS_FINISH_LINE_STATS() \
-	stats_.sumR_ += sumR;       \
-	stats_.sumG_ += sumG;       \
-	stats_.sumB_ += sumB;
+	stats.sumR_ += sumR;        \
+	stats.sumG_ += sumG;        \
+	stats.sumB_ += sumB;
 
-void SwStatsCpu::statsBGGR8Line0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR8Line0(const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x;
 	const uint8_t *src1 = src[2] + window_.x;
@@ -189,7 +205,7 @@ void SwStatsCpu::statsBGGR8Line0(const uint8_t *src[])
 	SWSTATS_FINISH_LINE_STATS()
 }
 
-void SwStatsCpu::statsBGGR10Line0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR10Line0(const uint8_t *src[], SwIspStats &stats)
 {
 	const uint16_t *src0 = (const uint16_t *)src[1] + window_.x;
 	const uint16_t *src1 = (const uint16_t *)src[2] + window_.x;
@@ -215,7 +231,7 @@ void SwStatsCpu::statsBGGR10Line0(const uint8_t *src[])
 	SWSTATS_FINISH_LINE_STATS()
 }
 
-void SwStatsCpu::statsBGGR12Line0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR12Line0(const uint8_t *src[], SwIspStats &stats)
 {
 	const uint16_t *src0 = (const uint16_t *)src[1] + window_.x;
 	const uint16_t *src1 = (const uint16_t *)src[2] + window_.x;
@@ -241,7 +257,7 @@ void SwStatsCpu::statsBGGR12Line0(const uint8_t *src[])
 	SWSTATS_FINISH_LINE_STATS()
 }
 
-void SwStatsCpu::statsBGGR10PLine0(const uint8_t *src[])
+void SwStatsCpu::statsBGGR10PLine0(const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x * 5 / 4;
 	const uint8_t *src1 = src[2] + window_.x * 5 / 4;
@@ -267,7 +283,7 @@ void SwStatsCpu::statsBGGR10PLine0(const uint8_t *src[])
 	SWSTATS_FINISH_LINE_STATS()
 }
 
-void SwStatsCpu::statsGBRG10PLine0(const uint8_t *src[])
+void SwStatsCpu::statsGBRG10PLine0(const uint8_t *src[], SwIspStats &stats)
 {
 	const uint8_t *src0 = src[1] + window_.x * 5 / 4;
 	const uint8_t *src1 = src[2] + window_.x * 5 / 4;
@@ -296,6 +312,10 @@ void SwStatsCpu::statsGBRG10PLine0(const uint8_t *src[])
 /**
  * \brief Reset state to start statistics gathering for a new frame
  *
+ * Reserve a free statistics buffer for the frame. If all buffers are still in
+ * use by the consumer of the statistics, statistics are not gathered for the
+ * frame, and finishFrame() drops it.
+ *
  * This may only be called after a successful setWindow() call.
  */
 void SwStatsCpu::startFrame(void)
@@ -303,21 +323,101 @@ void SwStatsCpu::startFrame(void)
 	if (window_.width == 0)
 		LOG(SwStatsCpu, Error) << "Calling startFrame() without setWindow()";
 
-	stats_.sumR_ = 0;
-	stats_.sumB_ = 0;
-	stats_.sumG_ = 0;
-	stats_.yHistogram.fill(0);
+	{
+		MutexLocker locker(mutex_);
+
+		auto it = std::find(busy_.begin(), busy_.end(), false);
+		if (it == busy_.end()) {
+			bufferId_ = -1;
+			return;
+		}
+
+		*it = true;
+		bufferId_ = it - busy_.begin();
+	}
+
+	for (StripeStats &stripe : stripeStats_) {
+		stripe.stats.sumR_ = 0;
+		stripe.stats.sumB_ = 0;
+		stripe.stats.sumG_ = 0;
+		stripe.stats.yHistogram.fill(0);
+	}
 }
 
 /**
  * \brief Finish statistics calculation for the current frame
+ * \param[in] frame The frame number
  *
- * This may only be called after a successful setWindow() call.
+ * Merge the partial statistics of all stripes into the shared memory buffer
+ * reserved by startFrame() and emit the statsReady signal. The buffer stays in
+ * use until it is released with releaseBuffer(), allowing the IPA to read the
+ * statistics of a frame while the following frames are being processed. When
+ * the IPA lags by kSwIspStatsBufferCount frames, the statistics of the
+ * following frames are dropped until a buffer gets released.
+ *
+ * This may only be called after a successful setWindow() call, once all
+ * stripes have been processed.
+ */
+void SwStatsCpu::finishFrame(uint32_t frame)
+{
+	if (bufferId_ < 0) {
+		LOG(SwStatsCpu, Debug)
+			<< "No free statistics buffer, dropping statistics for frame "
+			<< frame;
+		return;
+	}
+
+	const uint32_t bufferId = bufferId_;
+	SwIspStats &stats = (*sharedStats_)[bufferId];
+
+	stats = stripeStats_[0].stats;
+
+	for (unsigned int i = 1; i < stripeStats_.size(); i++) {
+		const SwIspStats &stripe = stripeStats_[i].stats;
+
+		stats.sumR_ += stripe.sumR_;
+		stats.sumG_ += stripe.sumG_;
+		stats.sumB_ += stripe.sumB_;
+
+		for (unsigned int j = 0; j < SwIspStats::kYHistogramSize; j++)
+			stats.yHistogram[j] += stripe.yHistogram[j];
+	}
+
+	statsReady.emit(frame, bufferId);
+}
+
+/**
+ * \brief Release a statistics buffer
+ * \param[in] bufferId The index of the statistics buffer
+ *
+ * Return the buffer signalled by statsReady to the ring once its content has
+ * been consumed, making it available to store the statistics of a new frame.
+ *
+ * \context This function is \threadsafe.
+ */
+void SwStatsCpu::releaseBuffer(uint32_t bufferId)
+{
+	if (bufferId >= kSwIspStatsBufferCount) {
+		LOG(SwStatsCpu, Error) << "Invalid statistics buffer " << bufferId;
+		return;
+	}
+
+	MutexLocker locker(mutex_);
+	busy_[bufferId] = false;
+}
+
+/**
+ * \brief Set the number of stripes statistics are gathered for
+ * \param[in] count The number of stripes
+ *
+ * Frames may be processed in multiple horizontal stripes concurrently. To
+ * avoid synchronization on every line, statistics are accumulated separately
+ * for each stripe and merged in finishFrame(). Lines belonging to different
+ * stripes may be processed concurrently, lines of the same stripe may not.
  */
-void SwStatsCpu::finishFrame(void)
+void SwStatsCpu::setStripeCount(unsigned int count)
 {
-	*sharedStats_ = stats_;
-	statsReady.emit();
+	stripeStats_.resize(std::max(count, 1U));
 }
 
 /**
@@ -11,9 +11,13 @@
 
 #pragma once
 
+#include <array>
 #include <stdint.h>
+#include <vector>
 
+#include <libcamera/base/mutex.h>
 #include <libcamera/base/signal.h>
+#include <libcamera/base/thread_annotations.h>
 
 #include <libcamera/geometry.h>
 
@@ -40,42 +44,51 @@ public:
 
 	int configure(const StreamConfiguration &inputCfg);
 	void setWindow(const Rectangle &window);
+	void setStripeCount(unsigned int count);
 	void startFrame();
-	void finishFrame();
+	void finishFrame(uint32_t frame);
+	void releaseBuffer(uint32_t bufferId);
 
-	void processLine0(unsigned int y, const uint8_t *src[])
+	void processLine0(unsigned int y, const uint8_t *src[], unsigned int stripe)
 	{
-		if ((y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
+		if (bufferId_ < 0 ||
+		    (y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
 		    y >= (window_.y + window_.height))
 			return;
 
-		(this->*stats0_)(src);
+		(this->*stats0_)(src, stripeStats_[stripe].stats);
 	}
 
-	void processLine2(unsigned int y, const uint8_t *src[])
+	void processLine2(unsigned int y, const uint8_t *src[], unsigned int stripe)
 	{
-		if ((y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
+		if (bufferId_ < 0 ||
+		    (y & ySkipMask_) || y < static_cast<unsigned int>(window_.y) ||
 		    y >= (window_.y + window_.height))
 			return;
 
-		(this->*stats2_)(src);
+		(this->*stats2_)(src, stripeStats_[stripe].stats);
 	}
 
-	Signal<> statsReady;
+	Signal<uint32_t, uint32_t> statsReady;
 
 private:
-	using statsProcessFn = void (SwStatsCpu::*)(const uint8_t *src[]);
+	using statsProcessFn = void (SwStatsCpu::*)(const uint8_t *src[], SwIspStats &stats);
+
+	/* Cache line aligned to avoid false sharing between stripes */
+	struct alignas(64) StripeStats {
+		SwIspStats stats;
+	};
 
 	int setupStandardBayerOrder(BayerFormat::Order order);
 	/* Bayer 8 bpp unpacked */
-	void statsBGGR8Line0(const uint8_t *src[]);
+	void statsBGGR8Line0(const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 10 bpp unpacked */
-	void statsBGGR10Line0(const uint8_t *src[]);
+	void statsBGGR10Line0(const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 12 bpp unpacked */
-	void statsBGGR12Line0(const uint8_t *src[]);
+	void statsBGGR12Line0(const uint8_t *src[], SwIspStats &stats);
 	/* Bayer 10 bpp packed */
-	void statsBGGR10PLine0(const uint8_t *src[]);
-	void statsGBRG10PLine0(const uint8_t *src[]);
+	void statsBGGR10PLine0(const uint8_t *src[], SwIspStats &stats);
+	void statsGBRG10PLine0(const uint8_t *src[], SwIspStats &stats);
 
 	/* Variables set by configure(), used every line */
 	statsProcessFn stats0_;
@@ -90,8 +103,15 @@ private:
 
 	unsigned int xShift_;
 
-	SharedMemObject<SwIspStats> sharedStats_;
-	SwIspStats stats_;
+	SharedMemObject<std::array<SwIspStats, kSwIspStatsBufferCount>> sharedStats_;
+	std::vector<StripeStats> stripeStats_;
+
+	/* Statistics buffer for the current frame, -1 if the ring is full */
+	int bufferId_;
+
+	Mutex mutex_;
+	/* Statistics buffers in use, from startFrame() until released */
+	std::array<bool, kSwIspStatsBufferCount> busy_ LIBCAMERA_TSA_GUARDED_BY(mutex_);
 };
 
 } /* namespace libcamera */
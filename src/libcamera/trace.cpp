@@ -0,0 +1,452 @@
+/* SPDX-License-Identifier: LGPL-2.1-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Binary trace recorder
+ */
+
+#include "libcamera/internal/trace.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <new>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+/**
+ * \file trace.h
+ * \brief Binary trace recorder
+ */
+
+namespace libcamera {
+
+LOG_DEFINE_CATEGORY(Trace)
+
+namespace {
+
+constexpr char kTraceMagic[8] = { 'L', 'C', 'T', 'R', 'A', 'C', 'E', '\0' };
+constexpr uint32_t kTraceVersion = 1;
+
+constexpr unsigned int kMaxEvents = 256;
+constexpr size_t kChunkSize = 64 * 1024;
+constexpr size_t kDefaultSize = 64;
+
+} /* namespace */
+
+/*
+ * The trace file starts with a FileHeader, followed by the table of event
+ * descriptions at offset eventsOffset, and by the chunks at offset
+ * chunksOffset. All integers are stored in native byte order, the decoder
+ * uses the magic and version to validate the file.
+ */
+struct TraceRecorder::FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t pid;
+	uint32_t eventsOffset;
+	uint32_t eventSize;
+	uint32_t maxEvents;
+	uint32_t chunksOffset;
+	uint32_t chunkSize;
+	uint32_t recordSize;
+	std::atomic<uint32_t> numEvents;
+	std::atomic<uint32_t> numChunks;
+	std::atomic<uint32_t> dropped;
+	uint32_t reserved;
+	/* Monotonic and realtime clocks sampled when the trace was created. */
+	uint64_t monotonicBase;
+	uint64_t realtimeBase;
+};
+
+/*
+ * Event descriptions are fixed-size null-terminated strings. The event
+ * identifier stored in records is the index in the table plus one, zero
+ * marks the end of the records in a chunk.
+ */
+struct TraceRecorder::EventInfo {
+	char category[16];
+	char name[80];
+	char args[2][16];
+};
+
+/*
+ * The first record slot of each chunk stores the thread ID of the chunk
+ * owner in its args[0] field, with a zero event identifier.
+ */
+struct TraceRecorder::Record {
+	uint64_t timestamp;
+	uint16_t event;
+	uint8_t phase;
+	uint8_t reserved[5];
+	uint64_t args[2];
+};
+
+/* Chunk currently being filled by a thread. */
+struct TraceRecorder::ThreadBuffer {
+	Record *pos = nullptr;
+	Record *end = nullptr;
+};
+
+/**
+ * \class TraceRecorder
+ * \brief Record trace events in a compact binary format
+ *
+ * The TraceRecorder is a dependency-free alternative to the lttng-based
+ * tracepoints, suitable for systems where lttng isn't available. It records
+ * events with their timestamp and up to two integer arguments to a file, to
+ * be converted offline with the utils/tracepoints/convert-trace.py script.
+ *
+ * Recording is enabled by setting the LIBCAMERA_TRACE_FILE environment
+ * variable to the path of the trace file. A "%p" in the path is replaced with
+ * the process ID, which allows tracing isolated IPA modules in separate files.
+ * The size of the trace file is 64MiB by default, and can be overridden by the
+ * LIBCAMERA_TRACE_SIZE environment variable, in MiB.
+ *
+ * The file is memory-mapped and split in fixed-size chunks. Each thread owns
+ * a chunk that it fills without any locking, and claims a new chunk with a
+ * single atomic operation when the current one is full. As records are
+ * written directly to the mapped file, a trace is preserved even if the
+ * process crashes. When the file is full, further events are dropped and
+ * counted in the file header.
+ */
+
+bool TraceRecorder::destroyed_ = false;
+
+TraceRecorder::TraceRecorder()
+	: mem_(nullptr), size_(0), header_(nullptr), events_(nullptr),
+	  numEvents_(0), numChunks_(0), nextChunk_(0)
+{
+	const char *path = utils::secure_getenv("LIBCAMERA_TRACE_FILE");
+	if (!path)
+		return;
+
+	size_ = kDefaultSize;
+	const char *size = utils::secure_getenv("LIBCAMERA_TRACE_SIZE");
+	if (size) {
+		char *end;
+		unsigned long value = strtoul(size, &end, 10);
+		if (*end == '\0' && value > 0)
+			size_ = value;
+		else
+			LOG(Trace, Warning) << "Invalid trace size '" << size << "'";
+	}
+	size_ *= 1024 * 1024;
+
+	std::string file(path);
+	size_t pos = file.find("%p");
+	if (pos != std::string::npos)
+		file.replace(pos, 2, std::to_string(getpid()));
+
+	int ret = open(file);
+	if (ret < 0) {
+		LOG(Trace, Error)
+			<< "Failed to create trace file '" << file << "': "
+			<< strerror(-ret);
+		return;
+	}
+
+	LOG(Trace, Info) << "Recording trace to '" << file << "'";
+}
+
+TraceRecorder::~TraceRecorder()
+{
+	destroyed_ = true;
+
+	if (mem_)
+		munmap(mem_, size_);
+}
+
+/**
+ * \brief Retrieve the trace recorder instance
+ *
+ * The TraceRecorder is a singleton, created on first use.
+ *
+ * \return The trace recorder instance if tracing is enabled, nullptr otherwise
+ */
+TraceRecorder *TraceRecorder::instance()
+{
+	static TraceRecorder recorder;
+
+	if (destroyed_ || !recorder.mem_)
+		return nullptr;
+
+	return &recorder;
+}
+
+int TraceRecorder::open(const std::string &path)
+{
+	/* The layout of the file is parsed by the trace converter. */
+	static_assert(sizeof(FileHeader) == 72, "Invalid size of trace header");
+	static_assert(sizeof(Record) == 32, "Invalid size of trace record");
+	static_assert(std::atomic<uint32_t>::is_always_lock_free,
+		      "Trace file atomics must be lock-free");
+
+	UniqueFD fd(::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC,
+			   0644));
+	if (!fd.isValid())
+		return -errno;
+
+	/* The file is sparse, only the chunks being used take disk space. */
+	if (ftruncate(fd.get(), size_) < 0)
+		return -errno;
+
+	void *mem = mmap(nullptr, size_, PROT_READ | PROT_WRITE, MAP_SHARED,
+			 fd.get(), 0);
+	if (mem == MAP_FAILED)
+		return -errno;
+
+	size_t eventsOffset = utils::alignUp(sizeof(FileHeader), 64);
+	size_t chunksOffset = utils::alignUp(eventsOffset + kMaxEvents * sizeof(EventInfo),
+					     kChunkSize);
+	if (chunksOffset + kChunkSize > size_) {
+		munmap(mem, size_);
+		return -ENOSPC;
+	}
+
+	timespec monotonic;
+	timespec realtime;
+	clock_gettime(CLOCK_MONOTONIC, &monotonic);
+	clock_gettime(CLOCK_REALTIME, &realtime);
+
+	header_ = new (mem) FileHeader();
+	memcpy(header_->magic, kTraceMagic, sizeof(header_->magic));
+	header_->version = kTraceVersion;
+	header_->pid = getpid();
+	header_->eventsOffset = eventsOffset;
+	header_->eventSize = sizeof(EventInfo);
+	header_->maxEvents = kMaxEvents;
+	header_->chunksOffset = chunksOffset;
+	header_->chunkSize = kChunkSize;
+	header_->recordSize = sizeof(Record);
+	header_->monotonicBase = monotonic.tv_sec * 1000000000ULL + monotonic.tv_nsec;
+	header_->realtimeBase = realtime.tv_sec * 1000000000ULL + realtime.tv_nsec;
+
+	events_ = reinterpret_cast<EventInfo *>(static_cast<uint8_t *>(mem) + eventsOffset);
+	numChunks_ = (size_ - chunksOffset) / kChunkSize;
+	mem_ = mem;
+
+	return 0;
+}
+
+/**
+ * \brief Record a trace event
+ * \param[in] event The event
+ * \param[in] phase The event phase
+ * \param[in] arg0 The first event argument
+ * \param[in] arg1 The second event argument
+ *
+ * This function is called by the TraceEvent class and shouldn't be called
+ * directly.
+ */
+void TraceRecorder::record(const TraceEvent &event, Phase phase, uint64_t arg0,
+			   uint64_t arg1)
+{
+	thread_local ThreadBuffer buffer;
+
+	uint16_t id = event.id_.load(std::memory_order_acquire);
+	if (!id) {
+		id = registerEvent(event);
+		if (!id)
+			return;
+	}
+
+	if (buffer.pos == buffer.end && !allocateChunk(&buffer)) {
+		header_->dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	Record *record = buffer.pos++;
+	record->timestamp = std::chrono::duration_cast<std::chrono::nanoseconds>(
+		utils::clock::now().time_since_epoch()).count();
+	record->phase = phase;
+	record->args[0] = arg0;
+	record->args[1] = arg1;
+	/* Write the identifier last, it marks the record as valid. */
+	__atomic_store_n(&record->event, id, __ATOMIC_RELEASE);
+}
+
+uint16_t TraceRecorder::registerEvent(const TraceEvent &event)
+{
+	MutexLocker locker(mutex_);
+
+	/* The event may have been registered concurrently by another thread. */
+	uint16_t id = event.id_.load(std::memory_order_relaxed);
+	if (id)
+		return id;
+
+	/* Events with the same category and name share the same entry. */
+	for (unsigned int i = 0; i < numEvents_; ++i) {
+		const EventInfo &info = events_[i];
+		if (!strncmp(info.category, event.category_, sizeof(info.category)) &&
+		    !strncmp(info.name, event.name_, sizeof(info.name))) {
+			id = i + 1;
+			event.id_.store(id, std::memory_order_release);
+			return id;
+		}
+	}
+
+	if (numEvents_ == kMaxEvents) {
+		LOG(Trace, Warning)
+			<< "Too many trace events, ignoring "
+			<< event.category_ << ":" << event.name_;
+		return 0;
+	}
+
+	EventInfo &info = events_[numEvents_];
+	utils::strlcpy(info.category, event.category_, sizeof(info.category));
+	utils::strlcpy(info.name, event.name_, sizeof(info.name));
+	for (unsigned int i = 0; i < 2; ++i) {
+		if (event.args_[i])
+			utils::strlcpy(info.args[i], event.args_[i],
+				       sizeof(info.args[i]));
+	}
+
+	id = ++numEvents_;
+	header_->numEvents.store(numEvents_, std::memory_order_release);
+	event.id_.store(id, std::memory_order_release);
+
+	return id;
+}
+
+bool TraceRecorder::allocateChunk(ThreadBuffer *buffer)
+{
+	/* Avoid wrapping the counter around once the file is full. */
+	if (nextChunk_.load(std::memory_order_relaxed) >= numChunks_)
+		return false;
+
+	unsigned int index = nextChunk_.fetch_add(1, std::memory_order_relaxed);
+	if (index >= numChunks_) {
+		/* Stop recording for this thread, the file is full. */
+		buffer->pos = buffer->end = nullptr;
+		return false;
+	}
+
+	header_->numChunks.fetch_add(1, std::memory_order_relaxed);
+
+	uint8_t *chunk = static_cast<uint8_t *>(mem_) + header_->chunksOffset
+		       + index * kChunkSize;
+	Record *records = reinterpret_cast<Record *>(chunk);
+
+	records[0].args[0] = Thread::currentId();
+
+	buffer->pos = &records[1];
+	buffer->end = &records[kChunkSize / sizeof(Record)];
+
+	return true;
+}
+
+/**
+ * \enum TraceRecorder::Phase
+ * \brief Phase of a trace event
+ * \var TraceRecorder::Begin
+ * \brief Start of a synchronous duration event
+ * \var TraceRecorder::End
+ * \brief End of a synchronous duration event
+ * \var TraceRecorder::Instant
+ * \brief Instantaneous event
+ * \var TraceRecorder::AsyncBegin
+ * \brief Start of an asynchronous duration event, identified by its first
+ * argument
+ * \var TraceRecorder::AsyncEnd
+ * \brief End of an asynchronous duration event, identified by its first
+ * argument
+ */
+
+/**
+ * \class TraceEvent
+ * \brief A trace event recorded by the TraceRecorder
+ *
+ * The TraceEvent class describes an event recorded in the trace. Each event
+ * has a category and a name, and can carry up to two integer arguments, whose
+ * names are stored in the trace file.
+ *
+ * Trace events are meant to be instantiated as static objects, and recorded
+ * with the begin(), end(), instant(), asyncBegin() and asyncEnd() functions.
+ * The event is registered with the TraceRecorder the first time it is
+ * recorded. Recording an event is a no-op when tracing is disabled.
+ *
+ * \code{.cpp}
+ * static const TraceEvent traceQueue("v4l2", "qbuf", "index");
+ *
+ * traceQueue.instant(buffer->index);
+ * \endcode
+ */
+
+/**
+ * \fn TraceEvent::TraceEvent()
+ * \brief Construct a trace event
+ * \param[in] category The event category
+ * \param[in] name The event name
+ * \param[in] arg0 The name of the first argument
+ * \param[in] arg1 The name of the second argument
+ *
+ * The \a category, \a name, \a arg0 and \a arg1 strings are referenced by the
+ * event and must outlive it.
+ */
+
+/**
+ * \fn TraceEvent::begin()
+ * \brief Record the start of a duration event
+ * \param[in] arg0 The first event argument
+ * \param[in] arg1 The second event argument
+ */
+
+/**
+ * \fn TraceEvent::end()
+ * \brief Record the end of a duration event
+ * \param[in] arg0 The first event argument
+ * \param[in] arg1 The second event argument
+ */
+
+/**
+ * \fn TraceEvent::instant()
+ * \brief Record an instantaneous event
+ * \param[in] arg0 The first event argument
+ * \param[in] arg1 The second event argument
+ */
+
+/**
+ * \fn TraceEvent::asyncBegin()
+ * \brief Record the start of an asynchronous duration event
+ * \param[in] id The identifier of the asynchronous event
+ * \param[in] arg1 The second event argument
+ *
+ * Asynchronous events can start and end in different threads. The start and
+ * end are matched by their \a id.
+ */
+
+/**
+ * \fn TraceEvent::asyncEnd()
+ * \brief Record the end of an asynchronous duration event
+ * \param[in] id The identifier of the asynchronous event
+ * \param[in] arg1 The second event argument
+ */
+
+/**
+ * \class TraceScope
+ * \brief Record a duration event for the lifetime of a scope
+ *
+ * The TraceScope records the start of a duration event when constructed, and
+ * its end when destroyed.
+ */
+
+/**
+ * \fn TraceScope::TraceScope()
+ * \brief Record the start of a duration event
+ * \param[in] event The event
+ * \param[in] arg0 The first event argument
+ * \param[in] arg1 The second event argument
+ */
+
+/**
+ * \fn TraceScope::~TraceScope()
+ * \brief Record the end of the duration event
+ */
+
+} /* namespace libcamera */
@@ -10,6 +10,7 @@
 #include <algorithm>
 #include <array>
 #include <fcntl.h>
+#include <functional>
 #include <iomanip>
 #include <sstream>
 #include <string.h>
@@ -31,6 +32,7 @@
 #include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/media_device.h"
 #include "libcamera/internal/media_object.h"
+#include "libcamera/internal/trace.h"
 
 /**
  * \file v4l2_videodevice.h
@@ -41,6 +43,13 @@ namespace libcamera {
 
 LOG_DECLARE_CATEGORY(V4L2)
 
+namespace {
+
+const TraceEvent traceQueueBuffer("v4l2", "qbuf", "fd", "index");
+const TraceEvent traceDequeueBuffer("v4l2", "dqbuf", "fd", "index");
+
+} /* namespace */
+
 /**
  * \struct V4L2Capability
  * \brief struct v4l2_capability object wrapper and helpers
@@ -162,6 +171,11 @@ LOG_DECLARE_CATEGORY(V4L2)
  * index associations to help selecting V4L2 buffers. It tracks, for every
  * entry, if the V4L2 buffer is in use, and offers lookup of the best free V4L2
  * buffer for a set of dmabufs.
+ *
+ * Lookups are performed in constant time, as they are on the hot path of
+ * every queueBuffer() call. Entries are indexed by a hash of their dmabufs,
+ * and free entries are kept in a list ordered by release time, from which the
+ * least recently released entry is evicted when no cache hit is found.
  */
 
 /**
@@ -173,9 +187,11 @@ LOG_DECLARE_CATEGORY(V4L2)
  * buffer import, with buffers added to the cache as they are queued.
  */
 V4L2BufferCache::V4L2BufferCache(unsigned int numEntries)
-	: lastUsedCounter_(1), missCounter_(0)
+	: cache_(numEntries), freeHead_(kNoEntry), freeTail_(kNoEntry),
+	  numUsed_(0), missCounter_(0)
 {
-	cache_.resize(numEntries);
+	for (unsigned int index = 0; index < cache_.size(); index++)
+		pushFree(index);
 }
 
 /**
@@ -187,12 +203,16 @@ V4L2BufferCache::V4L2BufferCache(unsigned int numEntries)
  * allocated.
  */
 V4L2BufferCache::V4L2BufferCache(const std::vector<std::unique_ptr<FrameBuffer>> &buffers)
-	: lastUsedCounter_(1), missCounter_(0)
+	: cache_(buffers.size()), freeHead_(kNoEntry), freeTail_(kNoEntry),
+	  numUsed_(0), missCounter_(0)
 {
-	for (const std::unique_ptr<FrameBuffer> &buffer : buffers)
-		cache_.emplace_back(true,
-				    lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel),
-				    *buffer.get());
+	for (unsigned int index = 0; index < cache_.size(); index++) {
+		size_t key = hash(*buffers[index]);
+
+		cache_[index].set(*buffers[index], key);
+		index_.emplace(key, index);
+		pushFree(index);
+	}
 }
 
 V4L2BufferCache::~V4L2BufferCache()
@@ -206,12 +226,7 @@ V4L2BufferCache::~V4L2BufferCache()
  */
 bool V4L2BufferCache::isEmpty() const
 {
-	for (auto const &entry : cache_) {
-		if (!entry.free_)
-			return false;
-	}
-
-	return true;
+	return numUsed_ == 0;
 }
 
 /**
@@ -221,48 +236,60 @@ bool V4L2BufferCache::isEmpty() const
  * Find the best V4L2 buffer index to be used for the FrameBuffer \a buffer
  * based on previous mappings of frame buffers to V4L2 buffers. If a free V4L2
  * buffer previously used with the same dmabufs as \a buffer is found in the
- * cache, return its index. Otherwise return the index of the first free V4L2
- * buffer and record its association with the dmabufs of \a buffer.
+ * cache, return its index. Otherwise return the index of the least recently
+ * released free V4L2 buffer and record its association with the dmabufs of
+ * \a buffer.
  *
  * \return The index of the best V4L2 buffer, or -ENOENT if no free V4L2 buffer
  * is available
  */
 int V4L2BufferCache::get(const FrameBuffer &buffer)
 {
-	bool hit = false;
-	int use = -1;
-	uint64_t oldest = UINT64_MAX;
+	size_t key = hash(buffer);
 
-	for (unsigned int index = 0; index < cache_.size(); index++) {
-		const Entry &entry = cache_[index];
+	/* Try to find a cache hit by comparing the planes. */
+	auto [first, last] = index_.equal_range(key);
+	for (auto it = first; it != last; ++it) {
+		unsigned int index = it->second;
+		Entry &entry = cache_[index];
 
-		if (!entry.free_)
+		if (!entry.free_ || !(entry == buffer))
 			continue;
 
-		/* Try to find a cache hit by comparing the planes. */
-		if (entry == buffer) {
-			hit = true;
-			use = index;
-			break;
-		}
+		removeFree(index);
+		entry.free_ = false;
+		numUsed_++;
 
-		if (entry.lastUsed_ < oldest) {
-			use = index;
-			oldest = entry.lastUsed_;
-		}
+		return index;
 	}
 
-	if (!hit)
-		missCounter_++;
+	missCounter_++;
 
-	if (use < 0)
+	if (freeHead_ == kNoEntry)
 		return -ENOENT;
 
-	cache_[use] = Entry(false,
-			    lastUsedCounter_.fetch_add(1, std::memory_order_acq_rel),
-			    buffer);
+	unsigned int index = freeHead_;
+	Entry &entry = cache_[index];
+
+	removeFree(index);
+
+	/* Drop the association of the evicted entry from the index. */
+	if (entry.valid_) {
+		auto [begin, end] = index_.equal_range(entry.hash_);
+		for (auto it = begin; it != end; ++it) {
+			if (it->second == index) {
+				index_.erase(it);
+				break;
+			}
+		}
+	}
+
+	entry.set(buffer, key);
+	entry.free_ = false;
+	index_.emplace(key, index);
+	numUsed_++;
 
-	return use;
+	return index;
 }
 
 /**
@@ -272,19 +299,75 @@ int V4L2BufferCache::get(const FrameBuffer &buffer)
 void V4L2BufferCache::put(unsigned int index)
 {
 	ASSERT(index < cache_.size());
-	cache_[index].free_ = true;
+
+	Entry &entry = cache_[index];
+	if (entry.free_)
+		return;
+
+	entry.free_ = true;
+	numUsed_--;
+	pushFree(index);
+}
+
+size_t V4L2BufferCache::hash(const FrameBuffer &buffer)
+{
+	size_t hash = 0;
+
+	for (const FrameBuffer::Plane &plane : buffer.planes()) {
+		hash = hash * 31 + std::hash<int>{}(plane.fd.get());
+		hash = hash * 31 + std::hash<unsigned int>{}(plane.length);
+	}
+
+	return hash;
+}
+
+void V4L2BufferCache::pushFree(unsigned int index)
+{
+	Entry &entry = cache_[index];
+
+	entry.prev_ = freeTail_;
+	entry.next_ = kNoEntry;
+
+	if (freeTail_ != kNoEntry)
+		cache_[freeTail_].next_ = index;
+	else
+		freeHead_ = index;
+
+	freeTail_ = index;
+}
+
+void V4L2BufferCache::removeFree(unsigned int index)
+{
+	Entry &entry = cache_[index];
+
+	if (entry.prev_ != kNoEntry)
+		cache_[entry.prev_].next_ = entry.next_;
+	else
+		freeHead_ = entry.next_;
+
+	if (entry.next_ != kNoEntry)
+		cache_[entry.next_].prev_ = entry.prev_;
+	else
+		freeTail_ = entry.prev_;
+
+	entry.prev_ = kNoEntry;
+	entry.next_ = kNoEntry;
 }
 
 V4L2BufferCache::Entry::Entry()
-	: free_(true), lastUsed_(0)
+	: free_(true), valid_(false), hash_(0), prev_(kNoEntry), next_(kNoEntry)
 {
 }
 
-V4L2BufferCache::Entry::Entry(bool free, uint64_t lastUsed, const FrameBuffer &buffer)
-	: free_(free), lastUsed_(lastUsed)
+void V4L2BufferCache::Entry::set(const FrameBuffer &buffer, size_t hash)
 {
+	/* Reuse the planes storage to avoid allocations on the hot path. */
+	planes_.clear();
 	for (const FrameBuffer::Plane &plane : buffer.planes())
 		planes_.emplace_back(plane);
+
+	hash_ = hash;
+	valid_ = true;
 }
 
 bool V4L2BufferCache::Entry::operator==(const FrameBuffer &buffer) const
@@ -534,8 +617,8 @@ std::ostream &operator<<(std::ostream &out, const V4L2DeviceFormat &f)
  */
 V4L2VideoDevice::V4L2VideoDevice(const std::string &deviceNode)
 	: V4L2Device(deviceNode), formatInfo_(nullptr), cache_(nullptr),
-	  fdBufferNotifier_(nullptr), state_(State::Stopped),
-	  watchdogDuration_(0.0)
+	  fdBufferNotifier_(nullptr), nonBlocking_(false),
+	  state_(State::Stopped), watchdogDuration_(0.0)
 {
 	/*
 	 * We default to an MMAP based CAPTURE video device, however this will
@@ -575,6 +658,8 @@ int V4L2VideoDevice::open()
 	if (ret < 0)
 		return ret;
 
+	nonBlocking_ = true;
+
 	ret = ioctl(VIDIOC_QUERYCAP, &caps_);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -676,6 +761,9 @@ int V4L2VideoDevice::open(SharedFD handle, enum v4l2_buf_type type)
 		return ret;
 	}
 
+	/* Buffers can only be dequeued in batches from non-blocking handles. */
+	nonBlocking_ = fcntl(fd(), F_GETFL) & O_NONBLOCK;
+
 	ret = ioctl(VIDIOC_QUERYCAP, &caps_);
 	if (ret < 0) {
 		LOG(V4L2, Error)
@@ -1622,41 +1710,95 @@ int V4L2VideoDevice::queueBuffer(FrameBuffer *buffer)
 /**
  * \brief Slot to handle completed buffer events from the V4L2 video device
  *
- * When this slot is called, a Buffer has become available from the device, and
- * will be emitted through the bufferReady Signal.
+ * When this slot is called, one or more Buffers have become available from the
+ * device. All available buffers are dequeued, and emitted in order through the
+ * bufferReady Signal. This avoids a round trip through the event loop for each
+ * buffer when the loop falls behind.
+ *
+ * Each buffer is emitted as soon as it is dequeued, before dequeuing the next
+ * one. The bufferReady slots may thus re-enter this function through a nested
+ * event loop, or stop the device, without reordering buffers or completing
+ * them after streamOff().
  *
  * For Capture video devices the FrameBuffer will contain valid data.
  * For Output video devices the FrameBuffer can be considered empty.
  */
 void V4L2VideoDevice::bufferAvailable()
 {
-	FrameBuffer *buffer = dequeueBuffer();
-	if (!buffer)
-		return;
+	unsigned int dequeued = 0;
+
+	while (!queuedBuffers_.empty()) {
+		FrameBuffer *buffer;
+		int ret = dequeueBuffer(&buffer);
+		if (ret == -EAGAIN && dequeued)
+			break;
 
-	/* Notify anyone listening to the device. */
-	bufferReady.emit(buffer);
+		if (ret < 0) {
+			LOG(V4L2, Error)
+				<< "Failed to dequeue buffer: " << strerror(-ret);
+			break;
+		}
+
+		dequeued++;
+
+		if (buffer) {
+			/*
+			 * Queue a buffer from the pending queue. If this
+			 * fails, log the error and continue, as the dequeued
+			 * buffer must still be completed.
+			 */
+			if (!pendingBuffersToQueue_.empty()) {
+				FrameBuffer *pending = pendingBuffersToQueue_.front();
+
+				pendingBuffersToQueue_.pop();
+				if (queueToDevice(pending))
+					LOG(V4L2, Error)
+						<< "Failed to re-queue pending buffer "
+						<< pending;
+			}
+
+			if (queuedBuffers_.empty()) {
+				fdBufferNotifier_->setEnabled(false);
+				watchdog_.stop();
+			} else if (watchdogDuration_) {
+				/*
+				 * Restart the watchdog timer if there are
+				 * buffers still queued in the device.
+				 */
+				watchdog_.start(std::chrono::duration_cast<std::chrono::milliseconds>(watchdogDuration_));
+			}
+
+			/* Notify anyone listening to the device. */
+			bufferReady.emit(buffer);
+		}
+
+		if (!nonBlocking_)
+			break;
+	}
 }
 
 /**
  * \brief Dequeue the next available buffer from the video device
+ * \param[out] buffer The dequeued buffer
  *
- * This function dequeues the next available buffer from the device. If no
- * buffer is available to be dequeued it will return nullptr immediately.
+ * This function dequeues the next available buffer from the device and fills
+ * its metadata. \a buffer is set to nullptr if the V4L2 buffer dequeued from
+ * the device isn't known, in which case it is ignored.
  *
- * Once a buffer is dequeued from the device, this function may also enqueue
- * a buffer that has been placed in the pending queue (due to reaching the V4L2
- * queue size limit. Note that if this enqueue fails, we log the error, but
- * continue running this function to completion.
+ * The caller is responsible for queueing buffers from the pending queue, and
+ * for updating the watchdog.
  *
- * \return A pointer to the dequeued buffer on success, or nullptr otherwise
+ * \return 0 on success, -EAGAIN if no buffer is available, or a negative error
+ * code otherwise
  */
-FrameBuffer *V4L2VideoDevice::dequeueBuffer()
+int V4L2VideoDevice::dequeueBuffer(FrameBuffer **buffer)
 {
 	struct v4l2_buffer buf = {};
 	struct v4l2_plane planes[VIDEO_MAX_PLANES] = {};
 	int ret;
 
+	*buffer = nullptr;
+
 	buf.type = bufferType_;
 	buf.memory = memoryType_;
 
@@ -1668,11 +1810,10 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	}
 
 	ret = ioctl(VIDIOC_DQBUF, &buf);
-	if (ret < 0) {
-		LOG(V4L2, Error)
-			<< "Failed to dequeue buffer: " << strerror(-ret);
-		return nullptr;
-	}
+	if (ret < 0)
+		return ret;
+
+	traceDequeueBuffer.instant(fd(), buf.index);
 
 	LOG(V4L2, Debug) << "Dequeuing buffer " << buf.index;
 
@@ -1693,39 +1834,30 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 		LOG(V4L2, Error)
 			<< "Dequeued unexpected buffer index " << buf.index;
 
-		return nullptr;
+		return 0;
 	}
 
 	cache_->put(buf.index);
 
-	FrameBuffer *buffer = it->second;
+	*buffer = it->second;
 	queuedBuffers_.erase(it);
 
-	if (!pendingBuffersToQueue_.empty()) {
-		FrameBuffer *pending = pendingBuffersToQueue_.front();
-
-		pendingBuffersToQueue_.pop();
-		/*
-		 * If the pending buffer enqueue fails, we must continue this
-		 * function to completion for the dequeue operation.
-		 */
-		if (queueToDevice(pending))
-			LOG(V4L2, Error)
-				<< "Failed to re-queue pending buffer "
-				<< pending;
-	}
+	fillMetadata(*buffer, buf, planes);
 
-	if (queuedBuffers_.empty()) {
-		fdBufferNotifier_->setEnabled(false);
-		watchdog_.stop();
-	} else if (watchdogDuration_) {
-		/*
-		 * Restart the watchdog timer if there are buffers still queued
-		 * in the device.
-		 */
-		watchdog_.start(std::chrono::duration_cast<std::chrono::milliseconds>(watchdogDuration_));
-	}
+	return 0;
+}
 
+/**
+ * \brief Fill the metadata of a dequeued buffer
+ * \param[in] buffer The dequeued buffer
+ * \param[in] buf The V4L2 buffer returned by VIDIOC_DQBUF
+ * \param[in] planes The V4L2 planes returned by VIDIOC_DQBUF
+ */
+void V4L2VideoDevice::fillMetadata(FrameBuffer *buffer,
+				   const struct v4l2_buffer &buf,
+				   const struct v4l2_plane *planes)
+{
+	bool multiPlanar = V4L2_TYPE_IS_MULTIPLANAR(buf.type);
 	FrameMetadata &metadata = buffer->_d()->metadata();
 
 	metadata.status = buf.flags & V4L2_BUF_FLAG_ERROR
@@ -1736,7 +1868,7 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 			   + buf.timestamp.tv_usec * 1000ULL;
 
 	if (V4L2_TYPE_IS_OUTPUT(buf.type))
-		return buffer;
+		return;
 
 	/*
 	 * Detect kernel drivers which do not reset the sequence number to zero
@@ -1766,7 +1898,7 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 				<< " != " << buffer->planes().size() << ")";
 
 			metadata.status = FrameMetadata::FrameError;
-			return buffer;
+			return;
 		}
 
 		/*
@@ -1791,7 +1923,7 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 						       });
 
 				metadata.status = FrameMetadata::FrameError;
-				return buffer;
+				return;
 			}
 
 			metadata.planes()[i].bytesused =
@@ -1809,8 +1941,6 @@ FrameBuffer *V4L2VideoDevice::dequeueBuffer()
 	} else {
 		metadata.planes()[0].bytesused = buf.bytesused;
 	}
-
-	return buffer;
 }
 
 /**
@@ -1964,6 +2094,8 @@ int V4L2VideoDevice::queueToDevice(FrameBuffer *buffer)
 		return ret;
 	}
 
+	traceQueueBuffer.instant(fd(), buf.index);
+
 	if (queuedBuffers_.empty()) {
 		fdBufferNotifier_->setEnabled(true);
 		if (watchdogDuration_)
@@ -0,0 +1,163 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * DmaBufAllocator buffer pooling test
+ */
+
+#include <iostream>
+#include <memory>
+#include <sys/stat.h>
+#include <vector>
+
+#include <libcamera/base/unique_fd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/dma_buf_allocator.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class DmaBufAllocatorTest : public Test
+{
+protected:
+	static constexpr unsigned int kNumBuffers = 4;
+
+	int init() override
+	{
+		allocator_ = make_unique<DmaBufAllocator>(DmaBufAllocator::DmaBufAllocatorFlag::CmaHeap |
+							  DmaBufAllocator::DmaBufAllocatorFlag::SystemHeap |
+							  DmaBufAllocator::DmaBufAllocatorFlag::UDmaBuf);
+		if (!allocator_->isValid()) {
+			cout << "No dma-buf provider available" << endl;
+			return TestSkip;
+		}
+
+		allocator_->setPoolLimit(64 << 20);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* A NV12 640x480 frame, with different sizes in the same class. */
+		const vector<unsigned int> planeSizes = { 640 * 480, 640 * 240 };
+		const vector<unsigned int> otherSizes = { 640 * 480, 640 * 240 - 1024 };
+
+		vector<unique_ptr<FrameBuffer>> buffers;
+		int ret = allocator_->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != kNumBuffers) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		DmaBufAllocator::PoolStats stats = allocator_->poolStats();
+		if (stats.hits != 0 || stats.misses != kNumBuffers) {
+			cerr << "Unexpected pool hits on first allocation" << endl;
+			return TestFail;
+		}
+
+		/* Freeing the buffers returns them to the pool. */
+		buffers.clear();
+
+		stats = allocator_->poolStats();
+		if (stats.buffers != kNumBuffers) {
+			cerr << "Expected " << kNumBuffers << " pooled buffers, got "
+			     << stats.buffers << endl;
+			return TestFail;
+		}
+
+		ret = allocator_->exportBuffers(kNumBuffers, otherSizes, &buffers);
+		if (ret != kNumBuffers) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		stats = allocator_->poolStats();
+		if (stats.hits != kNumBuffers || stats.buffers != 0 || stats.size != 0) {
+			cerr << "Pooled buffers not reused" << endl;
+			return TestFail;
+		}
+
+		for (const unique_ptr<FrameBuffer> &buffer : buffers) {
+			if (buffer->planes().size() != otherSizes.size() ||
+			    buffer->planes()[1].offset != otherSizes[0] ||
+			    buffer->planes()[1].length != otherSizes[1]) {
+				cerr << "Invalid buffer planes" << endl;
+				return TestFail;
+			}
+		}
+
+		/* Reducing the limit evicts the oldest buffers. */
+		buffers.clear();
+
+		size_t size = allocator_->poolStats().size;
+		allocator_->setPoolLimit(size / 2);
+
+		stats = allocator_->poolStats();
+		if (stats.buffers != kNumBuffers / 2 ||
+		    stats.evictions != kNumBuffers / 2) {
+			cerr << "Pool not trimmed to its limit" << endl;
+			return TestFail;
+		}
+
+		/* Buffers still referenced by the application are not reused. */
+		ret = allocator_->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != kNumBuffers) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		UniqueFD held = buffers[0]->planes()[0].fd.dup();
+		ino_t heldIno = inode(held.get());
+		buffers.clear();
+
+		stats = allocator_->poolStats();
+		ret = allocator_->exportBuffers(kNumBuffers, planeSizes, &buffers);
+		if (ret != kNumBuffers) {
+			cerr << "Failed to export buffers" << endl;
+			return TestFail;
+		}
+
+		for (const unique_ptr<FrameBuffer> &buffer : buffers) {
+			if (inode(buffer->planes()[0].fd.get()) == heldIno) {
+				cerr << "Buffer still referenced reused" << endl;
+				return TestFail;
+			}
+		}
+
+		DmaBufAllocator::PoolStats newStats = allocator_->poolStats();
+		if (newStats.hits - stats.hits != kNumBuffers - 1 ||
+		    newStats.evictions - stats.evictions != 1) {
+			cerr << "Buffer still referenced not evicted" << endl;
+			return TestFail;
+		}
+
+		/* Buffers outlive the allocator. */
+		allocator_.reset();
+		buffers.clear();
+
+		return TestPass;
+	}
+
+private:
+	static ino_t inode(int fd)
+	{
+		struct stat st;
+		if (fstat(fd, &st) < 0)
+			return 0;
+
+		return st.st_ino;
+	}
+
+	unique_ptr<DmaBufAllocator> allocator_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(DmaBufAllocatorTest)
@@ -0,0 +1,208 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Event dispatcher wakeup latency benchmark
+ */
+
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/resource.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/event_dispatcher_epoll.h>
+#include <libcamera/base/event_dispatcher_poll.h>
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+#include <libcamera/base/utils.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+class BenchmarkThread : public Thread
+{
+public:
+	BenchmarkThread(unsigned int count, unsigned int iterations)
+		: count_(count), iterations_(iterations), result_(TestFail)
+	{
+	}
+
+	int result() const { return result_; }
+	nanoseconds latency() const { return latency_; }
+
+protected:
+	void run() override
+	{
+		result_ = benchmark();
+	}
+
+private:
+	int benchmark()
+	{
+		vector<unique_ptr<EventNotifier>> notifiers;
+
+		for (unsigned int i = 0; i < count_; ++i) {
+			UniqueFD fd(eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK));
+			if (!fd.isValid()) {
+				cerr << "Failed to create eventfd: "
+				     << strerror(errno) << endl;
+				return TestFail;
+			}
+
+			auto notifier = make_unique<EventNotifier>(fd.get(),
+								   EventNotifier::Read);
+			notifier->activated.connect(this, [this, i]() { activated(i); });
+
+			fds_.push_back(std::move(fd));
+			notifiers.push_back(std::move(notifier));
+		}
+
+		EventDispatcher *dispatcher = eventDispatcher();
+		nanoseconds total{ 0 };
+
+		for (unsigned int i = 0; i < iterations_; ++i) {
+			/* Spread the wakeups over all notifiers. */
+			unsigned int index = (i * 7919) % count_;
+			uint64_t value = 1;
+
+			activated_ = -1;
+
+			if (write(fds_[index].get(), &value, sizeof(value)) != sizeof(value)) {
+				cerr << "Failed to write eventfd" << endl;
+				return TestFail;
+			}
+
+			start_ = utils::clock::now();
+			dispatcher->processEvents();
+
+			if (activated_ != static_cast<int>(index)) {
+				cerr << "Notifier " << activated_
+				     << " activated, expected " << index << endl;
+				return TestFail;
+			}
+
+			total += wakeup_ - start_;
+		}
+
+		latency_ = total / iterations_;
+
+		return TestPass;
+	}
+
+	void activated(unsigned int index)
+	{
+		wakeup_ = utils::clock::now();
+
+		uint64_t value;
+		if (read(fds_[index].get(), &value, sizeof(value)) != sizeof(value)) {
+			activated_ = -2;
+			return;
+		}
+
+		/* Only one notifier is expected to be activated per wakeup. */
+		if (activated_ != -1) {
+			activated_ = -2;
+			return;
+		}
+
+		activated_ = index;
+	}
+
+	const unsigned int count_;
+	const unsigned int iterations_;
+
+	vector<UniqueFD> fds_;
+
+	utils::time_point start_;
+	utils::time_point wakeup_;
+	int activated_;
+
+	nanoseconds latency_;
+	int result_;
+};
+
+class EventDispatcherBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		/* Raise the file descriptors limit to fit the largest test. */
+		struct rlimit limit;
+		if (getrlimit(RLIMIT_NOFILE, &limit) < 0)
+			return TestFail;
+
+		limit.rlim_cur = limit.rlim_max;
+		setrlimit(RLIMIT_NOFILE, &limit);
+		maxNotifiers_ = limit.rlim_cur;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		static const unsigned int counts[] = { 10, 100, 1000 };
+		static constexpr unsigned int kIterations = 2000;
+
+		for (unsigned int count : counts) {
+			/*
+			 * The epoll dispatcher duplicates the file descriptor
+			 * of each notifier. Leave some room for the file
+			 * descriptors of the test.
+			 */
+			if (2 * count + 64 > maxNotifiers_) {
+				cout << "Skipping " << count
+				     << " notifiers, file descriptors limit too low"
+				     << endl;
+				continue;
+			}
+
+			nanoseconds latency[2];
+
+			for (unsigned int i = 0; i < 2; ++i) {
+				BenchmarkThread thread(count, kIterations);
+				if (i == 0)
+					thread.setEventDispatcher(make_unique<EventDispatcherPoll>());
+				else
+					thread.setEventDispatcher(make_unique<EventDispatcherEpoll>());
+
+				thread.start();
+				thread.wait();
+
+				if (thread.result() != TestPass) {
+					cerr << (i == 0 ? "poll" : "epoll")
+					     << " dispatcher failed with " << count
+					     << " notifiers" << endl;
+					return TestFail;
+				}
+
+				latency[i] = thread.latency();
+			}
+
+			cout << setw(4) << count << " notifiers: poll "
+			     << setw(7) << latency[0].count() << "ns, epoll "
+			     << setw(7) << latency[1].count() << "ns" << endl;
+		}
+
+		return TestPass;
+	}
+
+private:
+	rlim_t maxNotifiers_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(EventDispatcherBenchmark)
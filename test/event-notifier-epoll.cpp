@@ -0,0 +1,157 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Epoll-based event dispatcher notifiers test
+ */
+
+#include <iostream>
+#include <memory>
+#include <unistd.h>
+
+#include <libcamera/base/event_dispatcher_epoll.h>
+#include <libcamera/base/event_notifier.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+#include <libcamera/base/unique_fd.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+class EventNotifierEpollTest : public Test
+{
+protected:
+	int init()
+	{
+		std::unique_ptr<EventDispatcherEpoll> dispatcher =
+			std::make_unique<EventDispatcherEpoll>();
+		dispatcher_ = dispatcher.get();
+
+		Thread::current()->setEventDispatcher(std::move(dispatcher));
+		if (Thread::current()->eventDispatcher() != dispatcher_) {
+			cout << "Failed to set the epoll event dispatcher" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/* Read the data written to a pipe when its notifier is activated */
+	void readReady(int fd, unsigned int &count)
+	{
+		char data;
+
+		if (read(fd, &data, 1) == 1)
+			count++;
+	}
+
+	int process(int fd1, int fd2)
+	{
+		Timer timeout;
+		char data = 0;
+
+		first_ = second_ = 0;
+
+		if ((fd1 >= 0 && write(fd1, &data, 1) != 1) ||
+		    (fd2 >= 0 && write(fd2, &data, 1) != 1)) {
+			cout << "Pipe write failed" << endl;
+			return TestFail;
+		}
+
+		timeout.start(100ms);
+		while (timeout.isRunning())
+			dispatcher_->processEvents();
+
+		return TestPass;
+	}
+
+	int run()
+	{
+		int fds[2];
+
+		if (pipe(fds) < 0) {
+			cout << "Failed to create pipe" << endl;
+			return TestFail;
+		}
+
+		UniqueFD read1(fds[0]);
+		UniqueFD write1(fds[1]);
+
+		if (pipe(fds) < 0) {
+			cout << "Failed to create pipe" << endl;
+			return TestFail;
+		}
+
+		UniqueFD read2(fds[0]);
+		UniqueFD write2(fds[1]);
+
+		unique_ptr<EventNotifier> notifier1 =
+			make_unique<EventNotifier>(read1.get(), EventNotifier::Read);
+
+		/*
+		 * Close the file descriptor of the first notifier without
+		 * unregistering it, while keeping its file open, and reuse its
+		 * number for the second pipe.
+		 */
+		const int fd = read1.get();
+		UniqueFD file1(dup(fd));
+		read1.reset();
+
+		if (dup2(read2.get(), fd) < 0) {
+			cout << "Failed to reuse file descriptor" << endl;
+			return TestFail;
+		}
+
+		UniqueFD file2(fd);
+
+		unique_ptr<EventNotifier> notifier2 =
+			make_unique<EventNotifier>(file2.get(), EventNotifier::Read);
+
+		notifier1->activated.connect(this, [&]() { readReady(file1.get(), first_); });
+		notifier2->activated.connect(this, [&]() { readReady(file2.get(), second_); });
+
+		/* Each notifier must only be activated by its own file. */
+		if (process(-1, write2.get()) != TestPass)
+			return TestFail;
+
+		if (first_ != 0 || second_ != 1) {
+			cout << "Reused file descriptor aliases the closed one" << endl;
+			return TestFail;
+		}
+
+		if (process(write1.get(), -1) != TestPass)
+			return TestFail;
+
+		if (first_ != 1 || second_ != 0) {
+			cout << "Notifier of the closed file descriptor not activated" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Unregistering the notifier of the closed file descriptor must
+		 * stop monitoring its file, without affecting the other notifier.
+		 */
+		notifier1.reset();
+
+		if (process(write1.get(), write2.get()) != TestPass)
+			return TestFail;
+
+		if (first_ != 0 || second_ != 1) {
+			cout << "Unregistering a closed file descriptor failed" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	EventDispatcherEpoll *dispatcher_;
+
+	unsigned int first_;
+	unsigned int second_;
+};
+
+TEST_REGISTER(EventNotifierEpollTest)
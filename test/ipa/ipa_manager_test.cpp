@@ -0,0 +1,206 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Test the IPA manager module index and cache
+ */
+
+#include <dirent.h>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <vector>
+
+#include <libcamera/ipa/vimc_ipa_proxy.h>
+
+#include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/process.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+class IPAManagerTest : public Test
+{
+protected:
+	int init() override
+	{
+		char tmpDir[] = "/tmp/libcamera-ipa-cache-test-XXXXXX";
+		if (!mkdtemp(tmpDir)) {
+			cerr << "Failed to create temporary directory" << endl;
+			return TestFail;
+		}
+
+		/* The cache directory doesn't exist yet, and must be created. */
+		tmpDir_ = tmpDir;
+		cacheDir_ = tmpDir_ + "/libcamera";
+		cachePath_ = cacheDir_ + "/ipa_modules";
+		setenv("LIBCAMERA_IPA_MODULE_CACHE", cachePath_.c_str(), 1);
+
+		for (const PipelineHandlerFactoryBase *factory :
+		     PipelineHandlerFactoryBase::factories()) {
+			if (factory->name() == "vimc") {
+				pipe_ = factory->create(nullptr);
+				break;
+			}
+		}
+
+		if (!pipe_) {
+			cerr << "Vimc pipeline not found" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Index the modules without a cache, and create the cache. */
+		if (!createIPA()) {
+			cerr << "Failed to create IPA without cache" << endl;
+			return TestFail;
+		}
+
+		vector<string> lines = readCache();
+		if (lines.size() < 2 || !findEntry(lines)) {
+			cerr << "IPA module cache not populated" << endl;
+			return TestFail;
+		}
+
+		/* The temporary file used to write the cache must be gone. */
+		if (listDir(cacheDir_) != vector<string>{ "ipa_modules" }) {
+			cerr << "Stray files in the IPA module cache directory" << endl;
+			return TestFail;
+		}
+
+		/* Index the modules from the cache. */
+		if (!createIPA()) {
+			cerr << "Failed to create IPA with cache" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Entries of unchanged modules are trusted, modules cached for
+		 * a different pipeline handler are not loaded.
+		 */
+		string *entry = findEntry(lines);
+		*entry = entry->substr(0, entry->rfind('\t')) + "\tother";
+		writeCache(lines);
+
+		if (createIPA()) {
+			cerr << "Cached module information ignored" << endl;
+			return TestFail;
+		}
+
+		/* Stale entries are refreshed. */
+		size_t pos = entry->find('\t');
+		*entry = entry->substr(0, pos) + "\t0" +
+			 entry->substr(entry->find('\t', pos + 1));
+		writeCache(lines);
+
+		if (!createIPA()) {
+			cerr << "Failed to create IPA with stale cache" << endl;
+			return TestFail;
+		}
+
+		lines = readCache();
+		if (!findEntry(lines)) {
+			cerr << "Stale IPA module cache entry not updated" << endl;
+			return TestFail;
+		}
+
+		/* A cache that can't be created doesn't prevent loading IPAs. */
+		string blocker = tmpDir_ + "/file";
+		ofstream(blocker).close();
+		setenv("LIBCAMERA_IPA_MODULE_CACHE", (blocker + "/ipa_modules").c_str(), 1);
+
+		bool created = createIPA();
+		unlink(blocker.c_str());
+
+		if (!created) {
+			cerr << "Failed to create IPA with an invalid cache path" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		unlink(cachePath_.c_str());
+		rmdir(cacheDir_.c_str());
+		rmdir(tmpDir_.c_str());
+	}
+
+private:
+	bool createIPA()
+	{
+		IPAManager manager;
+
+		return IPAManager::createIPA<ipa::vimc::IPAProxyVimc>(pipe_.get(), 0, 0) != nullptr;
+	}
+
+	vector<string> readCache()
+	{
+		ifstream file(cachePath_);
+		vector<string> lines;
+		string line;
+
+		while (getline(file, line))
+			lines.push_back(line);
+
+		return lines;
+	}
+
+	void writeCache(const vector<string> &lines)
+	{
+		ofstream file(cachePath_);
+
+		for (const string &line : lines)
+			file << line << "\n";
+	}
+
+	vector<string> listDir(const string &path)
+	{
+		vector<string> entries;
+
+		DIR *dir = opendir(path.c_str());
+		if (!dir)
+			return entries;
+
+		while (struct dirent *ent = readdir(dir)) {
+			if (strcmp(ent->d_name, ".") && strcmp(ent->d_name, ".."))
+				entries.push_back(ent->d_name);
+		}
+
+		closedir(dir);
+
+		return entries;
+	}
+
+	string *findEntry(vector<string> &lines)
+	{
+		for (string &line : lines) {
+			if (line.size() > 5 && line.substr(line.size() - 5) == "\tvimc")
+				return &line;
+		}
+
+		return nullptr;
+	}
+
+	ProcessManager processManager_;
+
+	shared_ptr<PipelineHandler> pipe_;
+	string tmpDir_;
+	string cacheDir_;
+	string cachePath_;
+};
+
+TEST_REGISTER(IPAManagerTest)
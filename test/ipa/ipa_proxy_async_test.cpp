@@ -0,0 +1,176 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Test asynchronous calls to an isolated IPA through the generated proxy
+ */
+
+#include <errno.h>
+#include <iostream>
+#include <numeric>
+#include <stdlib.h>
+
+#include <libcamera/ipa/vimc_ipa_proxy.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/ipc_pipe.h"
+#include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/process.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+class IPAProxyAsyncTest : public Test
+{
+protected:
+	int init() override
+	{
+		/* Run the IPA in a separate process to go through IPC. */
+		setenv("LIBCAMERA_IPA_FORCE_ISOLATION", "1", 1);
+
+		ipaManager_ = make_unique<IPAManager>();
+
+		for (const PipelineHandlerFactoryBase *factory :
+		     PipelineHandlerFactoryBase::factories()) {
+			if (factory->name() == "vimc") {
+				pipe_ = factory->create(nullptr);
+				break;
+			}
+		}
+
+		if (!pipe_) {
+			cerr << "Vimc pipeline not found" << endl;
+			return TestSkip;
+		}
+
+		return TestPass;
+	}
+
+	int callInit(Flags<ipa::vimc::TestFlag> inFlags, int *status, int *ret,
+		     Flags<ipa::vimc::TestFlag> *outFlags)
+	{
+		bool done = false;
+
+		ipa_->initAsync(IPASettings{ conf_, "vimc" },
+				ipa::vimc::IPAOperationInit, inFlags,
+				[&](int s, int32_t r, const Flags<ipa::vimc::TestFlag> &flags) {
+					*status = s;
+					*ret = r;
+					*outFlags = flags;
+					done = true;
+				});
+
+		/* The call must not complete before the event loop runs. */
+		if (done) {
+			cerr << "Call completed synchronously" << endl;
+			return TestFail;
+		}
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timer;
+		timer.start(1000ms);
+		while (timer.isRunning() && !done)
+			dispatcher->processEvents();
+
+		if (!done) {
+			cerr << "Call never completed" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		ipa_ = IPAManager::createIPA<ipa::vimc::IPAProxyVimc>(pipe_.get(), 0, 0);
+		if (!ipa_) {
+			cerr << "Failed to create VIMC IPA interface" << endl;
+			return TestFail;
+		}
+
+		IPCPipe *ipc = ipa_->ipc();
+		if (!ipc) {
+			cerr << "IPA not isolated" << endl;
+			return TestFail;
+		}
+
+		conf_ = ipa_->configurationFile("vimc.conf");
+
+		Flags<ipa::vimc::TestFlag> outFlags;
+		int status;
+		int ret;
+
+		/* A regular call completes with the IPA return value and outputs. */
+		if (callInit({}, &status, &ret, &outFlags) != TestPass)
+			return TestFail;
+
+		if (status != 0 || ret != 0 ||
+		    outFlags != ipa::vimc::TestFlag::Flag1) {
+			cerr << "Invalid async call result: status " << status
+			     << ", ret " << ret << endl;
+			return TestFail;
+		}
+
+		/*
+		 * A call that outlives the timeout completes with -ETIMEDOUT and
+		 * default-initialised outputs.
+		 */
+		ipc->setTimeout(50ms);
+
+		if (callInit(ipa::vimc::TestFlag::Flag3, &status, &ret, &outFlags) != TestPass)
+			return TestFail;
+
+		if (status != -ETIMEDOUT || ret != 0 || outFlags) {
+			cerr << "Call didn't time out: status " << status << endl;
+			return TestFail;
+		}
+
+		/*
+		 * The late reply to the timed out call must be dropped, and not
+		 * complete the next call.
+		 */
+		ipc->setTimeout(1000ms);
+
+		if (callInit({}, &status, &ret, &outFlags) != TestPass)
+			return TestFail;
+
+		if (status != 0 || ret != 0 ||
+		    outFlags != ipa::vimc::TestFlag::Flag1) {
+			cerr << "Late reply completed the wrong call" << endl;
+			return TestFail;
+		}
+
+		/* Three calls have been issued, one of them timed out. */
+		const IPCPipe::LatencyHistogram &latency = ipc->latency();
+		unsigned int calls = std::accumulate(latency.begin(), latency.end(), 0u);
+		if (calls != 2 || ipc->timeouts() != 1) {
+			cerr << "Invalid call latency histogram" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		ipa_.reset();
+		ipaManager_.reset();
+	}
+
+private:
+	ProcessManager processManager_;
+
+	std::shared_ptr<PipelineHandler> pipe_;
+	std::unique_ptr<ipa::vimc::IPAProxyVimc> ipa_;
+	std::unique_ptr<IPAManager> ipaManager_;
+	std::string conf_;
+};
+
+TEST_REGISTER(IPAProxyAsyncTest)
@@ -0,0 +1,288 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * Raspberry Pi ALSC solver benchmark
+ */
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include <libcamera/base/utils.h>
+
+#include "controller/rpi/alsc.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace libcamera;
+using namespace RPiController;
+
+namespace {
+
+constexpr double InsufficientData = -1.0;
+
+/*
+ * Reference implementation of the solver, as it was written originally. The
+ * optimised solver is expected to produce the same results.
+ */
+class ReferenceSolver
+{
+public:
+	using SparseArray = vector<array<double, 4>>;
+
+	unsigned int solve(const Array2D<double> &C, double sigma, double omega,
+			   unsigned int nIter, double threshold,
+			   double lambdaBound, Array2D<double> &lambda)
+	{
+		W_.resize(C.size());
+		M_.resize(C.size());
+
+		computeW(C, sigma);
+		constructM(C);
+
+		unsigned int i;
+		for (i = 0; i < nIter; i++) {
+			double maxDiff = fabs(gaussSeidel2Sor(omega, lambda, lambdaBound));
+			if (maxDiff < threshold) {
+				i++;
+				break;
+			}
+		}
+
+		return i;
+	}
+
+private:
+	static double computeWeight(double Ci, double Cj, double sigma)
+	{
+		if (Ci == InsufficientData || Cj == InsufficientData)
+			return 0;
+		double diff = (Ci - Cj) / sigma;
+		return exp(-diff * diff / 2);
+	}
+
+	void computeW(const Array2D<double> &C, double sigma)
+	{
+		size_t XY = C.size();
+		size_t X = C.dimensions().width;
+
+		for (unsigned int i = 0; i < XY; i++) {
+			W_[i][0] = i >= X ? computeWeight(C[i], C[i - X], sigma) : 0;
+			W_[i][1] = i % X < X - 1 ? computeWeight(C[i], C[i + 1], sigma) : 0;
+			W_[i][2] = i < XY - X ? computeWeight(C[i], C[i + X], sigma) : 0;
+			W_[i][3] = i % X ? computeWeight(C[i], C[i - 1], sigma) : 0;
+		}
+	}
+
+	void constructM(const Array2D<double> &C)
+	{
+		size_t XY = C.size();
+		size_t X = C.dimensions().width;
+
+		double epsilon = 0.001;
+		for (unsigned int i = 0; i < XY; i++) {
+			int m = !!(i >= X) + !!(i % X < X - 1) + !!(i < XY - X) +
+				!!(i % X);
+			double diagonal = (epsilon + W_[i][0] + W_[i][1] + W_[i][2] + W_[i][3]) * C[i];
+			M_[i][0] = i >= X ? (W_[i][0] * C[i - X] + epsilon / m * C[i]) / diagonal : 0;
+			M_[i][1] = i % X < X - 1 ? (W_[i][1] * C[i + 1] + epsilon / m * C[i]) / diagonal : 0;
+			M_[i][2] = i < XY - X ? (W_[i][2] * C[i + X] + epsilon / m * C[i]) / diagonal : 0;
+			M_[i][3] = i % X ? (W_[i][3] * C[i - 1] + epsilon / m * C[i]) / diagonal : 0;
+		}
+	}
+
+	double computeLambda(int i, int X, int XY, Array2D<double> &lambda)
+	{
+		double value = 0;
+		bool first = true;
+
+		auto add = [&](double term) {
+			value = first ? term : value + term;
+			first = false;
+		};
+
+		if (i >= X)
+			add(M_[i][0] * lambda[i - X]);
+		if (i < XY - 1)
+			add(M_[i][1] * lambda[i + 1]);
+		if (i < XY - X)
+			add(M_[i][2] * lambda[i + X]);
+		if (i > 0)
+			add(M_[i][3] * lambda[i - 1]);
+
+		return value;
+	}
+
+	double gaussSeidel2Sor(double omega, Array2D<double> &lambda,
+			       double lambdaBound)
+	{
+		int XY = lambda.size();
+		int X = lambda.dimensions().width;
+		const double min = 1 - lambdaBound, max = 1 + lambdaBound;
+		Array2D<double> oldLambda = lambda;
+
+		for (int i = 0; i < XY; i++)
+			lambda[i] = std::clamp(computeLambda(i, X, XY, lambda), min, max);
+		for (int i = XY - 1; i >= 0; i--)
+			lambda[i] = std::clamp(computeLambda(i, X, XY, lambda), min, max);
+
+		double maxDiff = 0;
+		for (int i = 0; i < XY; i++) {
+			lambda[i] = oldLambda[i] + (lambda[i] - oldLambda[i]) * omega;
+			if (fabs(lambda[i] - oldLambda[i]) > fabs(maxDiff))
+				maxDiff = lambda[i] - oldLambda[i];
+		}
+		return maxDiff;
+	}
+
+	SparseArray W_;
+	SparseArray M_;
+};
+
+} /* namespace */
+
+class RPiAlscTest : public Test
+{
+protected:
+	static constexpr unsigned int kFrames = 200;
+	static constexpr double kTolerance = 1e-9;
+
+	int init() override
+	{
+		generator_.seed(1);
+		return TestPass;
+	}
+
+	/*
+	 * Generate a sequence of colour ratio statistics, as computed from the
+	 * AWB regions of a camera panning over a scene. The lens shading
+	 * left in the statistics is a radial falloff that changes slowly over
+	 * time, and a few regions have insufficient data.
+	 */
+	vector<Array2D<double>> generateStats(const Size &size)
+	{
+		uniform_real_distribution<double> colour(0.4, 0.8);
+		uniform_real_distribution<double> noise(-0.002, 0.002);
+		uniform_int_distribution<unsigned int> region(0, size.width * size.height - 1);
+
+		/* The scene is twice as wide as the field of view. */
+		vector<double> scene(2 * size.width * size.height);
+		for (unsigned int y = 0; y < size.height; y++) {
+			double c = colour(generator_);
+			for (unsigned int x = 0; x < 2 * size.width; x++) {
+				/* Large areas of uniform colour. */
+				if (x % 8 == 0)
+					c = colour(generator_);
+				scene[y * 2 * size.width + x] = c;
+			}
+		}
+
+		vector<Array2D<double>> frames(kFrames);
+		for (unsigned int t = 0; t < kFrames; t++) {
+			Array2D<double> &C = frames[t];
+			C.resize(size);
+
+			unsigned int pan = t * size.width / kFrames;
+			double strength = 0.2 + 0.1 * sin(t * 0.05);
+
+			for (unsigned int y = 0; y < size.height; y++) {
+				for (unsigned int x = 0; x < size.width; x++) {
+					double dx = (x + 0.5) / size.width - 0.5;
+					double dy = (y + 0.5) / size.height - 0.5;
+					double shading = 1 - strength * (dx * dx + dy * dy);
+
+					C[y * size.width + x] =
+						scene[y * 2 * size.width + x + pan] * shading +
+						noise(generator_);
+				}
+			}
+
+			for (unsigned int i = 0; i < 4; i++)
+				C[region(generator_)] = InsufficientData;
+		}
+
+		return frames;
+	}
+
+	int benchmark(const Size &size)
+	{
+		/* Default tuning parameters of the ALSC algorithm. */
+		const double sigma = 0.01;
+		const double omega = 1.3;
+		const unsigned int nIter = size.width + size.height;
+		const double threshold = 1e-3;
+		const double lambdaBound = 0.05;
+
+		vector<Array2D<double>> frames = generateStats(size);
+
+		Array2D<double> lambda, refLambda;
+		lambda.resize(size, 1.0);
+		refLambda.resize(size, 1.0);
+
+		AlscSolver solver;
+		ReferenceSolver reference;
+		nanoseconds duration{ 0 }, refDuration{ 0 };
+		unsigned int iterations = 0;
+		double maxDelta = 0;
+
+		/* Warm start each frame from the results of the previous one. */
+		for (const Array2D<double> &C : frames) {
+			utils::time_point start = utils::clock::now();
+			unsigned int refIterations =
+				reference.solve(C, sigma, omega, nIter, threshold,
+						lambdaBound, refLambda);
+			refDuration += utils::clock::now() - start;
+
+			start = utils::clock::now();
+			unsigned int frameIterations =
+				solver.solve(C, sigma, omega, nIter, threshold,
+					     lambdaBound, lambda);
+			duration += utils::clock::now() - start;
+			iterations += frameIterations;
+
+			for (unsigned int i = 0; i < lambda.size(); i++)
+				maxDelta = max(maxDelta, fabs(lambda[i] - refLambda[i]));
+
+			if (maxDelta > kTolerance || frameIterations != refIterations) {
+				cerr << size << ": results differ from the reference by "
+				     << maxDelta << endl;
+				return TestFail;
+			}
+		}
+
+		cout << size << ": " << fixed << setprecision(1)
+		     << duration.count() / 1000.0 / kFrames << "us per solve ("
+		     << refDuration.count() / 1000.0 / kFrames << "us reference), "
+		     << static_cast<double>(iterations) / kFrames
+		     << " iterations, max delta " << scientific << maxDelta
+		     << defaultfloat << endl;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Table sizes of the VC4 and PiSP platforms. */
+		for (const Size &size : { Size(16, 12), Size(32, 32) }) {
+			int ret = benchmark(size);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+private:
+	mt19937 generator_;
+};
+
+TEST_REGISTER(RPiAlscTest)
@@ -0,0 +1,477 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * Raspberry Pi AWB search tests and benchmark
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include <libcamera/base/log.h>
+#include <libcamera/base/utils.h>
+
+#include "controller/rpi/awb.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace std::chrono;
+using namespace libcamera;
+using namespace RPiController;
+
+LOG_DEFINE_CATEGORY(RPiAwbReference)
+
+namespace {
+
+using PwlPoint = ipa::Pwl::Point;
+
+struct Result {
+	double t, r, b;
+};
+
+double interpolateQuadatric(PwlPoint const &a, PwlPoint const &b, PwlPoint const &c)
+{
+	const double eps = 1e-3;
+	PwlPoint ca = c - a, ba = b - a;
+	double denominator = 2 * (ba.y() * ca.x() - ca.y() * ba.x());
+	/* The AWB algorithm uses the integer abs() here. */
+	if (abs(static_cast<int>(denominator)) > eps) {
+		double numerator = ba.y() * ca.x() * ca.x() - ca.y() * ba.x() * ba.x();
+		double result = numerator / denominator + a.x();
+		return std::max(a.x(), std::min(c.x(), result));
+	}
+	return a.y() < c.y() - eps ? a.x() : (c.y() < a.y() - eps ? c.x() : b.x());
+}
+
+/*
+ * Reference implementation of the Bayesian search, as it was written
+ * originally. It evaluates the whole CT curve on every run, and logs every
+ * point it evaluates.
+ */
+class ReferenceSearch
+{
+public:
+	ReferenceSearch(const AwbConfig &config)
+		: config_(config)
+	{
+	}
+
+	Result search(const vector<Awb::RGB> &zones, double priorScale,
+		      double lux, const AwbMode &mode)
+	{
+		zones_ = &zones;
+
+		ipa::Pwl prior = interpolatePrior(lux);
+		prior *= priorScale;
+		prior.map([](double x, double y) {
+			LOG(RPiAwbReference, Debug) << "(" << x << "," << y << ")";
+		});
+
+		Result result;
+		result.t = coarseSearch(prior, mode);
+		result.r = config_.ctR.eval(result.t);
+		result.b = config_.ctB.eval(result.t);
+		LOG(RPiAwbReference, Debug)
+			<< "After coarse search: r " << result.r << " b " << result.b;
+		fineSearch(result.t, result.r, result.b, prior);
+		LOG(RPiAwbReference, Debug)
+			<< "After fine search: r " << result.r << " b " << result.b;
+
+		return result;
+	}
+
+private:
+	double computeDelta2Sum(double gainR, double gainB)
+	{
+		double delta2Sum = 0;
+		for (auto &z : *zones_) {
+			double deltaR = gainR * z.R - 1 - config_.whitepointR;
+			double deltaB = gainB * z.B - 1 - config_.whitepointB;
+			double delta2 = deltaR * deltaR + deltaB * deltaB;
+			delta2 = std::min(delta2, config_.deltaLimit);
+			delta2Sum += delta2;
+		}
+		return delta2Sum;
+	}
+
+	ipa::Pwl interpolatePrior(double lux)
+	{
+		if (lux <= config_.priors.front().lux)
+			return config_.priors.front().prior;
+		else if (lux >= config_.priors.back().lux)
+			return config_.priors.back().prior;
+
+		int idx = 0;
+		while (config_.priors[idx + 1].lux < lux)
+			idx++;
+		double lux0 = config_.priors[idx].lux,
+		       lux1 = config_.priors[idx + 1].lux;
+		return ipa::Pwl::combine(config_.priors[idx].prior,
+					 config_.priors[idx + 1].prior,
+					 [&](double /*x*/, double y0, double y1) {
+						 return y0 + (y1 - y0) *
+							(lux - lux0) / (lux1 - lux0);
+					 });
+	}
+
+	double coarseSearch(ipa::Pwl const &prior, const AwbMode &mode)
+	{
+		points_.clear();
+		size_t bestPoint = 0;
+		double t = mode.ctLo;
+		int spanR = 0, spanB = 0;
+		while (true) {
+			double r = config_.ctR.eval(t, &spanR);
+			double b = config_.ctB.eval(t, &spanB);
+			double gainR = 1 / r, gainB = 1 / b;
+			double delta2Sum = computeDelta2Sum(gainR, gainB);
+			double priorLogLikelihood = prior.eval(prior.domain().clamp(t));
+			double finalLogLikelihood = delta2Sum - priorLogLikelihood;
+			LOG(RPiAwbReference, Debug)
+				<< "t: " << t << " gain R " << gainR << " gain B "
+				<< gainB << " delta2_sum " << delta2Sum
+				<< " prior " << priorLogLikelihood << " final "
+				<< finalLogLikelihood;
+			points_.push_back(PwlPoint({ t, finalLogLikelihood }));
+			if (points_.back().y() < points_[bestPoint].y())
+				bestPoint = points_.size() - 1;
+			if (t == mode.ctHi)
+				break;
+			t = std::min(t + t / 10 * config_.coarseStep, mode.ctHi);
+		}
+		t = points_[bestPoint].x();
+		LOG(RPiAwbReference, Debug) << "Coarse search found CT " << t;
+		if (points_.size() > 2) {
+			unsigned long bp = std::min(bestPoint, points_.size() - 2);
+			bestPoint = std::max(1UL, bp);
+			t = interpolateQuadatric(points_[bestPoint - 1],
+						 points_[bestPoint],
+						 points_[bestPoint + 1]);
+			LOG(RPiAwbReference, Debug)
+				<< "After quadratic refinement, coarse search has CT "
+				<< t;
+		}
+		return t;
+	}
+
+	void fineSearch(double &t, double &r, double &b, ipa::Pwl const &prior)
+	{
+		int spanR = -1, spanB = -1;
+		config_.ctR.eval(t, &spanR);
+		config_.ctB.eval(t, &spanB);
+		double step = t / 10 * config_.coarseStep * 0.1;
+		int nsteps = 5;
+		double rDiff = config_.ctR.eval(t + nsteps * step, &spanR) -
+			       config_.ctR.eval(t - nsteps * step, &spanR);
+		double bDiff = config_.ctB.eval(t + nsteps * step, &spanB) -
+			       config_.ctB.eval(t - nsteps * step, &spanB);
+		PwlPoint transverse({ bDiff, -rDiff });
+		if (transverse.length2() < 1e-6)
+			return;
+		transverse = transverse / transverse.length();
+		double bestLogLikelihood = 0, bestT = 0, bestR = 0, bestB = 0;
+		double transverseRange = config_.transverseNeg + config_.transversePos;
+		const int maxNumDeltas = 12;
+		int numDeltas = floor(transverseRange * 100 + 0.5) + 1;
+		numDeltas = numDeltas < 3 ? 3 : (numDeltas > maxNumDeltas ? maxNumDeltas : numDeltas);
+		nsteps += numDeltas;
+		for (int i = -nsteps; i <= nsteps; i++) {
+			double tTest = t + i * step;
+			double priorLogLikelihood =
+				prior.eval(prior.domain().clamp(tTest));
+			double rCurve = config_.ctR.eval(tTest, &spanR);
+			double bCurve = config_.ctB.eval(tTest, &spanB);
+			PwlPoint points[maxNumDeltas];
+			int bestPoint = 0;
+			for (int j = 0; j < numDeltas; j++) {
+				points[j][0] = -config_.transverseNeg +
+					       (transverseRange * j) / (numDeltas - 1);
+				PwlPoint rbTest = PwlPoint({ rCurve, bCurve }) +
+					       transverse * points[j].x();
+				double gainR = 1 / rbTest.x(), gainB = 1 / rbTest.y();
+				points[j][1] = computeDelta2Sum(gainR, gainB) -
+					       priorLogLikelihood;
+				LOG(RPiAwbReference, Debug)
+					<< "At t " << tTest << " r " << rbTest.x() << " b "
+					<< rbTest.y() << ": " << points[j].y();
+				if (points[j].y() < points[bestPoint].y())
+					bestPoint = j;
+			}
+			bestPoint = std::max(1, std::min(bestPoint, numDeltas - 2));
+			PwlPoint rbTest = PwlPoint({ rCurve, bCurve }) +
+				       transverse * interpolateQuadatric(points[bestPoint - 1],
+									 points[bestPoint],
+									 points[bestPoint + 1]);
+			double rTest = rbTest.x(), bTest = rbTest.y();
+			double finalLogLikelihood =
+				computeDelta2Sum(1 / rTest, 1 / bTest) - priorLogLikelihood;
+			LOG(RPiAwbReference, Debug)
+				<< "Finally "
+				<< tTest << " r " << rTest << " b " << bTest << ": "
+				<< finalLogLikelihood
+				<< (finalLogLikelihood < bestLogLikelihood ? " BEST" : "");
+			if (bestT == 0 || finalLogLikelihood < bestLogLikelihood)
+				bestLogLikelihood = finalLogLikelihood,
+				bestT = tTest, bestR = rTest, bestB = bTest;
+		}
+		t = bestT, r = bestR, b = bestB;
+		LOG(RPiAwbReference, Debug)
+			<< "Fine search found t " << t << " r " << r << " b " << b;
+	}
+
+	const AwbConfig &config_;
+	const vector<Awb::RGB> *zones_;
+	vector<PwlPoint> points_;
+};
+
+} /* namespace */
+
+class RPiAwbTest : public Test
+{
+protected:
+	static constexpr unsigned int kFrames = 300;
+	static constexpr double kTolerance = 1e-6;
+
+	int init() override
+	{
+		generator_.seed(1);
+
+		/* Tuning of the imx219 sensor. */
+		config_.ctR = ipa::Pwl({ PwlPoint({ 2498.0, 0.9309 }), PwlPoint({ 2911.0, 0.8682 }),
+					 PwlPoint({ 2919.0, 0.8358 }), PwlPoint({ 3627.0, 0.7646 }),
+					 PwlPoint({ 4600.0, 0.6079 }), PwlPoint({ 5716.0, 0.5712 }),
+					 PwlPoint({ 8575.0, 0.4331 }) });
+		config_.ctB = ipa::Pwl({ PwlPoint({ 2498.0, 0.3599 }), PwlPoint({ 2911.0, 0.4283 }),
+					 PwlPoint({ 2919.0, 0.4621 }), PwlPoint({ 3627.0, 0.5327 }),
+					 PwlPoint({ 4600.0, 0.6721 }), PwlPoint({ 5716.0, 0.7017 }),
+					 PwlPoint({ 8575.0, 0.8037 }) });
+
+		AwbPrior prior;
+		prior.lux = 0;
+		prior.prior = ipa::Pwl({ PwlPoint({ 2000, 1.0 }), PwlPoint({ 3000, 0.0 }),
+					 PwlPoint({ 13000, 0.0 }) });
+		config_.priors.push_back(prior);
+		prior.lux = 800;
+		prior.prior = ipa::Pwl({ PwlPoint({ 2000, 0.0 }), PwlPoint({ 6000, 2.0 }),
+					 PwlPoint({ 13000, 2.0 }) });
+		config_.priors.push_back(prior);
+		prior.lux = 1500;
+		prior.prior = ipa::Pwl({ PwlPoint({ 2000, 0.0 }), PwlPoint({ 4000, 1.0 }),
+					 PwlPoint({ 6000, 6.0 }), PwlPoint({ 6500, 7.0 }),
+					 PwlPoint({ 7000, 1.0 }), PwlPoint({ 13000, 1.0 }) });
+		config_.priors.push_back(prior);
+
+		config_.modes["auto"] = { 2500, 8000 };
+		config_.defaultMode = &config_.modes["auto"];
+
+		config_.deltaLimit = 0.2;
+		config_.coarseStep = 0.2;
+		config_.fullSearchPeriod = 10;
+		config_.transversePos = 0.04791;
+		config_.transverseNeg = 0.04881;
+		config_.whitepointR = 0.0;
+		config_.whitepointB = 0.0;
+
+		return TestPass;
+	}
+
+	/*
+	 * Generate the statistics of a scene, lit by an illuminant whose colour
+	 * temperature and brightness drift over time. About half of the zones
+	 * are grey, the others have random colours.
+	 */
+	vector<vector<Awb::RGB>> generateStats(unsigned int numRegions,
+					       vector<double> &lux)
+	{
+		uniform_real_distribution<double> colour(0.5, 1.5);
+		uniform_real_distribution<double> level(100, 800);
+		normal_distribution<double> noise(0.0, 0.01);
+
+		vector<Awb::RGB> surfaces(numRegions);
+		for (unsigned int i = 0; i < numRegions; i++) {
+			bool grey = i % 2 == 0;
+			surfaces[i] = Awb::RGB(grey ? 1.0 : colour(generator_),
+					       level(generator_),
+					       grey ? 1.0 : colour(generator_));
+		}
+
+		vector<vector<Awb::RGB>> frames(kFrames);
+		lux.resize(kFrames);
+		for (unsigned int t = 0; t < kFrames; t++) {
+			double ct = 4500 + 2000 * sin(t * 0.02);
+			double r = config_.ctR.eval(ct), b = config_.ctB.eval(ct);
+			lux[t] = 1000 + 800 * cos(t * 0.015);
+
+			/* Drop a few zones, as if they had too few pixels. */
+			for (unsigned int i = 0; i < numRegions; i++) {
+				if ((i + t) % 17 == 0)
+					continue;
+
+				const Awb::RGB &s = surfaces[i];
+				double G = s.G;
+				frames[t].emplace_back(s.R * r * (1 + noise(generator_)) * G / (G + 1),
+						       G,
+						       s.B * b * (1 + noise(generator_)) * G / (G + 1));
+			}
+		}
+
+		return frames;
+	}
+
+	int benchmark(unsigned int numRegions)
+	{
+		vector<double> lux;
+		vector<vector<Awb::RGB>> frames = generateStats(numRegions, lux);
+		const AwbMode &mode = *config_.defaultMode;
+
+		ReferenceSearch reference(config_);
+		AwbSearch search;
+		search.configure(config_);
+
+		vector<double> zonesR, zonesB;
+		nanoseconds duration{ 0 }, refDuration{ 0 };
+		double maxDeltaT = 0, maxDeltaRB = 0;
+
+		for (unsigned int i = 0; i < kFrames; i++) {
+			const vector<Awb::RGB> &zones = frames[i];
+			double priorScale = zones.size() / static_cast<double>(numRegions);
+
+			utils::time_point start = utils::clock::now();
+			Result ref = reference.search(zones, priorScale, lux[i], mode);
+			refDuration += utils::clock::now() - start;
+
+			start = utils::clock::now();
+			zonesR.clear();
+			zonesB.clear();
+			for (const Awb::RGB &z : zones) {
+				zonesR.push_back(z.R);
+				zonesB.push_back(z.B);
+			}
+			Result result;
+			search.search(zonesR, zonesB, priorScale, lux[i], mode,
+				      result.t, result.r, result.b);
+			duration += utils::clock::now() - start;
+
+			maxDeltaT = max(maxDeltaT, fabs(result.t - ref.t));
+			maxDeltaRB = max({ maxDeltaRB, fabs(result.r - ref.r),
+					   fabs(result.b - ref.b) });
+
+			if (maxDeltaT > kTolerance * ref.t || maxDeltaRB > kTolerance) {
+				cerr << numRegions << " regions, frame " << i
+				     << ": CT " << result.t << " r " << result.r
+				     << " b " << result.b << ", expected CT "
+				     << ref.t << " r " << ref.r << " b " << ref.b
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		cout << numRegions << " regions: " << fixed << setprecision(1)
+		     << duration.count() / 1000.0 / kFrames << "us per AWB run ("
+		     << refDuration.count() / 1000.0 / kFrames
+		     << "us reference), max delta CT " << scientific << maxDeltaT
+		     << " r/b " << maxDeltaRB << defaultfloat << endl;
+
+		return TestPass;
+	}
+
+	struct Scene {
+		/* the two illuminants lighting the grey zones */
+		double ct0, ct1;
+		/* the proportion of zones lit by ct0 */
+		double weight;
+		double lux;
+	};
+
+	/*
+	 * Check that the search keeps finding the same result as the reference
+	 * when the scene changes abruptly, with each scene lasting a few frames
+	 * so that the search warm-starts in between.
+	 */
+	int testScenes(const char *name, const vector<Scene> &scenes)
+	{
+		static constexpr unsigned int kNumRegions = 16 * 12;
+		static constexpr unsigned int kFramesPerScene = 5;
+		normal_distribution<double> noise(0.0, 0.01);
+		const AwbMode &mode = *config_.defaultMode;
+
+		ReferenceSearch reference(config_);
+		AwbSearch search;
+		search.configure(config_);
+
+		for (auto [i, scene] : utils::enumerate(scenes)) {
+			for (unsigned int frame = 0; frame < kFramesPerScene; frame++) {
+				vector<Awb::RGB> zones;
+				vector<double> zonesR, zonesB;
+				for (unsigned int j = 0; j < kNumRegions; j++) {
+					double ct = j < scene.weight * kNumRegions
+						  ? scene.ct0 : scene.ct1;
+					double r = config_.ctR.eval(ct) * (1 + noise(generator_));
+					double b = config_.ctB.eval(ct) * (1 + noise(generator_));
+					zones.emplace_back(r, 500, b);
+					zonesR.push_back(r);
+					zonesB.push_back(b);
+				}
+
+				Result ref = reference.search(zones, 1.0, scene.lux, mode);
+				Result result;
+				search.search(zonesR, zonesB, 1.0, scene.lux, mode,
+					      result.t, result.r, result.b);
+
+				if (fabs(result.t - ref.t) > kTolerance * ref.t ||
+				    fabs(result.r - ref.r) > kTolerance ||
+				    fabs(result.b - ref.b) > kTolerance) {
+					cerr << name << ", scene " << i << " frame "
+					     << frame << ": CT " << result.t
+					     << ", expected " << ref.t << endl;
+					return TestFail;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* A cut to a scene lit by another illuminant, at the same lux. */
+		if (testScenes("Scene cut", { { 3000, 3000, 1.0, 400 },
+					      { 6500, 6500, 1.0, 400 } }) != TestPass)
+			return TestFail;
+
+		/*
+		 * Scenes lit by two illuminants have two likelihood minima. The
+		 * previous result stays a local minimum when the balance
+		 * between the illuminants changes, or when the lux level change
+		 * moves the prior towards the other illuminant.
+		 */
+		if (testScenes("Bimodal colour", { { 3000, 6500, 0.7, 400 },
+						   { 3000, 6500, 0.3, 400 } }) != TestPass)
+			return TestFail;
+
+		if (testScenes("Bimodal lux", { { 2600, 6500, 0.5, 50 },
+						{ 2600, 6500, 0.5, 1500 } }) != TestPass)
+			return TestFail;
+
+		/* AWB region counts of the VC4 and PiSP platforms. */
+		for (unsigned int numRegions : { 16 * 12, 32 * 32 }) {
+			int ret = benchmark(numRegions);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+private:
+	mt19937 generator_;
+	AwbConfig config_;
+};
+
+TEST_REGISTER(RPiAwbTest)
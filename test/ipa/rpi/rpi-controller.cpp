@@ -0,0 +1,226 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * Raspberry Pi controller algorithm scheduling tests
+ */
+
+#include <atomic>
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "controller/algorithm.h"
+#include "controller/controller.h"
+#include "controller/lux_status.h"
+#include "controller/metadata.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace RPiController;
+
+namespace {
+
+struct State {
+	atomic<unsigned int> running{ 0 };
+	atomic<unsigned int> frame{ 0 };
+	atomic<bool> otherThread{ false };
+	atomic<bool> failed{ false };
+	thread::id caller;
+};
+
+/* Check in prepare() that algorithms not declaring their accesses run alone. */
+class TestAlgorithm : public Algorithm
+{
+public:
+	TestAlgorithm(Controller *controller, State *state, char const *name,
+		      optional<MetadataAccess> access)
+		: Algorithm(controller), state_(state), name_(name), access_(access)
+	{
+	}
+
+	char const *name() const override { return name_; }
+
+	void prepare(Metadata *imageMetadata) override
+	{
+		unsigned int running = ++state_->running;
+
+		if (!access_ && running != 1) {
+			cerr << name_ << " not running alone" << endl;
+			state_->failed = true;
+		}
+
+		if (this_thread::get_id() != state_->caller)
+			state_->otherThread = true;
+
+		run(imageMetadata);
+
+		--state_->running;
+	}
+
+	optional<MetadataAccess> prepareAccess() const override { return access_; }
+	optional<MetadataAccess> processAccess() const override { return access_; }
+
+protected:
+	virtual void run([[maybe_unused]] Metadata *imageMetadata) {}
+
+	State *state_;
+
+private:
+	char const *name_;
+	optional<MetadataAccess> access_;
+};
+
+class LuxWriter : public TestAlgorithm
+{
+public:
+	LuxWriter(Controller *controller, State *state)
+		: TestAlgorithm(controller, state, "test.lux_writer",
+				MetadataAccess({}, { MetadataTag::LuxStatus }))
+	{
+	}
+
+protected:
+	void run(Metadata *imageMetadata) override
+	{
+		LuxStatus status{};
+		status.lux = state_->frame;
+		imageMetadata->set(MetadataTag::LuxStatus, status);
+	}
+};
+
+class LuxReader : public TestAlgorithm
+{
+public:
+	LuxReader(Controller *controller, State *state)
+		: TestAlgorithm(controller, state, "test.lux_reader",
+				MetadataAccess({ MetadataTag::LuxStatus }, {}))
+	{
+	}
+
+protected:
+	void run(Metadata *imageMetadata) override
+	{
+		LuxStatus status;
+		if (imageMetadata->get(MetadataTag::LuxStatus, status) ||
+		    status.lux != state_->frame) {
+			cerr << "Lux read before being written" << endl;
+			state_->failed = true;
+		}
+	}
+};
+
+class TestController : public Controller
+{
+public:
+	void add(Algorithm *algo)
+	{
+		algorithms_.push_back(AlgorithmPtr(algo));
+	}
+
+	/* Check the group assignment of the prepare and process schedules. */
+	bool checkSchedules(vector<vector<string>> const &expected) const
+	{
+		for (Schedule const *schedule : { &prepareSchedule_, &processSchedule_ }) {
+			vector<vector<string>> groups;
+
+			for (auto const &group : *schedule) {
+				groups.emplace_back();
+				for (Algorithm *algo : group)
+					groups.back().push_back(algo->name());
+			}
+
+			if (groups != expected)
+				return false;
+		}
+
+		return true;
+	}
+};
+
+} /* namespace */
+
+class RPiControllerTest : public Test
+{
+protected:
+	int runController(char const *threads, bool *otherThread)
+	{
+		if (threads)
+			setenv("LIBCAMERA_RPI_CONTROLLER_THREADS", threads, 1);
+		else
+			unsetenv("LIBCAMERA_RPI_CONTROLLER_THREADS");
+
+		TestController controller;
+		State state;
+		state.caller = this_thread::get_id();
+
+		/*
+		 * The reader depends on the writer, and the undeclared
+		 * algorithm on everything. The other algorithms are
+		 * independent.
+		 */
+		controller.add(new LuxWriter(&controller, &state));
+		controller.add(new TestAlgorithm(&controller, &state, "test.a",
+						 MetadataAccess()));
+		controller.add(new LuxReader(&controller, &state));
+		controller.add(new TestAlgorithm(&controller, &state, "test.b",
+						 MetadataAccess({ MetadataTag::AwbStatus }, {})));
+		controller.add(new TestAlgorithm(&controller, &state, "test.barrier",
+						 nullopt));
+		controller.add(new TestAlgorithm(&controller, &state, "test.c",
+						 MetadataAccess({}, { MetadataTag::CcmStatus })));
+
+		controller.initialise();
+
+		if (!controller.checkSchedules({
+			    { "test.lux_writer", "test.a", "test.b" },
+			    { "test.lux_reader" },
+			    { "test.barrier" },
+			    { "test.c" },
+		    })) {
+			cerr << "Invalid algorithm groups" << endl;
+			return TestFail;
+		}
+
+		Metadata metadata;
+		controller.switchMode(CameraMode{}, &metadata);
+
+		for (unsigned int i = 0; i < 10; i++) {
+			state.frame = i;
+			metadata.clear();
+			controller.prepare(&metadata);
+
+			if (state.failed)
+				return TestFail;
+		}
+
+		*otherThread = state.otherThread;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		bool otherThread;
+
+		/* The algorithms run in the calling thread by default. */
+		if (runController(nullptr, &otherThread) != TestPass)
+			return TestFail;
+
+		if (otherThread) {
+			cerr << "Algorithms run concurrently by default" << endl;
+			return TestFail;
+		}
+
+		if (runController("4", &otherThread) != TestPass)
+			return TestFail;
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(RPiControllerTest)
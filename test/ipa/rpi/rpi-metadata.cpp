@@ -0,0 +1,162 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * Raspberry Pi controller metadata tests
+ */
+
+#include <any>
+#include <iostream>
+#include <mutex>
+#include <string>
+
+#include "controller/awb_status.h"
+#include "controller/lux_status.h"
+#include "controller/metadata.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace RPiController;
+
+class RPiMetadataTest : public Test
+{
+protected:
+	int testTags()
+	{
+		Metadata metadata;
+		LuxStatus lux{};
+		lux.lux = 400;
+
+		/* Items set by tag must be visible by name, and vice versa. */
+		metadata.set(MetadataTag::LuxStatus, lux);
+		lux = {};
+		if (metadata.get("lux.status", lux) || lux.lux != 400) {
+			cerr << "Failed to get tagged item by name" << endl;
+			return TestFail;
+		}
+
+		lux.lux = 800;
+		metadata.set("lux.status", lux);
+		lux = {};
+		if (metadata.get(MetadataTag::LuxStatus, lux) || lux.lux != 800) {
+			cerr << "Failed to get named item by tag" << endl;
+			return TestFail;
+		}
+
+		/* Tags without a slot are stored by name. */
+		metadata.set("custom.status", 42);
+		int value = 0;
+		if (metadata.get("custom.status", value) || value != 42) {
+			cerr << "Failed to get custom item" << endl;
+			return TestFail;
+		}
+
+		AwbStatus awb;
+		if (!metadata.get(MetadataTag::AwbStatus, awb) ||
+		    !metadata.get("other.status", value)) {
+			cerr << "Got item that hasn't been set" << endl;
+			return TestFail;
+		}
+
+		try {
+			metadata.get(MetadataTag::LuxStatus, awb);
+			cerr << "Got item with the wrong type" << endl;
+			return TestFail;
+		} catch (const bad_any_cast &) {
+		}
+
+		/* In-place access returns nullptr on type mismatch. */
+		{
+			std::scoped_lock lock(metadata);
+			if (metadata.getLocked<AwbStatus>("lux.status") ||
+			    metadata.getLocked<const AwbStatus>(MetadataTag::LuxStatus) ||
+			    metadata.getLocked<AwbStatus>("custom.status")) {
+				cerr << "Got in-place item with the wrong type" << endl;
+				return TestFail;
+			}
+
+			if (!metadata.getLocked<LuxStatus>("lux.status")) {
+				cerr << "Failed to get in-place item by name" << endl;
+				return TestFail;
+			}
+		}
+
+		metadata.clear();
+		if (!metadata.get(MetadataTag::LuxStatus, lux) ||
+		    !metadata.get("custom.status", value)) {
+			cerr << "Got item after clear" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testMerge()
+	{
+		Metadata current, last;
+		LuxStatus lux{};
+		AwbStatus awb{};
+
+		lux.lux = 100;
+		current.set(MetadataTag::LuxStatus, lux);
+		lux.lux = 200;
+		last.set(MetadataTag::LuxStatus, lux);
+		awb.temperatureK = 5000;
+		last.set(MetadataTag::AwbStatus, awb);
+
+		/* Existing items must be preserved, missing ones copied. */
+		current.mergeCopy(last);
+		if (current.get(MetadataTag::LuxStatus, lux) || lux.lux != 100 ||
+		    current.get(MetadataTag::AwbStatus, awb) || awb.temperatureK != 5000) {
+			cerr << "Incorrect merged items" << endl;
+			return TestFail;
+		}
+
+		/* Modifying a copied item must not affect the original. */
+		{
+			std::scoped_lock lock(current);
+			AwbStatus *status = current.getLocked<AwbStatus>(MetadataTag::AwbStatus);
+			status->temperatureK = 3000;
+		}
+
+		if (last.get(MetadataTag::AwbStatus, awb) || awb.temperatureK != 5000) {
+			cerr << "Merged item not copied on write" << endl;
+			return TestFail;
+		}
+
+		/* Overwriting the original must not affect the copy either. */
+		awb.temperatureK = 6500;
+		last.set(MetadataTag::AwbStatus, awb);
+		Metadata copy = last;
+		awb.temperatureK = 2800;
+		last.set(MetadataTag::AwbStatus, awb);
+
+		if (copy.get(MetadataTag::AwbStatus, awb) || awb.temperatureK != 6500) {
+			cerr << "Copied item modified through the original" << endl;
+			return TestFail;
+		}
+
+		/* Merging moves missing items only. */
+		Metadata empty;
+		empty.merge(last);
+		if (empty.get(MetadataTag::LuxStatus, lux) || lux.lux != 200 ||
+		    !last.get(MetadataTag::LuxStatus, lux)) {
+			cerr << "Item not moved by merge" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = testTags();
+		if (ret != TestPass)
+			return ret;
+
+		return testMerge();
+	}
+};
+
+TEST_REGISTER(RPiMetadataTest)
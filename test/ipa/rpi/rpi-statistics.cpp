@@ -0,0 +1,77 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Raspberry Pi Ltd
+ *
+ * Raspberry Pi statistics pool tests
+ */
+
+#include <iostream>
+
+#include "controller/statistics.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+using namespace RPiController;
+
+class RPiStatisticsTest : public Test
+{
+protected:
+	int run() override
+	{
+		StatisticsPool pool(Statistics::AgcStatsPos::PostWb,
+				    Statistics::ColourStatsPos::PreLsc);
+
+		StatisticsPtr stats = pool.acquire();
+		if (stats->agcStatsPos != Statistics::AgcStatsPos::PostWb ||
+		    stats->colourStatsPos != Statistics::ColourStatsPos::PreLsc) {
+			cerr << "Statistics created with the wrong positions" << endl;
+			return TestFail;
+		}
+
+		stats->awbRegions.init({ 32, 32 });
+		const RgbyRegions::Region *regions = &*stats->awbRegions.begin();
+		Statistics *first = stats.get();
+
+		/* Statistics still referenced must not be handed out again. */
+		StatisticsPtr held = stats;
+		stats = pool.acquire();
+		if (stats.get() == first) {
+			cerr << "Statistics in use handed out again" << endl;
+			return TestFail;
+		}
+
+		/* Once released, they get reused along with their storage. */
+		held.reset();
+		stats.reset();
+		stats = pool.acquire();
+		if (stats.get() != first) {
+			cerr << "Released statistics not reused" << endl;
+			return TestFail;
+		}
+
+		stats->awbRegions.set(0, { { 1, 2, 3, 4 }, 5, 6 });
+		stats->awbRegions.init({ 32, 32 });
+		if (&*stats->awbRegions.begin() != regions) {
+			cerr << "Region storage not reused" << endl;
+			return TestFail;
+		}
+
+		if (stats->awbRegions.get(0).val.rSum || stats->awbRegions.get(0).counted) {
+			cerr << "Regions not cleared" << endl;
+			return TestFail;
+		}
+
+		uint32_t hist[] = { 1, 2, 3, 4 };
+		stats->yHist.set(hist, 4);
+		if (stats->yHist.bins() != 4 || stats->yHist.total() != 10) {
+			cerr << "Histogram not set" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+TEST_REGISTER(RPiStatisticsTest)
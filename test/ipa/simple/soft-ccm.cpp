@@ -0,0 +1,126 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * Software ISP color correction matrix tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <stdlib.h>
+#include <string>
+#include <unistd.h>
+
+#include <libcamera/base/file.h>
+
+#include "libcamera/internal/yaml_parser.h"
+
+#include "ccm.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+static const string tuningYaml =
+	"ccms:\n"
+	"  - ct: 2000\n"
+	"    ccm: [ 2, 0, 0, 0, 1, 0, 0, 0, 1 ]\n"
+	"  - ct: 8000\n"
+	"    ccm: [ 1, 0, 0, 0, 1, 0, 0, 0, 2 ]\n";
+
+class SoftCcmTest : public Test
+{
+protected:
+	int init() override
+	{
+		tuningFile_ = "/tmp/libcamera.test.XXXXXX";
+		int fd = mkstemp(&tuningFile_.front());
+		if (fd == -1)
+			return TestFail;
+
+		int ret = write(fd, tuningYaml.c_str(), tuningYaml.size());
+		close(fd);
+
+		if (ret != static_cast<int>(tuningYaml.size()))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		File file(tuningFile_);
+		if (!file.open(File::OpenModeFlag::ReadOnly)) {
+			cerr << "Failed to open tuning file" << endl;
+			return TestFail;
+		}
+
+		unique_ptr<YamlObject> tuningData = YamlParser::parse(file);
+		if (!tuningData) {
+			cerr << "Failed to parse tuning file" << endl;
+			return TestFail;
+		}
+
+		Ccm ccm;
+		if (ccm.init(*tuningData) || !ccm.enabled()) {
+			cerr << "Failed to initialize the CCM" << endl;
+			return TestFail;
+		}
+
+		const ipa::Matrix<float, 3, 3> initial = ccm.get();
+
+		/*
+		 * The color temperature can't be estimated from magenta,
+		 * saturated red or saturated blue scenes, the matrix must be
+		 * left untouched.
+		 */
+		static const uint64_t sums[][3] = {
+			{ 1000, 1, 1000 },
+			{ 1000, 1, 1 },
+			{ 1, 1, 1000 },
+		};
+
+		for (const auto &[sumR, sumG, sumB] : sums) {
+			ccm.update(sumR, sumG, sumB);
+			if (!equal(ccm.get(), initial)) {
+				cerr << "CCM changed for sums " << sumR << ", "
+				     << sumG << ", " << sumB << ": " << ccm.get()
+				     << endl;
+				return TestFail;
+			}
+		}
+
+		/* A neutral scene must still update the matrix. */
+		ccm.update(1000, 1000, 1000);
+		if (equal(ccm.get(), initial)) {
+			cerr << "CCM not updated for a neutral scene" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		unlink(tuningFile_.c_str());
+	}
+
+private:
+	static bool equal(const ipa::Matrix<float, 3, 3> &m1,
+			  const ipa::Matrix<float, 3, 3> &m2)
+	{
+		for (unsigned int i = 0; i < 3; i++) {
+			for (unsigned int j = 0; j < 3; j++) {
+				if (m1[i][j] != m2[i][j])
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	string tuningFile_;
+};
+
+TEST_REGISTER(SoftCcmTest)
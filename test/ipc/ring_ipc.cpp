@@ -0,0 +1,336 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Shared memory ring IPC test
+ */
+
+#include <functional>
+#include <iostream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/unique_fd.h>
+
+#include "libcamera/internal/ipc_pipe.h"
+#include "libcamera/internal/ipc_pipe_ring.h"
+#include "libcamera/internal/ipc_ring.h"
+#include "libcamera/internal/process.h"
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+enum {
+	CmdExit = 0,
+	CmdGetSync = 1,
+	CmdSetAsync = 2,
+};
+
+const int32_t kInitialValue = 1337;
+const int32_t kInvalidValue = -1;
+
+/*
+ * Layout of the rings in shared memory, the head and tail indices are stored
+ * in their own cache lines, followed by the data area.
+ */
+const size_t kRingHeadOffset = 0;
+const size_t kRingDataOffset = 128;
+const uint32_t kRingSize = 128 * 1024;
+
+class RingTestIPCSlave
+{
+public:
+	RingTestIPCSlave()
+		: value_(kInitialValue), exitCode_(EXIT_FAILURE), exit_(false)
+	{
+		dispatcher_ = Thread::current()->eventDispatcher();
+		ipc_.readyRead.connect(this, &RingTestIPCSlave::readyRead);
+	}
+
+	int run(IPCRing::Handle handle)
+	{
+		if (ipc_.bind(std::move(handle))) {
+			cerr << "Failed to connect to IPC channel" << endl;
+			return EXIT_FAILURE;
+		}
+
+		while (!exit_)
+			dispatcher_->processEvents();
+
+		ipc_.close();
+
+		return exitCode_;
+	}
+
+private:
+	void readyRead()
+	{
+		IPCRing::Payload message;
+		int ret;
+
+		ret = ipc_.receive(&message);
+		if (ret) {
+			cerr << "Receive message failed: " << ret << endl;
+			return;
+		}
+
+		IPCMessage ipcMessage(message);
+		uint32_t cmd = ipcMessage.header().cmd;
+
+		switch (cmd) {
+		case CmdExit: {
+			exitCode_ = EXIT_SUCCESS;
+			exit_ = true;
+			break;
+		}
+
+		case CmdGetSync: {
+			IPCMessage::Header header = { cmd, ipcMessage.header().cookie };
+			IPCMessage response(header);
+
+			response.data().resize(sizeof(value_));
+			memcpy(response.data().data(), &value_, sizeof(value_));
+
+			ret = ipc_.send(response.payload());
+			if (ret < 0) {
+				cerr << "Reply failed" << endl;
+				exit_ = true;
+			}
+			break;
+		}
+
+		case CmdSetAsync: {
+			/*
+			 * Values are expected to be received in increasing
+			 * order, invalidate the value otherwise.
+			 */
+			int32_t value;
+			memcpy(&value, ipcMessage.data().data(), sizeof(value));
+
+			if (value_ != kInvalidValue && value == value_ + 1)
+				value_ = value;
+			else
+				value_ = kInvalidValue;
+			break;
+		}
+		}
+	}
+
+	int32_t value_;
+
+	IPCRing ipc_;
+	EventDispatcher *dispatcher_;
+	int exitCode_;
+	bool exit_;
+};
+
+class RingTestIPC : public Test
+{
+protected:
+	int setValue(int32_t val, size_t size, bool withFd)
+	{
+		IPCMessage msg(CmdSetAsync);
+
+		msg.data().resize(std::max(size, sizeof(val)));
+		memcpy(msg.data().data(), &val, sizeof(val));
+
+		if (withFd)
+			msg.fds().push_back(SharedFD(eventfd(0, EFD_CLOEXEC)));
+
+		int ret = ipc_->sendAsync(msg);
+		if (ret < 0) {
+			cerr << "Failed to call set value" << endl;
+			return ret;
+		}
+
+		return 0;
+	}
+
+	int getValue()
+	{
+		IPCMessage msg(CmdGetSync);
+		IPCMessage buf;
+
+		int ret = ipc_->sendSync(msg, &buf);
+		if (ret < 0) {
+			cerr << "Failed to call get value" << endl;
+			return ret;
+		}
+
+		int32_t value;
+		memcpy(&value, buf.data().data(), sizeof(value));
+		return value;
+	}
+
+	int exit()
+	{
+		IPCMessage msg(CmdExit);
+
+		int ret = ipc_->sendAsync(msg);
+		if (ret < 0) {
+			cerr << "Failed to call exit" << endl;
+			return ret;
+		}
+
+		return 0;
+	}
+
+	/*
+	 * Corrupt the ring carrying data from the creator to the remote side
+	 * after sending a message, and check that the remote side rejects it
+	 * and closes the channel.
+	 */
+	int testCorruption(const char *name, std::function<void(uint8_t *ring)> corrupt)
+	{
+		IPCRing local;
+		IPCRing remote;
+
+		IPCRing::Handle handle = local.create();
+		UniqueFD memory(dup(handle.memory.get()));
+		if (!memory.isValid() || remote.bind(std::move(handle)) < 0) {
+			cerr << "Failed to create IPC ring" << endl;
+			return TestFail;
+		}
+
+		const size_t size = kRingDataOffset + kRingSize;
+		void *mem = mmap(nullptr, size, PROT_READ | PROT_WRITE,
+				 MAP_SHARED, memory.get(), 0);
+		if (mem == MAP_FAILED) {
+			cerr << "Failed to map IPC ring" << endl;
+			return TestFail;
+		}
+
+		IPCRing::Payload payload;
+		payload.data.resize(16);
+		int ret = local.send(payload);
+		if (ret < 0) {
+			cerr << "Failed to send payload" << endl;
+			munmap(mem, size);
+			return TestFail;
+		}
+
+		corrupt(static_cast<uint8_t *>(mem));
+
+		ret = remote.receive(&payload);
+		munmap(mem, size);
+
+		if (ret != -EPROTO || remote.isBound()) {
+			cerr << "Ring with " << name << " not rejected" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int testCorruptions()
+	{
+		int ret = testCorruption("head too far ahead", [](uint8_t *ring) {
+			uint32_t head = kRingSize + 8;
+			memcpy(ring + kRingHeadOffset, &head, sizeof(head));
+		});
+		if (ret != TestPass)
+			return ret;
+
+		ret = testCorruption("head too close to tail", [](uint8_t *ring) {
+			uint32_t head = 4;
+			memcpy(ring + kRingHeadOffset, &head, sizeof(head));
+		});
+		if (ret != TestPass)
+			return ret;
+
+		return testCorruption("invalid record size", [](uint8_t *ring) {
+			uint32_t recordSize = 0xffffff00;
+			memcpy(ring + kRingDataOffset, &recordSize, sizeof(recordSize));
+		});
+	}
+
+	int run()
+	{
+		/* The head and record sizes are untrusted, test their validation. */
+		if (testCorruptions() != TestPass)
+			return TestFail;
+
+		ipc_ = std::make_unique<IPCPipeRing>("", self().c_str());
+		if (!ipc_->isConnected()) {
+			cerr << "Failed to create IPCPipe" << endl;
+			return TestFail;
+		}
+
+		int32_t value = getValue();
+		if (value != kInitialValue) {
+			cerr << "Wrong initial value, expected "
+			     << kInitialValue << ", got " << value << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Send bursts of messages of varying sizes, some carrying file
+		 * descriptors or too large for the ring, to exercise ordering
+		 * between the ring and the socket. Check the value after each
+		 * burst.
+		 */
+		for (unsigned int burst = 0; burst < 20; ++burst) {
+			for (unsigned int i = 0; i < 100; ++i) {
+				size_t size = i == 50 ? 132 * 1024 : i * 13;
+				bool withFd = i % 50 == 3;
+
+				int ret = setValue(++value, size, withFd);
+				if (ret < 0) {
+					cerr << "Failed to set value: "
+					     << strerror(-ret) << endl;
+					return TestFail;
+				}
+			}
+
+			int32_t ret = getValue();
+			if (ret != value) {
+				cerr << "Wrong value, expected " << value
+				     << ", got " << ret << endl;
+				return TestFail;
+			}
+		}
+
+		int ret = exit();
+		if (ret < 0) {
+			cerr << "Failed to exit: " << strerror(-ret) << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+private:
+	ProcessManager processManager_;
+
+	unique_ptr<IPCPipeRing> ipc_;
+};
+
+/*
+ * Can't use TEST_REGISTER() as single binary needs to act as both client and
+ * server
+ */
+int main(int argc, char **argv)
+{
+	/* IPCPipeRing passes IPA module path in argv[1] */
+	if (argc == 6) {
+		IPCRing::Handle handle;
+		handle.socket = UniqueFD(std::stoi(argv[2]));
+		handle.memory = UniqueFD(std::stoi(argv[3]));
+		handle.rxDoorbell = UniqueFD(std::stoi(argv[4]));
+		handle.txDoorbell = UniqueFD(std::stoi(argv[5]));
+
+		RingTestIPCSlave slave;
+		return slave.run(std::move(handle));
+	}
+
+	RingTestIPC test;
+	test.setArgs(argc, argv);
+	return test.execute();
+}
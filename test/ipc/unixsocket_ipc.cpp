@@ -6,9 +6,11 @@
  */
 
 #include <algorithm>
+#include <errno.h>
 #include <fcntl.h>
 #include <iostream>
 #include <limits.h>
+#include <numeric>
 #include <stdlib.h>
 #include <sys/stat.h>
 #include <sys/types.h>
@@ -29,6 +31,7 @@
 
 using namespace std;
 using namespace libcamera;
+using namespace std::chrono_literals;
 
 enum {
 	CmdExit = 0,
@@ -158,6 +161,31 @@ protected:
 		return IPADataSerializer<int32_t>::deserialize(buf.data());
 	}
 
+	int callAsync(const IPCMessage &msg, IPCMessage *out)
+	{
+		int result = INT_MIN;
+
+		int ret = ipc_->sendCall(msg, [&](int status, IPCMessage &response) {
+			result = status;
+			*out = std::move(response);
+		});
+		if (ret < 0) {
+			cerr << "Failed to call async" << endl;
+			return ret;
+		}
+
+		/* The call must not complete before the event loop runs. */
+		if (result != INT_MIN) {
+			cerr << "Call completed synchronously" << endl;
+			return -EINVAL;
+		}
+
+		while (result == INT_MIN)
+			Thread::current()->eventDispatcher()->processEvents();
+
+		return result;
+	}
+
 	int exit()
 	{
 		IPCMessage msg(CmdExit);
@@ -199,6 +227,43 @@ protected:
 			return TestFail;
 		}
 
+		/* Test calls that complete asynchronously. */
+		IPCMessage::Header header = { CmdGetSync, 1 };
+		IPCMessage buf;
+		ret = callAsync(IPCMessage(header), &buf);
+		if (ret < 0) {
+			cerr << "Failed to get value asynchronously" << endl;
+			return TestFail;
+		}
+
+		ret = IPADataSerializer<int32_t>::deserialize(buf.data());
+		if (ret != kChangedValue) {
+			cerr << "Wrong async value, expected " << kChangedValue
+			     << ", got " << ret << endl;
+			return TestFail;
+		}
+
+		/* The slave doesn't reply to set commands, the call must time out. */
+		ipc_->setTimeout(50ms);
+
+		header = { CmdSetAsync, 2 };
+		IPCMessage msg(header);
+		tie(msg.data(), ignore) = IPADataSerializer<int32_t>::serialize(kChangedValue);
+
+		ret = callAsync(msg, &buf);
+		if (ret != -ETIMEDOUT) {
+			cerr << "Call didn't time out" << endl;
+			return TestFail;
+		}
+
+		/* Four calls have been issued, one of them timed out. */
+		const IPCPipe::LatencyHistogram &latency = ipc_->latency();
+		unsigned int calls = std::accumulate(latency.begin(), latency.end(), 0u);
+		if (calls != 3 || ipc_->timeouts() != 1) {
+			cerr << "Invalid call latency histogram" << endl;
+			return TestFail;
+		}
+
 		ret = exit();
 		if (ret < 0) {
 			cerr << "Failed to exit: " << strerror(-ret) << endl;
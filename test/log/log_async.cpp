@@ -0,0 +1,122 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Asynchronous logging test
+ */
+
+#include <iostream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/log.h>
+
+#include <libcamera/logging.h>
+
+#include "test.h"
+
+using namespace std;
+using namespace libcamera;
+
+LOG_DEFINE_CATEGORY(LogAsyncTest)
+
+class LogAsyncTest : public Test
+{
+protected:
+	static constexpr unsigned int kThreads = 4;
+	static constexpr unsigned int kMessages = 5000;
+
+	int run() override
+	{
+		stringstream log;
+
+		logSetStream(&log, false);
+		logSetLevel("LogAsyncTest", "DEBUG");
+
+		vector<thread> threads;
+		for (unsigned int i = 0; i < kThreads; ++i)
+			threads.emplace_back([i]() {
+				for (unsigned int j = 0; j < kMessages; ++j)
+					LOG(LogAsyncTest, Info)
+						<< "thread " << i << " message " << j;
+			});
+
+		for (thread &t : threads)
+			t.join();
+
+		/* Changing the log target flushes all queued messages. */
+		logSetTarget(LoggingTargetNone);
+
+		return verifyOutput(log);
+	}
+
+	int verifyOutput(istream &is)
+	{
+		vector<int> last(kThreads, -1);
+		unsigned int written = 0;
+		unsigned int dropped = 0;
+		string line;
+
+		while (getline(is, line)) {
+			size_t pos = line.find("log messages dropped");
+			if (pos != string::npos) {
+				size_t start = line.rfind(' ', pos - 2) + 1;
+				dropped += stoul(line.substr(start, pos - start));
+				continue;
+			}
+
+			pos = line.find("thread ");
+			if (pos == string::npos) {
+				cerr << "Unexpected log line: " << line << endl;
+				return TestFail;
+			}
+
+			unsigned int index;
+			int message;
+			if (sscanf(line.c_str() + pos, "thread %u message %d",
+				   &index, &message) != 2 || index >= kThreads) {
+				cerr << "Invalid log line: " << line << endl;
+				return TestFail;
+			}
+
+			/* Messages from a thread shall be written in order. */
+			if (message <= last[index]) {
+				cerr << "Message " << message << " from thread "
+				     << index << " out of order" << endl;
+				return TestFail;
+			}
+
+			last[index] = message;
+			written++;
+		}
+
+		if (written + dropped != kThreads * kMessages) {
+			cerr << "Expected " << kThreads * kMessages
+			     << " messages, got " << written << " written and "
+			     << dropped << " dropped" << endl;
+			return TestFail;
+		}
+
+		cout << written << " messages written, " << dropped
+		     << " dropped" << endl;
+
+		return TestPass;
+	}
+};
+
+/*
+ * Can't use TEST_REGISTER() as the environment must be set before the logger
+ * is instantiated.
+ */
+int main(int argc, char **argv)
+{
+	setenv("LIBCAMERA_LOG_ASYNC", "1", 1);
+
+	LogAsyncTest test;
+	test.setArgs(argc, argv);
+	return test.execute();
+}
@@ -9,6 +9,7 @@
 
 #include <libcamera/framebuffer_allocator.h>
 
+#include "libcamera/internal/framebuffer.h"
 #include "libcamera/internal/mapped_framebuffer.h"
 
 #include "camera_test.h"
@@ -103,6 +104,42 @@ protected:
 			return TestFail;
 		}
 
+		/* Test that mappings are cached in the buffer. */
+		using MapFlag = MappedFrameBuffer::MapFlag;
+		const FrameBuffer::Private *priv = buffer->_d();
+
+		const MappedFrameBuffer *read = priv->map(MapFlag::Read);
+		if (!read || read != priv->map(MapFlag::Read)) {
+			cout << "Failed to cache read mapping" << endl;
+			return TestFail;
+		}
+
+		const MappedFrameBuffer *rw = priv->map(MapFlag::ReadWrite);
+		if (!rw || rw == read || rw->flags() != MapFlag::ReadWrite) {
+			cout << "Failed to create RW mapping" << endl;
+			return TestFail;
+		}
+
+		/* Existing mappings are reused when they allow the access. */
+		if (priv->map(MapFlag::Write) != rw ||
+		    priv->map(MapFlag::Read) != read) {
+			cout << "Failed to reuse cached mappings" << endl;
+			return TestFail;
+		}
+
+		rw->beginAccess(MapFlag::Write);
+		rw->planes()[0][0] = 0xa5;
+		rw->endAccess(MapFlag::Write);
+
+		read->beginAccess(MapFlag::Read);
+		uint8_t value = read->planes()[0][0];
+		read->endAccess(MapFlag::Read);
+
+		if (value != 0xa5) {
+			cout << "Cached mappings are not coherent" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
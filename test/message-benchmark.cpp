@@ -0,0 +1,227 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Message queue latency and throughput benchmark
+ */
+
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/message.h>
+#include <libcamera/base/object.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/utils.h>
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono;
+
+namespace {
+
+/* Count the received messages, and optionally reply to a peer. */
+class CountingReceiver : public Object
+{
+public:
+	CountingReceiver()
+		: peer_(nullptr), replies_(0), count_(0)
+	{
+	}
+
+	void setPeer(Object *peer, unsigned int replies)
+	{
+		peer_ = peer;
+		replies_ = replies;
+	}
+
+	unsigned int count() const { return count_.load(memory_order_acquire); }
+
+protected:
+	void message(Message *msg) override
+	{
+		if (msg->type() != Message::None) {
+			Object::message(msg);
+			return;
+		}
+
+		unsigned int count = count_.fetch_add(1, memory_order_release) + 1;
+
+		if (peer_ && count <= replies_)
+			peer_->postMessage(make_unique<Message>(Message::None));
+	}
+
+private:
+	Object *peer_;
+	unsigned int replies_;
+	atomic<unsigned int> count_;
+};
+
+class ProducerThread : public Thread
+{
+public:
+	ProducerThread(Object *receiver, unsigned int count)
+		: receiver_(receiver), count_(count)
+	{
+	}
+
+protected:
+	void run() override
+	{
+		for (unsigned int i = 0; i < count_; ++i)
+			receiver_->postMessage(make_unique<Message>(Message::None));
+	}
+
+private:
+	Object *receiver_;
+	unsigned int count_;
+};
+
+class MessageBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		thread_.start();
+		peerThread_.start();
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		int ret = roundTrip();
+		if (ret != TestPass)
+			return ret;
+
+		for (unsigned int producers : { 1, 4 }) {
+			ret = throughput(producers);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		thread_.exit(0);
+		thread_.wait();
+		peerThread_.exit(0);
+		peerThread_.wait();
+	}
+
+private:
+	/*
+	 * Measure the latency of messages bounced back and forth between two
+	 * receivers bound to different threads.
+	 */
+	int roundTrip()
+	{
+		static constexpr unsigned int kIterations = 10000;
+
+		CountingReceiver &ping = createReceiver();
+		CountingReceiver &pong = createReceiver();
+
+		ping.setPeer(&pong, kIterations);
+		pong.setPeer(&ping, kIterations);
+		ping.moveToThread(&thread_);
+		pong.moveToThread(&peerThread_);
+
+		utils::time_point start = utils::clock::now();
+
+		ping.postMessage(make_unique<Message>(Message::None));
+
+		int ret = waitForMessages(pong, kIterations, start);
+		if (ret != TestPass)
+			return ret;
+
+		nanoseconds duration = utils::clock::now() - start;
+
+		cout << "Round trip latency: "
+		     << (duration / kIterations).count() << "ns" << endl;
+
+		return TestPass;
+	}
+
+	/*
+	 * Measure the rate at which messages posted by concurrent producer
+	 * threads are delivered to the worker thread.
+	 */
+	int throughput(unsigned int producers)
+	{
+		static constexpr unsigned int kMessages = 200000;
+
+		CountingReceiver &receiver = createReceiver();
+		receiver.moveToThread(&thread_);
+
+		vector<unique_ptr<ProducerThread>> threads;
+		for (unsigned int i = 0; i < producers; ++i)
+			threads.push_back(make_unique<ProducerThread>(&receiver,
+								       kMessages / producers));
+
+		utils::time_point start = utils::clock::now();
+
+		for (auto &thread : threads)
+			thread->start();
+
+		for (auto &thread : threads)
+			thread->wait();
+
+		const unsigned int total = kMessages / producers * producers;
+		int ret = waitForMessages(receiver, total, start);
+		if (ret != TestPass)
+			return ret;
+
+		duration<double> elapsed = utils::clock::now() - start;
+
+		cout << "Throughput with " << producers << " producer(s): "
+		     << static_cast<unsigned int>(total / elapsed.count())
+		     << " messages/s" << endl;
+
+		return TestPass;
+	}
+
+	int waitForMessages(const CountingReceiver &receiver, unsigned int count,
+			    utils::time_point start)
+	{
+		utils::time_point timeout = start + 10s;
+
+		while (receiver.count() != count) {
+			if (utils::clock::now() > timeout) {
+				cerr << "Timeout waiting for messages ("
+				     << receiver.count() << "/" << count << ")"
+				     << endl;
+				return TestFail;
+			}
+
+			this_thread::yield();
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Receivers are destroyed with the test, after the thread they are
+	 * bound to has been stopped.
+	 */
+	CountingReceiver &createReceiver()
+	{
+		receivers_.push_back(make_unique<CountingReceiver>());
+		return *receivers_.back();
+	}
+
+	Thread thread_;
+	Thread peerThread_;
+	vector<unique_ptr<CountingReceiver>> receivers_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(MessageBenchmark)
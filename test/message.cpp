@@ -154,6 +154,28 @@ protected:
 			return TestFail;
 		}
 
+		/* Test dispatching the messages of a single receiver. */
+		MessageReceiver first;
+		MessageReceiver second;
+
+		first.postMessage(std::make_unique<Message>(Message::None));
+		second.postMessage(std::make_unique<Message>(Message::None));
+
+		Thread::current()->dispatchMessages(Message::None, &second);
+
+		if (first.status() != MessageReceiver::NoMessage ||
+		    second.status() != MessageReceiver::MessageReceived) {
+			cout << "Messages dispatched to the wrong receiver" << endl;
+			return TestFail;
+		}
+
+		Thread::current()->dispatchMessages(Message::None);
+
+		if (first.status() != MessageReceiver::MessageReceived) {
+			cout << "Message to the first receiver not dispatched" << endl;
+			return TestFail;
+		}
+
 		return TestPass;
 	}
 
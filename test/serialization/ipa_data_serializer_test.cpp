@@ -72,9 +72,25 @@ int testVectorSerdes(const std::vector<T> &in,
 
 	std::tie(buf, fds) = IPADataSerializer<std::vector<T>>::serialize(in, cs);
 	std::vector<T> out = IPADataSerializer<std::vector<T>>::deserialize(buf, fds, cs);
-	if (in == out)
+	if (in == out && cs)
 		return TestPass;
 
+	/*
+	 * Serializing in place after existing data must produce the same
+	 * result. ControlInfoMap instances are only serialized once per
+	 * ControlSerializer, skip them.
+	 */
+	if (in == out) {
+		std::vector<uint8_t> arena = { 0xff, 0xff };
+		std::vector<SharedFD> arenaFds;
+
+		IPADataSerializer<std::vector<T>>::serialize(in, arena, arenaFds);
+		if (std::equal(arena.begin() + 2, arena.end(), buf.begin(), buf.end()))
+			return TestPass;
+
+		cerr << "In-place serialization doesn't match" << endl;
+	}
+
 	char *name = abi::__cxa_demangle(typeid(T).name(), nullptr,
 					 nullptr, nullptr);
 	cerr << "Deserialized std::vector<" << name
@@ -0,0 +1,260 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * DebayerCpu binned output tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <stdint.h>
+#include <string.h>
+#include <vector>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "debayer_cpu.h"
+#include "debayer_test.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class DebayerCpuBinningTest : public Test
+{
+protected:
+	int run() override
+	{
+		static const PixelFormat inputFormats[] = {
+			formats::SBGGR8, formats::SGBRG8, formats::SGRBG8, formats::SRGGB8,
+			formats::SBGGR10, formats::SGBRG10, formats::SGRBG10, formats::SRGGB10,
+			formats::SBGGR12, formats::SGBRG12, formats::SGRBG12, formats::SRGGB12,
+		};
+
+		for (const PixelFormat &inputFormat : inputFormats) {
+			for (unsigned int factor : { 2, 4 }) {
+				int ret = testBinning(inputFormat, factor);
+				if (ret != TestPass)
+					return ret;
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	static constexpr unsigned int kRed = 200;
+	static constexpr unsigned int kGreen = 100;
+	static constexpr unsigned int kBlue = 50;
+
+	/* Check that an RGB888 image only contains the input color */
+	static bool isUniform(const vector<uint8_t> &image, const Size &size)
+	{
+		/* RGB888 is stored as blue, green, red */
+		const unsigned int lineLength = size.width * 3;
+		const unsigned int stride = image.size() / size.height;
+
+		for (unsigned int y = 0; y < size.height; y++) {
+			const uint8_t *line = image.data() + y * stride;
+
+			for (unsigned int x = 0; x < lineLength; x += 3) {
+				if (line[x] != kBlue || line[x + 1] != kGreen ||
+				    line[x + 2] != kRed)
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/*
+	 * Process the input to the given outputs, returning the content of the
+	 * output buffers in the same order. If \a skipFirst is set, no buffer is
+	 * given for the first output, and its result is empty.
+	 */
+	int process(const StreamConfiguration &inputCfg,
+		    vector<StreamConfiguration> outputCfgs, FrameBuffer *input,
+		    vector<vector<uint8_t>> &results, bool skipFirst = false)
+	{
+		DebayerCpu debayer(make_unique<SwStatsCpu>());
+		vector<reference_wrapper<StreamConfiguration>> cfgs;
+
+		for (StreamConfiguration &cfg : outputCfgs) {
+			std::tie(cfg.stride, cfg.frameSize) =
+				debayer.strideAndFrameSize(cfg.pixelFormat, cfg.size);
+			cfgs.push_back(cfg);
+		}
+
+		if (debayer.configure(inputCfg, cfgs, false)) {
+			cerr << "Failed to configure debayer for "
+			     << inputCfg.toString() << endl;
+			return TestFail;
+		}
+
+		vector<unique_ptr<FrameBuffer>> buffers;
+		vector<FrameBuffer *> outputs;
+		for (const StreamConfiguration &cfg : outputCfgs) {
+			buffers.push_back(createBuffer(cfg.frameSize));
+			if (!buffers.back()) {
+				cerr << "Failed to allocate output buffer" << endl;
+				return TestFail;
+			}
+
+			outputs.push_back(buffers.back().get());
+		}
+
+		if (skipFirst)
+			outputs[0] = nullptr;
+
+		/* Identity lookup tables */
+		DebayerParams params;
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++)
+			params.red[i] = params.green[i] = params.blue[i] = i;
+
+		debayer.process(0, input, outputs, &params);
+
+		results.clear();
+		for (FrameBuffer *output : outputs)
+			results.push_back(output ? readBuffer(output) : vector<uint8_t>{});
+
+		return TestPass;
+	}
+
+	int testBinning(const PixelFormat &inputFormat, unsigned int factor)
+	{
+		BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputFormat);
+		const unsigned int bytesPerPixel = bayerFormat.bitDepth > 8 ? 2 : 1;
+		const unsigned int shift = bayerFormat.bitDepth - 8;
+		const Size inputSize(640, 480);
+		const Size fullSize(632, 472);
+		const Size binnedSize = fullSize / factor;
+
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = inputFormat;
+		inputCfg.size = inputSize;
+		inputCfg.stride = inputSize.width * bytesPerPixel;
+
+		unique_ptr<FrameBuffer> input =
+			createBuffer(inputCfg.stride * inputSize.height);
+		if (!input) {
+			cerr << "Failed to allocate input buffer" << endl;
+			return TestFail;
+		}
+
+		/* Fill the input with a uniform color */
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid()) {
+				cerr << "Failed to map input buffer" << endl;
+				return TestFail;
+			}
+
+			uint8_t *data = map.planes()[0].data();
+			/* Location of the red pixel in the 2x2 pattern */
+			const unsigned int redX = bayerFormat.order == BayerFormat::BGGR ||
+						  bayerFormat.order == BayerFormat::GRBG;
+			const unsigned int redY = bayerFormat.order == BayerFormat::BGGR ||
+						  bayerFormat.order == BayerFormat::GBRG;
+
+			for (unsigned int y = 0; y < inputSize.height; y++) {
+				for (unsigned int x = 0; x < inputSize.width; x++) {
+					unsigned int value;
+					if (x % 2 == redX && y % 2 == redY)
+						value = kRed;
+					else if (x % 2 != redX && y % 2 != redY)
+						value = kBlue;
+					else
+						value = kGreen;
+
+					value <<= shift;
+
+					uint8_t *pixel = data + y * inputCfg.stride +
+							 x * bytesPerPixel;
+					if (bytesPerPixel == 1)
+						*pixel = value;
+					else
+						*reinterpret_cast<uint16_t *>(pixel) = value;
+				}
+			}
+		}
+
+		StreamConfiguration fullCfg;
+		fullCfg.pixelFormat = formats::RGB888;
+		fullCfg.size = fullSize;
+
+		StreamConfiguration binnedCfg;
+		binnedCfg.pixelFormat = formats::RGB888;
+		binnedCfg.size = binnedSize;
+
+		/* Binned output only, without a buffer for the full output */
+		vector<vector<uint8_t>> binned;
+		int ret = process(inputCfg, { fullCfg, binnedCfg }, input.get(),
+				  binned, true);
+		if (ret != TestPass)
+			return ret;
+
+		if (!isUniform(binned[1], binnedSize)) {
+			cerr << "Invalid binned output for " << inputFormat
+			     << " with factor " << factor << endl;
+			return TestFail;
+		}
+
+		/* Full and binned outputs from the same pass */
+		vector<vector<uint8_t>> full;
+		ret = process(inputCfg, { fullCfg }, input.get(), full);
+		if (ret != TestPass)
+			return ret;
+
+		vector<vector<uint8_t>> dual;
+		ret = process(inputCfg, { fullCfg, binnedCfg }, input.get(), dual);
+		if (ret != TestPass)
+			return ret;
+
+		if (dual[0] != full[0] || dual[1] != binned[1]) {
+			cerr << "Dual stream output differs for " << inputFormat
+			     << " with factor " << factor << endl;
+			return TestFail;
+		}
+
+		/*
+		 * A single output is debayered at native resolution from the
+		 * centre of the input, even if the input could be binned to it.
+		 * Clear the top lines of the input, outside of the centre crop
+		 * but inside the window that binning would use.
+		 */
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid()) {
+				cerr << "Failed to map input buffer" << endl;
+				return TestFail;
+			}
+
+			memset(map.planes()[0].data(), 0, 16 * inputCfg.stride);
+		}
+
+		vector<vector<uint8_t>> native;
+		ret = process(inputCfg, { binnedCfg }, input.get(), native);
+		if (ret != TestPass)
+			return ret;
+
+		if (!isUniform(native[0], binnedSize)) {
+			cerr << "Single output binned for " << inputFormat
+			     << " with factor " << factor << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(DebayerCpuBinningTest)
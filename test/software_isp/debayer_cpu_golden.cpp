@@ -0,0 +1,389 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * DebayerCpu output values tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdint.h>
+#include <stdlib.h>
+#include <vector>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/formats.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "debayer_cpu.h"
+#include "debayer_test.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+/* Expected output for a uniform color, with RGB888 stored as blue, green, red */
+struct Golden {
+	uint8_t bgr[3];
+	uint8_t y;
+	uint8_t u;
+	uint8_t v;
+};
+
+class DebayerCpuGoldenTest : public Test
+{
+protected:
+	int run() override
+	{
+		static const PixelFormat inputFormats[] = {
+			formats::SBGGR8, formats::SGBRG8, formats::SGRBG8, formats::SRGGB8,
+			formats::SBGGR10, formats::SGBRG10, formats::SGRBG10, formats::SRGGB10,
+			formats::SBGGR12, formats::SGBRG12, formats::SGRBG12, formats::SRGGB12,
+			formats::SBGGR10_CSI2P, formats::SGBRG10_CSI2P,
+			formats::SGRBG10_CSI2P, formats::SRGGB10_CSI2P,
+		};
+		static const PixelFormat outputFormats[] = {
+			formats::RGB888, formats::XRGB8888, formats::ARGB8888,
+			formats::BGR888, formats::XBGR8888, formats::ABGR8888,
+			formats::NV12, formats::YUYV,
+		};
+
+		for (bool simd : { false, true }) {
+			/* The SIMD selection is made when constructing the DebayerCpu */
+			if (simd)
+				unsetenv("LIBCAMERA_SOFTISP_NO_SIMD");
+			else
+				setenv("LIBCAMERA_SOFTISP_NO_SIMD", "1", 1);
+
+			for (const PixelFormat &inputFormat : inputFormats) {
+				for (const PixelFormat &outputFormat : outputFormats) {
+					int ret = testGolden(inputFormat, outputFormat);
+					if (ret != TestPass)
+						return ret;
+
+					ret = testIdentityCcm(inputFormat, outputFormat);
+					if (ret != TestPass)
+						return ret;
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	static constexpr unsigned int kRed = 200;
+	static constexpr unsigned int kGreen = 100;
+	static constexpr unsigned int kBlue = 50;
+
+	/*
+	 * BT.601 limited range values of the input color, and of the input
+	 * color with red and blue swapped.
+	 */
+	static constexpr Golden kGolden = { { kBlue, kGreen, kRed }, 123, 91, 175 };
+	static constexpr Golden kGoldenSwapped = { { kRed, kGreen, kBlue }, 99, 179, 99 };
+
+	const Size inputSize_{ 640, 480 };
+	const Size outputSize_{ 632, 480 };
+
+	static StreamConfiguration inputConfiguration(const PixelFormat &format,
+						      const Size &size)
+	{
+		BayerFormat bayerFormat = BayerFormat::fromPixelFormat(format);
+
+		StreamConfiguration cfg;
+		cfg.pixelFormat = format;
+		cfg.size = size;
+
+		if (bayerFormat.packing == BayerFormat::Packing::CSI2)
+			cfg.stride = size.width * 5 / 4;
+		else
+			cfg.stride = size.width * (bayerFormat.bitDepth > 8 ? 2 : 1);
+
+		return cfg;
+	}
+
+	/* Store an 8-bit value at the input bit depth */
+	static void storePixel(uint8_t *line, unsigned int x,
+			       const BayerFormat &bayerFormat, unsigned int value)
+	{
+		if (bayerFormat.packing == BayerFormat::Packing::CSI2) {
+			/* The least significant bits are left to 0 */
+			line[x / 4 * 5 + x % 4] = value;
+		} else if (bayerFormat.bitDepth == 8) {
+			line[x] = value;
+		} else {
+			reinterpret_cast<uint16_t *>(line)[x] =
+				value << (bayerFormat.bitDepth - 8);
+		}
+	}
+
+	int process(const StreamConfiguration &inputCfg, const PixelFormat &outputFormat,
+		    bool ccmEnabled, FrameBuffer *input, const DebayerParams &params,
+		    vector<uint8_t> &result)
+	{
+		DebayerCpu debayer(make_unique<SwStatsCpu>());
+
+		StreamConfiguration outputCfg;
+		outputCfg.pixelFormat = outputFormat;
+		outputCfg.size = outputSize_;
+		std::tie(outputCfg.stride, outputCfg.frameSize) =
+			debayer.strideAndFrameSize(outputCfg.pixelFormat,
+						   outputCfg.size);
+
+		vector<reference_wrapper<StreamConfiguration>> outputCfgs{ outputCfg };
+		if (debayer.configure(inputCfg, outputCfgs, ccmEnabled)) {
+			cerr << "Failed to configure debayer for "
+			     << inputCfg.pixelFormat << " -> " << outputFormat << endl;
+			return TestFail;
+		}
+
+		unique_ptr<FrameBuffer> output = createBuffer(outputCfg.frameSize);
+		if (!output) {
+			cerr << "Failed to allocate output buffer" << endl;
+			return TestFail;
+		}
+
+		debayer.process(0, input, { output.get() }, &params);
+
+		result = readBuffer(output.get());
+		if (result.empty()) {
+			cerr << "Failed to map output buffer" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	/* Check that every pixel of the output has the golden value */
+	bool check(const vector<uint8_t> &image, const PixelFormat &format,
+		   const Golden &golden)
+	{
+		const unsigned int width = outputSize_.width;
+		const unsigned int height = outputSize_.height;
+		vector<uint8_t> pattern;
+		unsigned int lineLength;
+		unsigned int stride;
+
+		if (format == formats::NV12) {
+			stride = image.size() * 2 / 3 / height;
+
+			for (unsigned int y = 0; y < height; y++) {
+				for (unsigned int x = 0; x < width; x++) {
+					if (image[y * stride + x] != golden.y)
+						return false;
+				}
+			}
+
+			/* Check the chroma plane below */
+			pattern = { golden.u, golden.v };
+			lineLength = width;
+			return checkLines(image.data() + stride * height, height / 2,
+					  stride, lineLength, pattern);
+		}
+
+		stride = image.size() / height;
+
+		if (format == formats::YUYV) {
+			pattern = { golden.y, golden.u, golden.y, golden.v };
+		} else {
+			/* BGR888 and 32-bit variants store red first */
+			const bool swap = format == formats::BGR888 ||
+					  format == formats::XBGR8888 ||
+					  format == formats::ABGR8888;
+
+			pattern = { golden.bgr[swap ? 2 : 0], golden.bgr[1],
+				    golden.bgr[swap ? 0 : 2] };
+			if (PixelFormatInfo::info(format).bitsPerPixel == 32)
+				pattern.push_back(255);
+		}
+
+		lineLength = width * pattern.size() / (format == formats::YUYV ? 2 : 1);
+
+		return checkLines(image.data(), height, stride, lineLength, pattern);
+	}
+
+	static bool checkLines(const uint8_t *data, unsigned int lines,
+			       unsigned int stride, unsigned int lineLength,
+			       const vector<uint8_t> &pattern)
+	{
+		for (unsigned int y = 0; y < lines; y++) {
+			const uint8_t *line = data + y * stride;
+
+			for (unsigned int x = 0; x < lineLength; x++) {
+				if (line[x] != pattern[x % pattern.size()])
+					return false;
+			}
+		}
+
+		return true;
+	}
+
+	/*
+	 * Debayer a uniform color to every output format, without CCM and
+	 * with a CCM swapping red and blue, and compare the output with
+	 * precomputed values.
+	 */
+	int testGolden(const PixelFormat &inputFormat, const PixelFormat &outputFormat)
+	{
+		BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputFormat);
+		StreamConfiguration inputCfg = inputConfiguration(inputFormat, inputSize_);
+
+		unique_ptr<FrameBuffer> input =
+			createBuffer(inputCfg.stride * inputSize_.height);
+		if (!input) {
+			cerr << "Failed to allocate input buffer" << endl;
+			return TestFail;
+		}
+
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid()) {
+				cerr << "Failed to map input buffer" << endl;
+				return TestFail;
+			}
+
+			uint8_t *data = map.planes()[0].data();
+			/* Location of the red pixel in the 2x2 pattern */
+			const unsigned int redX = bayerFormat.order == BayerFormat::BGGR ||
+						  bayerFormat.order == BayerFormat::GRBG;
+			const unsigned int redY = bayerFormat.order == BayerFormat::BGGR ||
+						  bayerFormat.order == BayerFormat::GBRG;
+
+			for (unsigned int y = 0; y < inputSize_.height; y++) {
+				for (unsigned int x = 0; x < inputSize_.width; x++) {
+					unsigned int value;
+					if (x % 2 == redX && y % 2 == redY)
+						value = kRed;
+					else if (x % 2 != redX && y % 2 != redY)
+						value = kBlue;
+					else
+						value = kGreen;
+
+					storePixel(data + y * inputCfg.stride, x,
+						   bayerFormat, value);
+				}
+			}
+		}
+
+		/*
+		 * Identity lookup tables. The CCM tables scale the input to the
+		 * gamma table range, and the gamma table scales it back.
+		 */
+		DebayerParams params;
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+			const int16_t value = i * 4;
+
+			params.red[i] = params.green[i] = params.blue[i] = i;
+			params.redCcm[i] = { 0, 0, value };
+			params.greenCcm[i] = { 0, value, 0 };
+			params.blueCcm[i] = { value, 0, 0 };
+		}
+		for (unsigned int i = 0; i < DebayerParams::kGammaLookupSize; i++)
+			params.gammaLut[i] = i / 4;
+
+		for (bool ccmEnabled : { false, true }) {
+			vector<uint8_t> result;
+
+			int ret = process(inputCfg, outputFormat, ccmEnabled,
+					  input.get(), params, result);
+			if (ret != TestPass)
+				return ret;
+
+			if (!check(result, outputFormat,
+				   ccmEnabled ? kGoldenSwapped : kGolden)) {
+				cerr << "Invalid output for " << inputFormat
+				     << " -> " << outputFormat
+				     << (ccmEnabled ? " with CCM" : "") << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Debayer random data with an identity CCM, and with the gamma table
+	 * applied through the per-channel lookup tables, and check that the
+	 * outputs are identical.
+	 */
+	int testIdentityCcm(const PixelFormat &inputFormat, const PixelFormat &outputFormat)
+	{
+		StreamConfiguration inputCfg = inputConfiguration(inputFormat, inputSize_);
+
+		unique_ptr<FrameBuffer> input =
+			createBuffer(inputCfg.stride * inputSize_.height);
+		if (!input) {
+			cerr << "Failed to allocate input buffer" << endl;
+			return TestFail;
+		}
+
+		mt19937 gen(inputFormat.fourcc() ^ outputFormat.fourcc());
+
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid()) {
+				cerr << "Failed to map input buffer" << endl;
+				return TestFail;
+			}
+
+			BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputFormat);
+			uint8_t *data = map.planes()[0].data();
+
+			for (unsigned int y = 0; y < inputSize_.height; y++) {
+				for (unsigned int x = 0; x < inputSize_.width; x++)
+					storePixel(data + y * inputCfg.stride, x,
+						   bayerFormat, gen() & 0xff);
+			}
+		}
+
+		DebayerParams::ColorLookupTable gamma;
+		for (uint8_t &value : gamma)
+			value = gen();
+
+		DebayerParams params;
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+			const int16_t value = i * 4;
+
+			params.red[i] = params.green[i] = params.blue[i] = gamma[i];
+			params.redCcm[i] = { value, 0, 0 };
+			params.greenCcm[i] = { 0, value, 0 };
+			params.blueCcm[i] = { 0, 0, value };
+		}
+		for (unsigned int i = 0; i < DebayerParams::kGammaLookupSize; i++)
+			params.gammaLut[i] = gamma[i / 4];
+
+		vector<uint8_t> reference;
+		vector<uint8_t> result;
+
+		int ret = process(inputCfg, outputFormat, false, input.get(),
+				  params, reference);
+		if (ret != TestPass)
+			return ret;
+
+		ret = process(inputCfg, outputFormat, true, input.get(), params,
+			      result);
+		if (ret != TestPass)
+			return ret;
+
+		if (reference != result) {
+			cerr << "Identity CCM output differs for " << inputFormat
+			     << " -> " << outputFormat << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(DebayerCpuGoldenTest)
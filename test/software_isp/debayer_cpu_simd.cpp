@@ -0,0 +1,207 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * DebayerCpu SIMD implementation tests
+ */
+
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/bayer_format.h"
+#include "libcamera/internal/mapped_framebuffer.h"
+
+#include "debayer_cpu.h"
+#include "debayer_test.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class DebayerCpuSimdTest : public Test
+{
+protected:
+	int run() override
+	{
+		static const PixelFormat inputFormats[] = {
+			formats::SBGGR8, formats::SGBRG8, formats::SGRBG8, formats::SRGGB8,
+			formats::SBGGR10, formats::SGBRG10, formats::SGRBG10, formats::SRGGB10,
+			formats::SBGGR12, formats::SGBRG12, formats::SGRBG12, formats::SRGGB12,
+		};
+		static const PixelFormat outputFormats[] = {
+			formats::RGB888, formats::XRGB8888,
+			formats::BGR888, formats::ABGR8888,
+			formats::NV12, formats::YUYV,
+		};
+		/* Output widths not multiple of 16 exercise the scalar tail */
+		static const Size sizes[][2] = {
+			{ { 640, 480 }, { 636, 480 } },
+			{ { 322, 64 }, { 318, 58 } },
+		};
+
+		for (const PixelFormat &inputFormat : inputFormats) {
+			for (const PixelFormat &outputFormat : outputFormats) {
+				for (const auto &size : sizes) {
+					for (bool ccmEnabled : { false, true }) {
+						int ret = compare(inputFormat, size[0],
+								  outputFormat, size[1],
+								  ccmEnabled);
+						if (ret != TestPass)
+							return ret;
+					}
+				}
+			}
+		}
+
+		return TestPass;
+	}
+
+private:
+	int process(bool simd, const StreamConfiguration &inputCfg,
+		    StreamConfiguration outputCfg, bool ccmEnabled,
+		    FrameBuffer *input, const DebayerParams &params,
+		    vector<uint8_t> &result)
+	{
+		/* The SIMD selection is made when constructing the DebayerCpu */
+		if (simd)
+			unsetenv("LIBCAMERA_SOFTISP_NO_SIMD");
+		else
+			setenv("LIBCAMERA_SOFTISP_NO_SIMD", "1", 1);
+
+		DebayerCpu debayer(make_unique<SwStatsCpu>());
+
+		std::tie(outputCfg.stride, outputCfg.frameSize) =
+			debayer.strideAndFrameSize(outputCfg.pixelFormat,
+						   outputCfg.size);
+
+		vector<reference_wrapper<StreamConfiguration>> outputCfgs{ outputCfg };
+		if (debayer.configure(inputCfg, outputCfgs, ccmEnabled)) {
+			cerr << "Failed to configure debayer for "
+			     << inputCfg.pixelFormat << " -> "
+			     << outputCfg.pixelFormat << endl;
+			return TestFail;
+		}
+
+		unique_ptr<FrameBuffer> output = createBuffer(outputCfg.frameSize);
+		if (!output) {
+			cerr << "Failed to allocate output buffer" << endl;
+			return TestFail;
+		}
+
+		debayer.process(0, input, { output.get() }, &params);
+
+		result = readBuffer(output.get());
+		if (result.empty()) {
+			cerr << "Failed to map output buffer" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int compare(const PixelFormat &inputFormat, const Size &inputSize,
+		    const PixelFormat &outputFormat, const Size &outputSize,
+		    bool ccmEnabled)
+	{
+		BayerFormat bayerFormat = BayerFormat::fromPixelFormat(inputFormat);
+		const unsigned int bytesPerPixel = bayerFormat.bitDepth > 8 ? 2 : 1;
+
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = inputFormat;
+		inputCfg.size = inputSize;
+		inputCfg.stride = inputSize.width * bytesPerPixel;
+
+		StreamConfiguration outputCfg;
+		outputCfg.pixelFormat = outputFormat;
+		outputCfg.size = outputSize;
+
+		unique_ptr<FrameBuffer> input =
+			createBuffer(inputCfg.stride * inputSize.height);
+		if (!input) {
+			cerr << "Failed to allocate input buffer" << endl;
+			return TestFail;
+		}
+
+		/* Fill the input and the lookup tables with random data */
+		mt19937 gen(inputFormat.fourcc() ^ outputFormat.fourcc());
+
+		{
+			MappedFrameBuffer map(input.get(), MappedFrameBuffer::MapFlag::Write);
+			if (!map.isValid()) {
+				cerr << "Failed to map input buffer" << endl;
+				return TestFail;
+			}
+
+			Span<uint8_t> data = map.planes()[0];
+			const unsigned int maxValue = (1 << bayerFormat.bitDepth) - 1;
+
+			if (bytesPerPixel == 1) {
+				for (uint8_t &pixel : data)
+					pixel = gen() & maxValue;
+			} else {
+				uint16_t *pixels = reinterpret_cast<uint16_t *>(data.data());
+				for (size_t i = 0; i < data.size() / 2; i++)
+					pixels[i] = gen() & maxValue;
+			}
+		}
+
+		DebayerParams params;
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+			params.red[i] = gen();
+			params.green[i] = gen();
+			params.blue[i] = gen();
+		}
+
+		/* Exceed the gamma table range to test clamping */
+		uniform_int_distribution<int16_t> ccmDist(-512, 1024);
+		for (unsigned int i = 0; i < DebayerParams::kRGBLookupSize; i++) {
+			params.redCcm[i] = { ccmDist(gen), ccmDist(gen), ccmDist(gen) };
+			params.greenCcm[i] = { ccmDist(gen), ccmDist(gen), ccmDist(gen) };
+			params.blueCcm[i] = { ccmDist(gen), ccmDist(gen), ccmDist(gen) };
+		}
+		for (uint8_t &value : params.gammaLut)
+			value = gen();
+
+		vector<uint8_t> reference;
+		vector<uint8_t> result;
+
+		int ret = process(false, inputCfg, outputCfg, ccmEnabled,
+				  input.get(), params, reference);
+		if (ret != TestPass)
+			return ret;
+
+		ret = process(true, inputCfg, outputCfg, ccmEnabled, input.get(),
+			      params, result);
+		if (ret != TestPass)
+			return ret;
+
+		if (reference != result) {
+			auto mismatch = std::mismatch(reference.begin(), reference.end(),
+						      result.begin());
+			cerr << "SIMD output differs from scalar output for "
+			     << inputFormat << " " << inputSize << " -> "
+			     << outputFormat << " " << outputSize
+			     << (ccmEnabled ? " with CCM" : "")
+			     << " at offset " << mismatch.first - reference.begin()
+			     << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+};
+
+} /* namespace */
+
+TEST_REGISTER(DebayerCpuSimdTest)
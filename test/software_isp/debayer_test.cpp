@@ -0,0 +1,41 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * DebayerCpu tests helpers
+ */
+
+#include "debayer_test.h"
+
+#include <libcamera/base/memfd.h>
+#include <libcamera/base/span.h>
+
+#include "libcamera/internal/mapped_framebuffer.h"
+
+using namespace libcamera;
+
+/* Create a single plane frame buffer backed by a memfd */
+std::unique_ptr<FrameBuffer> createBuffer(size_t size)
+{
+	UniqueFD fd = MemFd::create("debayer", size);
+	if (!fd.isValid())
+		return nullptr;
+
+	FrameBuffer::Plane plane;
+	plane.fd = SharedFD(std::move(fd));
+	plane.offset = 0;
+	plane.length = size;
+
+	return std::make_unique<FrameBuffer>(std::vector<FrameBuffer::Plane>{ plane });
+}
+
+/* Read the content of a single plane frame buffer, empty on error */
+std::vector<uint8_t> readBuffer(FrameBuffer *buffer)
+{
+	MappedFrameBuffer map(buffer, MappedFrameBuffer::MapFlag::Read);
+	if (!map.isValid())
+		return {};
+
+	Span<uint8_t> data = map.planes()[0];
+	return { data.begin(), data.end() };
+}
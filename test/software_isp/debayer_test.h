@@ -0,0 +1,18 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * DebayerCpu tests helpers
+ */
+
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+
+#include <libcamera/framebuffer.h>
+
+std::unique_ptr<libcamera::FrameBuffer> createBuffer(size_t size);
+std::vector<uint8_t> readBuffer(libcamera::FrameBuffer *buffer);
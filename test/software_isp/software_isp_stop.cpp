@@ -0,0 +1,242 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * SoftwareIsp stop tests
+ */
+
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include <libcamera/formats.h>
+#include <libcamera/framebuffer.h>
+#include <libcamera/stream.h>
+
+#include "libcamera/internal/camera_sensor.h"
+#include "libcamera/internal/device_enumerator.h"
+#include "libcamera/internal/ipa_manager.h"
+#include "libcamera/internal/media_device.h"
+#include "libcamera/internal/pipeline_handler.h"
+#include "libcamera/internal/software_isp/software_isp.h"
+
+#include "debayer_test.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+using namespace std::chrono_literals;
+
+namespace {
+
+class SoftwareIspStopTest : public Test
+{
+protected:
+	int init() override
+	{
+		ipaManager_ = make_unique<IPAManager>();
+
+		for (const PipelineHandlerFactoryBase *factory :
+		     PipelineHandlerFactoryBase::factories()) {
+			if (factory->name() == "simple") {
+				pipe_ = factory->create(nullptr);
+				break;
+			}
+		}
+
+		if (!pipe_) {
+			cerr << "Simple pipeline not found" << endl;
+			return TestSkip;
+		}
+
+		enumerator_ = DeviceEnumerator::create();
+		if (!enumerator_ || enumerator_->enumerate()) {
+			cerr << "Failed to enumerate media devices" << endl;
+			return TestFail;
+		}
+
+		DeviceMatch dm("vimc");
+		media_ = enumerator_->search(dm);
+		if (!media_) {
+			cerr << "Unable to find \'vimc\' media device node" << endl;
+			return TestSkip;
+		}
+
+		MediaEntity *entity = media_->getEntityByName("Sensor B");
+		if (!entity) {
+			cerr << "Unable to find media entity 'Sensor B'" << endl;
+			return TestFail;
+		}
+
+		sensor_ = make_unique<CameraSensor>(entity);
+		if (sensor_->init() < 0) {
+			cerr << "Unable to initialise camera sensor" << endl;
+			return TestFail;
+		}
+
+		/* The soft IPA requires exposure and gain controls. */
+		swIsp_ = make_unique<SoftwareIsp>(pipe_.get(), sensor_.get());
+		if (!swIsp_->isValid()) {
+			cerr << "Software ISP not supported by the sensor" << endl;
+			return TestSkip;
+		}
+
+		swIsp_->inputBufferReady.connect(this, &SoftwareIspStopTest::bufferReady);
+		swIsp_->outputBufferReady.connect(this, &SoftwareIspStopTest::bufferReady);
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		/* Queue more frames than there are parameters buffers. */
+		constexpr unsigned int kFrameCount = kDebayerParamsBufferCount * 2;
+		const Size size{ 640, 480 };
+
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = formats::SBGGR8;
+		inputCfg.size = size;
+		inputCfg.stride = size.width;
+
+		vector<PixelFormat> outputFormats = swIsp_->formats(inputCfg.pixelFormat);
+		if (outputFormats.empty()) {
+			cerr << "No output format for " << inputCfg.pixelFormat << endl;
+			return TestFail;
+		}
+
+		StreamConfiguration outputCfg;
+		outputCfg.pixelFormat = outputFormats.front();
+		outputCfg.size = swIsp_->sizes(inputCfg.pixelFormat, size).max;
+		std::tie(outputCfg.stride, outputCfg.frameSize) =
+			swIsp_->strideAndFrameSize(outputCfg.pixelFormat, outputCfg.size);
+		outputCfg.setStream(&stream_);
+
+		vector<reference_wrapper<StreamConfiguration>> outputCfgs{ outputCfg };
+		if (swIsp_->configure(inputCfg, outputCfgs, sensor_->controls())) {
+			cerr << "Failed to configure the software ISP" << endl;
+			return TestFail;
+		}
+
+		vector<unique_ptr<FrameBuffer>> buffers;
+		for (unsigned int i = 0; i < kFrameCount * 2; i++) {
+			size_t bufferSize = i < kFrameCount
+					  ? inputCfg.stride * size.height
+					  : outputCfg.frameSize;
+			buffers.push_back(createBuffer(bufferSize));
+			if (!buffers.back()) {
+				cerr << "Failed to allocate buffer" << endl;
+				return TestFail;
+			}
+		}
+
+		if (swIsp_->start()) {
+			cerr << "Failed to start the software ISP" << endl;
+			return TestFail;
+		}
+
+		/*
+		 * Stop right after queuing the frames, with frames waiting for
+		 * their parameters buffer to be filled or released.
+		 */
+		for (unsigned int i = 0; i < kFrameCount; i++) {
+			int ret = swIsp_->queueBuffers(i, buffers[i].get(),
+						       { { &stream_, buffers[kFrameCount + i].get() } });
+			if (ret) {
+				cerr << "Failed to queue frame " << i << endl;
+				return TestFail;
+			}
+		}
+
+		swIsp_->stop();
+
+		/* All buffers must be completed once, when stop() returns. */
+		if (completions_.size() != buffers.size()) {
+			cerr << "Completed " << completions_.size() << " buffers out of "
+			     << buffers.size() << endl;
+			return TestFail;
+		}
+
+		unsigned int cancelled = 0;
+		for (const auto &[buffer, status] : completions_) {
+			if (status.count != 1) {
+				cerr << "Buffer completed " << status.count << " times" << endl;
+				return TestFail;
+			}
+
+			if (status.status == FrameMetadata::FrameCancelled)
+				cancelled++;
+		}
+
+		/*
+		 * The frames waiting for a parameters buffer used by an earlier
+		 * frame can't have been processed.
+		 */
+		if (cancelled < (kFrameCount - kDebayerParamsBufferCount) * 2) {
+			cerr << "Only " << cancelled << " buffers cancelled" << endl;
+			return TestFail;
+		}
+
+		/* Make sure no stale work is left to run on the next start. */
+		if (swIsp_->start()) {
+			cerr << "Failed to restart the software ISP" << endl;
+			return TestFail;
+		}
+
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timer;
+		timer.start(100ms);
+		while (timer.isRunning())
+			dispatcher->processEvents();
+
+		swIsp_->stop();
+
+		for (const auto &[buffer, status] : completions_) {
+			if (status.count != 1) {
+				cerr << "Buffer completed after stop" << endl;
+				return TestFail;
+			}
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		swIsp_.reset();
+		sensor_.reset();
+	}
+
+private:
+	struct Completion {
+		unsigned int count = 0;
+		FrameMetadata::Status status;
+	};
+
+	void bufferReady(FrameBuffer *buffer)
+	{
+		Completion &completion = completions_[buffer];
+		completion.count++;
+		completion.status = buffer->metadata().status;
+	}
+
+	unique_ptr<IPAManager> ipaManager_;
+	shared_ptr<PipelineHandler> pipe_;
+	unique_ptr<DeviceEnumerator> enumerator_;
+	shared_ptr<MediaDevice> media_;
+	unique_ptr<CameraSensor> sensor_;
+	unique_ptr<SoftwareIsp> swIsp_;
+	Stream stream_;
+
+	map<FrameBuffer *, Completion> completions_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(SoftwareIspStopTest)
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Red Hat Inc.
+ *
+ * SwStatsCpu statistics buffers ring tests
+ */
+
+#include <iostream>
+#include <map>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <vector>
+
+#include <libcamera/formats.h>
+#include <libcamera/stream.h>
+
+#include "swstats_cpu.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+class SwStatsCpuTest : public Test
+{
+protected:
+	int run() override
+	{
+		SwStatsCpu stats;
+		if (!stats.isValid()) {
+			cerr << "Failed to create SwStatsCpu" << endl;
+			return TestFail;
+		}
+
+		StreamConfiguration inputCfg;
+		inputCfg.pixelFormat = formats::SBGGR8;
+		inputCfg.size = { kWidth, 2 };
+		if (stats.configure(inputCfg)) {
+			cerr << "Failed to configure SwStatsCpu" << endl;
+			return TestFail;
+		}
+		stats.setWindow(Rectangle(inputCfg.size));
+
+		stats.statsReady.connect(this, [&](uint32_t frame, uint32_t bufferId) {
+			ready_[frame] = bufferId;
+		});
+
+		void *mem = mmap(nullptr, sizeof(SwIspStats) * kSwIspStatsBufferCount,
+				 PROT_READ, MAP_SHARED, stats.getStatsFD().get(), 0);
+		if (mem == MAP_FAILED) {
+			cerr << "Failed to map statistics" << endl;
+			return TestFail;
+		}
+		buffers_ = static_cast<const SwIspStats *>(mem);
+
+		int ret = testRing(stats);
+
+		munmap(mem, sizeof(SwIspStats) * kSwIspStatsBufferCount);
+
+		return ret;
+	}
+
+private:
+	static constexpr unsigned int kWidth = 16;
+
+	/* Gather the statistics of a frame whose pixels all equal frame + 1. */
+	void processFrame(SwStatsCpu &stats, uint32_t frame)
+	{
+		vector<uint8_t> line(kWidth, frame + 1);
+		const uint8_t *src[] = { line.data(), line.data(), line.data() };
+
+		stats.startFrame();
+		stats.processLine0(0, src, 0);
+		stats.finishFrame(frame);
+	}
+
+	bool checkBuffer(uint32_t frame)
+	{
+		auto it = ready_.find(frame);
+		if (it == ready_.end()) {
+			cerr << "No statistics for frame " << frame << endl;
+			return false;
+		}
+
+		/* One sample every other 2x2 block */
+		const uint64_t expected = kWidth / 4 * (frame + 1);
+		const SwIspStats &buffer = buffers_[it->second];
+		if (buffer.sumR_ != expected || buffer.sumB_ != expected) {
+			cerr << "Wrong statistics for frame " << frame << ": "
+			     << buffer.sumR_ << ", expected " << expected << endl;
+			return false;
+		}
+
+		return true;
+	}
+
+	int testRing(SwStatsCpu &stats)
+	{
+		/* Without any release, statistics stop once the ring is full. */
+		for (uint32_t frame = 0; frame < kSwIspStatsBufferCount + 2; frame++)
+			processFrame(stats, frame);
+
+		if (ready_.size() != kSwIspStatsBufferCount) {
+			cerr << "Expected " << kSwIspStatsBufferCount
+			     << " statistics, got " << ready_.size() << endl;
+			return TestFail;
+		}
+
+		/* The dropped frames must not have touched the buffers in use. */
+		for (uint32_t frame = 0; frame < kSwIspStatsBufferCount; frame++) {
+			if (!checkBuffer(frame))
+				return TestFail;
+		}
+
+		/* A released buffer is reused for the next frame. */
+		const uint32_t released = ready_[1];
+		stats.releaseBuffer(released);
+
+		const uint32_t frame = kSwIspStatsBufferCount + 2;
+		processFrame(stats, frame);
+		processFrame(stats, frame + 1);
+
+		if (ready_.size() != kSwIspStatsBufferCount + 1 ||
+		    !ready_.count(frame) || ready_[frame] != released) {
+			cerr << "Released statistics buffer not reused" << endl;
+			return TestFail;
+		}
+
+		if (!checkBuffer(frame))
+			return TestFail;
+
+		return TestPass;
+	}
+
+	map<uint32_t, uint32_t> ready_;
+	const SwIspStats *buffers_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(SwStatsCpuTest)
@@ -0,0 +1,199 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Binary trace recorder test
+ */
+
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+#include "libcamera/internal/trace.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std;
+
+namespace {
+
+/* Mirror of the trace file format, as parsed by utils/tracepoints. */
+struct FileHeader {
+	char magic[8];
+	uint32_t version;
+	uint32_t pid;
+	uint32_t eventsOffset;
+	uint32_t eventSize;
+	uint32_t maxEvents;
+	uint32_t chunksOffset;
+	uint32_t chunkSize;
+	uint32_t recordSize;
+	uint32_t numEvents;
+	uint32_t numChunks;
+	uint32_t dropped;
+	uint32_t reserved;
+	uint64_t monotonicBase;
+	uint64_t realtimeBase;
+};
+
+struct EventInfo {
+	char category[16];
+	char name[80];
+	char args[2][16];
+};
+
+struct Record {
+	uint64_t timestamp;
+	uint16_t event;
+	uint8_t phase;
+	uint8_t reserved[5];
+	uint64_t args[2];
+};
+
+const TraceEvent traceInstant("test", "instant", "index", "thread");
+const TraceEvent traceScope("test", "scope", "thread");
+
+} /* namespace */
+
+class TraceTest : public Test
+{
+protected:
+	static constexpr unsigned int kThreads = 4;
+	static constexpr unsigned int kEvents = 10000;
+
+	int init() override
+	{
+		if (!TraceRecorder::instance()) {
+			cerr << "Trace recorder not enabled" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		vector<thread> threads;
+		for (unsigned int i = 0; i < kThreads; ++i)
+			threads.emplace_back([i]() {
+				TraceScope scope(traceScope, i);
+
+				for (unsigned int j = 0; j < kEvents; ++j)
+					traceInstant.instant(j, i);
+			});
+
+		for (thread &t : threads)
+			t.join();
+
+		ifstream file(path(), ios::binary);
+		vector<char> data{ istreambuf_iterator<char>(file),
+				   istreambuf_iterator<char>() };
+
+		if (data.size() < sizeof(FileHeader)) {
+			cerr << "Trace file too short" << endl;
+			return TestFail;
+		}
+
+		FileHeader header;
+		memcpy(&header, data.data(), sizeof(header));
+
+		if (memcmp(header.magic, "LCTRACE", 8) || header.version != 1 ||
+		    header.pid != static_cast<uint32_t>(getpid()) ||
+		    header.eventSize != sizeof(EventInfo) ||
+		    header.recordSize != sizeof(Record)) {
+			cerr << "Invalid trace file header" << endl;
+			return TestFail;
+		}
+
+		if (header.numEvents != 2) {
+			cerr << "Expected 2 events, got " << header.numEvents << endl;
+			return TestFail;
+		}
+
+		const EventInfo *events =
+			reinterpret_cast<const EventInfo *>(data.data() + header.eventsOffset);
+		if (strcmp(events[0].name, "scope") || strcmp(events[1].name, "instant") ||
+		    strcmp(events[1].args[0], "index")) {
+			cerr << "Invalid event descriptions" << endl;
+			return TestFail;
+		}
+
+		/* Check that events are recorded in order for each thread. */
+		map<uint64_t, int64_t> last;
+		unsigned int recorded = 0;
+
+		for (unsigned int i = 0; i < header.numChunks; ++i) {
+			const char *chunk = data.data() + header.chunksOffset
+					  + i * header.chunkSize;
+			const Record *records = reinterpret_cast<const Record *>(chunk);
+			unsigned int count = header.chunkSize / sizeof(Record);
+
+			for (unsigned int j = 1; j < count && records[j].event; ++j) {
+				const Record &record = records[j];
+				recorded++;
+
+				if (record.event != 2)
+					continue;
+
+				uint64_t thread = record.args[1];
+				auto it = last.try_emplace(thread, -1).first;
+				if (static_cast<int64_t>(record.args[0]) <= it->second) {
+					cerr << "Event " << record.args[0]
+					     << " out of order" << endl;
+					return TestFail;
+				}
+
+				it->second = record.args[0];
+			}
+		}
+
+		/* Each thread also records the begin and end of a scope. */
+		unsigned int total = kThreads * (kEvents + 2);
+		if (recorded + header.dropped != total) {
+			cerr << "Expected " << total << " events, got " << recorded
+			     << " recorded and " << header.dropped << " dropped"
+			     << endl;
+			return TestFail;
+		}
+
+		if (!header.dropped) {
+			cerr << "Trace file expected to overflow" << endl;
+			return TestFail;
+		}
+
+		return TestPass;
+	}
+
+	void cleanup() override
+	{
+		unlink(path().c_str());
+	}
+
+public:
+	static string path()
+	{
+		return "/tmp/libcamera-trace-test-" + to_string(getpid());
+	}
+};
+
+/*
+ * Can't use TEST_REGISTER() as the environment must be set before the trace
+ * recorder is instantiated.
+ */
+int main(int argc, char **argv)
+{
+	setenv("LIBCAMERA_TRACE_FILE", TraceTest::path().c_str(), 1);
+	setenv("LIBCAMERA_TRACE_SIZE", "1", 1);
+
+	TraceTest test;
+	test.setArgs(argc, argv);
+	return test.execute();
+}
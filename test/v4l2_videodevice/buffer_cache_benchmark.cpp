@@ -0,0 +1,170 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Measure the cost of buffer cache lookups at queue time
+ */
+
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <queue>
+#include <random>
+#include <vector>
+
+#include <libcamera/base/memfd.h>
+#include <libcamera/base/shared_fd.h>
+#include <libcamera/base/utils.h>
+
+#include <libcamera/framebuffer.h>
+
+#include "libcamera/internal/v4l2_videodevice.h"
+
+#include "test.h"
+
+using namespace libcamera;
+using namespace std::chrono;
+
+namespace {
+
+class BufferCacheBenchmark : public Test
+{
+protected:
+	int init() override
+	{
+		generator_.seed(std::random_device{}());
+
+		return TestPass;
+	}
+
+	int run() override
+	{
+		for (unsigned int numBuffers : { 4, 32, 128 }) {
+			int ret = benchmark(numBuffers);
+			if (ret != TestPass)
+				return ret;
+		}
+
+		return TestPass;
+	}
+
+private:
+	/*
+	 * Create buffers backed by memfds. Only the file descriptors and
+	 * lengths matter to the cache, the buffers are never mapped.
+	 */
+	int createBuffers(unsigned int count,
+			  std::vector<std::unique_ptr<FrameBuffer>> *buffers)
+	{
+		static constexpr unsigned int kPlaneSize = 4096;
+
+		for (unsigned int i = 0; i < count; ++i) {
+			UniqueFD fd = MemFd::create("buffer", kPlaneSize * 2);
+			if (!fd.isValid()) {
+				std::cerr << "Failed to create memfd" << std::endl;
+				return TestFail;
+			}
+
+			SharedFD shared(std::move(fd));
+			std::vector<FrameBuffer::Plane> planes(2);
+			for (unsigned int j = 0; j < planes.size(); ++j) {
+				planes[j].fd = shared;
+				planes[j].offset = j * kPlaneSize;
+				planes[j].length = kPlaneSize;
+			}
+
+			buffers->push_back(std::make_unique<FrameBuffer>(planes));
+		}
+
+		return TestPass;
+	}
+
+	/*
+	 * Simulate a capture cycle with half of the buffers queued to the
+	 * device. Buffers are dequeued in the order they have been queued, and
+	 * a random buffer owned by the application is queued back for each
+	 * dequeued buffer, to exercise lookups of arbitrary entries. The cache
+	 * is populated on import, and every lookup is expected to hit the entry
+	 * used previously for the same buffer.
+	 */
+	int benchmark(unsigned int numBuffers)
+	{
+		static constexpr unsigned int kIterations = 200000;
+
+		std::vector<std::unique_ptr<FrameBuffer>> buffers;
+		int ret = createBuffers(numBuffers, &buffers);
+		if (ret != TestPass)
+			return ret;
+
+		V4L2BufferCache cache(numBuffers);
+		std::vector<int> indices(numBuffers);
+		std::queue<unsigned int> queued;
+		std::vector<unsigned int> dequeued;
+
+		for (unsigned int i = 0; i < numBuffers; ++i) {
+			indices[i] = cache.get(*buffers[i]);
+			if (indices[i] < 0) {
+				std::cerr << "Failed to import buffer " << i << std::endl;
+				return TestFail;
+			}
+
+			if (i < numBuffers / 2) {
+				queued.push(i);
+			} else {
+				cache.put(indices[i]);
+				dequeued.push_back(i);
+			}
+		}
+
+		std::vector<unsigned int> order;
+		order.reserve(kIterations);
+		std::uniform_int_distribution<unsigned int> dist(0, numBuffers - 1);
+		for (unsigned int i = 0; i < kIterations; ++i)
+			order.push_back(dist(generator_));
+
+		unsigned int mismatches = 0;
+
+		utils::time_point start = utils::clock::now();
+
+		for (unsigned int i = 0; i < kIterations; ++i) {
+			unsigned int buffer = queued.front();
+			queued.pop();
+			cache.put(indices[buffer]);
+			dequeued.push_back(buffer);
+
+			/* Queue a random buffer owned by the application. */
+			unsigned int pick = order[i] % dequeued.size();
+			buffer = dequeued[pick];
+			dequeued[pick] = dequeued.back();
+			dequeued.pop_back();
+
+			int index = cache.get(*buffers[buffer]);
+			if (index != indices[buffer])
+				mismatches++;
+
+			queued.push(buffer);
+		}
+
+		nanoseconds duration = utils::clock::now() - start;
+
+		if (mismatches) {
+			std::cerr << mismatches << " cache misses with "
+				  << numBuffers << " buffers" << std::endl;
+			return TestFail;
+		}
+
+		std::cout << std::setw(3) << numBuffers << " buffers: "
+			  << (duration / kIterations).count()
+			  << "ns per queue/dequeue cycle" << std::endl;
+
+		return TestPass;
+	}
+
+	std::mt19937 generator_;
+};
+
+} /* namespace */
+
+TEST_REGISTER(BufferCacheBenchmark)
@@ -0,0 +1,143 @@
+/* SPDX-License-Identifier: GPL-2.0-or-later */
+/*
+ * Copyright (C) 2024, Google Inc.
+ *
+ * Test completion of bursts of buffers
+ */
+
+#include <iostream>
+#include <unistd.h>
+
+#include <libcamera/framebuffer.h>
+
+#include <libcamera/base/event_dispatcher.h>
+#include <libcamera/base/thread.h>
+#include <libcamera/base/timer.h>
+
+#include "v4l2_videodevice_test.h"
+
+using namespace libcamera;
+using namespace std::chrono_literals;
+
+class CaptureBurstTest : public V4L2VideoDeviceTest
+{
+public:
+	CaptureBurstTest()
+		: V4L2VideoDeviceTest("vimc", "Raw Capture 0"), frames_(0),
+		  burst_(0), lastSequence_(0), nested_(false), stopped_(false),
+		  failed_(false)
+	{
+	}
+
+	void receiveBuffer(FrameBuffer *buffer)
+	{
+		const FrameMetadata &metadata = buffer->metadata();
+
+		burst_++;
+
+		if (metadata.status == FrameMetadata::FrameCancelled)
+			return;
+
+		if (stopped_) {
+			std::cout << "Buffer completed after streamOff()" << std::endl;
+			failed_ = true;
+			return;
+		}
+
+		if (frames_ && metadata.sequence <= lastSequence_) {
+			std::cout << "Buffer " << metadata.sequence
+				  << " completed after " << lastSequence_ << std::endl;
+			failed_ = true;
+		}
+
+		lastSequence_ = metadata.sequence;
+		frames_++;
+
+		/*
+		 * Run a nested event loop for the first buffer, as a slot
+		 * performing a synchronous IPC call would.
+		 */
+		if (!nested_) {
+			nested_ = true;
+			Thread::current()->eventDispatcher()->processEvents();
+		}
+
+		/* Stop the device from the slot once enough frames completed. */
+		if (frames_ >= kStopFrames) {
+			capture_->streamOff();
+			stopped_ = true;
+			return;
+		}
+
+		capture_->queueBuffer(buffer);
+	}
+
+protected:
+	static constexpr unsigned int kBufferCount = 8;
+	static constexpr unsigned int kStopFrames = 20;
+
+	int run()
+	{
+		EventDispatcher *dispatcher = Thread::current()->eventDispatcher();
+		Timer timeout;
+		int ret;
+
+		ret = capture_->allocateBuffers(kBufferCount, &buffers_);
+		if (ret < 0) {
+			std::cout << "Failed to allocate buffers" << std::endl;
+			return TestFail;
+		}
+
+		capture_->bufferReady.connect(this, &CaptureBurstTest::receiveBuffer);
+
+		for (const std::unique_ptr<FrameBuffer> &buffer : buffers_) {
+			if (capture_->queueBuffer(buffer.get())) {
+				std::cout << "Failed to queue buffer" << std::endl;
+				return TestFail;
+			}
+		}
+
+		ret = capture_->streamOn();
+		if (ret)
+			return TestFail;
+
+		/*
+		 * Let the device complete several buffers without processing
+		 * events, they should then all be completed in one go.
+		 */
+		usleep(500000);
+		dispatcher->processEvents();
+
+		if (burst_ < 2) {
+			std::cout << "Buffers not completed in a burst" << std::endl;
+			return TestFail;
+		}
+
+		timeout.start(500ms * kStopFrames);
+		while (timeout.isRunning() && !stopped_)
+			dispatcher->processEvents();
+
+		if (!stopped_) {
+			std::cout << "Failed to capture " << kStopFrames
+				  << " frames within timeout." << std::endl;
+			return TestFail;
+		}
+
+		/* Make sure no buffer is completed after the device stopped. */
+		timeout.start(100ms);
+		while (timeout.isRunning())
+			dispatcher->processEvents();
+
+		return failed_ ? TestFail : TestPass;
+	}
+
+private:
+	unsigned int frames_;
+	unsigned int burst_;
+	unsigned int lastSequence_;
+	bool nested_;
+	bool stopped_;
+	bool failed_;
+};
+
+TEST_REGISTER(CaptureBurstTest)
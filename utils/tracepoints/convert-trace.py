@@ -0,0 +1,164 @@
+#!/usr/bin/env python3
+# SPDX-License-Identifier: GPL-2.0-or-later
+# Copyright (C) 2024, Google Inc.
+#
+# Convert libcamera binary traces to the Chrome trace event JSON format
+
+import argparse
+import json
+import struct
+import sys
+
+MAGIC = b'LCTRACE\0'
+VERSION = 1
+
+# magic, version, pid, eventsOffset, eventSize, maxEvents, chunksOffset,
+# chunkSize, recordSize, numEvents, numChunks, dropped, reserved,
+# monotonicBase, realtimeBase
+HEADER = struct.Struct('=8s12I2Q')
+
+# category, name, args[2]
+EVENT = struct.Struct('=16s80s16s16s')
+
+# timestamp, event, phase, reserved, args[2]
+RECORD = struct.Struct('=QHB5x2Q')
+
+PHASES = {
+    1: 'B',
+    2: 'E',
+    3: 'i',
+    4: 'b',
+    5: 'e',
+}
+
+
+def cstr(data):
+    return data.split(b'\0', 1)[0].decode('utf-8', errors='replace')
+
+
+class Event(object):
+    def __init__(self, data):
+        category, name, arg0, arg1 = EVENT.unpack(data)
+        self.category = cstr(category)
+        self.name = cstr(name)
+        self.args = [cstr(arg0), cstr(arg1)]
+
+
+def parse_trace(path):
+    with open(path, 'rb') as f:
+        data = f.read()
+
+    if len(data) < HEADER.size:
+        raise RuntimeError(f'{path}: file too short')
+
+    magic, version, pid, events_offset, event_size, max_events, \
+        chunks_offset, chunk_size, record_size, num_events, num_chunks, \
+        dropped, _, _, _ = HEADER.unpack_from(data)
+
+    if magic != MAGIC:
+        raise RuntimeError(f'{path}: not a libcamera trace file')
+    if version != VERSION:
+        raise RuntimeError(f'{path}: unsupported version {version}')
+    if event_size != EVENT.size or record_size != RECORD.size:
+        raise RuntimeError(f'{path}: unsupported record format')
+
+    if dropped:
+        sys.stderr.write(f'{path}: {dropped} events dropped, trace file full\n')
+
+    events = []
+    for i in range(min(num_events, max_events)):
+        offset = events_offset + i * event_size
+        events.append(Event(data[offset:offset + event_size]))
+
+    output = []
+    for chunk in range(num_chunks):
+        base = chunks_offset + chunk * chunk_size
+        if base + chunk_size > len(data):
+            break
+
+        # The first record slot stores the ID of the thread owning the chunk.
+        _, _, _, tid, _ = RECORD.unpack_from(data, base)
+
+        for offset in range(base + record_size, base + chunk_size, record_size):
+            timestamp, event_id, phase, arg0, arg1 = RECORD.unpack_from(data, offset)
+            if event_id == 0:
+                break
+
+            if event_id > len(events) or phase not in PHASES:
+                sys.stderr.write(f'{path}: invalid record at offset {offset}\n')
+                break
+
+            event = events[event_id - 1]
+            entry = {
+                'name': event.name,
+                'cat': event.category,
+                'ph': PHASES[phase],
+                'ts': timestamp,
+                'pid': pid,
+                'tid': tid,
+            }
+
+            args = {}
+            if phase in (4, 5):
+                # Asynchronous events are identified by their first argument.
+                entry['id'] = hex(arg0)
+                if event.args[1]:
+                    args[event.args[1]] = arg1
+            else:
+                for name, value in zip(event.args, (arg0, arg1)):
+                    if name:
+                        args[name] = value
+
+            if phase == 3:
+                entry['s'] = 't'
+            if args:
+                entry['args'] = args
+
+            output.append(entry)
+
+    return output
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(
+            description='Convert libcamera binary traces to Chrome trace JSON')
+    parser.add_argument('-o', '--output', type=str, default='-',
+                        help='Output file name (default: standard output)')
+    parser.add_argument('trace', type=str, nargs='+',
+                        help='Path to binary trace files (from LIBCAMERA_TRACE_FILE)')
+    args = parser.parse_args(argv[1:])
+
+    # The monotonic clock is shared by all processes, which allows merging
+    # traces of the camera manager and isolated IPA modules.
+    events = []
+    for path in args.trace:
+        try:
+            events += parse_trace(path)
+        except (OSError, RuntimeError) as e:
+            sys.stderr.write(f'{e}\n')
+            return 1
+
+    # Convert the timestamps from nanoseconds to microseconds.
+    if events:
+        origin = min(e['ts'] for e in events)
+        for event in events:
+            event['ts'] = (event['ts'] - origin) / 1000
+
+    events.sort(key=lambda e: e['ts'])
+
+    trace = {
+        'traceEvents': events,
+        'displayTimeUnit': 'ms',
+    }
+
+    if args.output == '-':
+        json.dump(trace, sys.stdout)
+    else:
+        with open(args.output, 'w') as f:
+            json.dump(trace, f)
+
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main(sys.argv))